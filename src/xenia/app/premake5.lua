@@ -27,6 +27,7 @@ project("xenia-app")
     "xenia-debug-ui",
     "xenia-gpu",
     "xenia-gpu-null",
+    "xenia-gpu-sw",
     "xenia-gpu-vulkan",
     "xenia-hid",
     "xenia-hid-nop",
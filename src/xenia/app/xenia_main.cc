@@ -28,6 +28,7 @@
 
 // Available graphics systems:
 #include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/sw/sw_graphics_system.h"
 #include "xenia/gpu/vulkan/vulkan_graphics_system.h"
 
 // Available input drivers:
@@ -38,7 +39,7 @@
 #endif  // XE_PLATFORM_WIN32
 
 DEFINE_string(apu, "any", "Audio system. Use: [any, nop, xaudio2]");
-DEFINE_string(gpu, "any", "Graphics system. Use: [any, vulkan, null]");
+DEFINE_string(gpu, "any", "Graphics system. Use: [any, vulkan, null, sw]");
 DEFINE_string(hid, "any", "Input system. Use: [any, nop, winkey, xinput]");
 
 DEFINE_string(target, "", "Specifies the target .xex or .iso to execute.");
@@ -80,6 +81,9 @@ std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() {
   } else if (FLAGS_gpu.compare("null") == 0) {
     return std::unique_ptr<gpu::GraphicsSystem>(
         new xe::gpu::null::NullGraphicsSystem());
+  } else if (FLAGS_gpu.compare("sw") == 0) {
+    return std::unique_ptr<gpu::GraphicsSystem>(
+        new xe::gpu::sw::SwGraphicsSystem());
   } else {
     // Create best available.
     std::unique_ptr<gpu::GraphicsSystem> best;
@@ -94,6 +94,10 @@ class FileHandle {
   // Flushes any pending write buffers to the underlying filesystem.
   virtual void Flush() = 0;
 
+  // Hints that the given range will be read soon, so the host can start
+  // loading it into its cache without blocking the caller.
+  virtual void ReadAhead(size_t file_offset, size_t length) {}
+
  protected:
   explicit FileHandle(std::wstring path) : path_(std::move(path)) {}
 
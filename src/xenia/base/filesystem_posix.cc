@@ -11,6 +11,8 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
 
+#include <cstring>
+
 #include <dirent.h>
 #include <fcntl.h>
 #include <ftw.h>
@@ -103,6 +105,9 @@ class PosixFileHandle : public FileHandle {
     return ftruncate(handle_, length) >= 0 ? true : false;
   }
   void Flush() override { fsync(handle_); }
+  void ReadAhead(size_t file_offset, size_t length) override {
+    posix_fadvise(handle_, file_offset, length, POSIX_FADV_WILLNEED);
+  }
 
  private:
   int handle_ = -1;
@@ -140,17 +145,25 @@ std::unique_ptr<FileHandle> FileHandle::OpenExisting(std::wstring path,
   return std::make_unique<PosixFileHandle>(path, handle);
 }
 
+static void FillInfo(const struct stat& st, FileInfo* out_info) {
+  if (S_ISDIR(st.st_mode)) {
+    out_info->type = FileInfo::Type::kDirectory;
+    out_info->total_size = 0;
+  } else {
+    out_info->type = FileInfo::Type::kFile;
+    out_info->total_size = st.st_size;
+  }
+  out_info->create_timestamp = convertUnixtimeToWinFiletime(st.st_ctime);
+  out_info->access_timestamp = convertUnixtimeToWinFiletime(st.st_atime);
+  out_info->write_timestamp = convertUnixtimeToWinFiletime(st.st_mtime);
+}
+
 bool GetInfo(const std::wstring& path, FileInfo* out_info) {
   struct stat st;
   if (stat(xe::to_string(path).c_str(), &st) == 0) {
-    if (S_ISDIR(st.st_mode)) {
-      out_info->type = FileInfo::Type::kDirectory;
-    } else {
-      out_info->type = FileInfo::Type::kFile;
-    }
-    out_info->create_timestamp = convertUnixtimeToWinFiletime(st.st_ctime);
-    out_info->access_timestamp = convertUnixtimeToWinFiletime(st.st_atime);
-    out_info->write_timestamp = convertUnixtimeToWinFiletime(st.st_mtime);
+    FillInfo(st, out_info);
+    out_info->path = xe::find_base_path(path);
+    out_info->name = xe::find_name_from_path(path);
     return true;
   }
   return false;
@@ -164,24 +177,26 @@ std::vector<FileInfo> ListFiles(const std::wstring& path) {
     return result;
   }
 
+  // readdir returns entries from large getdents batches, and each one is
+  // stat'ed relative to the open directory rather than by walking its full
+  // path again.
+  int dir_fd = dirfd(dir);
   while (auto ent = readdir(dir)) {
-    FileInfo info;
-
-    info.name = xe::to_wstring(ent->d_name);
+    if (!std::strcmp(ent->d_name, ".") || !std::strcmp(ent->d_name, "..")) {
+      continue;
+    }
     struct stat st;
-    stat((xe::to_string(path) + xe::to_string(info.name)).c_str(), &st);
-    info.create_timestamp = convertUnixtimeToWinFiletime(st.st_ctime);
-    info.access_timestamp = convertUnixtimeToWinFiletime(st.st_atime);
-    info.write_timestamp = convertUnixtimeToWinFiletime(st.st_mtime);
-    if (ent->d_type == DT_DIR) {
-      info.type = FileInfo::Type::kDirectory;
-      info.total_size = 0;
-    } else {
-      info.type = FileInfo::Type::kFile;
-      info.total_size = st.st_size;
+    if (fstatat(dir_fd, ent->d_name, &st, 0) != 0) {
+      // Removed since it was listed, or a dangling link.
+      continue;
     }
+    FileInfo info;
+    FillInfo(st, &info);
+    info.name = xe::to_wstring(ent->d_name);
+    info.path = path;
     result.push_back(info);
   }
+  closedir(dir);
 
   return result;
 }
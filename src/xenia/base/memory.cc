@@ -12,225 +12,471 @@
 
 #include <algorithm>
 
-namespace xe {
+#if XE_ARCH_AMD64
+#if XE_COMPILER_MSVC
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif  // XE_COMPILER_MSVC
+#endif  // XE_ARCH_AMD64
 
-// TODO(benvanik): fancy AVX versions.
-// http://gnuradio.org/redmine/projects/gnuradio/repository/revisions/cb32b70b79f430456208a2cd521d028e0ece5d5b/entry/volk/kernels/volk/volk_16u_byteswap.h
-// http://gnuradio.org/redmine/projects/gnuradio/repository/revisions/f2bc76cc65ffba51a141950f98e75364e49df874/entry/volk/kernels/volk/volk_32u_byteswap.h
-// http://gnuradio.org/redmine/projects/gnuradio/repository/revisions/2c4c371885c31222362f70a1cd714415d1398021/entry/volk/kernels/volk/volk_64u_byteswap.h
+namespace xe {
 
 void copy_128_aligned(void* dest, const void* src, size_t count) {
   std::memcpy(dest, src, count * 16);
 }
 
+// Byte swapping is done as a byte shuffle within each 128-bit lane, so every
+// element size shares the same kernels and only the lane pattern differs.
+// Kernels return the number of bytes they handled; the rest is swapped by the
+// scalar loop in copy_and_swap_elements.
+typedef size_t (*SwapKernel)(uint8_t* dest, const uint8_t* src, size_t length,
+                             const uint8_t* lane_pattern, bool non_temporal);
+
+alignas(16) static const uint8_t kSwap16Pattern[16] = {
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+alignas(16) static const uint8_t kSwap32Pattern[16] = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+alignas(16) static const uint8_t kSwap64Pattern[16] = {
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+alignas(16) static const uint8_t kSwap16In32Pattern[16] = {
+    2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13};
+
 #if XE_ARCH_AMD64
-void copy_and_swap_16_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
-  assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
-  assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
+#if XE_COMPILER_MSVC
+#define XE_TARGET_AVX2
+#define XE_TARGET_AVX512
+#else
+#define XE_TARGET_AVX2 __attribute__((target("avx2")))
+#define XE_TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#endif  // XE_COMPILER_MSVC
 
-  auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint16_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07,
-                   0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
+static void query_cpuid(uint32_t regs[4], uint32_t leaf, uint32_t subleaf) {
+#if XE_COMPILER_MSVC
+  __cpuidex(reinterpret_cast<int*>(regs), leaf, subleaf);
+#else
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif  // XE_COMPILER_MSVC
+}
 
-  size_t i = 0;
-  for (i = 0; i + 8 <= count; i += 8) {
-    __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-    _mm_store_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+static uint64_t query_xcr0() {
+#if XE_COMPILER_MSVC
+  return _xgetbv(0);
+#else
+  uint32_t xcr0_lo, xcr0_hi;
+  __asm__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+  return (uint64_t(xcr0_hi) << 32) | xcr0_lo;
+#endif  // XE_COMPILER_MSVC
+}
+
+static SwapIsa detect_swap_isa() {
+  uint32_t regs[4];
+  query_cpuid(regs, 0, 0);
+  if (regs[0] < 7) {
+    return SwapIsa::kSSSE3;
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
+  // XGETBV is only available with OSXSAVE.
+  query_cpuid(regs, 1, 0);
+  if (!(regs[2] & (1u << 27))) {
+    return SwapIsa::kSSSE3;
+  }
+  uint64_t xcr0 = query_xcr0();
+  query_cpuid(regs, 7, 0);
+  // The OS must save YMM registers (XCR0 bits 1-2).
+  if ((xcr0 & 0x6) != 0x6 || !(regs[1] & (1u << 5))) {
+    return SwapIsa::kSSSE3;
+  }
+  // AVX-512F and AVX-512BW, with opmask and ZMM state saved (XCR0 bits 5-7).
+  if ((xcr0 & 0xE0) == 0xE0 && (regs[1] & (1u << 16)) &&
+      (regs[1] & (1u << 30))) {
+    return SwapIsa::kAVX512;
   }
+  return SwapIsa::kAVX2;
 }
 
-void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
-  auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint16_t*>(src_ptr);
+static size_t swap_bytes_ssse3(uint8_t* dest, const uint8_t* src,
+                               size_t length, const uint8_t* lane_pattern,
+                               bool non_temporal) {
   __m128i shufmask =
-      _mm_set_epi8(0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07,
-                   0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
+      _mm_load_si128(reinterpret_cast<const __m128i*>(lane_pattern));
 
   size_t i;
-  for (i = 0; i + 8 <= count; i += 8) {
+  if (non_temporal) {
+    for (i = 0; i + 16 <= length; i += 16) {
+      __m128i input =
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+      __m128i output = _mm_shuffle_epi8(input, shufmask);
+      _mm_stream_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+    }
+    _mm_sfence();
+    return i;
+  }
+  for (i = 0; i + 16 <= length; i += 16) {
     __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
     __m128i output = _mm_shuffle_epi8(input, shufmask);
     _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
-  }
+  return i;
 }
 
-void copy_and_swap_32_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
-  assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
-  assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
-
-  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
-                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+XE_TARGET_AVX2 static size_t swap_bytes_avx2(uint8_t* dest, const uint8_t* src,
+                                             size_t length,
+                                             const uint8_t* lane_pattern,
+                                             bool non_temporal) {
+  __m256i shufmask = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(lane_pattern)));
 
   size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
-    __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-    _mm_store_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-  }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
+  if (non_temporal) {
+    for (i = 0; i + 32 <= length; i += 32) {
+      __m256i input =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+      __m256i output = _mm256_shuffle_epi8(input, shufmask);
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
+    }
+    _mm_sfence();
+  } else {
+    for (i = 0; i + 64 <= length; i += 64) {
+      __m256i input0 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+      __m256i input1 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 32]));
+      __m256i output0 = _mm256_shuffle_epi8(input0, shufmask);
+      __m256i output1 = _mm256_shuffle_epi8(input1, shufmask);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output0);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 32]), output1);
+    }
+    for (; i + 32 <= length; i += 32) {
+      __m256i input =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+      __m256i output = _mm256_shuffle_epi8(input, shufmask);
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
+    }
   }
+  // Handle the last 16 bytes with SSSE3.
+  return i + swap_bytes_ssse3(dest + i, src + i, length - i, lane_pattern,
+                              false);
 }
 
-void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
-  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
-                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+XE_TARGET_AVX512 static size_t swap_bytes_avx512(uint8_t* dest,
+                                                 const uint8_t* src,
+                                                 size_t length,
+                                                 const uint8_t* lane_pattern,
+                                                 bool non_temporal) {
+  __m512i shufmask = _mm512_broadcast_i32x4(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(lane_pattern)));
 
   size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
-    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+  if (non_temporal) {
+    for (i = 0; i + 64 <= length; i += 64) {
+      __m512i input = _mm512_loadu_si512(&src[i]);
+      __m512i output = _mm512_shuffle_epi8(input, shufmask);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(&dest[i]), output);
+    }
+    _mm_sfence();
+  } else {
+    for (i = 0; i + 64 <= length; i += 64) {
+      __m512i input = _mm512_loadu_si512(&src[i]);
+      __m512i output = _mm512_shuffle_epi8(input, shufmask);
+      _mm512_storeu_si512(&dest[i], output);
+    }
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
+  // Masked loads and stores cover the tail without touching bytes past it.
+  if (i < length) {
+    __mmask64 tail_mask = ~__mmask64(0) >> (64 - (length - i));
+    __m512i input = _mm512_maskz_loadu_epi8(tail_mask, &src[i]);
+    __m512i output = _mm512_shuffle_epi8(input, shufmask);
+    _mm512_mask_storeu_epi8(&dest[i], tail_mask, output);
   }
+  return length;
 }
 
-void copy_and_swap_64_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
-  assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
-  assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
+SwapIsa host_swap_isa() {
+  static const SwapIsa isa = detect_swap_isa();
+  return isa;
+}
+#else
+SwapIsa host_swap_isa() { return SwapIsa::kGeneric; }
+#endif  // XE_ARCH_AMD64
 
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x00, 0x01,
-                   0x02, 0x03, 0x04, 0x05, 0x06, 0x07);
+// Not synchronized: overrides are expected before any copies are in flight.
+static SwapIsa& active_swap_isa() {
+  static SwapIsa isa = host_swap_isa();
+  return isa;
+}
 
-  size_t i;
-  for (i = 0; i + 2 <= count; i += 2) {
-    __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-    _mm_store_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+SwapIsa swap_isa() { return active_swap_isa(); }
+
+bool set_swap_isa(SwapIsa isa) {
+  if (isa > host_swap_isa()) {
+    return false;
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
+  active_swap_isa() = isa;
+  return true;
+}
+
+const char* swap_isa_name(SwapIsa isa) {
+  switch (isa) {
+    case SwapIsa::kGeneric:
+      return "generic";
+    case SwapIsa::kSSSE3:
+      return "SSSE3";
+    case SwapIsa::kAVX2:
+      return "AVX2";
+    case SwapIsa::kAVX512:
+      return "AVX-512";
   }
+  return "unknown";
 }
 
-void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x00, 0x01,
-                   0x02, 0x03, 0x04, 0x05, 0x06, 0x07);
+template <typename T, typename F>
+static void copy_and_swap_elements(void* dest_ptr, const void* src_ptr,
+                                   size_t count, const uint8_t* lane_pattern,
+                                   F swap) {
+  auto dest = reinterpret_cast<T*>(dest_ptr);
+  auto src = reinterpret_cast<const T*>(src_ptr);
 
-  size_t i;
-  for (i = 0; i + 2 <= count; i += 2) {
-    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+  SwapKernel kernel = nullptr;
+  size_t vector_size = 0;
+  switch (swap_isa()) {
+#if XE_ARCH_AMD64
+    case SwapIsa::kSSSE3:
+      kernel = swap_bytes_ssse3;
+      vector_size = 16;
+      break;
+    case SwapIsa::kAVX2:
+      kernel = swap_bytes_avx2;
+      vector_size = 32;
+      break;
+    case SwapIsa::kAVX512:
+      kernel = swap_bytes_avx512;
+      vector_size = 64;
+      break;
+#endif  // XE_ARCH_AMD64
+    default:
+      break;
+  }
+
+  size_t i = 0;
+  if (kernel) {
+    // Streaming stores need an aligned destination, so elements up to the
+    // first vector boundary are swapped individually.
+    bool non_temporal = false;
+    if (count * sizeof(T) >= kCopyAndSwapNonTemporalThreshold) {
+      size_t misalignment =
+          reinterpret_cast<uintptr_t>(dest) & (vector_size - 1);
+      if (!(misalignment % sizeof(T))) {
+        non_temporal = true;
+        size_t head = ((vector_size - misalignment) & (vector_size - 1)) /
+                      sizeof(T);
+        for (; i < head; ++i) {
+          dest[i] = swap(src[i]);
+        }
+      }
+    }
+    i += kernel(reinterpret_cast<uint8_t*>(dest + i),
+                reinterpret_cast<const uint8_t*>(src + i),
+                (count - i) * sizeof(T), lane_pattern, non_temporal) /
+         sizeof(T);
   }
   for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
+    dest[i] = swap(src[i]);
   }
 }
 
-void copy_and_swap_16_in_32_aligned(void* dest_ptr, const void* src_ptr,
+// The aligned variants share the unaligned kernels: on AVX capable hosts
+// unaligned loads and stores of aligned data cost the same as aligned ones.
+void copy_and_swap_16_aligned(void* dest, const void* src, size_t count) {
+  assert_zero(reinterpret_cast<uintptr_t>(dest) & 0xF);
+  assert_zero(reinterpret_cast<uintptr_t>(src) & 0xF);
+  copy_and_swap_16_unaligned(dest, src, count);
+}
+
+void copy_and_swap_16_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_elements<uint16_t>(
+      dest, src, count, kSwap16Pattern,
+      [](uint16_t value) { return byte_swap(value); });
+}
+
+void copy_and_swap_32_aligned(void* dest, const void* src, size_t count) {
+  assert_zero(reinterpret_cast<uintptr_t>(dest) & 0xF);
+  assert_zero(reinterpret_cast<uintptr_t>(src) & 0xF);
+  copy_and_swap_32_unaligned(dest, src, count);
+}
+
+void copy_and_swap_32_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_elements<uint32_t>(
+      dest, src, count, kSwap32Pattern,
+      [](uint32_t value) { return byte_swap(value); });
+}
+
+void copy_and_swap_64_aligned(void* dest, const void* src, size_t count) {
+  assert_zero(reinterpret_cast<uintptr_t>(dest) & 0xF);
+  assert_zero(reinterpret_cast<uintptr_t>(src) & 0xF);
+  copy_and_swap_64_unaligned(dest, src, count);
+}
+
+void copy_and_swap_64_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_elements<uint64_t>(
+      dest, src, count, kSwap64Pattern,
+      [](uint64_t value) { return byte_swap(value); });
+}
+
+void copy_and_swap_16_in_32_aligned(void* dest, const void* src,
                                     size_t count) {
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
+  assert_zero(reinterpret_cast<uintptr_t>(dest) & 0xF);
+  assert_zero(reinterpret_cast<uintptr_t>(src) & 0xF);
+  copy_and_swap_16_in_32_unaligned(dest, src, count);
+}
+
+void copy_and_swap_16_in_32_unaligned(void* dest, const void* src,
+                                      size_t count) {
+  copy_and_swap_elements<uint32_t>(
+      dest, src, count, kSwap16In32Pattern,
+      [](uint32_t value) { return (value >> 16) | (value << 16); });
+}
+
+// Primitive restart index conversion.
+
+template <typename T>
+static void copy_cmp_swap_generic(T* dest, const T* src, T cmp_value,
+                                  size_t count) {
+  for (size_t i = 0; i < count; ++i) {
+    T value = byte_swap(src[i]);
+    dest[i] = value == cmp_value ? T(~T(0)) : value;
+  }
+}
+
+#if XE_ARCH_AMD64
+static void copy_cmp_swap_16_ssse3(uint16_t* dest, const uint16_t* src,
+                                   uint16_t cmp_value, size_t count) {
+  __m128i shufmask =
+      _mm_set_epi8(0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07,
+                   0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
+  __m128i cmpval = _mm_set1_epi16(cmp_value);
+
   size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
-    __m128i input = _mm_load_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output =
-        _mm_or_si128(_mm_slli_epi32(input, 16), _mm_srli_epi32(input, 16));
-    _mm_store_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
+  for (i = 0; i + 16 <= count; i += 16) {
+    __m128i input0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i input1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i + 8]));
+    __m128i output0 = _mm_shuffle_epi8(input0, shufmask);
+    __m128i output1 = _mm_shuffle_epi8(input1, shufmask);
+    output0 = _mm_or_si128(output0, _mm_cmpeq_epi16(output0, cmpval));
+    output1 = _mm_or_si128(output1, _mm_cmpeq_epi16(output1, cmpval));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i + 8]), output1);
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = (src[i] >> 16) | (src[i] << 16);
+  for (; i + 8 <= count; i += 8) {
+    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i output = _mm_shuffle_epi8(input, shufmask);
+    output = _mm_or_si128(output, _mm_cmpeq_epi16(output, cmpval));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
   }
+  // Handle residual elements.
+  copy_cmp_swap_generic(dest + i, src + i, cmp_value, count - i);
 }
 
-void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                      size_t count) {
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
+static void copy_cmp_swap_32_ssse3(uint32_t* dest, const uint32_t* src,
+                                   uint32_t cmp_value, size_t count) {
+  __m128i shufmask =
+      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
+                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+  __m128i cmpval = _mm_set1_epi32(cmp_value);
+
   size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m128i input0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i input1 =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i + 4]));
+    __m128i output0 = _mm_shuffle_epi8(input0, shufmask);
+    __m128i output1 = _mm_shuffle_epi8(input1, shufmask);
+    output0 = _mm_or_si128(output0, _mm_cmpeq_epi32(output0, cmpval));
+    output1 = _mm_or_si128(output1, _mm_cmpeq_epi32(output1, cmpval));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i + 4]), output1);
+  }
+  for (; i + 4 <= count; i += 4) {
     __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output =
-        _mm_or_si128(_mm_slli_epi32(input, 16), _mm_srli_epi32(input, 16));
+    __m128i output = _mm_shuffle_epi8(input, shufmask);
+    output = _mm_or_si128(output, _mm_cmpeq_epi32(output, cmpval));
     _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
   }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = (src[i] >> 16) | (src[i] << 16);
-  }
-}
-#else
-// Generic routines.
-void copy_and_swap_16_aligned(void* dest, const void* src, size_t count) {
-  return copy_and_swap_16_unaligned(dest, src, count);
+  // Handle residual elements.
+  copy_cmp_swap_generic(dest + i, src + i, cmp_value, count - i);
 }
 
-void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
-  auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint16_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = byte_swap(src[i]);
+XE_TARGET_AVX2 static void copy_cmp_swap_16_avx2(uint16_t* dest,
+                                                 const uint16_t* src,
+                                                 uint16_t cmp_value,
+                                                 size_t count) {
+  __m256i shufmask = _mm256_set_epi8(
+      0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07, 0x04, 0x05,
+      0x02, 0x03, 0x00, 0x01, 0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09,
+      0x06, 0x07, 0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
+  __m256i cmpval = _mm256_set1_epi16(cmp_value);
+
+  size_t i;
+  for (i = 0; i + 16 <= count; i += 16) {
+    __m256i input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+    __m256i output = _mm256_shuffle_epi8(input, shufmask);
+    output = _mm256_or_si256(output, _mm256_cmpeq_epi16(output, cmpval));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
   }
+  copy_cmp_swap_16_ssse3(dest + i, src + i, cmp_value, count - i);
 }
 
-void copy_and_swap_32_aligned(void* dest, const void* src, size_t count) {
-  return copy_and_swap_32_unaligned(dest, src, count);
-}
+XE_TARGET_AVX2 static void copy_cmp_swap_32_avx2(uint32_t* dest,
+                                                 const uint32_t* src,
+                                                 uint32_t cmp_value,
+                                                 size_t count) {
+  __m256i shufmask = _mm256_set_epi8(
+      0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05, 0x06, 0x07,
+      0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B,
+      0x04, 0x05, 0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+  __m256i cmpval = _mm256_set1_epi32(cmp_value);
 
-void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
-  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = byte_swap(src[i]);
+  size_t i;
+  for (i = 0; i + 8 <= count; i += 8) {
+    __m256i input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
+    __m256i output = _mm256_shuffle_epi8(input, shufmask);
+    output = _mm256_or_si256(output, _mm256_cmpeq_epi32(output, cmpval));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
   }
+  copy_cmp_swap_32_ssse3(dest + i, src + i, cmp_value, count - i);
 }
 
-void copy_and_swap_64_aligned(void* dest, const void* src, size_t count) {
-  return copy_and_swap_64_unaligned(dest, src, count);
+void copy_cmp_swap_16_unaligned(void* dest, const void* src, uint16_t cmp_value,
+                                size_t count) {
+  auto kernel = swap_isa() >= SwapIsa::kAVX2 ? copy_cmp_swap_16_avx2
+                                             : copy_cmp_swap_16_ssse3;
+  kernel(reinterpret_cast<uint16_t*>(dest),
+         reinterpret_cast<const uint16_t*>(src), cmp_value, count);
 }
 
-void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
+void copy_cmp_swap_32_unaligned(void* dest, const void* src, uint32_t cmp_value,
                                 size_t count) {
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = byte_swap(src[i]);
-  }
+  auto kernel = swap_isa() >= SwapIsa::kAVX2 ? copy_cmp_swap_32_avx2
+                                             : copy_cmp_swap_32_ssse3;
+  kernel(reinterpret_cast<uint32_t*>(dest),
+         reinterpret_cast<const uint32_t*>(src), cmp_value, count);
 }
-
-void copy_and_swap_16_in_32_aligned(void* dest, const void* src, size_t count) {
-  return copy_and_swap_16_in_32_unaligned(dest, src, count);
+#else
+void copy_cmp_swap_16_unaligned(void* dest, const void* src, uint16_t cmp_value,
+                                size_t count) {
+  copy_cmp_swap_generic(reinterpret_cast<uint16_t*>(dest),
+                        reinterpret_cast<const uint16_t*>(src), cmp_value,
+                        count);
 }
 
-void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                      size_t count) {
-  auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint64_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    dest[i] = (src[i] >> 16) | (src[i] << 16);
-  }
+void copy_cmp_swap_32_unaligned(void* dest, const void* src, uint32_t cmp_value,
+                                size_t count) {
+  copy_cmp_swap_generic(reinterpret_cast<uint32_t*>(dest),
+                        reinterpret_cast<const uint32_t*>(src), cmp_value,
+                        count);
 }
-#endif
+#endif  // XE_ARCH_AMD64
 
 }  // namespace xe
@@ -70,6 +70,12 @@ bool Protect(void* base_address, size_t length, PageAccess access,
 // the region.
 bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out);
 
+// Hints that a range of file-backed memory will be read soon, so the host can
+// page it in with a few large requests rather than one fault at a time. The
+// range is widened to page_size(). Returns false if the hint is not
+// supported; the memory is readable either way.
+bool Prefetch(const void* base_address, size_t length);
+
 // Allocates a block of memory for a type with the given alignment.
 // The memory must be freed with AlignedFree.
 template <typename T>
@@ -123,16 +129,46 @@ inline void* low_address(void* address) {
 
 void copy_128_aligned(void* dest, const void* src, size_t count);
 
+// Vector instruction sets the copy_and_swap family can be dispatched to.
+enum class SwapIsa {
+  kGeneric,
+  kSSSE3,
+  kAVX2,
+  kAVX512,
+};
+
+// Best instruction set supported by the host, detected once with CPUID.
+SwapIsa host_swap_isa();
+// Instruction set currently used; defaults to host_swap_isa().
+SwapIsa swap_isa();
+// Forces a lower instruction set, for benchmarks and tests. Returns false if
+// the host does not support isa. Must not race with copies on other threads.
+bool set_swap_isa(SwapIsa isa);
+const char* swap_isa_name(SwapIsa isa);
+
+// Copies of at least this many bytes use non-temporal stores, as the data is
+// usually consumed by the GPU or another thread rather than by the caller.
+constexpr size_t kCopyAndSwapNonTemporalThreshold = 1024 * 1024;
+
 void copy_and_swap_16_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_16_unaligned(void* dest, const void* src, size_t count);
 void copy_and_swap_32_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_32_unaligned(void* dest, const void* src, size_t count);
 void copy_and_swap_64_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_64_unaligned(void* dest, const void* src, size_t count);
+// Swaps the 16-bit halves of count 32-bit values.
 void copy_and_swap_16_in_32_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_16_in_32_unaligned(void* dest, const void* src,
                                       size_t count);
 
+// Byte swaps like copy_and_swap_*_unaligned and replaces every swapped value
+// equal to cmp_value with all ones, which is how primitive restart indices are
+// converted to the host's fixed restart index.
+void copy_cmp_swap_16_unaligned(void* dest, const void* src, uint16_t cmp_value,
+                                size_t count);
+void copy_cmp_swap_32_unaligned(void* dest, const void* src, uint32_t cmp_value,
+                                size_t count);
+
 template <typename T>
 void copy_and_swap(T* dest, const T* src, size_t count) {
   bool is_aligned = reinterpret_cast<uintptr_t>(dest) % 32 == 0 &&
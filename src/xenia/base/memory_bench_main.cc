@@ -0,0 +1,125 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+
+DEFINE_int32(memory_bench_max_size, 64 * 1024 * 1024,
+             "Largest copy size in bytes; sizes grow by 8x from 4 KiB.");
+DEFINE_int32(memory_bench_bytes_per_run, 512 * 1024 * 1024,
+             "Bytes copied per measurement, split into as many copies of the "
+             "current size as needed.");
+
+namespace xe {
+
+// Measures the copy_and_swap family under every instruction set the host
+// supports, across sizes on both sides of the non-temporal threshold and
+// across source and destination alignments.
+class MemoryBench {
+ public:
+  void Run() {
+    XELOGI("copy_and_swap benchmark: host supports %s, non-temporal stores "
+           "from %zu bytes",
+           swap_isa_name(host_swap_isa()), kCopyAndSwapNonTemporalThreshold);
+
+    size_t max_size = size_t(std::max(FLAGS_memory_bench_max_size, 4096));
+    // Extra room for the misaligned runs.
+    src_.resize(max_size + 64);
+    dest_.resize(max_size + 64);
+    std::mt19937 random(0x58454E49);
+    for (auto& value : src_) {
+      value = uint8_t(random());
+    }
+
+    SwapIsa original_isa = swap_isa();
+    for (int isa = int(SwapIsa::kGeneric); isa <= int(host_swap_isa());
+         ++isa) {
+      set_swap_isa(SwapIsa(isa));
+      XELOGI("%s:", swap_isa_name(SwapIsa(isa)));
+      for (size_t size = 4096; size <= max_size; size *= 8) {
+        BenchSize(size);
+      }
+    }
+    set_swap_isa(original_isa);
+  }
+
+ private:
+  struct Variant {
+    const char* name;
+    size_t element_size;
+    void (*fn)(void* dest, const void* src, size_t count);
+  };
+
+  void BenchSize(size_t size) {
+    const Variant variants[] = {
+        {"16", 2, copy_and_swap_16_unaligned},
+        {"32", 4, copy_and_swap_32_unaligned},
+        {"64", 8, copy_and_swap_64_unaligned},
+        {"16_in_32", 4, copy_and_swap_16_in_32_unaligned},
+    };
+    // Destination and source offsets from a 64 byte boundary.
+    const size_t alignments[][2] = {{0, 0}, {0, 4}, {8, 0}, {1, 3}};
+    for (size_t i = 0; i < xe::countof(variants); ++i) {
+      const auto& variant = variants[i];
+      for (size_t j = 0; j < xe::countof(alignments); ++j) {
+        Measure(variant, size, alignments[j][0], alignments[j][1]);
+      }
+    }
+  }
+
+  static uint8_t* AlignTo64(uint8_t* ptr) {
+    uintptr_t address = reinterpret_cast<uintptr_t>(ptr);
+    return ptr + (xe::align(address, uintptr_t(64)) - address);
+  }
+
+  void Measure(const Variant& variant, size_t size, size_t dest_offset,
+               size_t src_offset) {
+    uint8_t* dest = AlignTo64(dest_.data()) + dest_offset;
+    const uint8_t* src = AlignTo64(src_.data()) + src_offset;
+    size_t count = size / variant.element_size;
+    size_t runs = std::max(
+        size_t(FLAGS_memory_bench_bytes_per_run) / size, size_t(1));
+
+    // Warm up caches and the page tables.
+    variant.fn(dest, src, count);
+    uint64_t start = Clock::QueryHostTickCount();
+    for (size_t i = 0; i < runs; ++i) {
+      variant.fn(dest, src, count);
+    }
+    uint64_t ticks = Clock::QueryHostTickCount() - start;
+    double seconds = double(ticks) / double(Clock::host_tick_frequency());
+    double gb_per_second = double(size) * runs / seconds / 1.0e9;
+    XELOGI("  copy_and_swap_%-8s %9zu bytes dest+%zu src+%zu %8.2f GB/s",
+           variant.name, size, dest_offset, src_offset, gb_per_second);
+  }
+
+  std::vector<uint8_t> src_;
+  std::vector<uint8_t> dest_;
+};
+
+int memory_bench_main(const std::vector<std::wstring>& args) {
+  MemoryBench bench;
+  bench.Run();
+  return 0;
+}
+
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-base-memory-bench", L"xenia-base-memory-bench",
+                   xe::memory_bench_main);
@@ -61,6 +61,14 @@ bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out) {
   return false;
 }
 
+bool Prefetch(const void* base_address, size_t length) {
+  size_t page_mask = page_size() - 1;
+  uintptr_t start = reinterpret_cast<uintptr_t>(base_address) & ~page_mask;
+  uintptr_t end = reinterpret_cast<uintptr_t>(base_address) + length;
+  return madvise(reinterpret_cast<void*>(start), end - start, MADV_WILLNEED) ==
+         0;
+}
+
 FileMappingHandle CreateFileMappingHandle(std::wstring path, size_t length,
                                           PageAccess access, bool commit) {
   int oflag;
@@ -142,6 +142,26 @@ bool QueryProtect(void* base_address, size_t& length, PageAccess& access_out) {
   return true;
 }
 
+bool Prefetch(const void* base_address, size_t length) {
+  // PrefetchVirtualMemory only exists on Windows 8 and newer.
+  struct MemoryRangeEntry {
+    PVOID virtual_address;
+    SIZE_T number_of_bytes;
+  };
+  typedef BOOL(WINAPI * PrefetchVirtualMemoryFn)(HANDLE, ULONG_PTR,
+                                                 MemoryRangeEntry*, ULONG);
+  static auto prefetch_virtual_memory =
+      reinterpret_cast<PrefetchVirtualMemoryFn>(GetProcAddress(
+          GetModuleHandleW(L"kernel32.dll"), "PrefetchVirtualMemory"));
+  if (!prefetch_virtual_memory) {
+    return false;
+  }
+  MemoryRangeEntry range;
+  range.virtual_address = const_cast<void*>(base_address);
+  range.number_of_bytes = length;
+  return prefetch_virtual_memory(GetCurrentProcess(), 1, &range, 0) != FALSE;
+}
+
 FileMappingHandle CreateFileMappingHandle(std::wstring path, size_t length,
                                           PageAccess access, bool commit) {
   DWORD protect =
@@ -17,3 +17,21 @@ project("xenia-base")
   })
 
 include("testing")
+
+project("xenia-base-memory-bench")
+  uuid("6d0f3b58-2c1e-4a97-b3d4-8e5f17a2c940")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "gflags",
+    "xenia-base",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "memory_bench_main.cc",
+    "main_"..platform_suffix..".cc",
+  })
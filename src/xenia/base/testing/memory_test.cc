@@ -9,6 +9,10 @@
 
 #include "xenia/base/memory.h"
 
+#include <chrono>
+#include <random>
+#include <vector>
+
 #include "third_party/catch/include/catch.hpp"
 
 namespace xe {
@@ -405,13 +409,233 @@ TEST_CASE("copy_and_swap_64_unaligned", "Copy and Swap") {
 }
 
 TEST_CASE("copy_and_swap_16_in_32_aligned", "Copy and Swap") {
-  // TODO(bwrsandman): test once properly understood.
-  REQUIRE(true == true);
+  alignas(16) uint32_t a[8] = {0x00010002, 0x00030004, 0x00050006,
+                               0x00070008, 0x0009000A, 0x000B000C,
+                               0x000D000E, 0x000F0010};
+  alignas(16) uint32_t b[8] = {0};
+
+  copy_and_swap_16_in_32_aligned(b, a, 8);
+  for (uint32_t i = 0; i < 8; ++i) {
+    REQUIRE(b[i] == (((2 * i + 2) << 16) | (2 * i + 1)));
+  }
+
+  std::memset(b, 0, sizeof(b));
+  copy_and_swap_16_in_32_aligned(b, a, 5);
+  REQUIRE(b[4] == 0x000A0009);
+  REQUIRE(b[5] == 0);
 }
 
 TEST_CASE("copy_and_swap_16_in_32_unaligned", "Copy and Swap") {
-  // TODO(bwrsandman): test once properly understood.
-  REQUIRE(true == true);
+  uint8_t a[36], b[36];
+  for (uint8_t i = 0; i < 36; ++i) {
+    a[i] = i;
+  }
+
+  std::memset(b, 0, sizeof(b));
+  copy_and_swap_16_in_32_unaligned(b + 1, a + 3, 8);
+  for (size_t i = 0; i < 8; ++i) {
+    REQUIRE(b[1 + i * 4 + 0] == 3 + i * 4 + 2);
+    REQUIRE(b[1 + i * 4 + 1] == 3 + i * 4 + 3);
+    REQUIRE(b[1 + i * 4 + 2] == 3 + i * 4 + 0);
+    REQUIRE(b[1 + i * 4 + 3] == 3 + i * 4 + 1);
+  }
+  REQUIRE(b[0] == 0);
+  REQUIRE(b[33] == 0);
+}
+
+// Runs every copy_and_swap variant under each instruction set the host
+// supports, across lengths, misalignments and the non-temporal threshold.
+template <typename T, typename F, typename S>
+static void test_copy_and_swap_isas(F fn, S swap) {
+  const size_t large_count = kCopyAndSwapNonTemporalThreshold / sizeof(T) + 37;
+  std::vector<T> src(large_count + 16);
+  std::mt19937_64 random(sizeof(T));
+  for (auto& value : src) {
+    value = T(random());
+  }
+  std::vector<T> dest(src.size() + 1);
+
+  SwapIsa original_isa = swap_isa();
+  for (int isa = int(SwapIsa::kGeneric); isa <= int(host_swap_isa()); ++isa) {
+    REQUIRE(set_swap_isa(SwapIsa(isa)));
+    auto check = [&](size_t dest_offset, size_t src_offset, size_t count) {
+      std::fill(dest.begin(), dest.end(), T(0x5A5A5A5A));
+      fn(dest.data() + dest_offset, src.data() + src_offset, count);
+      for (size_t i = 0; i < count; ++i) {
+        if (dest[dest_offset + i] != swap(src[src_offset + i])) {
+          FAIL(swap_isa_name(SwapIsa(isa)) << " mismatch at " << i << " of "
+                                           << count);
+        }
+      }
+      REQUIRE(dest[dest_offset + count] == T(0x5A5A5A5A));
+    };
+    for (size_t offset = 0; offset < 9; ++offset) {
+      for (size_t count = 0; count <= 80; ++count) {
+        check(offset, 8 - offset, count);
+      }
+      check(offset, 8 - offset, large_count);
+    }
+  }
+  set_swap_isa(original_isa);
+}
+
+TEST_CASE("copy_and_swap ISA dispatch", "Copy and Swap") {
+  REQUIRE(swap_isa() <= host_swap_isa());
+  REQUIRE(!set_swap_isa(SwapIsa(int(host_swap_isa()) + 1)));
+
+  test_copy_and_swap_isas<uint16_t>(
+      copy_and_swap_16_unaligned,
+      [](uint16_t value) { return byte_swap(value); });
+  test_copy_and_swap_isas<uint32_t>(
+      copy_and_swap_32_unaligned,
+      [](uint32_t value) { return byte_swap(value); });
+  test_copy_and_swap_isas<uint64_t>(
+      copy_and_swap_64_unaligned,
+      [](uint64_t value) { return byte_swap(value); });
+  test_copy_and_swap_isas<uint32_t>(
+      copy_and_swap_16_in_32_unaligned,
+      [](uint32_t value) { return (value >> 16) | (value << 16); });
+}
+
+template <typename T>
+static std::vector<T> copy_cmp_swap_reference(const std::vector<T>& src,
+                                              size_t offset, T cmp_value,
+                                              size_t count) {
+  std::vector<T> dest(count);
+  for (size_t i = 0; i < count; ++i) {
+    T value = byte_swap(src[offset + i]);
+    dest[i] = value == cmp_value ? T(~T(0)) : value;
+  }
+  return dest;
+}
+
+// Checks every length and start element up to a few vector widths so both
+// the vector loops and the residual handling are covered.
+template <typename T, typename F>
+static void test_copy_cmp_swap_lengths(F fn, T cmp_value) {
+  std::mt19937 random(0x1234);
+  std::vector<T> src(256);
+  for (size_t i = 0; i < src.size(); ++i) {
+    T value = random() % 3 ? T(random()) : cmp_value;
+    src[i] = byte_swap(value);
+  }
+  for (size_t offset = 0; offset < 16; ++offset) {
+    for (size_t count = 0; count <= 100; ++count) {
+      // Guard elements catch writes past the end.
+      std::vector<T> dest(count + 1, T(0x5A5A5A5A));
+      fn(dest.data(), src.data() + offset, cmp_value, count);
+      auto expected = copy_cmp_swap_reference(src, offset, cmp_value, count);
+      REQUIRE(std::equal(expected.begin(), expected.end(), dest.begin()));
+      REQUIRE(dest[count] == T(0x5A5A5A5A));
+    }
+  }
+}
+
+TEST_CASE("copy_cmp_swap_16_unaligned", "Copy and Swap") {
+  // Every index value against a spread of restart indices.
+  std::vector<uint16_t> src(0x10000);
+  for (uint32_t i = 0; i < 0x10000; ++i) {
+    src[i] = byte_swap(uint16_t(i));
+  }
+  const uint16_t cmp_values[] = {0x0000, 0x0001, 0x00FF, 0x7FFF,
+                                 0x8000, 0xABCD, 0xFF00, 0xFFFF};
+  std::vector<uint16_t> dest(src.size());
+  for (auto cmp_value : cmp_values) {
+    copy_cmp_swap_16_unaligned(dest.data(), src.data(), cmp_value, src.size());
+    REQUIRE(dest == copy_cmp_swap_reference<uint16_t>(src, 0, cmp_value,
+                                                      src.size()));
+  }
+
+  // Every restart index, placed in each lane of a vector.
+  std::vector<uint16_t> lanes(40);
+  std::vector<uint16_t> lanes_dest(lanes.size());
+  for (uint32_t cmp_value = 0; cmp_value < 0x10000; ++cmp_value) {
+    for (size_t i = 0; i < lanes.size(); ++i) {
+      uint16_t value = i % 3 ? uint16_t(cmp_value ^ (1 << (i % 16)))
+                             : uint16_t(cmp_value);
+      lanes[i] = byte_swap(value);
+    }
+    copy_cmp_swap_16_unaligned(lanes_dest.data(), lanes.data(),
+                               uint16_t(cmp_value), lanes.size());
+    REQUIRE(lanes_dest ==
+            copy_cmp_swap_reference<uint16_t>(lanes, 0, uint16_t(cmp_value),
+                                              lanes.size()));
+  }
+
+  for (auto cmp_value : cmp_values) {
+    test_copy_cmp_swap_lengths<uint16_t>(copy_cmp_swap_16_unaligned,
+                                         cmp_value);
+  }
+}
+
+TEST_CASE("copy_cmp_swap_32_unaligned", "Copy and Swap") {
+  // Values sharing a half, byte or bit with the restart index must not match.
+  const uint32_t cmp_values[] = {0x00000000, 0x0000FFFF, 0x00FFFFFF,
+                                 0x7FFFFFFF, 0x80000000, 0x12345678,
+                                 0xFFFF0000, 0xFFFFFFFF};
+  for (auto cmp_value : cmp_values) {
+    std::vector<uint32_t> src;
+    src.push_back(byte_swap(cmp_value));
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+      src.push_back(byte_swap(cmp_value ^ (1u << bit)));
+      src.push_back(byte_swap(cmp_value));
+    }
+    for (uint32_t shift = 0; shift < 32; shift += 8) {
+      src.push_back(byte_swap(cmp_value ^ (0xFFu << shift)));
+    }
+    std::vector<uint32_t> dest(src.size());
+    copy_cmp_swap_32_unaligned(dest.data(), src.data(), cmp_value, src.size());
+    REQUIRE(dest == copy_cmp_swap_reference<uint32_t>(src, 0, cmp_value,
+                                                      src.size()));
+
+    test_copy_cmp_swap_lengths<uint32_t>(copy_cmp_swap_32_unaligned,
+                                         cmp_value);
+  }
+}
+
+// Not run by default; select with the [benchmark] tag.
+TEST_CASE("copy_cmp_swap benchmark", "[.][benchmark]") {
+  const size_t count = 256 * 1024;
+  std::vector<uint32_t> src(count);
+  std::vector<uint32_t> dest(count);
+  std::mt19937 random(0x5678);
+  for (auto& value : src) {
+    value = random();
+  }
+
+  auto measure = [&](const char* name, size_t bytes, auto fn) {
+    const int iterations = 500;
+    fn();
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+      fn();
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::high_resolution_clock::now() - start;
+    WARN(name << ": " << bytes * iterations / elapsed.count() / 1.0e9
+              << " GB/s");
+  };
+
+  measure("copy_cmp_swap_16_unaligned", count * 2, [&]() {
+    copy_cmp_swap_16_unaligned(dest.data(), src.data(), 0x1234, count * 2);
+  });
+  measure("copy_cmp_swap_16 scalar", count * 2, [&]() {
+    auto d = reinterpret_cast<uint16_t*>(dest.data());
+    auto s = reinterpret_cast<const uint16_t*>(src.data());
+    for (size_t i = 0; i < count * 2; ++i) {
+      uint16_t value = byte_swap(s[i]);
+      d[i] = value == 0x1234 ? 0xFFFF : value;
+    }
+  });
+  measure("copy_cmp_swap_32_unaligned", count * 4, [&]() {
+    copy_cmp_swap_32_unaligned(dest.data(), src.data(), 0x12345678, count);
+  });
+  measure("copy_cmp_swap_32 scalar", count * 4, [&]() {
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t value = byte_swap(src[i]);
+      dest[i] = value == 0x12345678 ? 0xFFFFFFFF : value;
+    }
+  });
 }
 
 }  // namespace test
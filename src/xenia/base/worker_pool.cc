@@ -0,0 +1,107 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/worker_pool.h"
+
+#include "xenia/base/string.h"
+
+namespace xe {
+namespace threading {
+
+WorkerPool::WorkerPool(const std::string& name, uint32_t thread_count) {
+  if (!thread_count) {
+    thread_count = logical_processor_count();
+    thread_count = thread_count > 1 ? thread_count - 1 : 0;
+  }
+
+  threads_.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() { WorkerMain(); });
+    set_name(threads_.back().native_handle(),
+             xe::format_string("%s %u", name.c_str(), i));
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkerPool::ParallelFor(size_t count,
+                             const std::function<void(size_t)>& fn) {
+  if (threads_.empty() || count <= 1) {
+    for (size_t i = 0; i < count; ++i) {
+      fn(i);
+    }
+    return;
+  }
+
+  std::lock_guard<std::mutex> dispatch_lock(dispatch_mutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    fn_ = &fn;
+    count_ = count;
+    next_index_ = 0;
+    ++generation_;
+  }
+  work_cv_.notify_all();
+
+  RunJobs(fn, count);
+
+  // Workers that haven't picked up this batch yet will see fn_ cleared and
+  // go back to sleep.
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this]() { return active_workers_ == 0; });
+  fn_ = nullptr;
+  count_ = 0;
+}
+
+void WorkerPool::WorkerMain() {
+  uint64_t seen_generation = 0;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock, [&]() {
+      return shutting_down_ || generation_ != seen_generation;
+    });
+    if (shutting_down_) {
+      return;
+    }
+    seen_generation = generation_;
+    if (!fn_) {
+      continue;
+    }
+
+    auto fn = fn_;
+    size_t count = count_;
+    ++active_workers_;
+    lock.unlock();
+    RunJobs(*fn, count);
+    lock.lock();
+    if (--active_workers_ == 0) {
+      done_cv_.notify_all();
+    }
+  }
+}
+
+void WorkerPool::RunJobs(const std::function<void(size_t)>& fn,
+                         size_t count) {
+  size_t index;
+  while ((index = next_index_.fetch_add(1)) < count) {
+    fn(index);
+  }
+}
+
+}  // namespace threading
+}  // namespace xe
@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_WORKER_POOL_H_
+#define XENIA_BASE_WORKER_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace threading {
+
+// A fixed set of host threads used to split CPU-heavy work into independent
+// jobs, such as converting the mips of a texture.
+class WorkerPool {
+ public:
+  // A thread_count of 0 creates one worker per logical processor, minus one
+  // for the calling thread which always takes part in ParallelFor.
+  explicit WorkerPool(const std::string& name, uint32_t thread_count = 0);
+  ~WorkerPool();
+
+  // Number of threads that run jobs, including the calling thread.
+  uint32_t concurrency() const { return uint32_t(threads_.size()) + 1; }
+
+  // Calls fn(index) for every index in [0, count) across the pool and the
+  // calling thread in no particular order, returning once all calls have
+  // completed. Concurrent calls from multiple threads are serialized.
+  void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+ private:
+  void WorkerMain();
+  void RunJobs(const std::function<void(size_t)>& fn, size_t count);
+
+  std::vector<std::thread> threads_;
+
+  // Held for the duration of a ParallelFor.
+  std::mutex dispatch_mutex_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable done_cv_;
+  bool shutting_down_ = false;
+  uint64_t generation_ = 0;
+  const std::function<void(size_t)>* fn_ = nullptr;
+  size_t count_ = 0;
+  size_t active_workers_ = 0;
+
+  std::atomic<size_t> next_index_ = {0};
+};
+
+}  // namespace threading
+}  // namespace xe
+
+#endif  // XENIA_BASE_WORKER_POOL_H_
@@ -9,6 +9,8 @@
 
 #include "xenia/cpu/mmio_handler.h"
 
+#include <algorithm>
+
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
 #include "xenia/base/exception_handler.h"
@@ -109,41 +111,9 @@ uintptr_t MMIOHandler::AddPhysicalAccessWatch(uint32_t guest_address,
 
   auto lock = global_critical_region_.Acquire();
 
-  // Fire any access watches that overlap this region.
-  for (auto it = access_watches_.begin(); it != access_watches_.end();) {
-    // Case 1: 2222222|222|11111111
-    // Case 2: 1111111|222|22222222
-    // Case 3: 1111111|222|11111111 (fragmentation)
-    // Case 4: 2222222|222|22222222 (complete overlap)
-    bool hit = false;
-    auto entry = *it;
-
-    if (base_address <= (*it)->address &&
-        base_address + length > (*it)->address) {
-      hit = true;
-    } else if ((*it)->address <= base_address &&
-               (*it)->address + (*it)->length > base_address) {
-      hit = true;
-    } else if ((*it)->address <= base_address &&
-               (*it)->address + (*it)->length > base_address + length) {
-      hit = true;
-    } else if ((*it)->address >= base_address &&
-               (*it)->address + (*it)->length < base_address + length) {
-      hit = true;
-    }
-
-    if (hit) {
-      FireAccessWatch(*it);
-      it = access_watches_.erase(it);
-      delete entry;
-      continue;
-    }
-
-    ++it;
-  }
-
-  // Add to table. The slot reservation may evict a previous watch, which
-  // could include our target, so we do it first.
+  // Watches overlapping this one are kept: the texture and buffer caches
+  // watch the same pages, and firing each other's watches as they are armed
+  // would keep both invalidating forever.
   auto entry = new AccessWatchEntry();
   entry->address = base_address;
   entry->length = uint32_t(length);
@@ -153,56 +123,85 @@ uintptr_t MMIOHandler::AddPhysicalAccessWatch(uint32_t guest_address,
   entry->callback_data = callback_data;
   access_watches_.push_back(entry);
 
-  auto page_access = memory::PageAccess::kNoAccess;
-  switch (type) {
-    case kWatchWrite:
-      page_access = memory::PageAccess::kReadOnly;
-      break;
-    case kWatchReadWrite:
-      page_access = memory::PageAccess::kNoAccess;
-      break;
-    default:
-      assert_unhandled_case(type);
-      break;
-  }
-
-  // Protect the range under all address spaces
-  memory::Protect(physical_membase_ + entry->address, entry->length,
-                  page_access, nullptr);
-  memory::Protect(virtual_membase_ + 0xA0000000 + entry->address, entry->length,
-                  page_access, nullptr);
-  memory::Protect(virtual_membase_ + 0xC0000000 + entry->address, entry->length,
-                  page_access, nullptr);
-  memory::Protect(virtual_membase_ + 0xE0000000 + entry->address, entry->length,
-                  page_access, nullptr);
+  UpdateWatchProtection(entry->address, entry->length);
 
   return reinterpret_cast<uintptr_t>(entry);
 }
 
-void MMIOHandler::FireAccessWatch(AccessWatchEntry* entry) {
-  ClearAccessWatch(entry);
-  entry->callback(entry->callback_context, entry->callback_data,
-                  entry->address);
+void MMIOHandler::ProtectPhysicalRange(uint32_t address, uint32_t length,
+                                       memory::PageAccess access) {
+  // Protect the range under all address spaces
+  memory::Protect(physical_membase_ + address, length, access, nullptr);
+  memory::Protect(virtual_membase_ + 0xA0000000 + address, length, access,
+                  nullptr);
+  memory::Protect(virtual_membase_ + 0xC0000000 + address, length, access,
+                  nullptr);
+  memory::Protect(virtual_membase_ + 0xE0000000 + address, length, access,
+                  nullptr);
+}
+
+void MMIOHandler::UpdateWatchProtection(uint32_t address, uint32_t length) {
+  // Split the range where the watches covering it start and end, and give
+  // each piece the strictest protection of its watches. Pages are never left
+  // unprotected in between, so no write to a watched page is missed.
+  uint32_t end = address + length;
+  std::vector<AccessWatchEntry*> overlapping;
+  std::vector<uint32_t> bounds = {address, end};
+  for (auto watch : access_watches_) {
+    if (watch->address < end && watch->address + watch->length > address) {
+      overlapping.push_back(watch);
+      bounds.push_back(std::max(watch->address, address));
+      bounds.push_back(std::min(watch->address + watch->length, end));
+    }
+  }
+  std::sort(bounds.begin(), bounds.end());
+  bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+  for (size_t i = 0; i + 1 < bounds.size(); ++i) {
+    WatchType strictest = kWatchInvalid;
+    for (auto watch : overlapping) {
+      if (watch->address <= bounds[i] &&
+          watch->address + watch->length >= bounds[i + 1]) {
+        strictest = std::max(strictest, watch->type);
+      }
+    }
+    auto page_access = memory::PageAccess::kReadWrite;
+    switch (strictest) {
+      case kWatchInvalid:
+        break;
+      case kWatchWrite:
+        page_access = memory::PageAccess::kReadOnly;
+        break;
+      case kWatchReadWrite:
+        page_access = memory::PageAccess::kNoAccess;
+        break;
+      default:
+        assert_unhandled_case(strictest);
+        break;
+    }
+    ProtectPhysicalRange(bounds[i], bounds[i + 1] - bounds[i], page_access);
+  }
 }
 
-void MMIOHandler::ClearAccessWatch(AccessWatchEntry* entry) {
-  memory::Protect(physical_membase_ + entry->address, entry->length,
-                  xe::memory::PageAccess::kReadWrite, nullptr);
-  memory::Protect(virtual_membase_ + 0xA0000000 + entry->address, entry->length,
-                  xe::memory::PageAccess::kReadWrite, nullptr);
-  memory::Protect(virtual_membase_ + 0xC0000000 + entry->address, entry->length,
-                  xe::memory::PageAccess::kReadWrite, nullptr);
-  memory::Protect(virtual_membase_ + 0xE0000000 + entry->address, entry->length,
-                  xe::memory::PageAccess::kReadWrite, nullptr);
+void MMIOHandler::FireAccessWatches(std::vector<AccessWatchEntry*> entries) {
+  // Everything is unlinked and unprotected before any callback runs, as the
+  // callbacks may add or cancel other watches.
+  for (auto entry : entries) {
+    access_watches_.remove(entry);
+  }
+  for (auto entry : entries) {
+    UpdateWatchProtection(entry->address, entry->length);
+  }
+  for (auto entry : entries) {
+    entry->callback(entry->callback_context, entry->callback_data,
+                    entry->address);
+    delete entry;
+  }
 }
 
 void MMIOHandler::CancelAccessWatch(uintptr_t watch_handle) {
   auto entry = reinterpret_cast<AccessWatchEntry*>(watch_handle);
   auto lock = global_critical_region_.Acquire();
 
-  // Allow access to the range again.
-  ClearAccessWatch(entry);
-
   // Remove from table.
   auto it = std::find(access_watches_.begin(), access_watches_.end(), entry);
   assert_false(it == access_watches_.end());
@@ -211,27 +210,26 @@ void MMIOHandler::CancelAccessWatch(uintptr_t watch_handle) {
     access_watches_.erase(it);
   }
 
+  // Allow access to the range again, unless other watches cover it.
+  UpdateWatchProtection(entry->address, entry->length);
+
   delete entry;
 }
 
 void MMIOHandler::InvalidateRange(uint32_t physical_address, size_t length) {
   auto lock = global_critical_region_.Acquire();
 
-  for (auto it = access_watches_.begin(); it != access_watches_.end();) {
-    auto entry = *it;
+  std::vector<AccessWatchEntry*> hits;
+  for (auto entry : access_watches_) {
     if ((entry->address <= physical_address &&
          entry->address + entry->length > physical_address) ||
         (entry->address >= physical_address &&
          entry->address < physical_address + length)) {
       // This watch lies within the range. End it.
-      FireAccessWatch(entry);
-      it = access_watches_.erase(it);
-      delete entry;
-      continue;
+      hits.push_back(entry);
     }
-
-    ++it;
   }
+  FireAccessWatches(std::move(hits));
 }
 
 bool MMIOHandler::IsRangeWatched(uint32_t physical_address, size_t length) {
@@ -262,25 +260,20 @@ bool MMIOHandler::IsRangeWatched(uint32_t physical_address, size_t length) {
 bool MMIOHandler::CheckAccessWatch(uint32_t physical_address) {
   auto lock = global_critical_region_.Acquire();
 
-  bool hit = false;
-  for (auto it = access_watches_.begin(); it != access_watches_.end();) {
-    auto entry = *it;
+  std::vector<AccessWatchEntry*> hits;
+  for (auto entry : access_watches_) {
     if (entry->address <= physical_address &&
         entry->address + entry->length > physical_address) {
       // Hit! Remove the watch.
-      hit = true;
-      FireAccessWatch(entry);
-      it = access_watches_.erase(it);
-      delete entry;
-      continue;
+      hits.push_back(entry);
     }
-    ++it;
   }
 
-  if (!hit) {
+  if (hits.empty()) {
     // Rethrow access violation - range was not being watched.
     return false;
   }
+  FireAccessWatches(std::move(hits));
 
   // Range was watched, so lets eat this access violation.
   return true;
@@ -14,6 +14,7 @@
 #include <memory>
 #include <vector>
 
+#include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
 
 namespace xe {
@@ -69,6 +70,7 @@ class MMIOHandler {
   // either written to or read from, depending on the watch type. These fire as
   // soon as a read/write happens, and only fire once.
   // These watches may be spuriously fired if memory is accessed nearby.
+  // Overlapping watches are independent, and all fire on an access to them.
   uintptr_t AddPhysicalAccessWatch(uint32_t guest_address, size_t length,
                                    WatchType type, AccessWatchCallback callback,
                                    void* callback_context, void* callback_data);
@@ -99,8 +101,12 @@ class MMIOHandler {
   static bool ExceptionCallbackThunk(Exception* ex, void* data);
   bool ExceptionCallback(Exception* ex);
 
-  void FireAccessWatch(AccessWatchEntry* entry);
-  void ClearAccessWatch(AccessWatchEntry* entry);
+  void ProtectPhysicalRange(uint32_t address, uint32_t length,
+                            memory::PageAccess access);
+  // Reprotects the pages in the range to match the watches covering them.
+  void UpdateWatchProtection(uint32_t address, uint32_t length);
+  // Removes the watches from the table, then calls them back.
+  void FireAccessWatches(std::vector<AccessWatchEntry*> entries);
   bool CheckAccessWatch(uint32_t guest_address);
 
   uint8_t* virtual_membase_;
@@ -0,0 +1,86 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/mmio_handler.h"
+
+#include "third_party/catch/include/catch.hpp"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace cpu {
+namespace test {
+
+// A texture inside a 64 KiB block watched by a buffer mirror, as the texture
+// and buffer caches arm them.
+const uint32_t kBlockAddress = 0x00100000;
+const uint32_t kBlockSize = 0x10000;
+const uint32_t kTextureAddress = kBlockAddress + 0x2100;
+const uint32_t kTextureSize = 0x800;
+
+void CountFire(void* context_ptr, void* data_ptr, uint32_t address) {
+  ++*reinterpret_cast<int*>(data_ptr);
+}
+
+TEST_CASE("overlapping_watches_survive_arming", "MMIO watches") {
+  Memory memory;
+  REQUIRE(memory.Initialize());
+  int texture_fired = 0;
+  int mirror_fired = 0;
+
+  auto texture = memory.AddPhysicalAccessWatch(
+      kTextureAddress, kTextureSize, MMIOHandler::kWatchWrite, &CountFire,
+      nullptr, &texture_fired);
+  memory.AddPhysicalAccessWatch(kBlockAddress, kBlockSize,
+                                MMIOHandler::kWatchWrite, &CountFire, nullptr,
+                                &mirror_fired);
+  REQUIRE(texture_fired == 0);
+  REQUIRE(mirror_fired == 0);
+
+  // The texture being re-armed leaves the mirror alone.
+  memory.CancelAccessWatch(texture);
+  memory.AddPhysicalAccessWatch(kTextureAddress, kTextureSize,
+                                MMIOHandler::kWatchWrite, &CountFire, nullptr,
+                                &texture_fired);
+  REQUIRE(texture_fired == 0);
+  REQUIRE(mirror_fired == 0);
+
+  // A write to the texture fires both.
+  MMIOHandler::global_handler()->InvalidateRange(kTextureAddress, 4);
+  REQUIRE(texture_fired == 1);
+  REQUIRE(mirror_fired == 1);
+  REQUIRE(!MMIOHandler::global_handler()->IsRangeWatched(kTextureAddress, 4));
+}
+
+TEST_CASE("overlapping_watches_fire_independently", "MMIO watches") {
+  Memory memory;
+  REQUIRE(memory.Initialize());
+  int texture_fired = 0;
+  int mirror_fired = 0;
+
+  memory.AddPhysicalAccessWatch(kBlockAddress, kBlockSize,
+                                MMIOHandler::kWatchWrite, &CountFire, nullptr,
+                                &mirror_fired);
+  memory.AddPhysicalAccessWatch(kTextureAddress, kTextureSize,
+                                MMIOHandler::kWatchWrite, &CountFire, nullptr,
+                                &texture_fired);
+
+  // A write elsewhere in the block only fires the mirror.
+  MMIOHandler::global_handler()->InvalidateRange(kBlockAddress + 0x8000, 4);
+  REQUIRE(mirror_fired == 1);
+  REQUIRE(texture_fired == 0);
+  REQUIRE(MMIOHandler::global_handler()->IsRangeWatched(kTextureAddress, 4));
+
+  MMIOHandler::global_handler()->InvalidateRange(kTextureAddress, 4);
+  REQUIRE(mirror_fired == 1);
+  REQUIRE(texture_fired == 1);
+}
+
+}  // namespace test
+}  // namespace cpu
+}  // namespace xe
@@ -32,6 +32,10 @@ namespace gpu {
 
 using namespace xe::gpu::xenos;
 
+// Registers from the start of the context block (RB_SURFACE_INFO) onwards have
+// no side effects when written, so runs of them can be written in bulk.
+const uint32_t kBulkRegisterBase = 0x2000;
+
 CommandProcessor::CommandProcessor(GraphicsSystem* graphics_system,
                                    kernel::KernelState* kernel_state)
     : memory_(graphics_system->memory()),
@@ -117,7 +121,9 @@ void CommandProcessor::CallInThread(std::function<void()> fn) {
 void CommandProcessor::ClearCaches() {}
 
 void CommandProcessor::WorkerThreadMain() {
-  context_->MakeCurrent();
+  if (context_) {
+    context_->MakeCurrent();
+  }
   if (!SetupContext()) {
     xe::FatalError("Unable to setup command processor internal state");
     return;
@@ -263,7 +269,7 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
     return;
   }
 
-  regs->values[index].u32 = value;
+  regs->Write(index, value);
   if (!regs->GetRegisterInfo(index)) {
     XELOGW("GPU: Write to unknown register (%.4X = %.8X)", index, value);
   }
@@ -287,6 +293,49 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
   }
 }
 
+void CommandProcessor::WriteRegisterRangeFromMem(uint32_t start_index,
+                                                 const uint32_t* base,
+                                                 uint32_t count) {
+  uint32_t end_index = start_index + count;
+  uint32_t bulk_start = std::max(start_index, kBulkRegisterBase);
+  uint32_t bulk_end =
+      std::min(end_index, uint32_t(RegisterFile::kRegisterCount));
+  if (bulk_start >= bulk_end) {
+    for (uint32_t i = 0; i < count; ++i) {
+      WriteRegister(start_index + i, xe::load_and_swap<uint32_t>(base + i));
+    }
+    return;
+  }
+
+  for (uint32_t i = start_index; i < bulk_start; ++i) {
+    WriteRegister(i, xe::load_and_swap<uint32_t>(base + (i - start_index)));
+  }
+  register_file_->WriteRangeFromGuest(
+      bulk_start, base + (bulk_start - start_index), bulk_end - bulk_start);
+  // Anything past the end of the register file gets rejected (and logged) by
+  // WriteRegister.
+  for (uint32_t i = bulk_end; i < end_index; ++i) {
+    WriteRegister(i, xe::load_and_swap<uint32_t>(base + (i - start_index)));
+  }
+}
+
+void CommandProcessor::WriteRegisterRangeFromRing(RingBuffer* reader,
+                                                  uint32_t start_index,
+                                                  uint32_t count) {
+  auto read_range = reader->BeginRead(count * sizeof(uint32_t));
+  uint32_t first_count = uint32_t(read_range.first_length / sizeof(uint32_t));
+  WriteRegisterRangeFromMem(
+      start_index, reinterpret_cast<const uint32_t*>(read_range.first),
+      first_count);
+  if (read_range.second) {
+    WriteRegisterRangeFromMem(
+        start_index + first_count,
+        reinterpret_cast<const uint32_t*>(read_range.second),
+        uint32_t(read_range.second_length / sizeof(uint32_t)));
+  }
+  reader->EndRead(read_range);
+}
+
 void CommandProcessor::UpdateGammaRampValue(GammaRampType type,
                                             uint32_t value) {
   RegisterFile* regs = register_file_;
@@ -525,10 +574,13 @@ bool CommandProcessor::ExecutePacketType0(RingBuffer* reader, uint32_t packet) {
 
   uint32_t base_index = (packet & 0x7FFF);
   uint32_t write_one_reg = (packet >> 15) & 0x1;
-  for (uint32_t m = 0; m < count; m++) {
-    uint32_t reg_data = reader->ReadAndSwap<uint32_t>();
-    uint32_t target_index = write_one_reg ? base_index : base_index + m;
-    WriteRegister(target_index, reg_data);
+  if (write_one_reg) {
+    for (uint32_t m = 0; m < count; m++) {
+      uint32_t reg_data = reader->ReadAndSwap<uint32_t>();
+      WriteRegister(base_index, reg_data);
+    }
+  } else {
+    WriteRegisterRangeFromRing(reader, base_index, count);
   }
 
   trace_writer_.WritePacketEnd();
@@ -1229,10 +1281,7 @@ bool CommandProcessor::ExecutePacketType3_SET_CONSTANT(RingBuffer* reader,
       reader->AdvanceRead((count - 1) * sizeof(uint32_t));
       return true;
   }
-  for (uint32_t n = 0; n < count - 1; n++, index++) {
-    uint32_t data = reader->ReadAndSwap<uint32_t>();
-    WriteRegister(index, data);
-  }
+  WriteRegisterRangeFromRing(reader, index, count - 1);
   return true;
 }
 
@@ -1241,10 +1290,7 @@ bool CommandProcessor::ExecutePacketType3_SET_CONSTANT2(RingBuffer* reader,
                                                         uint32_t count) {
   uint32_t offset_type = reader->ReadAndSwap<uint32_t>();
   uint32_t index = offset_type & 0xFFFF;
-  for (uint32_t n = 0; n < count - 1; n++, index++) {
-    uint32_t data = reader->ReadAndSwap<uint32_t>();
-    WriteRegister(index, data);
-  }
+  WriteRegisterRangeFromRing(reader, index, count - 1);
   return true;
 }
 
@@ -1280,11 +1326,8 @@ bool CommandProcessor::ExecutePacketType3_LOAD_ALU_CONSTANT(RingBuffer* reader,
       return true;
   }
   trace_writer_.WriteMemoryRead(CpuToGpu(address), size_dwords * 4);
-  for (uint32_t n = 0; n < size_dwords; n++, index++) {
-    uint32_t data = xe::load_and_swap<uint32_t>(
-        memory_->TranslatePhysical(address + n * 4));
-    WriteRegister(index, data);
-  }
+  WriteRegisterRangeFromMem(
+      index, memory_->TranslatePhysical<const uint32_t*>(address), size_dwords);
   return true;
 }
 
@@ -1292,10 +1335,7 @@ bool CommandProcessor::ExecutePacketType3_SET_SHADER_CONSTANTS(
     RingBuffer* reader, uint32_t packet, uint32_t count) {
   uint32_t offset_type = reader->ReadAndSwap<uint32_t>();
   uint32_t index = offset_type & 0xFFFF;
-  for (uint32_t n = 0; n < count - 1; n++, index++) {
-    uint32_t data = reader->ReadAndSwap<uint32_t>();
-    WriteRegister(index, data);
-  }
+  WriteRegisterRangeFromRing(reader, index, count - 1);
   return true;
 }
 
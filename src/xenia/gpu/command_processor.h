@@ -162,6 +162,15 @@ class CommandProcessor {
   virtual void ShutdownContext() = 0;
 
   virtual void WriteRegister(uint32_t index, uint32_t value);
+  // Writes count consecutive registers starting at start_index from big-endian
+  // values. Registers without side effects are byte swapped into the register
+  // file in bulk; everything else goes through WriteRegister one at a time.
+  virtual void WriteRegisterRangeFromMem(uint32_t start_index,
+                                         const uint32_t* base, uint32_t count);
+  // Same as WriteRegisterRangeFromMem but reading from the ring buffer,
+  // handling wraparound.
+  void WriteRegisterRangeFromRing(RingBuffer* reader, uint32_t start_index,
+                                  uint32_t count);
 
   void UpdateGammaRampValue(GammaRampType type, uint32_t value);
 
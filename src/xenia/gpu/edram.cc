@@ -0,0 +1,972 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/edram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/platform.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/texture_conversion.h"
+
+namespace xe {
+namespace gpu {
+
+using namespace xe::gpu::xenos;
+
+namespace {
+
+// Encodes a non-negative float with a small unsigned exponent and no sign,
+// such as the 7e3 color and 20e4 depth formats.
+uint32_t EncodeSmallFloat(float value, uint32_t exponent_bits,
+                          uint32_t mantissa_bits, int bias) {
+  uint32_t max_exponent = (1u << exponent_bits) - 1;
+  uint32_t mantissa_max = 1u << mantissa_bits;
+  if (!(value > 0.0f)) {
+    return 0;
+  }
+  if (value < std::ldexp(1.0f, 1 - bias)) {
+    // Denormal.
+    uint32_t mantissa = uint32_t(
+        std::min(std::ldexp(value, bias - 1 + int(mantissa_bits)) + 0.5f,
+                 float(mantissa_max - 1)));
+    return mantissa;
+  }
+  int exp;
+  float fraction = std::frexp(value, &exp);
+  int exponent = exp - 1 + bias;
+  uint32_t mantissa = uint32_t(
+      std::ldexp(fraction * 2.0f - 1.0f, int(mantissa_bits)) + 0.5f);
+  if (mantissa >= mantissa_max) {
+    mantissa = 0;
+    ++exponent;
+  }
+  if (exponent > int(max_exponent)) {
+    return (max_exponent << mantissa_bits) | (mantissa_max - 1);
+  }
+  return (uint32_t(exponent) << mantissa_bits) | mantissa;
+}
+
+float DecodeSmallFloat(uint32_t value, uint32_t exponent_bits,
+                       uint32_t mantissa_bits, int bias) {
+  uint32_t mantissa = value & ((1u << mantissa_bits) - 1);
+  uint32_t exponent = (value >> mantissa_bits) & ((1u << exponent_bits) - 1);
+  if (!exponent) {
+    return std::ldexp(float(mantissa), 1 - bias - int(mantissa_bits));
+  }
+  return std::ldexp(1.0f + std::ldexp(float(mantissa), -int(mantissa_bits)),
+                    int(exponent) - bias);
+}
+
+// The scalar conversions below are written to match the SSE span versions
+// bit for bit: clamps send NaN to the lower bound like minps/maxps, and
+// rounding to the nearest even integer matches cvtps2dq.
+
+uint32_t PackUnorm(float value, uint32_t bits) {
+  float max_value = float((1u << bits) - 1);
+  value = value > 0.0f ? value : 0.0f;
+  value = value < 1.0f ? value : 1.0f;
+  return uint32_t(value * max_value + 0.5f);
+}
+
+float UnpackUnorm(uint32_t value, uint32_t bits) {
+  return float(value) / float((1u << bits) - 1);
+}
+
+// The 16 bit fixed point render target formats cover [-32, 32].
+const float kFixed16Scale = 32767.0f / 32.0f;
+const float kFixed16InvScale = 32.0f / 32767.0f;
+
+uint32_t PackFixed16(float value) {
+  value = value > -32.0f ? value : -32.0f;
+  value = value < 32.0f ? value : 32.0f;
+  return uint32_t(int32_t(std::lrint(value * kFixed16Scale))) & 0xFFFF;
+}
+
+float UnpackFixed16(uint32_t value) {
+  return std::max(float(int16_t(value)) * kFixed16InvScale, -32.0f);
+}
+
+float LinearToGamma(float value) {
+  return std::pow(std::min(std::max(value, 0.0f), 1.0f), 1.0f / 2.2f);
+}
+
+float GammaToLinear(float value) { return std::pow(value, 2.2f); }
+
+struct PackedLayout {
+  uint32_t count;
+  uint32_t shifts[4];
+  uint32_t bits[4];
+};
+
+// Resolve destination formats whose components are unorm integers packed
+// with the first component in the least significant bits.
+bool GetPackedLayout(TextureFormat format, PackedLayout* out) {
+  switch (format) {
+    case TextureFormat::k_8:
+    case TextureFormat::k_8_A:
+    case TextureFormat::k_8_B:
+      *out = {1, {0}, {8}};
+      return true;
+    case TextureFormat::k_8_8:
+      *out = {2, {0, 8}, {8, 8}};
+      return true;
+    case TextureFormat::k_8_8_8_8:
+    case TextureFormat::k_8_8_8_8_A:
+    case TextureFormat::k_8_8_8_8_AS_16_16_16_16:
+      *out = {4, {0, 8, 16, 24}, {8, 8, 8, 8}};
+      return true;
+    case TextureFormat::k_1_5_5_5:
+      *out = {4, {0, 5, 10, 15}, {5, 5, 5, 1}};
+      return true;
+    case TextureFormat::k_5_6_5:
+      *out = {3, {0, 5, 11}, {5, 6, 5}};
+      return true;
+    case TextureFormat::k_6_5_5:
+      *out = {3, {0, 6, 11}, {6, 5, 5}};
+      return true;
+    case TextureFormat::k_4_4_4_4:
+      *out = {4, {0, 4, 8, 12}, {4, 4, 4, 4}};
+      return true;
+    case TextureFormat::k_2_10_10_10:
+    case TextureFormat::k_2_10_10_10_AS_16_16_16_16:
+      *out = {4, {0, 10, 20, 30}, {10, 10, 10, 2}};
+      return true;
+    case TextureFormat::k_10_11_11:
+    case TextureFormat::k_10_11_11_AS_16_16_16_16:
+      *out = {3, {0, 11, 22}, {11, 11, 10}};
+      return true;
+    case TextureFormat::k_11_11_10:
+    case TextureFormat::k_11_11_10_AS_16_16_16_16:
+      *out = {3, {0, 10, 21}, {10, 11, 11}};
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Unpacks four 32bpp values with four unorm components each, the first in
+// the least significant bits, into four float RGBA pixels.
+template <uint32_t rgb_bits, uint32_t alpha_bits>
+void UnpackUnorm4x4(const uint32_t* values, float* out_colors) {
+  const __m128i rgb_mask = _mm_set1_epi32((1 << rgb_bits) - 1);
+  const __m128 rgb_max = _mm_set1_ps(float((1u << rgb_bits) - 1));
+  const __m128 alpha_max = _mm_set1_ps(float((1u << alpha_bits) - 1));
+  __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values));
+  __m128 r = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(v, rgb_mask)), rgb_max);
+  __m128 g = _mm_div_ps(
+      _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, rgb_bits), rgb_mask)),
+      rgb_max);
+  __m128 b = _mm_div_ps(
+      _mm_cvtepi32_ps(
+          _mm_and_si128(_mm_srli_epi32(v, rgb_bits * 2), rgb_mask)),
+      rgb_max);
+  __m128 a = _mm_div_ps(
+      _mm_cvtepi32_ps(_mm_srli_epi32(v, rgb_bits * 3)), alpha_max);
+  _MM_TRANSPOSE4_PS(r, g, b, a);
+  _mm_storeu_ps(out_colors, r);
+  _mm_storeu_ps(out_colors + 4, g);
+  _mm_storeu_ps(out_colors + 8, b);
+  _mm_storeu_ps(out_colors + 12, a);
+}
+
+__m128i PackUnorm4(__m128 value, __m128 max_value) {
+  value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+  return _mm_cvttps_epi32(
+      _mm_add_ps(_mm_mul_ps(value, max_value), _mm_set1_ps(0.5f)));
+}
+
+// Inverse of UnpackUnorm4x4.
+template <uint32_t rgb_bits, uint32_t alpha_bits>
+void PackUnorm4x4(const float* colors, uint32_t* out_values) {
+  const __m128 rgb_max = _mm_set1_ps(float((1u << rgb_bits) - 1));
+  const __m128 alpha_max = _mm_set1_ps(float((1u << alpha_bits) - 1));
+  __m128 r = _mm_loadu_ps(colors);
+  __m128 g = _mm_loadu_ps(colors + 4);
+  __m128 b = _mm_loadu_ps(colors + 8);
+  __m128 a = _mm_loadu_ps(colors + 12);
+  _MM_TRANSPOSE4_PS(r, g, b, a);
+  __m128i v = PackUnorm4(r, rgb_max);
+  v = _mm_or_si128(v, _mm_slli_epi32(PackUnorm4(g, rgb_max), rgb_bits));
+  v = _mm_or_si128(v, _mm_slli_epi32(PackUnorm4(b, rgb_max), rgb_bits * 2));
+  v = _mm_or_si128(v,
+                   _mm_slli_epi32(PackUnorm4(a, alpha_max), rgb_bits * 3));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out_values), v);
+}
+
+__m128 UnpackFixed16x4(__m128i value) {
+  return _mm_max_ps(
+      _mm_mul_ps(_mm_cvtepi32_ps(value), _mm_set1_ps(kFixed16InvScale)),
+      _mm_set1_ps(-32.0f));
+}
+
+// Returns the signed 16 bit fixed point values of a float RGBA pixel in the
+// low 64 bits.
+__m128i PackFixed16x4(__m128 color) {
+  color = _mm_max_ps(color, _mm_set1_ps(-32.0f));
+  color = _mm_min_ps(color, _mm_set1_ps(32.0f));
+  __m128i value =
+      _mm_cvtps_epi32(_mm_mul_ps(color, _mm_set1_ps(kFixed16Scale)));
+  return _mm_packs_epi32(value, value);
+}
+
+// Returns the samples a resolve reads, which are averaged for color.
+uint32_t GetResolveSamples(MsaaSamples msaa_samples, uint32_t sample_select,
+                           uint32_t out_samples[4]) {
+  uint32_t sample_count = Edram::GetSampleCount(msaa_samples);
+  if (sample_count == 1) {
+    out_samples[0] = 0;
+    return 1;
+  }
+  if (sample_select <= 3) {
+    out_samples[0] = std::min(sample_select, sample_count - 1);
+    return 1;
+  }
+  if (sample_select == 6 || sample_count == 2) {
+    // 2X surfaces only have samples 0 and 1, so both pairs average them.
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      out_samples[i] = i;
+    }
+    return sample_count;
+  }
+  out_samples[0] = sample_select == 5 ? 2 : 0;
+  out_samples[1] = out_samples[0] + 1;
+  return 2;
+}
+
+}  // namespace
+
+bool EdramCopyInfo::Decode(const RegisterFile& regs, Memory* memory,
+                           EdramCopyInfo* out_info) {
+  auto& info = *out_info;
+  info = EdramCopyInfo();
+
+  reg::RB_COPY_CONTROL copy_control;
+  copy_control.value = regs.values[XE_GPU_REG_RB_COPY_CONTROL].u32;
+  reg::RB_COPY_DEST_PITCH copy_dest_pitch;
+  copy_dest_pitch.value = regs.values[XE_GPU_REG_RB_COPY_DEST_PITCH].u32;
+  reg::RB_COPY_DEST_INFO copy_dest_info;
+  copy_dest_info.value = regs.values[XE_GPU_REG_RB_COPY_DEST_INFO].u32;
+
+  reg::RB_SURFACE_INFO surface_info;
+  surface_info.value = regs.values[XE_GPU_REG_RB_SURFACE_INFO].u32;
+  info.surface_pitch = surface_info.surface_pitch;
+  info.msaa_samples = surface_info.msaa_samples;
+  if (!info.surface_pitch) {
+    return false;
+  }
+
+  reg::PA_SC_WINDOW_OFFSET window_offset;
+  window_offset.value = regs.values[XE_GPU_REG_PA_SC_WINDOW_OFFSET].u32;
+  int32_t window_offset_x = window_offset.window_x_offset;
+  int32_t window_offset_y = window_offset.window_y_offset;
+
+  // The copy rectangle is always in vertex fetch constant 0.
+  auto group = reinterpret_cast<const xe_gpu_fetch_group_t*>(
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0]);
+  const auto& fetch = group->vertex_fetch_0;
+  if (fetch.type != 3 || fetch.size < 6) {
+    XELOGW("EDRAM: copy without a rectangle in vertex fetch 0");
+    return false;
+  }
+  info.rect_address = fetch.address << 2;
+  info.rect_length = fetch.size * 4;
+  const uint8_t* vertex_addr = memory->TranslatePhysical(info.rect_address);
+
+  reg::PA_SU_VTX_CNTL vtx_cntl;
+  vtx_cntl.value = regs.values[XE_GPU_REG_PA_SU_VTX_CNTL].u32;
+  float vtx_offset = vtx_cntl.pix_center == 0 ? 0.5f : 0.0f;
+  float points[6];
+  for (int i = 0; i < 6; ++i) {
+    points[i] =
+        GpuSwap(xe::load<float>(vertex_addr + i * 4), Endian(fetch.endian)) +
+        vtx_offset;
+  }
+  int32_t min_x = int32_t(std::min(std::min(points[0], points[2]), points[4]));
+  int32_t max_x = int32_t(std::max(std::max(points[0], points[2]), points[4]));
+  int32_t min_y = int32_t(std::min(std::min(points[1], points[3]), points[5]));
+  int32_t max_y = int32_t(std::max(std::max(points[1], points[3]), points[5]));
+  min_x = std::max(min_x, 0);
+  min_y = std::max(min_y, 0);
+  if (max_x <= min_x || max_y <= min_y) {
+    return false;
+  }
+  info.width = uint32_t(max_x - min_x);
+  info.height = uint32_t(max_y - min_y);
+
+  // The rectangle is relative to the window, while render target contents
+  // were drawn with the window offset applied.
+  info.x = uint32_t(std::max(min_x + window_offset_x, 0));
+  info.y = uint32_t(std::max(min_y + window_offset_y, 0));
+
+  uint32_t copy_src_select = copy_control.copy_src_select;
+  bool is_color_source = copy_src_select <= 3;
+  static const Register kColorInfoRegisters[] = {
+      XE_GPU_REG_RB_COLOR_INFO, XE_GPU_REG_RB_COLOR1_INFO,
+      XE_GPU_REG_RB_COLOR2_INFO, XE_GPU_REG_RB_COLOR3_INFO};
+  reg::RB_COLOR_INFO color_info;
+  color_info.value = regs.values[kColorInfoRegisters[copy_src_select & 3]].u32;
+  reg::RB_DEPTH_INFO depth_info;
+  depth_info.value = regs.values[XE_GPU_REG_RB_DEPTH_INFO].u32;
+  info.color_base = color_info.color_base;
+  info.color_format = color_info.color_format;
+  info.depth_base = depth_info.depth_base;
+
+  CopyCommand copy_command = copy_control.copy_command;
+  if (copy_command == CopyCommand::kRaw ||
+      copy_command == CopyCommand::kConvert) {
+    auto& resolve_info = info.resolve_info;
+    resolve_info.is_depth = !is_color_source;
+    resolve_info.edram_base =
+        is_color_source ? color_info.color_base : depth_info.depth_base;
+    resolve_info.surface_pitch = info.surface_pitch;
+    resolve_info.msaa_samples = info.msaa_samples;
+    resolve_info.color_format = color_info.color_format;
+    resolve_info.depth_format = depth_info.depth_format;
+    resolve_info.src_x = info.x;
+    resolve_info.src_y = info.y;
+    resolve_info.width = info.width;
+    resolve_info.height = info.height;
+    resolve_info.sample_select = copy_control.copy_sample_select;
+
+    TextureFormat dest_format =
+        is_color_source
+            ? ColorFormatToTextureFormat(copy_dest_info.copy_dest_format)
+            : DepthRenderTargetToTextureFormat(depth_info.depth_format);
+    Endian dest_endian = Endian::k8in32;
+    if (copy_dest_info.copy_dest_endian <= Endian128::k16in32) {
+      dest_endian =
+          static_cast<Endian>(copy_dest_info.copy_dest_endian.value());
+    }
+    uint32_t dest_pitch = copy_dest_pitch.copy_dest_pitch;
+    uint32_t dest_height = copy_dest_pitch.copy_dest_height;
+
+    // Match the vulkan backend's view of where the texture starts, so
+    // textures sampled from the resolve line up.
+    uint32_t dest_texel_size = uint32_t(GetTexelSize(dest_format));
+    uint32_t dest_base = regs.values[XE_GPU_REG_RB_COPY_DEST_BASE].u32;
+    dest_base += window_offset_y * dest_pitch * dest_texel_size;
+    dest_base += window_offset_x * 32 * dest_texel_size;
+
+    TextureInfo texture_info;
+    if (dest_pitch &&
+        TextureInfo::PrepareResolve(dest_base, dest_format, dest_endian,
+                                    dest_pitch, dest_pitch,
+                                    std::max(1u, dest_height), 1,
+                                    &texture_info)) {
+      auto extent = texture_info.GetMipExtent(0, false);
+      resolve_info.dest_address = dest_base;
+      resolve_info.dest_pitch = extent.block_pitch_h;
+      resolve_info.dest_height = extent.block_pitch_v;
+      resolve_info.dest_x = uint32_t(min_x);
+      resolve_info.dest_y = uint32_t(min_y);
+      resolve_info.dest_format = dest_format;
+      resolve_info.dest_endian = dest_endian;
+      resolve_info.dest_tiled = true;
+      resolve_info.swap_red_blue = copy_dest_info.copy_dest_swap != 0;
+      resolve_info.exp_bias =
+          int32_t(copy_dest_info.copy_dest_exp_bias << 26) >> 26;
+      info.resolve = true;
+      info.written_address = dest_base;
+      info.written_length = extent.block_pitch_h * extent.block_pitch_v *
+                            texture_info.format_info()->bytes_per_block();
+    }
+  }
+
+  uint32_t color_clear = regs.values[XE_GPU_REG_RB_COLOR_CLEAR].u32;
+  info.color_clear = copy_control.color_clear_enable && is_color_source;
+  info.color_clear_low = Edram::IsColorFormat64bpp(info.color_format)
+                             ? regs.values[XE_GPU_REG_RB_COLOR_CLEAR_LOW].u32
+                             : color_clear;
+  info.color_clear_high = color_clear;
+  info.depth_clear = copy_control.depth_clear_enable != 0;
+  info.depth_clear_value = regs.values[XE_GPU_REG_RB_DEPTH_CLEAR].u32;
+  return info.resolve || info.color_clear || info.depth_clear;
+}
+
+Edram::Edram() : data_(kTileCount * kTileDwords, 0) {}
+
+Edram::~Edram() = default;
+
+bool Edram::IsColorFormat64bpp(ColorRenderTargetFormat format) {
+  switch (format) {
+    case ColorRenderTargetFormat::k_16_16_16_16:
+    case ColorRenderTargetFormat::k_16_16_16_16_FLOAT:
+    case ColorRenderTargetFormat::k_32_32_FLOAT:
+      return true;
+    default:
+      return false;
+  }
+}
+
+uint32_t Edram::GetSampleCount(MsaaSamples msaa_samples) {
+  switch (msaa_samples) {
+    case MsaaSamples::k2X:
+      return 2;
+    case MsaaSamples::k4X:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+uint32_t Edram::GetOffset(uint32_t base_tile, uint32_t surface_pitch,
+                          MsaaSamples msaa_samples, bool is_64bpp, uint32_t x,
+                          uint32_t y, uint32_t sample) {
+  switch (msaa_samples) {
+    case MsaaSamples::k2X:
+      y = y * 2 + (sample & 1);
+      break;
+    case MsaaSamples::k4X:
+      x = x * 2 + (sample & 1);
+      y = y * 2 + ((sample >> 1) & 1);
+      surface_pitch *= 2;
+      break;
+    default:
+      break;
+  }
+  uint32_t tile_width = is_64bpp ? kTileWidth / 2 : kTileWidth;
+  uint32_t tiles_wide = (surface_pitch + tile_width - 1) / tile_width;
+  uint32_t tile = (base_tile + (y / kTileHeight) * tiles_wide +
+                   x / tile_width) %
+                  kTileCount;
+  return tile * kTileDwords + (y % kTileHeight) * kTileWidth +
+         (x % tile_width) * (is_64bpp ? 2 : 1);
+}
+
+void Edram::PackColor(ColorRenderTargetFormat format, const float color[4],
+                      uint32_t out_value[2]) {
+  out_value[1] = 0;
+  switch (format) {
+    case ColorRenderTargetFormat::k_8_8_8_8:
+      out_value[0] = PackUnorm(color[0], 8) | (PackUnorm(color[1], 8) << 8) |
+                     (PackUnorm(color[2], 8) << 16) |
+                     (PackUnorm(color[3], 8) << 24);
+      break;
+    case ColorRenderTargetFormat::k_8_8_8_8_GAMMA:
+      out_value[0] = PackUnorm(LinearToGamma(color[0]), 8) |
+                     (PackUnorm(LinearToGamma(color[1]), 8) << 8) |
+                     (PackUnorm(LinearToGamma(color[2]), 8) << 16) |
+                     (PackUnorm(color[3], 8) << 24);
+      break;
+    case ColorRenderTargetFormat::k_2_10_10_10:
+    case ColorRenderTargetFormat::k_2_10_10_10_AS_16_16_16_16:
+      out_value[0] = PackUnorm(color[0], 10) |
+                     (PackUnorm(color[1], 10) << 10) |
+                     (PackUnorm(color[2], 10) << 20) |
+                     (PackUnorm(color[3], 2) << 30);
+      break;
+    case ColorRenderTargetFormat::k_2_10_10_10_FLOAT:
+    case ColorRenderTargetFormat::k_2_10_10_10_FLOAT_AS_16_16_16_16:
+      out_value[0] = EncodeSmallFloat(color[0], 3, 7, 3) |
+                     (EncodeSmallFloat(color[1], 3, 7, 3) << 10) |
+                     (EncodeSmallFloat(color[2], 3, 7, 3) << 20) |
+                     (PackUnorm(color[3], 2) << 30);
+      break;
+    case ColorRenderTargetFormat::k_16_16:
+      out_value[0] = PackFixed16(color[0]) | (PackFixed16(color[1]) << 16);
+      break;
+    case ColorRenderTargetFormat::k_16_16_16_16:
+      out_value[0] = PackFixed16(color[0]) | (PackFixed16(color[1]) << 16);
+      out_value[1] = PackFixed16(color[2]) | (PackFixed16(color[3]) << 16);
+      break;
+    case ColorRenderTargetFormat::k_16_16_FLOAT:
+      out_value[0] = uint32_t(xe::float_to_half(color[0])) |
+                     (uint32_t(xe::float_to_half(color[1])) << 16);
+      break;
+    case ColorRenderTargetFormat::k_16_16_16_16_FLOAT:
+      out_value[0] = uint32_t(xe::float_to_half(color[0])) |
+                     (uint32_t(xe::float_to_half(color[1])) << 16);
+      out_value[1] = uint32_t(xe::float_to_half(color[2])) |
+                     (uint32_t(xe::float_to_half(color[3])) << 16);
+      break;
+    case ColorRenderTargetFormat::k_32_FLOAT:
+      std::memcpy(&out_value[0], &color[0], sizeof(float));
+      break;
+    case ColorRenderTargetFormat::k_32_32_FLOAT:
+      std::memcpy(&out_value[0], &color[0], sizeof(float) * 2);
+      break;
+    default:
+      out_value[0] = 0;
+      break;
+  }
+}
+
+void Edram::UnpackColor(ColorRenderTargetFormat format,
+                        const uint32_t value[2], float out_color[4]) {
+  out_color[0] = out_color[1] = out_color[2] = 0.0f;
+  out_color[3] = 1.0f;
+  uint32_t v = value[0];
+  switch (format) {
+    case ColorRenderTargetFormat::k_8_8_8_8:
+      for (uint32_t i = 0; i < 4; ++i) {
+        out_color[i] = UnpackUnorm((v >> (i * 8)) & 0xFF, 8);
+      }
+      break;
+    case ColorRenderTargetFormat::k_8_8_8_8_GAMMA:
+      for (uint32_t i = 0; i < 4; ++i) {
+        out_color[i] = UnpackUnorm((v >> (i * 8)) & 0xFF, 8);
+        if (i < 3) {
+          out_color[i] = GammaToLinear(out_color[i]);
+        }
+      }
+      break;
+    case ColorRenderTargetFormat::k_2_10_10_10:
+    case ColorRenderTargetFormat::k_2_10_10_10_AS_16_16_16_16:
+      for (uint32_t i = 0; i < 3; ++i) {
+        out_color[i] = UnpackUnorm((v >> (i * 10)) & 0x3FF, 10);
+      }
+      out_color[3] = UnpackUnorm(v >> 30, 2);
+      break;
+    case ColorRenderTargetFormat::k_2_10_10_10_FLOAT:
+    case ColorRenderTargetFormat::k_2_10_10_10_FLOAT_AS_16_16_16_16:
+      for (uint32_t i = 0; i < 3; ++i) {
+        out_color[i] = DecodeSmallFloat((v >> (i * 10)) & 0x3FF, 3, 7, 3);
+      }
+      out_color[3] = UnpackUnorm(v >> 30, 2);
+      break;
+    case ColorRenderTargetFormat::k_16_16:
+      out_color[0] = UnpackFixed16(v & 0xFFFF);
+      out_color[1] = UnpackFixed16(v >> 16);
+      break;
+    case ColorRenderTargetFormat::k_16_16_16_16:
+      out_color[0] = UnpackFixed16(v & 0xFFFF);
+      out_color[1] = UnpackFixed16(v >> 16);
+      out_color[2] = UnpackFixed16(value[1] & 0xFFFF);
+      out_color[3] = UnpackFixed16(value[1] >> 16);
+      break;
+    case ColorRenderTargetFormat::k_16_16_FLOAT:
+      out_color[0] = xe::half_to_float(uint16_t(v));
+      out_color[1] = xe::half_to_float(uint16_t(v >> 16));
+      break;
+    case ColorRenderTargetFormat::k_16_16_16_16_FLOAT:
+      out_color[0] = xe::half_to_float(uint16_t(v));
+      out_color[1] = xe::half_to_float(uint16_t(v >> 16));
+      out_color[2] = xe::half_to_float(uint16_t(value[1]));
+      out_color[3] = xe::half_to_float(uint16_t(value[1] >> 16));
+      break;
+    case ColorRenderTargetFormat::k_32_FLOAT:
+      std::memcpy(&out_color[0], &value[0], sizeof(float));
+      break;
+    case ColorRenderTargetFormat::k_32_32_FLOAT:
+      std::memcpy(&out_color[0], &value[0], sizeof(float) * 2);
+      break;
+    default:
+      break;
+  }
+}
+
+uint32_t Edram::PackDepth(DepthRenderTargetFormat format, float depth) {
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+  if (format == DepthRenderTargetFormat::kD24FS8) {
+    return EncodeSmallFloat(depth, 4, 20, 15);
+  }
+  return uint32_t(double(depth) * double(0xFFFFFF) + 0.5);
+}
+
+float Edram::UnpackDepth(DepthRenderTargetFormat format, uint32_t depth24) {
+  if (format == DepthRenderTargetFormat::kD24FS8) {
+    return DecodeSmallFloat(depth24, 4, 20, 15);
+  }
+  return float(double(depth24) / double(0xFFFFFF));
+}
+
+bool Edram::PackTexel(TextureFormat format, const float color[4],
+                      uint8_t* out) {
+  PackedLayout layout;
+  if (GetPackedLayout(format, &layout)) {
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < layout.count; ++i) {
+      value |= PackUnorm(color[i], layout.bits[i]) << layout.shifts[i];
+    }
+    uint32_t bits = layout.shifts[layout.count - 1] +
+                    layout.bits[layout.count - 1];
+    if (bits <= 8) {
+      *out = uint8_t(value);
+    } else if (bits <= 16) {
+      xe::store(out, uint16_t(value));
+    } else {
+      xe::store(out, value);
+    }
+    return true;
+  }
+
+  switch (format) {
+    case TextureFormat::k_8_8_8_8_GAMMA: {
+      uint32_t value = 0;
+      for (uint32_t i = 0; i < 4; ++i) {
+        float component = i < 3 ? LinearToGamma(color[i]) : color[i];
+        value |= PackUnorm(component, 8) << (i * 8);
+      }
+      xe::store(out, value);
+      return true;
+    }
+    case TextureFormat::k_2_10_10_10_FLOAT: {
+      uint32_t value = 0;
+      for (uint32_t i = 0; i < 3; ++i) {
+        value |= EncodeSmallFloat(color[i], 3, 7, 3) << (i * 10);
+      }
+      value |= PackUnorm(color[3], 2) << 30;
+      xe::store(out, value);
+      return true;
+    }
+    case TextureFormat::k_16:
+    case TextureFormat::k_16_16:
+    case TextureFormat::k_16_16_16_16: {
+      uint32_t count = format == TextureFormat::k_16
+                           ? 1
+                           : format == TextureFormat::k_16_16 ? 2 : 4;
+      for (uint32_t i = 0; i < count; ++i) {
+        xe::store(out + i * 2, uint16_t(PackFixed16(color[i])));
+      }
+      return true;
+    }
+    case TextureFormat::k_16_FLOAT:
+    case TextureFormat::k_16_16_FLOAT:
+    case TextureFormat::k_16_16_16_16_FLOAT: {
+      uint32_t count = format == TextureFormat::k_16_FLOAT
+                           ? 1
+                           : format == TextureFormat::k_16_16_FLOAT ? 2 : 4;
+      for (uint32_t i = 0; i < count; ++i) {
+        xe::store(out + i * 2, xe::float_to_half(color[i]));
+      }
+      return true;
+    }
+    case TextureFormat::k_32_FLOAT:
+    case TextureFormat::k_32_32_FLOAT:
+    case TextureFormat::k_32_32_32_32_FLOAT: {
+      uint32_t count = format == TextureFormat::k_32_FLOAT
+                           ? 1
+                           : format == TextureFormat::k_32_32_FLOAT ? 2 : 4;
+      std::memcpy(out, color, count * sizeof(float));
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+void Edram::UnpackColorSpan(ColorRenderTargetFormat format,
+                            const uint32_t* values, float* out_colors,
+                            uint32_t count) {
+  uint32_t i = 0;
+  switch (format) {
+    case ColorRenderTargetFormat::k_8_8_8_8:
+      for (; i + 4 <= count; i += 4) {
+        UnpackUnorm4x4<8, 8>(values + i, out_colors + i * 4);
+      }
+      break;
+    case ColorRenderTargetFormat::k_2_10_10_10:
+    case ColorRenderTargetFormat::k_2_10_10_10_AS_16_16_16_16:
+      for (; i + 4 <= count; i += 4) {
+        UnpackUnorm4x4<10, 2>(values + i, out_colors + i * 4);
+      }
+      break;
+    case ColorRenderTargetFormat::k_16_16:
+      for (; i + 4 <= count; i += 4) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+        __m128 r = UnpackFixed16x4(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+        __m128 g = UnpackFixed16x4(_mm_srai_epi32(v, 16));
+        __m128 b = _mm_setzero_ps();
+        __m128 a = _mm_set1_ps(1.0f);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+        float* out = out_colors + i * 4;
+        _mm_storeu_ps(out, r);
+        _mm_storeu_ps(out + 4, g);
+        _mm_storeu_ps(out + 8, b);
+        _mm_storeu_ps(out + 12, a);
+      }
+      break;
+    case ColorRenderTargetFormat::k_16_16_16_16:
+      // Two pixels per iteration: the low halves hold red and blue and the
+      // high halves green and alpha.
+      for (; i + 2 <= count; i += 2) {
+        __m128i v =
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i * 2));
+        __m128 low =
+            UnpackFixed16x4(_mm_srai_epi32(_mm_slli_epi32(v, 16), 16));
+        __m128 high = UnpackFixed16x4(_mm_srai_epi32(v, 16));
+        _mm_storeu_ps(out_colors + i * 4, _mm_unpacklo_ps(low, high));
+        _mm_storeu_ps(out_colors + i * 4 + 4, _mm_unpackhi_ps(low, high));
+      }
+      break;
+    case ColorRenderTargetFormat::k_32_FLOAT:
+      for (; i < count; ++i) {
+        float* out = out_colors + i * 4;
+        std::memcpy(out, values + i, sizeof(float));
+        out[1] = out[2] = 0.0f;
+        out[3] = 1.0f;
+      }
+      break;
+    case ColorRenderTargetFormat::k_32_32_FLOAT:
+      for (; i < count; ++i) {
+        float* out = out_colors + i * 4;
+        std::memcpy(out, values + i * 2, sizeof(float) * 2);
+        out[2] = 0.0f;
+        out[3] = 1.0f;
+      }
+      break;
+    default:
+      break;
+  }
+  uint32_t stride = IsColorFormat64bpp(format) ? 2 : 1;
+  for (; i < count; ++i) {
+    UnpackColor(format, values + i * stride, out_colors + i * 4);
+  }
+}
+
+bool Edram::PackTexelSpan(TextureFormat format, const float* colors,
+                          uint8_t* out, uint32_t count) {
+  uint32_t i = 0;
+  switch (format) {
+    case TextureFormat::k_8_8_8_8:
+    case TextureFormat::k_8_8_8_8_A:
+    case TextureFormat::k_8_8_8_8_AS_16_16_16_16:
+      for (; i + 4 <= count; i += 4) {
+        PackUnorm4x4<8, 8>(colors + i * 4,
+                           reinterpret_cast<uint32_t*>(out + i * 4));
+      }
+      break;
+    case TextureFormat::k_2_10_10_10:
+    case TextureFormat::k_2_10_10_10_AS_16_16_16_16:
+      for (; i + 4 <= count; i += 4) {
+        PackUnorm4x4<10, 2>(colors + i * 4,
+                            reinterpret_cast<uint32_t*>(out + i * 4));
+      }
+      break;
+    case TextureFormat::k_16_16:
+      for (; i < count; ++i) {
+        __m128i value = PackFixed16x4(_mm_loadu_ps(colors + i * 4));
+        xe::store(out + i * 4, uint32_t(_mm_cvtsi128_si32(value)));
+      }
+      break;
+    case TextureFormat::k_16_16_16_16:
+      for (; i < count; ++i) {
+        __m128i value = PackFixed16x4(_mm_loadu_ps(colors + i * 4));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i * 8), value);
+      }
+      break;
+    case TextureFormat::k_32_FLOAT:
+      for (; i < count; ++i) {
+        std::memcpy(out + i * 4, colors + i * 4, sizeof(float));
+      }
+      break;
+    case TextureFormat::k_32_32_FLOAT:
+      for (; i < count; ++i) {
+        std::memcpy(out + i * 8, colors + i * 4, sizeof(float) * 2);
+      }
+      break;
+    case TextureFormat::k_32_32_32_32_FLOAT:
+      std::memcpy(out, colors, size_t(count) * sizeof(float) * 4);
+      return true;
+    default:
+      break;
+  }
+  if (i >= count) {
+    return true;
+  }
+  uint32_t texel_size = FormatInfo::Get(format)->bytes_per_block();
+  for (; i < count; ++i) {
+    if (!PackTexel(format, colors + i * 4, out + i * texel_size)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void Edram::ClearColor(uint32_t base_tile, uint32_t surface_pitch,
+                       MsaaSamples msaa_samples,
+                       ColorRenderTargetFormat format, uint32_t x, uint32_t y,
+                       uint32_t width, uint32_t height, uint32_t clear_low,
+                       uint32_t clear_high) {
+  SCOPE_profile_cpu_f("gpu");
+  bool is_64bpp = IsColorFormat64bpp(format);
+  uint32_t sample_count = GetSampleCount(msaa_samples);
+  for (uint32_t sample = 0; sample < sample_count; ++sample) {
+    for (uint32_t row = y; row < y + height; ++row) {
+      for (uint32_t column = x; column < x + width; ++column) {
+        uint32_t offset = GetOffset(base_tile, surface_pitch, msaa_samples,
+                                    is_64bpp, column, row, sample);
+        data_[offset] = clear_low;
+        if (is_64bpp) {
+          data_[offset + 1] = clear_high;
+        }
+      }
+    }
+  }
+}
+
+void Edram::ClearDepth(uint32_t base_tile, uint32_t surface_pitch,
+                       MsaaSamples msaa_samples, uint32_t x, uint32_t y,
+                       uint32_t width, uint32_t height, uint32_t clear_value) {
+  SCOPE_profile_cpu_f("gpu");
+  uint32_t sample_count = GetSampleCount(msaa_samples);
+  for (uint32_t sample = 0; sample < sample_count; ++sample) {
+    for (uint32_t row = y; row < y + height; ++row) {
+      for (uint32_t column = x; column < x + width; ++column) {
+        data_[GetOffset(base_tile, surface_pitch, msaa_samples, false, column,
+                        row, sample)] = clear_value;
+      }
+    }
+  }
+}
+
+void Edram::GatherRow(const EdramResolveInfo& info, bool is_64bpp, uint32_t y,
+                      uint32_t width, uint32_t sample) {
+  uint32_t stride = is_64bpp ? 2 : 1;
+  uint32_t tile_width = is_64bpp ? kTileWidth / 2 : kTileWidth;
+  uint32_t* out = row_values_.data();
+  uint32_t x = 0;
+  while (x < width) {
+    uint32_t offset =
+        GetOffset(info.edram_base, info.surface_pitch, info.msaa_samples,
+                  is_64bpp, info.src_x + x, info.src_y + y, sample);
+    // Pixels are contiguous up to the end of the tile row, except with 4X
+    // where the samples of a pixel are side by side.
+    uint32_t run = 1;
+    if (info.msaa_samples != MsaaSamples::k4X) {
+      run = std::min(width - x, tile_width - (info.src_x + x) % tile_width);
+    }
+    std::memcpy(out, data_.data() + offset, run * stride * sizeof(uint32_t));
+    out += run * stride;
+    x += run;
+  }
+}
+
+bool Edram::Resolve(const EdramResolveInfo& info, uint8_t* dest) {
+  SCOPE_profile_cpu_f("gpu");
+
+  const FormatInfo* format_info = FormatInfo::Get(info.dest_format);
+  if (format_info->block_width != 1 || format_info->block_height != 1) {
+    XELOGW("EDRAM: unsupported resolve destination format %u",
+           uint32_t(info.dest_format));
+    return false;
+  }
+  uint32_t bytes_per_texel = format_info->bytes_per_block();
+  if (info.dest_x >= info.dest_pitch || info.dest_y >= info.dest_height) {
+    return true;
+  }
+  uint32_t width = std::min(info.width, info.dest_pitch - info.dest_x);
+  uint32_t height = std::min(info.height, info.dest_height - info.dest_y);
+  if (!width || !height) {
+    return true;
+  }
+
+  bool is_64bpp = !info.is_depth && IsColorFormat64bpp(info.color_format);
+  uint32_t samples[4];
+  uint32_t sample_count =
+      GetResolveSamples(info.msaa_samples, info.sample_select, samples);
+  // Averaged color is scaled once along with the exponent bias.
+  const __m128 scale = _mm_set1_ps(std::ldexp(1.0f, info.exp_bias) /
+                                   float(info.is_depth ? 1 : sample_count));
+
+  // Convert into a linear staging image in the destination format.
+  size_t row_length = size_t(width) * bytes_per_texel;
+  resolve_scratch_.resize(row_length * height);
+  row_values_.resize(size_t(width) * (is_64bpp ? 2 : 1));
+  row_colors_.resize(size_t(width) * 4);
+  row_sum_.resize(size_t(width) * 4);
+  for (uint32_t y = 0; y < height; ++y) {
+    uint8_t* texel_row = resolve_scratch_.data() + y * row_length;
+    if (info.is_depth) {
+      // Depth is copied as the raw 24:8 value of a single sample.
+      GatherRow(info, false, y, width, samples[0]);
+      for (uint32_t x = 0; x < width; ++x) {
+        uint8_t* texel = texel_row + x * bytes_per_texel;
+        std::memset(texel, 0, bytes_per_texel);
+        std::memcpy(texel, &row_values_[x], std::min(bytes_per_texel, 4u));
+      }
+      continue;
+    }
+
+    for (uint32_t i = 0; i < sample_count; ++i) {
+      GatherRow(info, is_64bpp, y, width, samples[i]);
+      UnpackColorSpan(info.color_format, row_values_.data(),
+                      i ? row_colors_.data() : row_sum_.data(), width);
+      if (i) {
+        for (uint32_t j = 0; j < width * 4; j += 4) {
+          __m128 sum = _mm_add_ps(_mm_loadu_ps(&row_sum_[j]),
+                                  _mm_loadu_ps(&row_colors_[j]));
+          _mm_storeu_ps(&row_sum_[j], sum);
+        }
+      }
+    }
+    float* colors = row_sum_.data();
+    for (uint32_t j = 0; j < width * 4; j += 4) {
+      __m128 color = _mm_mul_ps(_mm_loadu_ps(colors + j), scale);
+      if (info.swap_red_blue) {
+        color = _mm_shuffle_ps(color, color, _MM_SHUFFLE(3, 0, 1, 2));
+      }
+      _mm_storeu_ps(colors + j, color);
+    }
+    if (!PackTexelSpan(info.dest_format, colors, texel_row, width)) {
+      XELOGW("EDRAM: unsupported resolve destination format %u",
+             uint32_t(info.dest_format));
+      return false;
+    }
+  }
+
+  Endian endian = info.dest_endian;
+  if (info.dest_tiled) {
+    texture_conversion::UntileInfo tile_info;
+    std::memset(&tile_info, 0, sizeof(tile_info));
+    tile_info.offset_x = info.dest_x;
+    tile_info.offset_y = info.dest_y;
+    tile_info.width = width;
+    tile_info.height = height;
+    tile_info.input_pitch = width;
+    tile_info.output_pitch = info.dest_pitch;
+    tile_info.input_format_info = format_info;
+    tile_info.output_format_info = format_info;
+    tile_info.copy_callback = [=](auto o, auto i, auto l) {
+      texture_conversion::CopySwapBlock(endian, o, i, l);
+    };
+    texture_conversion::Tile(dest, resolve_scratch_.data(), &tile_info);
+  } else {
+    for (uint32_t y = 0; y < height; ++y) {
+      uint8_t* dest_row =
+          dest + (size_t(info.dest_y + y) * info.dest_pitch + info.dest_x) *
+                     bytes_per_texel;
+      texture_conversion::CopySwapBlock(
+          endian, dest_row, resolve_scratch_.data() + y * row_length,
+          row_length);
+    }
+  }
+  return true;
+}
+
+bool Edram::Resolve(const EdramResolveInfo& info, Memory* memory) {
+  return Resolve(info,
+                 memory->TranslatePhysical<uint8_t*>(info.dest_address));
+}
+
+void Edram::Copy(const EdramCopyInfo& info, Memory* memory) {
+  if (info.resolve) {
+    Resolve(info.resolve_info, memory);
+  }
+  if (info.color_clear) {
+    ClearColor(info.color_base, info.surface_pitch, info.msaa_samples,
+               info.color_format, info.x, info.y, info.width, info.height,
+               info.color_clear_low, info.color_clear_high);
+  }
+  if (info.depth_clear) {
+    ClearDepth(info.depth_base, info.surface_pitch, info.msaa_samples, info.x,
+               info.y, info.width, info.height, info.depth_clear_value);
+  }
+}
+
+}  // namespace gpu
+}  // namespace xe
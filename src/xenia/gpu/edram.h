@@ -0,0 +1,190 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_EDRAM_H_
+#define XENIA_GPU_EDRAM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/texture_info.h"
+#include "xenia/gpu/xenos.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace gpu {
+
+// Parameters of a copy from EDRAM to guest memory.
+struct EdramResolveInfo {
+  bool is_depth = false;
+  uint32_t edram_base = 0;
+  // Surface pitch in pixels, as in RB_SURFACE_INFO.
+  uint32_t surface_pitch = 0;
+  MsaaSamples msaa_samples = MsaaSamples::k1X;
+  ColorRenderTargetFormat color_format = ColorRenderTargetFormat::k_8_8_8_8;
+  DepthRenderTargetFormat depth_format = DepthRenderTargetFormat::kD24S8;
+
+  // Source rectangle in EDRAM pixels.
+  uint32_t src_x = 0;
+  uint32_t src_y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  // RB_COPY_CONTROL copy_sample_select: 0-3 take a single sample, 4 averages
+  // samples 0 and 1, 5 samples 2 and 3 and 6 all of them. Depth never
+  // averages and uses the first selected sample.
+  uint32_t sample_select = 0;
+
+  // Physical address of the destination texture and its size in texels. For
+  // tiled destinations the pitch is the tiled (aligned) pitch.
+  uint32_t dest_address = 0;
+  uint32_t dest_pitch = 0;
+  uint32_t dest_height = 0;
+  uint32_t dest_x = 0;
+  uint32_t dest_y = 0;
+  TextureFormat dest_format = TextureFormat::k_8_8_8_8;
+  Endian dest_endian = Endian::kUnspecified;
+  bool dest_tiled = true;
+
+  // Color conversion applied on the way out.
+  bool swap_red_blue = false;
+  int32_t exp_bias = 0;
+};
+
+// A copy command decoded from the RB_COPY_* registers: an optional resolve
+// followed by optional clears of the same rectangle.
+struct EdramCopyInfo {
+  bool resolve = false;
+  EdramResolveInfo resolve_info;
+
+  // Rectangle in EDRAM pixels that the clears cover.
+  uint32_t surface_pitch = 0;
+  MsaaSamples msaa_samples = MsaaSamples::k1X;
+  uint32_t x = 0;
+  uint32_t y = 0;
+  uint32_t width = 0;
+  uint32_t height = 0;
+
+  bool color_clear = false;
+  uint32_t color_base = 0;
+  ColorRenderTargetFormat color_format = ColorRenderTargetFormat::k_8_8_8_8;
+  uint32_t color_clear_low = 0;
+  uint32_t color_clear_high = 0;
+
+  bool depth_clear = false;
+  uint32_t depth_base = 0;
+  uint32_t depth_clear_value = 0;
+
+  // Guest memory the copy reads its rectangle from and writes the resolve
+  // to, for trace writers.
+  uint32_t rect_address = 0;
+  uint32_t rect_length = 0;
+  uint32_t written_address = 0;
+  uint32_t written_length = 0;
+
+  // Decodes the copy registers. Returns false if the copy does nothing.
+  static bool Decode(const RegisterFile& regs, Memory* memory,
+                     EdramCopyInfo* out_info);
+};
+
+// CPU model of the 10 MiB of embedded render target memory, shared by the
+// software backend, backends that want CPU resolves, tools and tests.
+//
+// EDRAM is split into 2048 tiles of 80x16 dwords; render targets are placed
+// at a tile index and laid out row of tiles by row of tiles with the surface
+// pitch. Pixels are stored in the render target format: 32bpp formats use one
+// dword per pixel and 64bpp formats two, so 64bpp tiles are 40 pixels wide.
+// Depth is stored as (depth24 << 8) | stencil. Multisampled surfaces store
+// samples as extra pixels: 2X doubles the height and 4X doubles both
+// dimensions, with sample 0 at the top left of each pixel.
+class Edram {
+ public:
+  static const uint32_t kTileCount = 2048;
+  static const uint32_t kTileWidth = 80;
+  static const uint32_t kTileHeight = 16;
+  static const uint32_t kTileDwords = kTileWidth * kTileHeight;
+
+  Edram();
+  ~Edram();
+
+  uint32_t* data() { return data_.data(); }
+  const uint32_t* data() const { return data_.data(); }
+
+  static bool IsColorFormat64bpp(ColorRenderTargetFormat format);
+  static uint32_t GetSampleCount(MsaaSamples msaa_samples);
+
+  // Returns the dword index of a sample of a render target at base_tile.
+  static uint32_t GetOffset(uint32_t base_tile, uint32_t surface_pitch,
+                            MsaaSamples msaa_samples, bool is_64bpp,
+                            uint32_t x, uint32_t y, uint32_t sample = 0);
+
+  // Converts between float RGBA and the render target representation. 32bpp
+  // formats only use the first dword.
+  static void PackColor(ColorRenderTargetFormat format, const float color[4],
+                        uint32_t out_value[2]);
+  static void UnpackColor(ColorRenderTargetFormat format,
+                          const uint32_t value[2], float out_color[4]);
+
+  // Converts between [0, 1] depth and the 24 bit depth representation.
+  static uint32_t PackDepth(DepthRenderTargetFormat format, float depth);
+  static float UnpackDepth(DepthRenderTargetFormat format, uint32_t depth24);
+
+  // Writes one texel of an uncompressed resolve destination format. Returns
+  // false if the format can't be a resolve destination.
+  static bool PackTexel(TextureFormat format, const float color[4],
+                        uint8_t* out);
+
+  // Span versions of UnpackColor and PackTexel over count pixels of packed
+  // render target values (two dwords each for 64bpp) and float RGBA. The
+  // 8_8_8_8, 2_10_10_10, 16_16(_16_16) and 32 bit float formats use SSE and
+  // produce the same bits as the per-pixel functions.
+  static void UnpackColorSpan(ColorRenderTargetFormat format,
+                              const uint32_t* values, float* out_colors,
+                              uint32_t count);
+  static bool PackTexelSpan(TextureFormat format, const float* colors,
+                            uint8_t* out, uint32_t count);
+
+  // Fill a rectangle of pixels, all samples included, with raw values: for
+  // 32bpp color only clear_low is written.
+  void ClearColor(uint32_t base_tile, uint32_t surface_pitch,
+                  MsaaSamples msaa_samples, ColorRenderTargetFormat format,
+                  uint32_t x, uint32_t y, uint32_t width, uint32_t height,
+                  uint32_t clear_low, uint32_t clear_high);
+  void ClearDepth(uint32_t base_tile, uint32_t surface_pitch,
+                  MsaaSamples msaa_samples, uint32_t x, uint32_t y,
+                  uint32_t width, uint32_t height, uint32_t clear_value);
+
+  // Converts a rectangle of a render target to the destination format and
+  // writes it to dest, the host address of info.dest_address. Returns false
+  // if the destination format is not supported.
+  bool Resolve(const EdramResolveInfo& info, uint8_t* dest);
+  bool Resolve(const EdramResolveInfo& info, Memory* memory);
+
+  // Performs a decoded copy command: the resolve, then the clears.
+  void Copy(const EdramCopyInfo& info, Memory* memory);
+
+ private:
+  // Gathers one row of samples of the source rectangle into row_values_.
+  void GatherRow(const EdramResolveInfo& info, bool is_64bpp, uint32_t y,
+                 uint32_t width, uint32_t sample);
+
+  std::vector<uint32_t> data_;
+
+  // Resolve scratch, kept to avoid reallocating for every copy.
+  std::vector<uint32_t> row_values_;
+  std::vector<float> row_colors_;
+  std::vector<float> row_sum_;
+  std::vector<uint8_t> resolve_scratch_;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_EDRAM_H_
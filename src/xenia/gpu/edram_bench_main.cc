@@ -0,0 +1,180 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/base/math.h"
+#include "xenia/gpu/edram.h"
+#include "xenia/gpu/texture_info.h"
+
+DEFINE_int32(edram_bench_width, 1280, "Width in pixels of the resolves.");
+DEFINE_int32(edram_bench_height, 720, "Height in pixels of the resolves.");
+DEFINE_int32(edram_bench_iterations, 20,
+             "Number of times each conversion is repeated.");
+
+namespace xe {
+namespace gpu {
+
+using namespace xe::gpu::xenos;
+
+// CPU-only benchmark of the EDRAM library: span conversions against their
+// per-pixel reference versions, then whole resolves per render target format.
+// EDRAM holds random data, so only throughput is meaningful.
+class EdramBench {
+ public:
+  void Run() {
+    width_ = std::min(uint32_t(FLAGS_edram_bench_width), 2560u);
+    height_ = uint32_t(FLAGS_edram_bench_height);
+    XELOGI("EDRAM benchmark: %ux%u, %d iterations", width_, height_,
+           FLAGS_edram_bench_iterations);
+
+    std::mt19937 random(0x4544524D);
+    for (uint32_t i = 0; i < Edram::kTileCount * Edram::kTileDwords; ++i) {
+      edram_.data()[i] = uint32_t(random());
+    }
+
+    for (const auto& format : kFormats) {
+      BenchSpans(format);
+    }
+    for (const auto& format : kFormats) {
+      BenchResolve(format, MsaaSamples::k1X, 0);
+    }
+    // Averaging four samples is the most expensive resolve.
+    BenchResolve(kFormats[0], MsaaSamples::k4X, 6);
+    BenchResolve(kFormats[3], MsaaSamples::k4X, 6);
+  }
+
+ private:
+  struct Format {
+    const char* name;
+    ColorRenderTargetFormat color_format;
+    TextureFormat texture_format;
+  };
+  static const Format kFormats[6];
+
+  // Runs fn iterations times and logs the throughput for pixels per run.
+  void Measure(const std::string& name, size_t pixels,
+               const std::function<void()>& fn) {
+    fn();
+    uint64_t start = Clock::QueryHostTickCount();
+    for (int i = 0; i < FLAGS_edram_bench_iterations; ++i) {
+      fn();
+    }
+    uint64_t ticks = Clock::QueryHostTickCount() - start;
+    double seconds = double(ticks) / double(Clock::host_tick_frequency());
+    double per_run_ms = seconds * 1000.0 / FLAGS_edram_bench_iterations;
+    double mpixels_per_second =
+        double(pixels) * FLAGS_edram_bench_iterations / seconds / 1.0e6;
+    XELOGI("  %-44s %9.3f ms %10.1f Mpix/s", name.c_str(), per_run_ms,
+           mpixels_per_second);
+  }
+
+  void BenchSpans(const Format& format) {
+    uint32_t pixel_count = width_ * height_;
+    uint32_t stride = Edram::IsColorFormat64bpp(format.color_format) ? 2 : 1;
+    uint32_t texel_size =
+        FormatInfo::Get(format.texture_format)->bytes_per_block();
+    // Wraps around EDRAM for large sizes; only the speed matters.
+    uint32_t span_pixels = std::min(
+        pixel_count, Edram::kTileCount * Edram::kTileDwords / stride);
+    colors_.resize(size_t(span_pixels) * 4);
+    texels_.resize(size_t(span_pixels) * texel_size);
+    const uint32_t* values = edram_.data();
+
+    std::string name = format.name;
+    Measure(name + " unpack per-pixel", span_pixels, [&]() {
+      for (uint32_t i = 0; i < span_pixels; ++i) {
+        Edram::UnpackColor(format.color_format, values + i * stride,
+                           &colors_[i * 4]);
+      }
+    });
+    Measure(name + " unpack span", span_pixels, [&]() {
+      Edram::UnpackColorSpan(format.color_format, values, colors_.data(),
+                             span_pixels);
+    });
+    Measure(name + " pack per-pixel", span_pixels, [&]() {
+      for (uint32_t i = 0; i < span_pixels; ++i) {
+        Edram::PackTexel(format.texture_format, &colors_[i * 4],
+                         &texels_[i * texel_size]);
+      }
+    });
+    Measure(name + " pack span", span_pixels, [&]() {
+      Edram::PackTexelSpan(format.texture_format, colors_.data(),
+                           texels_.data(), span_pixels);
+    });
+  }
+
+  void BenchResolve(const Format& format, MsaaSamples msaa_samples,
+                    uint32_t sample_select) {
+    EdramResolveInfo info;
+    info.surface_pitch = width_;
+    info.msaa_samples = msaa_samples;
+    info.color_format = format.color_format;
+    info.width = width_;
+    info.height = height_;
+    info.sample_select = sample_select;
+    info.dest_pitch = xe::round_up(width_, 32u);
+    info.dest_height = xe::round_up(height_, 32u);
+    info.dest_format = format.texture_format;
+    info.dest_endian = Endian::k8in32;
+    info.dest_tiled = true;
+    uint32_t texel_size =
+        FormatInfo::Get(format.texture_format)->bytes_per_block();
+    dest_.resize(size_t(info.dest_pitch) * info.dest_height * texel_size);
+
+    std::string name = std::string("Resolve ") + format.name;
+    if (msaa_samples == MsaaSamples::k4X) {
+      name += " 4X average";
+    }
+    Measure(name, size_t(width_) * height_,
+            [&]() { edram_.Resolve(info, dest_.data()); });
+  }
+
+  Edram edram_;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<float> colors_;
+  std::vector<uint8_t> texels_;
+  std::vector<uint8_t> dest_;
+};
+
+const EdramBench::Format EdramBench::kFormats[6] = {
+    {"8_8_8_8", ColorRenderTargetFormat::k_8_8_8_8, TextureFormat::k_8_8_8_8},
+    {"2_10_10_10", ColorRenderTargetFormat::k_2_10_10_10,
+     TextureFormat::k_2_10_10_10},
+    {"16_16_16_16", ColorRenderTargetFormat::k_16_16_16_16,
+     TextureFormat::k_16_16_16_16},
+    {"16_16_16_16_FLOAT", ColorRenderTargetFormat::k_16_16_16_16_FLOAT,
+     TextureFormat::k_16_16_16_16_FLOAT},
+    {"32_FLOAT", ColorRenderTargetFormat::k_32_FLOAT,
+     TextureFormat::k_32_FLOAT},
+    {"8_8_8_8_GAMMA", ColorRenderTargetFormat::k_8_8_8_8_GAMMA,
+     TextureFormat::k_8_8_8_8_GAMMA},
+};
+
+int edram_bench_main(const std::vector<std::wstring>& args) {
+  EdramBench bench;
+  bench.Run();
+  return 0;
+}
+
+}  // namespace gpu
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-gpu-edram-bench", L"xenia-gpu-edram-bench",
+                   xe::gpu::edram_bench_main);
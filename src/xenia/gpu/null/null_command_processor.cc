@@ -9,6 +9,16 @@
 
 #include "xenia/gpu/null/null_command_processor.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "third_party/xxhash/xxhash.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/null/null_gpu_flags.h"
+#include "xenia/gpu/texture_conversion.h"
+#include "xenia/gpu/texture_info.h"
+
 namespace xe {
 namespace gpu {
 namespace null {
@@ -19,32 +29,183 @@ NullCommandProcessor::NullCommandProcessor(NullGraphicsSystem* graphics_system,
 NullCommandProcessor::~NullCommandProcessor() = default;
 
 bool NullCommandProcessor::SetupContext() {
+  shader_translator_ = std::make_unique<SpirvShaderTranslator>();
   return CommandProcessor::SetupContext();
 }
 
 void NullCommandProcessor::ShutdownContext() {
+  shader_map_.clear();
+  shader_translator_.reset();
+  converted_textures_.clear();
+  texture_scratch_.clear();
+  edram_.reset();
   return CommandProcessor::ShutdownContext();
 }
 
 void NullCommandProcessor::PerformSwap(uint32_t frontbuffer_ptr,
                                        uint32_t frontbuffer_width,
-                                       uint32_t frontbuffer_height) {}
+                                       uint32_t frontbuffer_height) {
+  // Textures are allowed to change between frames, so convert them again.
+  converted_textures_.clear();
+}
 
 Shader* NullCommandProcessor::LoadShader(ShaderType shader_type,
                                          uint32_t guest_address,
                                          const uint32_t* host_address,
                                          uint32_t dword_count) {
-  return nullptr;
+  if (!FLAGS_null_translate_shaders && !FLAGS_null_convert_textures) {
+    return nullptr;
+  }
+
+  // Hash the input memory and lookup the shader.
+  uint64_t data_hash = XXH64(host_address, dword_count * sizeof(uint32_t), 0);
+  auto it = shader_map_.find(data_hash);
+  if (it != shader_map_.end()) {
+    return it->second.get();
+  }
+
+  auto shader = new Shader(shader_type, data_hash, host_address, dword_count);
+  shader_map_.insert({data_hash, std::unique_ptr<Shader>(shader)});
+  return shader;
 }
 
 bool NullCommandProcessor::IssueDraw(PrimitiveType prim_type,
                                      uint32_t index_count,
                                      IndexBufferInfo* index_buffer_info) {
+  auto vertex_shader = active_vertex_shader_;
+  auto pixel_shader = active_pixel_shader_;
+
+  // Translation also parses the ucode, which fills in the texture bindings.
+  if (vertex_shader) {
+    TranslateShader(vertex_shader);
+  }
+  if (pixel_shader) {
+    TranslateShader(pixel_shader);
+  }
+
+  if (FLAGS_null_convert_textures) {
+    if (vertex_shader) {
+      ConvertTextures(vertex_shader->texture_bindings());
+    }
+    if (pixel_shader) {
+      ConvertTextures(pixel_shader->texture_bindings());
+    }
+  }
+  return true;
+}
+
+bool NullCommandProcessor::IssueCopy() {
+  if (!FLAGS_null_resolve) {
+    return true;
+  }
+  SCOPE_profile_cpu_f("gpu");
+  EdramCopyInfo copy_info;
+  if (!EdramCopyInfo::Decode(*register_file_, memory_, &copy_info)) {
+    return true;
+  }
+  if (!edram_) {
+    edram_ = std::make_unique<Edram>();
+  }
+  trace_writer_.WriteMemoryRead(copy_info.rect_address,
+                                copy_info.rect_length);
+  edram_->Copy(copy_info, memory_);
+  if (copy_info.resolve) {
+    trace_writer_.WriteMemoryWrite(copy_info.written_address,
+                                   copy_info.written_length);
+  }
   return true;
 }
 
-bool NullCommandProcessor::IssueCopy() { return true; }
+void NullCommandProcessor::TranslateShader(Shader* shader) {
+  if (shader->is_translated()) {
+    return;
+  }
+  SCOPE_profile_cpu_f("gpu");
+
+  xenos::xe_gpu_program_cntl_t sq_program_cntl;
+  sq_program_cntl.dword_0 =
+      register_file_->values[XE_GPU_REG_SQ_PROGRAM_CNTL].u32;
+  if (!shader_translator_->Translate(shader, sq_program_cntl)) {
+    XELOGE("Shader translation failed; marking shader as ignored");
+  }
+}
+
+void NullCommandProcessor::ConvertTextures(
+    const std::vector<Shader::TextureBinding>& bindings) {
+  SCOPE_profile_cpu_f("gpu");
+
+  auto& regs = *register_file_;
+  for (auto& binding : bindings) {
+    int r = XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + binding.fetch_constant * 6;
+    auto group =
+        reinterpret_cast<const xenos::xe_gpu_fetch_group_t*>(&regs.values[r]);
+    auto& fetch = group->texture_fetch;
+    if (fetch.type != 0x2) {
+      continue;
+    }
+
+    TextureInfo texture_info;
+    if (!TextureInfo::Prepare(fetch, &texture_info)) {
+      continue;
+    }
+    if (!converted_textures_.insert(texture_info.hash()).second) {
+      continue;
+    }
+
+    // Untile every mip into scratch memory in the guest format. The result is
+    // discarded; only the CPU cost matters here.
+    const FormatInfo* format_info = texture_info.format_info();
+    uint32_t bytes_per_block = format_info->bytes_per_block();
+    for (uint32_t mip = texture_info.mip_min_level;
+         mip <= texture_info.mip_max_level; mip++) {
+      uint32_t offset_x = 0;
+      uint32_t offset_y = 0;
+      uint32_t address =
+          texture_info.GetMipLocation(mip, &offset_x, &offset_y, true);
+      if (!address) {
+        continue;
+      }
+
+      auto extent = texture_info.GetMipExtent(mip, true);
+      uint32_t pitch = extent.block_pitch_h * bytes_per_block;
+      size_t face_length = size_t(pitch) * extent.block_pitch_v;
+      texture_scratch_.resize(
+          std::max(texture_scratch_.size(), face_length * extent.depth));
+
+      auto src_mem = memory_->TranslatePhysical<const uint8_t*>(address);
+      uint8_t* dest = texture_scratch_.data();
+      auto endianness = texture_info.endianness;
+      for (uint32_t face = 0; face < extent.depth; face++) {
+        if (!texture_info.is_tiled) {
+          const uint8_t* src =
+              src_mem + offset_y * pitch + offset_x * bytes_per_block;
+          for (uint32_t y = 0; y < extent.block_height; y++) {
+            texture_conversion::CopySwapBlock(endianness, dest + y * pitch,
+                                              src + y * pitch, pitch);
+          }
+        } else {
+          texture_conversion::UntileInfo untile_info;
+          std::memset(&untile_info, 0, sizeof(untile_info));
+          untile_info.offset_x = offset_x;
+          untile_info.offset_y = offset_y;
+          untile_info.width = extent.block_width;
+          untile_info.height = extent.block_height;
+          untile_info.input_pitch = extent.block_pitch_h;
+          untile_info.output_pitch = extent.block_pitch_h;
+          untile_info.input_format_info = format_info;
+          untile_info.output_format_info = format_info;
+          untile_info.copy_callback = [=](auto o, auto i, auto l) {
+            texture_conversion::CopySwapBlock(endianness, o, i, l);
+          };
+          texture_conversion::Untile(dest, src_mem, &untile_info);
+        }
+        src_mem += face_length;
+        dest += face_length;
+      }
+    }
+  }
+}
 
 }  // namespace null
 }  // namespace gpu
-}  // namespace xe
\ No newline at end of file
+}  // namespace xe
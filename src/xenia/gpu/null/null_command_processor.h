@@ -10,8 +10,16 @@
 #ifndef XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 #define XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/edram.h"
 #include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/spirv_shader_translator.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/kernel/kernel_state.h"
 
@@ -39,6 +47,22 @@ class NullCommandProcessor : public CommandProcessor {
   bool IssueDraw(PrimitiveType prim_type, uint32_t index_count,
                  IndexBufferInfo* index_buffer_info) override;
   bool IssueCopy() override;
+
+  // CPU-side work normally done by a real backend, performed only when the
+  // matching null_* flags are set so the null backend can be used to profile
+  // the shader translator, texture conversion and resolves without a GPU.
+  void TranslateShader(Shader* shader);
+  void ConvertTextures(const std::vector<Shader::TextureBinding>& bindings);
+
+  std::unordered_map<uint64_t, std::unique_ptr<Shader>> shader_map_;
+  std::unique_ptr<SpirvShaderTranslator> shader_translator_;
+
+  // Textures already converted this frame, keyed by TextureInfo::hash().
+  std::unordered_set<uint64_t> converted_textures_;
+  std::vector<uint8_t> texture_scratch_;
+
+  // Created on the first copy with null_resolve set.
+  std::unique_ptr<Edram> edram_;
 };
 
 }  // namespace null
@@ -0,0 +1,21 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/null/null_gpu_flags.h"
+
+DEFINE_bool(null_translate_shaders, false,
+            "Translate shaders to SPIR-V on the CPU even though the null "
+            "backend discards them. Useful for benchmarking.");
+DEFINE_bool(null_convert_textures, false,
+            "Untile and convert textures referenced by draws into scratch "
+            "memory. Useful for benchmarking.");
+DEFINE_bool(null_resolve, false,
+            "Perform EDRAM clears and resolves on the CPU. Nothing is drawn "
+            "into EDRAM, but resolved clears reach guest memory. Useful for "
+            "benchmarking.");
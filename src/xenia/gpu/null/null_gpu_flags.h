@@ -0,0 +1,19 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_NULL_NULL_GPU_FLAGS_H_
+#define XENIA_GPU_NULL_NULL_GPU_FLAGS_H_
+
+#include <gflags/gflags.h>
+
+DECLARE_bool(null_translate_shaders);
+DECLARE_bool(null_convert_textures);
+DECLARE_bool(null_resolve);
+
+#endif  // XENIA_GPU_NULL_NULL_GPU_FLAGS_H_
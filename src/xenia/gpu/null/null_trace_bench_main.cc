@@ -0,0 +1,37 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/trace_bench.h"
+
+namespace xe {
+namespace gpu {
+namespace null {
+
+class NullTraceBench : public TraceBench {
+ public:
+  std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() override {
+    return std::unique_ptr<gpu::GraphicsSystem>(new NullGraphicsSystem());
+  }
+};
+
+int trace_bench_main(const std::vector<std::wstring>& args) {
+  NullTraceBench trace_bench;
+  return trace_bench.Main(args);
+}
+
+}  // namespace null
+}  // namespace gpu
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-gpu-trace-bench",
+                   L"xenia-gpu-trace-bench some.trace",
+                   xe::gpu::null::trace_bench_main);
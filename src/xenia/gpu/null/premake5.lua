@@ -19,3 +19,54 @@ project("xenia-gpu-null")
     project_root.."/third_party/gflags/src",
   })
   local_platform_files()
+
+group("src")
+project("xenia-gpu-trace-bench")
+  uuid("8d3f7c2e-5a41-4b9e-9c6d-2f1a0e7b4d58")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "capstone",
+    "gflags",
+    "glslang-spirv",
+    "imgui",
+    "libavcodec",
+    "libavutil",
+    "snappy",
+    "spirv-tools",
+    "volk",
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-cpu-backend-x64",
+    "xenia-gpu",
+    "xenia-gpu-null",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-ui-spirv",
+    "xenia-ui-vulkan",
+    "xenia-vfs",
+    "xxhash",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "null_trace_bench_main.cc",
+    "../../base/main_"..platform_suffix..".cc",
+  })
+
+  filter("platforms:Linux")
+    links({
+      "X11",
+      "xcb",
+      "X11-xcb",
+      "GL",
+      "vulkan",
+    })
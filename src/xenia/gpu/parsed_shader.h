@@ -0,0 +1,170 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_PARSED_SHADER_H_
+#define XENIA_GPU_PARSED_SHADER_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe {
+namespace gpu {
+
+// Immutable result of parsing a shader's ucode: every control flow, fetch and
+// ALU instruction decoded, the bindings and constants it uses and its
+// disassembly. Parsing is independent of the translation target and of
+// SQ_PROGRAM_CNTL, so one ParsedShader per ucode hash is shared by every
+// translator and every Shader object with that ucode, on any thread.
+//
+// Translators consume it as a flat list of steps that replays the
+// ShaderTranslator::Process* callbacks in ucode order.
+class ParsedShader {
+ public:
+  enum class StepType : uint8_t {
+    // index is the control flow index.
+    kLabel,
+    kControlFlowBegin,
+    kControlFlowEnd,
+    kControlFlowNop,
+    // index is into exec_instructions().
+    kExecBegin,
+    kExecEnd,
+    // index is into the matching per-kind instruction list.
+    kLoopStart,
+    kLoopEnd,
+    kCall,
+    kReturn,
+    kJump,
+    kAlloc,
+    kVertexFetch,
+    kTextureFetch,
+    kAlu,
+  };
+  struct Step {
+    StepType type;
+    uint32_t index;
+    // Line in the ucode disassembly the step corresponds to.
+    uint32_t disasm_line;
+  };
+
+  // Returns the parse of the given ucode (in host endianness), sharing it
+  // with all other users of the same ucode_hash. A hash of 0 is treated as
+  // unknown and always parses a private copy. Thread safe.
+  static std::shared_ptr<const ParsedShader> Get(ShaderType shader_type,
+                                                 uint64_t ucode_hash,
+                                                 const uint32_t* ucode_dwords,
+                                                 size_t ucode_dword_count);
+  // Parses the ucode without consulting the shared cache.
+  static std::shared_ptr<const ParsedShader> Parse(
+      ShaderType shader_type, const uint32_t* ucode_dwords,
+      size_t ucode_dword_count);
+
+  ParsedShader(const ParsedShader&) = delete;
+  ParsedShader& operator=(const ParsedShader&) = delete;
+
+  ShaderType type() const { return shader_type_; }
+  size_t ucode_dword_count() const { return ucode_dword_count_; }
+
+  // All control flow instructions, in pairs as stored in the ucode.
+  const std::vector<ucode::ControlFlowInstruction>& cf_instructions() const {
+    return cf_instructions_;
+  }
+  const std::vector<Step>& steps() const { return steps_; }
+
+  const std::vector<ParsedExecInstruction>& exec_instructions() const {
+    return exec_instructions_;
+  }
+  const std::vector<ParsedLoopStartInstruction>& loop_start_instructions()
+      const {
+    return loop_start_instructions_;
+  }
+  const std::vector<ParsedLoopEndInstruction>& loop_end_instructions() const {
+    return loop_end_instructions_;
+  }
+  const std::vector<ParsedCallInstruction>& call_instructions() const {
+    return call_instructions_;
+  }
+  const std::vector<ParsedReturnInstruction>& return_instructions() const {
+    return return_instructions_;
+  }
+  const std::vector<ParsedJumpInstruction>& jump_instructions() const {
+    return jump_instructions_;
+  }
+  const std::vector<ParsedAllocInstruction>& alloc_instructions() const {
+    return alloc_instructions_;
+  }
+  const std::vector<ParsedVertexFetchInstruction>& vertex_fetch_instructions()
+      const {
+    return vertex_fetch_instructions_;
+  }
+  const std::vector<ParsedTextureFetchInstruction>&
+  texture_fetch_instructions() const {
+    return texture_fetch_instructions_;
+  }
+  const std::vector<ParsedAluInstruction>& alu_instructions() const {
+    return alu_instructions_;
+  }
+
+  const std::vector<Shader::VertexBinding>& vertex_bindings() const {
+    return vertex_bindings_;
+  }
+  const std::vector<Shader::TextureBinding>& texture_bindings() const {
+    return texture_bindings_;
+  }
+  // Bit per texture fetch constant [0-31] used by texture_bindings().
+  uint32_t texture_fetch_mask() const { return texture_fetch_mask_; }
+  const Shader::ConstantRegisterMap& constant_register_map() const {
+    return constant_register_map_;
+  }
+  bool writes_color_target(int i) const { return writes_color_targets_[i]; }
+
+  const std::string& ucode_disassembly() const { return ucode_disassembly_; }
+
+ private:
+  friend class ShaderParser;
+
+  ParsedShader() = default;
+
+  ShaderType shader_type_ = ShaderType::kVertex;
+  size_t ucode_dword_count_ = 0;
+
+  std::vector<ucode::ControlFlowInstruction> cf_instructions_;
+  std::vector<Step> steps_;
+
+  // Instruction records, each kind packed in its own array.
+  std::vector<ParsedExecInstruction> exec_instructions_;
+  std::vector<ParsedLoopStartInstruction> loop_start_instructions_;
+  std::vector<ParsedLoopEndInstruction> loop_end_instructions_;
+  std::vector<ParsedCallInstruction> call_instructions_;
+  std::vector<ParsedReturnInstruction> return_instructions_;
+  std::vector<ParsedJumpInstruction> jump_instructions_;
+  std::vector<ParsedAllocInstruction> alloc_instructions_;
+  std::vector<ParsedVertexFetchInstruction> vertex_fetch_instructions_;
+  std::vector<ParsedTextureFetchInstruction> texture_fetch_instructions_;
+  std::vector<ParsedAluInstruction> alu_instructions_;
+
+  std::vector<Shader::VertexBinding> vertex_bindings_;
+  std::vector<Shader::TextureBinding> texture_bindings_;
+  uint32_t texture_fetch_mask_ = 0;
+  Shader::ConstantRegisterMap constant_register_map_ = {0};
+  bool writes_color_targets_[4] = {false, false, false, false};
+
+  std::string ucode_disassembly_;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_PARSED_SHADER_H_
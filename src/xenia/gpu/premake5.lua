@@ -25,6 +25,8 @@ project("xenia-gpu")
   -- local_platform_files("spirv")
   -- local_platform_files("spirv/passes")
 
+include("testing")
+
 group("src")
 project("xenia-gpu-shader-compiler")
   uuid("ad76d3e4-4c62-439b-a0f6-f83fcf0e83c5")
@@ -59,3 +61,53 @@ project("xenia-gpu-shader-compiler")
         "1>scratch/stdout-shader-compiler.txt",
       })
     end
+
+group("src")
+project("xenia-gpu-texture-bench")
+  uuid("3b6e2a91-0f7d-4c58-8e1a-5d94c7b2e613")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "gflags",
+    "glslang-spirv",
+    "snappy",
+    "spirv-tools",
+    "xenia-base",
+    "xenia-gpu",
+    "xenia-ui-spirv",
+    "xxhash",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "texture_bench_main.cc",
+    "../base/main_"..platform_suffix..".cc",
+  })
+
+group("src")
+project("xenia-gpu-edram-bench")
+  uuid("a4c71e26-93d8-4b0f-8e52-1f6d3b9a7c04")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "gflags",
+    "glslang-spirv",
+    "snappy",
+    "spirv-tools",
+    "xenia-base",
+    "xenia-gpu",
+    "xenia-ui-spirv",
+    "xxhash",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "edram_bench_main.cc",
+    "../base/main_"..platform_suffix..".cc",
+  })
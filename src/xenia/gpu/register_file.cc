@@ -9,14 +9,22 @@
 
 #include "xenia/gpu/register_file.h"
 
+#include <algorithm>
 #include <cstring>
 
+#include "xenia/base/assert.h"
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 
 namespace xe {
 namespace gpu {
 
-RegisterFile::RegisterFile() { std::memset(values, 0, sizeof(values)); }
+RegisterFile::RegisterFile() {
+  std::memset(values, 0, sizeof(values));
+  // Start every group at the initial serial so that consumers that haven't
+  // synced yet (serial 0) see everything as dirty.
+  std::fill_n(dirty_stamps_, kDirtyGroupCount, dirty_serial_);
+}
 
 const RegisterInfo* RegisterFile::GetRegisterInfo(uint32_t index) {
   switch (index) {
@@ -35,5 +43,27 @@ const RegisterInfo* RegisterFile::GetRegisterInfo(uint32_t index) {
   }
 }
 
+void RegisterFile::WriteRangeFromGuest(uint32_t first,
+                                       const void* guest_values,
+                                       uint32_t count) {
+  assert_true(first + count <= kRegisterCount);
+  auto src = reinterpret_cast<const uint32_t*>(guest_values);
+  uint32_t swapped[kDirtyGroupSize];
+  while (count) {
+    // Stop at the end of the current group so that unchanged groups can be
+    // detected with a single compare.
+    uint32_t group_offset = first & (kDirtyGroupSize - 1);
+    uint32_t run = std::min(count, kDirtyGroupSize - group_offset);
+    xe::copy_and_swap_32_unaligned(swapped, src, run);
+    if (std::memcmp(&values[first], swapped, run * sizeof(uint32_t))) {
+      std::memcpy(&values[first], swapped, run * sizeof(uint32_t));
+      MarkDirty(first);
+    }
+    first += run;
+    src += run;
+    count -= run;
+  }
+}
+
 }  //  namespace gpu
 }  //  namespace xe
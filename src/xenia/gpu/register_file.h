@@ -46,6 +46,54 @@ class RegisterFile {
 
   RegisterValue& operator[](int reg) { return values[reg]; }
   RegisterValue& operator[](Register reg) { return values[reg]; }
+
+  // Registers are tracked for changes in groups of 64. Each group holds the
+  // serial of the last write that actually changed one of its values, so
+  // caches shadowing register state can remember the serial they last synced
+  // at and skip re-reading and re-hashing groups that haven't changed since.
+  static const uint32_t kDirtyGroupShift = 6;
+  static const uint32_t kDirtyGroupSize = 1 << kDirtyGroupShift;
+  static const size_t kDirtyGroupCount =
+      (kRegisterCount + kDirtyGroupSize - 1) >> kDirtyGroupShift;
+
+  // Serial of the most recent value-changing register write.
+  uint64_t dirty_serial() const { return dirty_serial_; }
+
+  // Returns true if any register in [first, first + count) changed after the
+  // given serial. A serial of 0 always reports dirty.
+  bool IsRangeDirty(uint32_t first, uint32_t count, uint64_t serial) const {
+    uint32_t first_group = first >> kDirtyGroupShift;
+    uint32_t last_group = (first + count - 1) >> kDirtyGroupShift;
+    for (uint32_t i = first_group; i <= last_group; ++i) {
+      if (dirty_stamps_[i] > serial) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Marks the group containing the register as changed.
+  void MarkDirty(uint32_t index) {
+    dirty_stamps_[index >> kDirtyGroupShift] = ++dirty_serial_;
+  }
+
+  // Sets a single register, marking it dirty only if the value changed.
+  void Write(uint32_t index, uint32_t value) {
+    if (values[index].u32 != value) {
+      values[index].u32 = value;
+      MarkDirty(index);
+    }
+  }
+
+  // Byte swaps count big-endian guest values into consecutive registers
+  // starting at first. Values are swapped a group at a time with the vector
+  // copy_and_swap routines and only groups whose contents change are marked.
+  void WriteRangeFromGuest(uint32_t first, const void* guest_values,
+                           uint32_t count);
+
+ private:
+  uint64_t dirty_serial_ = 1;
+  uint64_t dirty_stamps_[kDirtyGroupCount];
 };
 
 }  // namespace gpu
@@ -10,6 +10,7 @@
 #ifndef XENIA_GPU_SHADER_H_
 #define XENIA_GPU_SHADER_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -473,6 +474,8 @@ struct ParsedAluInstruction {
   void Disassemble(StringBuffer* out) const;
 };
 
+class ParsedShader;
+
 class Shader {
  public:
   struct Error {
@@ -552,6 +555,13 @@ class Shader {
     return texture_bindings_;
   }
 
+  // Bit per texture fetch constant [0-31] used by texture_bindings().
+  uint32_t texture_fetch_mask() const { return texture_fetch_mask_; }
+
+  // Parsed ucode shared by all shaders with the same ucode, or null until
+  // the shader has been translated or had its bindings gathered.
+  const ParsedShader* parsed_shader() const { return parsed_shader_.get(); }
+
   // Bitmaps of all constant registers accessed by the shader.
   const ConstantRegisterMap& constant_register_map() const {
     return constant_register_map_;
@@ -603,9 +613,11 @@ class Shader {
   ShaderType shader_type_;
   std::vector<uint32_t> ucode_data_;
   uint64_t ucode_data_hash_;
+  std::shared_ptr<const ParsedShader> parsed_shader_;
 
   std::vector<VertexBinding> vertex_bindings_;
   std::vector<TextureBinding> texture_bindings_;
+  uint32_t texture_fetch_mask_ = 0;
   ConstantRegisterMap constant_register_map_ = {0};
   bool writes_color_targets_[4] = {false, false, false, false};
 
@@ -15,6 +15,7 @@
 #include <vector>
 
 #include "xenia/base/string_buffer.h"
+#include "xenia/gpu/parsed_shader.h"
 #include "xenia/gpu/shader.h"
 #include "xenia/gpu/ucode.h"
 #include "xenia/gpu/xenos.h"
@@ -45,13 +46,16 @@ class ShaderTranslator {
   bool is_vertex_shader() const { return shader_type_ == ShaderType::kVertex; }
   // True if the current shader is a pixel shader.
   bool is_pixel_shader() const { return shader_type_ == ShaderType::kPixel; }
+  // Parsed ucode of the shader being translated, shared with other
+  // translators and shaders with the same ucode.
+  const ParsedShader& parsed_shader() const { return *parsed_shader_; }
   // A list of all vertex bindings, populated before translation occurs.
   const std::vector<Shader::VertexBinding>& vertex_bindings() const {
-    return vertex_bindings_;
+    return parsed_shader_->vertex_bindings();
   }
   // A list of all texture bindings, populated before translation occurs.
   const std::vector<Shader::TextureBinding>& texture_bindings() const {
-    return texture_bindings_;
+    return parsed_shader_->texture_bindings();
   }
 
   // Current line number in the ucode disassembly.
@@ -129,61 +133,14 @@ class ShaderTranslator {
   virtual void ProcessAluInstruction(const ParsedAluInstruction& instr) {}
 
  private:
-  struct AluOpcodeInfo {
-    const char* name;
-    size_t argument_count;
-    int src_swizzle_component_count;
-  };
+  // Returns the parse of the shader's ucode, shared through the shader.
+  const std::shared_ptr<const ParsedShader>& PrepareParsedShader(
+      Shader* shader);
 
   bool TranslateInternal(Shader* shader);
 
-  void MarkUcodeInstruction(uint32_t dword_offset);
-  void AppendUcodeDisasm(char c);
-  void AppendUcodeDisasm(const char* value);
-  void AppendUcodeDisasmFormat(const char* format, ...);
-
-  bool TranslateBlocks();
-  void GatherBindingInformation(const ucode::ControlFlowInstruction& cf);
-  void GatherVertexBindingInformation(const ucode::VertexFetchInstruction& op);
-  void GatherTextureBindingInformation(
-      const ucode::TextureFetchInstruction& op);
-  void TranslateControlFlowInstruction(const ucode::ControlFlowInstruction& cf);
-  void TranslateControlFlowNop(const ucode::ControlFlowInstruction& cf);
-  void TranslateControlFlowExec(const ucode::ControlFlowExecInstruction& cf);
-  void TranslateControlFlowCondExec(
-      const ucode::ControlFlowCondExecInstruction& cf);
-  void TranslateControlFlowCondExecPred(
-      const ucode::ControlFlowCondExecPredInstruction& cf);
-  void TranslateControlFlowLoopStart(
-      const ucode::ControlFlowLoopStartInstruction& cf);
-  void TranslateControlFlowLoopEnd(
-      const ucode::ControlFlowLoopEndInstruction& cf);
-  void TranslateControlFlowCondCall(
-      const ucode::ControlFlowCondCallInstruction& cf);
-  void TranslateControlFlowReturn(
-      const ucode::ControlFlowReturnInstruction& cf);
-  void TranslateControlFlowCondJmp(
-      const ucode::ControlFlowCondJmpInstruction& cf);
-  void TranslateControlFlowAlloc(const ucode::ControlFlowAllocInstruction& cf);
-
-  void TranslateExecInstructions(const ParsedExecInstruction& instr);
-
-  void TranslateVertexFetchInstruction(const ucode::VertexFetchInstruction& op);
-  void ParseVertexFetchInstruction(const ucode::VertexFetchInstruction& op,
-                                   ParsedVertexFetchInstruction* out_instr);
-
-  void TranslateTextureFetchInstruction(
-      const ucode::TextureFetchInstruction& op);
-  void ParseTextureFetchInstruction(const ucode::TextureFetchInstruction& op,
-                                    ParsedTextureFetchInstruction* out_instr);
-
-  void TranslateAluInstruction(const ucode::AluInstruction& op);
-  void ParseAluVectorInstruction(const ucode::AluInstruction& op,
-                                 const AluOpcodeInfo& opcode_info,
-                                 ParsedAluInstruction& instr);
-  void ParseAluScalarInstruction(const ucode::AluInstruction& op,
-                                 const AluOpcodeInfo& opcode_info,
-                                 ParsedAluInstruction& instr);
+  // Calls the Process* handlers for the parsed instructions.
+  void ReplayParsedShader();
 
   // Input shader metadata and microcode.
   ShaderType shader_type_;
@@ -192,34 +149,15 @@ class ShaderTranslator {
   xenos::xe_gpu_program_cntl_t program_cntl_;
   uint32_t register_count_;
 
+  std::shared_ptr<const ParsedShader> parsed_shader_;
+
   // Accumulated translation errors.
   std::vector<Shader::Error> errors_;
 
-  // Current control flow dword index.
-  uint32_t cf_index_ = 0;
-
-  // Microcode disassembly buffer, accumulated throughout the translation.
+  // Microcode disassembly buffer, holding the disassembly of the whole shader.
   StringBuffer ucode_disasm_buffer_;
   // Current line number in the disasm, which can be used for source annotation.
   size_t ucode_disasm_line_number_ = 0;
-  // Last offset used when scanning for line numbers.
-  size_t previous_ucode_disasm_scan_offset_ = 0;
-
-  // Kept for supporting vfetch_mini.
-  ucode::VertexFetchInstruction previous_vfetch_full_;
-
-  // Detected binding information gathered before translation.
-  int total_attrib_count_ = 0;
-  std::vector<Shader::VertexBinding> vertex_bindings_;
-  std::vector<Shader::TextureBinding> texture_bindings_;
-  uint32_t unique_vertex_bindings_ = 0;
-  uint32_t unique_texture_bindings_ = 0;
-
-  Shader::ConstantRegisterMap constant_register_map_ = {0};
-  bool writes_color_targets_[4] = {false, false, false, false};
-
-  static const AluOpcodeInfo alu_vector_opcode_infos_[0x20];
-  static const AluOpcodeInfo alu_scalar_opcode_infos_[0x40];
 };
 
 class UcodeShaderTranslator : public ShaderTranslator {
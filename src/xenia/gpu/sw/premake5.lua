@@ -0,0 +1,84 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+group("src")
+project("xenia-gpu-sw")
+  uuid("b92117cf-a285-4a25-94b0-4f58a89de3d2")
+  kind("StaticLib")
+  language("C++")
+  links({
+    "xenia-base",
+    "xenia-gpu",
+    "xenia-ui",
+    "xenia-ui-vulkan",
+    "xxhash",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  local_platform_files()
+
+group("src")
+project("xenia-gpu-sw-trace-dump")
+  uuid("3c5e9a71-0b2d-4f86-a4e3-7d18c6b2f905")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "capstone",
+    "gflags",
+    "glslang-spirv",
+    "imgui",
+    "libavcodec",
+    "libavutil",
+    "snappy",
+    "spirv-tools",
+    "volk",
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-cpu-backend-x64",
+    "xenia-gpu",
+    "xenia-gpu-sw",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-ui-spirv",
+    "xenia-ui-vulkan",
+    "xenia-vfs",
+    "xxhash",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "sw_trace_dump_main.cc",
+    "../../base/main_"..platform_suffix..".cc",
+  })
+
+  filter("platforms:Linux")
+    links({
+      "X11",
+      "xcb",
+      "X11-xcb",
+      "GL",
+      "vulkan",
+    })
+
+  filter("platforms:Windows")
+    -- Only create the .user file if it doesn't already exist.
+    local user_file = project_root.."/build/xenia-gpu-sw-trace-dump.vcxproj.user"
+    if not os.isfile(user_file) then
+      debugdir(project_root)
+      debugargs({
+        "--flagfile=scratch/flags.txt",
+        "2>&1",
+        "1>scratch/stdout-trace-dump.txt",
+      })
+    end
@@ -0,0 +1,226 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_command_processor.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "third_party/xxhash/xxhash.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/texture_info.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+using namespace xe::gpu::xenos;
+
+SwCommandProcessor::SwCommandProcessor(SwGraphicsSystem* graphics_system,
+                                       kernel::KernelState* kernel_state)
+    : CommandProcessor(graphics_system, kernel_state) {}
+SwCommandProcessor::~SwCommandProcessor() = default;
+
+bool SwCommandProcessor::SetupContext() {
+  shader_translator_ = std::make_unique<SwShaderTranslator>();
+  texture_cache_ = std::make_unique<SwTextureCache>(memory_);
+  edram_ = std::make_unique<Edram>();
+  rasterizer_ = std::make_unique<SwRasterizer>(edram_.get());
+  return CommandProcessor::SetupContext();
+}
+
+void SwCommandProcessor::ShutdownContext() {
+  rasterizer_.reset();
+  edram_.reset();
+  texture_cache_.reset();
+  shader_map_.clear();
+  shader_translator_.reset();
+  return CommandProcessor::ShutdownContext();
+}
+
+std::unique_ptr<xe::ui::RawImage> SwCommandProcessor::CaptureFrontbuffer() {
+  std::lock_guard<std::mutex> lock(frontbuffer_mutex_);
+  if (!frontbuffer_) {
+    return nullptr;
+  }
+  return std::make_unique<xe::ui::RawImage>(*frontbuffer_);
+}
+
+void SwCommandProcessor::PerformSwap(uint32_t frontbuffer_ptr,
+                                     uint32_t frontbuffer_width,
+                                     uint32_t frontbuffer_height) {
+  SCOPE_profile_cpu_f("gpu");
+
+  // Guest memory may change before the next frame.
+  texture_cache_->Clear();
+
+  // The frontbuffer is bound to the first texture fetch constant.
+  auto& regs = *register_file_;
+  auto group = reinterpret_cast<const xe_gpu_fetch_group_t*>(
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0]);
+  const SwTexture* texture = texture_cache_->Demand(group->texture_fetch);
+  if (!texture) {
+    return;
+  }
+
+  auto image = std::make_unique<xe::ui::RawImage>();
+  image->width = texture->width;
+  image->height = texture->height;
+  image->stride = texture->width * 4;
+  image->data.resize(image->stride * image->height);
+  const float* texel = texture->texels.data();
+  uint8_t* out = image->data.data();
+  for (size_t i = 0; i < size_t(texture->width) * texture->height; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      *out++ = uint8_t(xe::saturate(texel[j]) * 255.0f + 0.5f);
+    }
+    *out++ = 0xFF;
+    texel += 4;
+  }
+  texture_cache_->Clear();
+
+  std::lock_guard<std::mutex> lock(frontbuffer_mutex_);
+  frontbuffer_ = std::move(image);
+}
+
+Shader* SwCommandProcessor::LoadShader(ShaderType shader_type,
+                                       uint32_t guest_address,
+                                       const uint32_t* host_address,
+                                       uint32_t dword_count) {
+  // Hash the input memory and lookup the shader.
+  uint64_t data_hash = XXH64(host_address, dword_count * sizeof(uint32_t), 0);
+  auto it = shader_map_.find(data_hash);
+  if (it != shader_map_.end()) {
+    return it->second.get();
+  }
+
+  auto shader = new SwShader(shader_type, data_hash, host_address, dword_count);
+  shader_map_.insert({data_hash, std::unique_ptr<SwShader>(shader)});
+  return shader;
+}
+
+const SwProgram* SwCommandProcessor::PrepareShader(SwShader* shader) {
+  if (!shader->is_translated()) {
+    SCOPE_profile_cpu_f("gpu");
+    xenos::xe_gpu_program_cntl_t sq_program_cntl;
+    sq_program_cntl.dword_0 =
+        register_file_->values[XE_GPU_REG_SQ_PROGRAM_CNTL].u32;
+    if (!shader_translator_->Translate(shader, sq_program_cntl)) {
+      XELOGE("Shader translation failed; marking shader as ignored");
+    }
+  }
+  return shader->is_valid() ? shader->program() : nullptr;
+}
+
+void SwCommandProcessor::BindTextures(
+    const std::vector<Shader::TextureBinding>& bindings) {
+  auto& regs = *register_file_;
+  for (auto& binding : bindings) {
+    int r = XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + binding.fetch_constant * 6;
+    auto group = reinterpret_cast<const xe_gpu_fetch_group_t*>(&regs.values[r]);
+    auto& texture_binding = texture_bindings_[binding.fetch_constant];
+    texture_binding.fetch = group->texture_fetch;
+    texture_binding.texture = group->texture_fetch.type == 0x2
+                                  ? texture_cache_->Demand(group->texture_fetch)
+                                  : nullptr;
+  }
+}
+
+bool SwCommandProcessor::IssueDraw(PrimitiveType prim_type,
+                                   uint32_t index_count,
+                                   IndexBufferInfo* index_buffer_info) {
+  SCOPE_profile_cpu_f("gpu");
+  auto& regs = *register_file_;
+
+  SwDrawState state;
+  if (!SwDrawState::Decode(regs, prim_type, &state)) {
+    // Nothing would be written.
+    return true;
+  }
+
+  auto vertex_shader = static_cast<SwShader*>(active_vertex_shader_);
+  auto pixel_shader = static_cast<SwShader*>(active_pixel_shader_);
+  if (!vertex_shader) {
+    return true;
+  }
+  SwDrawCall call;
+  call.vertex_program = PrepareShader(vertex_shader);
+  if (!call.vertex_program) {
+    return true;
+  }
+  if (pixel_shader) {
+    call.pixel_program = PrepareShader(pixel_shader);
+    if (!call.pixel_program) {
+      return true;
+    }
+  }
+
+  for (auto& binding : texture_bindings_) {
+    binding.texture = nullptr;
+  }
+  BindTextures(vertex_shader->texture_bindings());
+  if (pixel_shader) {
+    BindTextures(pixel_shader->texture_bindings());
+  }
+
+  SwShaderContext vertex_context;
+  vertex_context.float_constants =
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_000_X].f32;
+  vertex_context.bool_constants =
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031].u32;
+  vertex_context.loop_constants =
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_LOOP_00].u32;
+  vertex_context.fetch_constants =
+      &regs.values[XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0].u32;
+  vertex_context.memory = memory_;
+  vertex_context.textures = texture_bindings_;
+  SwShaderContext pixel_context = vertex_context;
+  pixel_context.is_pixel_shader = true;
+  call.vertex_context = &vertex_context;
+  call.pixel_context = &pixel_context;
+
+  call.index_count = index_count;
+  if (index_buffer_info) {
+    call.index_data = memory_->TranslatePhysical<const uint8_t*>(
+        index_buffer_info->guest_base);
+    call.index_format = index_buffer_info->format;
+    call.index_endian = index_buffer_info->endianness;
+    trace_writer_.WriteMemoryRead(index_buffer_info->guest_base,
+                                  index_buffer_info->length);
+  }
+
+  rasterizer_->Draw(state, call);
+  return true;
+}
+
+bool SwCommandProcessor::IssueCopy() {
+  SCOPE_profile_cpu_f("gpu");
+  EdramCopyInfo copy_info;
+  if (!EdramCopyInfo::Decode(*register_file_, memory_, &copy_info)) {
+    return true;
+  }
+  trace_writer_.WriteMemoryRead(copy_info.rect_address,
+                                copy_info.rect_length);
+  edram_->Copy(copy_info, memory_);
+  if (copy_info.resolve) {
+    trace_writer_.WriteMemoryWrite(copy_info.written_address,
+                                   copy_info.written_length);
+  }
+
+  // The resolve may have overwritten memory backing decoded textures.
+  texture_cache_->Clear();
+  return true;
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,78 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_COMMAND_PROCESSOR_H_
+#define XENIA_GPU_SW_SW_COMMAND_PROCESSOR_H_
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/edram.h"
+#include "xenia/gpu/sw/sw_graphics_system.h"
+#include "xenia/gpu/sw/sw_rasterizer.h"
+#include "xenia/gpu/sw/sw_shader.h"
+#include "xenia/gpu/sw/sw_texture_cache.h"
+#include "xenia/gpu/xenos.h"
+#include "xenia/kernel/kernel_state.h"
+#include "xenia/ui/graphics_context.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+class SwCommandProcessor : public CommandProcessor {
+ public:
+  SwCommandProcessor(SwGraphicsSystem* graphics_system,
+                     kernel::KernelState* kernel_state);
+  ~SwCommandProcessor();
+
+  // Returns a copy of the most recently swapped frontbuffer as RGBA8, or
+  // nullptr before the first swap. Safe to call from any thread.
+  std::unique_ptr<xe::ui::RawImage> CaptureFrontbuffer();
+
+ private:
+  bool SetupContext() override;
+  void ShutdownContext() override;
+
+  void PerformSwap(uint32_t frontbuffer_ptr, uint32_t frontbuffer_width,
+                   uint32_t frontbuffer_height) override;
+
+  Shader* LoadShader(ShaderType shader_type, uint32_t guest_address,
+                     const uint32_t* host_address,
+                     uint32_t dword_count) override;
+
+  bool IssueDraw(PrimitiveType prim_type, uint32_t index_count,
+                 IndexBufferInfo* index_buffer_info) override;
+  bool IssueCopy() override;
+
+  // Translates the shader on first use; returns its program or nullptr if it
+  // failed to translate.
+  const SwProgram* PrepareShader(SwShader* shader);
+  void BindTextures(const std::vector<Shader::TextureBinding>& bindings);
+
+  std::unordered_map<uint64_t, std::unique_ptr<SwShader>> shader_map_;
+  std::unique_ptr<SwShaderTranslator> shader_translator_;
+  std::unique_ptr<SwTextureCache> texture_cache_;
+  std::unique_ptr<Edram> edram_;
+  std::unique_ptr<SwRasterizer> rasterizer_;
+
+  SwTextureBinding texture_bindings_[32];
+
+  std::mutex frontbuffer_mutex_;
+  std::unique_ptr<xe::ui::RawImage> frontbuffer_;
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_COMMAND_PROCESSOR_H_
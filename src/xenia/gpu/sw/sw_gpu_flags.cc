@@ -0,0 +1,17 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_gpu_flags.h"
+
+DEFINE_int32(sw_threads, 0,
+             "Worker threads used by the software rasterizer for vertex "
+             "shading and tile rasterization. 0 uses one per host core.");
+DEFINE_bool(sw_bilinear_filtering, true,
+            "Honor linear texture filters in the software rasterizer. When "
+            "false every texture is point sampled.");
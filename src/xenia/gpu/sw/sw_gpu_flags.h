@@ -0,0 +1,18 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_GPU_FLAGS_H_
+#define XENIA_GPU_SW_SW_GPU_FLAGS_H_
+
+#include <gflags/gflags.h>
+
+DECLARE_int32(sw_threads);
+DECLARE_bool(sw_bilinear_filtering);
+
+#endif  // XENIA_GPU_SW_SW_GPU_FLAGS_H_
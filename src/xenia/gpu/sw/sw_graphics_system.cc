@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_graphics_system.h"
+
+#include "xenia/gpu/sw/sw_command_processor.h"
+#include "xenia/ui/vulkan/vulkan_provider.h"
+#include "xenia/xbox.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+SwGraphicsSystem::SwGraphicsSystem() {}
+
+SwGraphicsSystem::~SwGraphicsSystem() {}
+
+X_STATUS SwGraphicsSystem::Setup(cpu::Processor* processor,
+                                 kernel::KernelState* kernel_state,
+                                 ui::Window* target_window) {
+  // As with the null backend, the UI still needs a provider when there is a
+  // window. Without one nothing here touches a GPU.
+  if (target_window) {
+    provider_ = xe::ui::vulkan::VulkanProvider::Create(target_window);
+  }
+
+  return GraphicsSystem::Setup(processor, kernel_state, target_window);
+}
+
+void SwGraphicsSystem::Shutdown() { GraphicsSystem::Shutdown(); }
+
+std::unique_ptr<xe::ui::RawImage> SwGraphicsSystem::Capture() {
+  if (!command_processor_) {
+    return nullptr;
+  }
+  return static_cast<SwCommandProcessor*>(command_processor_.get())
+      ->CaptureFrontbuffer();
+}
+
+std::unique_ptr<CommandProcessor> SwGraphicsSystem::CreateCommandProcessor() {
+  return std::unique_ptr<CommandProcessor>(
+      new SwCommandProcessor(this, kernel_state_));
+}
+
+void SwGraphicsSystem::Swap(xe::ui::UIEvent* e) {
+  if (!command_processor_) {
+    return;
+  }
+
+  auto& swap_state = command_processor_->swap_state();
+  std::lock_guard<std::mutex> lock(swap_state.mutex);
+  swap_state.pending = false;
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,48 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_GRAPHICS_SYSTEM_H_
+#define XENIA_GPU_SW_SW_GRAPHICS_SYSTEM_H_
+
+#include <memory>
+
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/graphics_system.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// Renders on the CPU, for machines without a usable GPU. Frames are kept in
+// memory and are available through Capture(); a window, if any, only gets
+// the UI.
+class SwGraphicsSystem : public GraphicsSystem {
+ public:
+  SwGraphicsSystem();
+  ~SwGraphicsSystem() override;
+
+  std::wstring name() const override { return L"sw"; }
+
+  X_STATUS Setup(cpu::Processor* processor, kernel::KernelState* kernel_state,
+                 ui::Window* target_window) override;
+  void Shutdown() override;
+
+  std::unique_ptr<xe::ui::RawImage> Capture() override;
+
+ private:
+  std::unique_ptr<CommandProcessor> CreateCommandProcessor() override;
+
+  void Swap(xe::ui::UIEvent* e) override;
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_GRAPHICS_SYSTEM_H_
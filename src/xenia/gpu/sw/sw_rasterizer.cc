@@ -0,0 +1,976 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_rasterizer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/byte_order.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/sw/sw_gpu_flags.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+using namespace xe::gpu::xenos;
+
+namespace {
+
+// Vertices shaded per job; small enough to balance, large enough to amortize
+// the dispatch.
+const uint32_t kVerticesPerJob = 64;
+
+// Xenos compare functions, shared by depth, stencil and alpha tests.
+template <typename T>
+bool Compare(uint32_t func, T value, T reference) {
+  switch (func & 7) {
+    case 0:
+      return false;
+    case 1:
+      return value < reference;
+    case 2:
+      return value == reference;
+    case 3:
+      return value <= reference;
+    case 4:
+      return value > reference;
+    case 5:
+      return value != reference;
+    case 6:
+      return value >= reference;
+    default:
+      return true;
+  }
+}
+
+uint32_t ApplyStencilOp(uint32_t op, uint32_t value, uint32_t reference) {
+  switch (op & 7) {
+    case 0:
+      return value;
+    case 1:
+      return 0;
+    case 2:
+      return reference;
+    case 3:
+      return std::min(value + 1, 0xFFu);
+    case 4:
+      return value ? value - 1 : 0;
+    case 5:
+      return ~value & 0xFF;
+    case 6:
+      return (value + 1) & 0xFF;
+    default:
+      return (value - 1) & 0xFF;
+  }
+}
+
+float BlendFactor(uint32_t factor, const float src[4], const float dst[4],
+                  const float constant[4], int component) {
+  switch (factor) {
+    case 0:
+      return 0.0f;
+    case 1:
+      return 1.0f;
+    case 4:
+      return src[component];
+    case 5:
+      return 1.0f - src[component];
+    case 6:
+      return src[3];
+    case 7:
+      return 1.0f - src[3];
+    case 8:
+      return dst[component];
+    case 9:
+      return 1.0f - dst[component];
+    case 10:
+      return dst[3];
+    case 11:
+      return 1.0f - dst[3];
+    case 12:
+      return constant[component];
+    case 13:
+      return 1.0f - constant[component];
+    case 14:
+      return constant[3];
+    case 15:
+      return 1.0f - constant[3];
+    case 16:
+      return component == 3 ? 1.0f : std::min(src[3], 1.0f - dst[3]);
+    default:
+      return 0.0f;
+  }
+}
+
+float BlendOp(uint32_t op, float src, float dst) {
+  switch (op) {
+    case 0:
+      return src + dst;
+    case 1:
+      return src - dst;
+    case 2:
+      return std::min(src, dst);
+    case 3:
+      return std::max(src, dst);
+    case 4:
+      return dst - src;
+    default:
+      return src;
+  }
+}
+
+void Blend(uint32_t control, const float src[4], const float dst[4],
+           const float constant[4], float out_color[4]) {
+  uint32_t color_src = control & 0x1F;
+  uint32_t color_op = (control >> 5) & 0x7;
+  uint32_t color_dst = (control >> 8) & 0x1F;
+  uint32_t alpha_src = (control >> 16) & 0x1F;
+  uint32_t alpha_op = (control >> 21) & 0x7;
+  uint32_t alpha_dst = (control >> 24) & 0x1F;
+  for (int i = 0; i < 4; ++i) {
+    uint32_t src_factor = i < 3 ? color_src : alpha_src;
+    uint32_t dst_factor = i < 3 ? color_dst : alpha_dst;
+    uint32_t op = i < 3 ? color_op : alpha_op;
+    if (op == 2 || op == 3) {
+      // Min and max ignore the factors.
+      out_color[i] = BlendOp(op, src[i], dst[i]);
+      continue;
+    }
+    out_color[i] =
+        BlendOp(op, src[i] * BlendFactor(src_factor, src, dst, constant, i),
+                dst[i] * BlendFactor(dst_factor, src, dst, constant, i));
+  }
+}
+
+// Blend control leaving the source color untouched.
+const uint32_t kBlendPassthrough = 0x00010001;
+
+int32_t SignExtend(uint32_t value, uint32_t bits) {
+  return int32_t(value << (32 - bits)) >> (32 - bits);
+}
+
+}  // namespace
+
+bool SwDrawState::Decode(const RegisterFile& regs,
+                         PrimitiveType primitive_type,
+                         SwDrawState* out_state) {
+  auto& state = *out_state;
+  state = SwDrawState();
+  state.primitive_type = primitive_type;
+
+  reg::RB_MODECONTROL mode_control;
+  mode_control.value = regs.values[XE_GPU_REG_RB_MODECONTROL].u32;
+  bool color_enabled = mode_control.edram_mode == ModeControl::kColorDepth;
+  if (!color_enabled && mode_control.edram_mode != ModeControl::kDepth) {
+    return false;
+  }
+
+  reg::RB_SURFACE_INFO surface_info;
+  surface_info.value = regs.values[XE_GPU_REG_RB_SURFACE_INFO].u32;
+  state.surface_pitch = surface_info.surface_pitch;
+  state.msaa_samples = surface_info.msaa_samples;
+  if (!state.surface_pitch) {
+    return false;
+  }
+
+  reg::PA_SC_WINDOW_OFFSET window_offset;
+  window_offset.value = regs.values[XE_GPU_REG_PA_SC_WINDOW_OFFSET].u32;
+  int32_t window_x = window_offset.window_x_offset;
+  int32_t window_y = window_offset.window_y_offset;
+
+  // Viewport.
+  reg::PA_CL_VTE_CNTL vte_control;
+  vte_control.value = regs.values[XE_GPU_REG_PA_CL_VTE_CNTL].u32;
+  state.xy_divide = !vte_control.vtx_xy_fmt;
+  state.z_divide = !vte_control.vtx_z_fmt;
+  state.w_is_reciprocal = vte_control.vtx_w0_fmt != 0;
+  state.viewport_scale[0] = vte_control.vport_x_scale_ena
+                                ? regs.values[XE_GPU_REG_PA_CL_VPORT_XSCALE].f32
+                                : 1.0f;
+  state.viewport_scale[1] = vte_control.vport_y_scale_ena
+                                ? regs.values[XE_GPU_REG_PA_CL_VPORT_YSCALE].f32
+                                : 1.0f;
+  state.viewport_scale[2] = vte_control.vport_z_scale_ena
+                                ? regs.values[XE_GPU_REG_PA_CL_VPORT_ZSCALE].f32
+                                : 1.0f;
+  state.viewport_offset[0] =
+      vte_control.vport_x_offset_ena
+          ? regs.values[XE_GPU_REG_PA_CL_VPORT_XOFFSET].f32
+          : 0.0f;
+  state.viewport_offset[1] =
+      vte_control.vport_y_offset_ena
+          ? regs.values[XE_GPU_REG_PA_CL_VPORT_YOFFSET].f32
+          : 0.0f;
+  state.viewport_offset[2] =
+      vte_control.vport_z_offset_ena
+          ? regs.values[XE_GPU_REG_PA_CL_VPORT_ZOFFSET].f32
+          : 0.0f;
+
+  reg::PA_SU_SC_MODE_CNTL mode_cntl;
+  mode_cntl.value = regs.values[XE_GPU_REG_PA_SU_SC_MODE_CNTL].u32;
+  if (mode_cntl.vtx_window_offset_enable) {
+    state.viewport_offset[0] += float(window_x);
+    state.viewport_offset[1] += float(window_y);
+  }
+  reg::PA_SU_VTX_CNTL vtx_cntl;
+  vtx_cntl.value = regs.values[XE_GPU_REG_PA_SU_VTX_CNTL].u32;
+  if (!vtx_cntl.pix_center) {
+    // Pixel centers are at integer coordinates; ours are at the half.
+    state.viewport_offset[0] += 0.5f;
+    state.viewport_offset[1] += 0.5f;
+  }
+  state.cull_front = mode_cntl.cull_front != 0;
+  state.cull_back = mode_cntl.cull_back != 0;
+  state.front_face_cw = mode_cntl.face != 0;
+
+  // Scissor.
+  reg::PA_SC_WINDOW_SCISSOR_TL scissor_tl;
+  scissor_tl.value = regs.values[XE_GPU_REG_PA_SC_WINDOW_SCISSOR_TL].u32;
+  reg::PA_SC_WINDOW_SCISSOR_BR scissor_br;
+  scissor_br.value = regs.values[XE_GPU_REG_PA_SC_WINDOW_SCISSOR_BR].u32;
+  int32_t scissor_left = scissor_tl.tl_x;
+  int32_t scissor_top = scissor_tl.tl_y;
+  int32_t scissor_right = scissor_br.br_x;
+  int32_t scissor_bottom = scissor_br.br_y;
+  if (!scissor_tl.window_offset_disable) {
+    scissor_left += window_x;
+    scissor_top += window_y;
+    scissor_right += window_x;
+    scissor_bottom += window_y;
+  }
+  state.scissor_left = uint32_t(std::max(scissor_left, 0));
+  state.scissor_top = uint32_t(std::max(scissor_top, 0));
+  state.scissor_right = uint32_t(
+      std::min(std::max(scissor_right, 0), int32_t(state.surface_pitch)));
+  state.scissor_bottom = uint32_t(std::max(scissor_bottom, 0));
+  if (state.scissor_left >= state.scissor_right ||
+      state.scissor_top >= state.scissor_bottom) {
+    return false;
+  }
+
+  // Color targets.
+  bool any_color_write = false;
+  if (color_enabled) {
+    static const Register kColorInfoRegisters[] = {
+        XE_GPU_REG_RB_COLOR_INFO, XE_GPU_REG_RB_COLOR1_INFO,
+        XE_GPU_REG_RB_COLOR2_INFO, XE_GPU_REG_RB_COLOR3_INFO};
+    static const Register kBlendControlRegisters[] = {
+        XE_GPU_REG_RB_BLENDCONTROL_0, XE_GPU_REG_RB_BLENDCONTROL_1,
+        XE_GPU_REG_RB_BLENDCONTROL_2, XE_GPU_REG_RB_BLENDCONTROL_3};
+    uint32_t color_mask = regs.values[XE_GPU_REG_RB_COLOR_MASK].u32;
+    for (uint32_t i = 0; i < 4; ++i) {
+      auto& target = state.color_targets[i];
+      target.write_mask = (color_mask >> (i * 4)) & 0xF;
+      if (!target.write_mask) {
+        continue;
+      }
+      reg::RB_COLOR_INFO color_info;
+      color_info.value = regs.values[kColorInfoRegisters[i]].u32;
+      target.enabled = true;
+      target.base = color_info.color_base;
+      target.format = color_info.color_format;
+      target.is_64bpp = Edram::IsColorFormat64bpp(target.format);
+      target.exp_scale =
+          std::ldexp(1.0f, SignExtend(color_info.color_exp_bias, 6));
+      target.blend_control = regs.values[kBlendControlRegisters[i]].u32;
+      any_color_write = true;
+    }
+  }
+  reg::RB_COLORCONTROL color_control;
+  color_control.value = regs.values[XE_GPU_REG_RB_COLORCONTROL].u32;
+  state.blend_enable = !(color_control.value & 0x20);
+  state.blend_constant[0] = regs.values[XE_GPU_REG_RB_BLEND_RED].f32;
+  state.blend_constant[1] = regs.values[XE_GPU_REG_RB_BLEND_GREEN].f32;
+  state.blend_constant[2] = regs.values[XE_GPU_REG_RB_BLEND_BLUE].f32;
+  state.blend_constant[3] = regs.values[XE_GPU_REG_RB_BLEND_ALPHA].f32;
+  state.alpha_test_enable = color_control.alpha_test_enable != 0;
+  state.alpha_func = color_control.alpha_func;
+  state.alpha_ref = regs.values[XE_GPU_REG_RB_ALPHA_REF].f32;
+
+  // Depth and stencil.
+  uint32_t depth_control = regs.values[XE_GPU_REG_RB_DEPTHCONTROL].u32;
+  state.stencil_enable = (depth_control & 0x1) != 0;
+  state.depth_test = (depth_control & 0x2) != 0;
+  state.depth_write = state.depth_test && (depth_control & 0x4) != 0;
+  state.depth_func = (depth_control >> 4) & 0x7;
+  state.depth_stencil_enable = state.stencil_enable || state.depth_test;
+  reg::RB_DEPTH_INFO depth_info;
+  depth_info.value = regs.values[XE_GPU_REG_RB_DEPTH_INFO].u32;
+  state.depth_base = depth_info.depth_base;
+  state.depth_format = depth_info.depth_format;
+  if (state.stencil_enable) {
+    uint32_t ref_mask = regs.values[XE_GPU_REG_RB_STENCILREFMASK].u32;
+    auto& front = state.stencil_front;
+    front.func = (depth_control >> 8) & 0x7;
+    front.fail_op = (depth_control >> 11) & 0x7;
+    front.pass_op = (depth_control >> 14) & 0x7;
+    front.depth_fail_op = (depth_control >> 17) & 0x7;
+    front.ref = ref_mask & 0xFF;
+    front.mask = (ref_mask >> 8) & 0xFF;
+    front.write_mask = (ref_mask >> 16) & 0xFF;
+    auto& back = state.stencil_back;
+    if (depth_control & 0x80) {
+      uint32_t ref_mask_bf = regs.values[XE_GPU_REG_RB_STENCILREFMASK_BF].u32;
+      back.func = (depth_control >> 20) & 0x7;
+      back.fail_op = (depth_control >> 23) & 0x7;
+      back.pass_op = (depth_control >> 26) & 0x7;
+      back.depth_fail_op = (depth_control >> 29) & 0x7;
+      back.ref = ref_mask_bf & 0xFF;
+      back.mask = (ref_mask_bf >> 8) & 0xFF;
+      back.write_mask = (ref_mask_bf >> 16) & 0xFF;
+    } else {
+      back = front;
+    }
+  }
+  if (!any_color_write && !state.depth_stencil_enable) {
+    return false;
+  }
+
+  state.primitive_reset_enable = mode_cntl.multi_prim_ib_ena != 0;
+  state.primitive_reset_index =
+      regs.values[XE_GPU_REG_VGT_MULTI_PRIM_IB_RESET_INDX].u32;
+  state.index_offset = regs.values[XE_GPU_REG_VGT_INDX_OFFSET].u32;
+
+  xenos::xe_gpu_program_cntl_t program_cntl;
+  program_cntl.dword_0 = regs.values[XE_GPU_REG_SQ_PROGRAM_CNTL].u32;
+  state.ps_param_gen =
+      program_cntl.param_gen
+          ? int32_t((regs.values[XE_GPU_REG_SQ_CONTEXT_MISC].u32 >> 8) & 0xFF)
+          : -1;
+  return true;
+}
+
+SwRasterizer::SwRasterizer(Edram* edram) : edram_(edram) {
+  // The calling thread always takes part, so one thread needs no pool.
+  if (FLAGS_sw_threads != 1) {
+    worker_pool_ = std::make_unique<threading::WorkerPool>(
+        "SW Rasterizer",
+        FLAGS_sw_threads > 1 ? uint32_t(FLAGS_sw_threads - 1) : 0);
+  }
+}
+
+SwRasterizer::~SwRasterizer() = default;
+
+void SwRasterizer::ParallelFor(size_t count,
+                               const std::function<void(size_t)>& fn) {
+  if (worker_pool_ && count > 1) {
+    worker_pool_->ParallelFor(count, fn);
+    return;
+  }
+  for (size_t i = 0; i < count; ++i) {
+    fn(i);
+  }
+}
+
+void SwRasterizer::Draw(const SwDrawState& state, const SwDrawCall& call) {
+  SCOPE_profile_cpu_f("gpu");
+
+  switch (state.primitive_type) {
+    case PrimitiveType::kTriangleList:
+    case PrimitiveType::kTriangleStrip:
+    case PrimitiveType::kTriangleFan:
+    case PrimitiveType::kRectangleList:
+    case PrimitiveType::kQuadList:
+      break;
+    default: {
+      static bool warned = false;
+      if (!warned) {
+        XELOGW("SW: primitive type %u is not supported, skipping draws",
+               uint32_t(state.primitive_type));
+        warned = true;
+      }
+      return;
+    }
+  }
+  if (!call.vertex_program || !call.index_count) {
+    return;
+  }
+
+  interpolator_count_ = 0;
+  if (call.pixel_program) {
+    interpolator_count_ =
+        std::min(call.pixel_program->register_count, kMaxInterpolators);
+  }
+
+  GatherIndices(state, call);
+  ShadeVertices(state, call);
+  AssembleTriangles(state);
+  if (triangles_.empty()) {
+    return;
+  }
+  BinTriangles(state);
+
+  ParallelFor(active_bins_.size(), [&](size_t i) {
+    uint32_t bin_index = active_bins_[i];
+    RasterizeTile(state, call, bin_index % bins_wide_, bin_index / bins_wide_,
+                  bins_[bin_index]);
+  });
+}
+
+void SwRasterizer::GatherIndices(const SwDrawState& state,
+                                 const SwDrawCall& call) {
+  slots_.resize(call.index_count);
+  unique_indices_.clear();
+  index_slots_.clear();
+
+  if (!call.index_data) {
+    for (uint32_t i = 0; i < call.index_count; ++i) {
+      slots_[i] = i;
+      unique_indices_.push_back(i + state.index_offset);
+    }
+    return;
+  }
+
+  bool is_32bit = call.index_format == IndexFormat::kInt32;
+  uint32_t reset_index =
+      is_32bit ? state.primitive_reset_index
+               : (state.primitive_reset_index & 0xFFFF);
+  for (uint32_t i = 0; i < call.index_count; ++i) {
+    uint32_t index;
+    if (is_32bit) {
+      index = xe::load<uint32_t>(call.index_data + i * 4);
+      if (call.index_endian == Endian::k8in32) {
+        index = xe::byte_swap(index);
+      } else if (call.index_endian == Endian::k16in32) {
+        index = (index >> 16) | (index << 16);
+      }
+    } else {
+      index = xe::load<uint16_t>(call.index_data + i * 2);
+      if (call.index_endian == Endian::k8in16) {
+        index = xe::byte_swap(uint16_t(index));
+      }
+    }
+    if (state.primitive_reset_enable && index == reset_index) {
+      slots_[i] = UINT32_MAX;
+      continue;
+    }
+    index += state.index_offset;
+    auto it = index_slots_.find(index);
+    if (it != index_slots_.end()) {
+      slots_[i] = it->second;
+    } else {
+      uint32_t slot = uint32_t(unique_indices_.size());
+      index_slots_.emplace(index, slot);
+      unique_indices_.push_back(index);
+      slots_[i] = slot;
+    }
+  }
+}
+
+void SwRasterizer::ShadeVertices(const SwDrawState& state,
+                                 const SwDrawCall& call) {
+  SCOPE_profile_cpu_f("gpu");
+
+  uint32_t vertex_count = uint32_t(unique_indices_.size());
+  vertices_.resize(vertex_count);
+  uint32_t job_count = (vertex_count + kVerticesPerJob - 1) / kVerticesPerJob;
+  uint32_t register_count = std::min(call.vertex_program->register_count,
+                                     SwShaderState::kMaxRegisters);
+  ParallelFor(job_count, [&](size_t job) {
+    SwShaderState vs_state;
+    uint32_t first = uint32_t(job) * kVerticesPerJob;
+    uint32_t last = std::min(first + kVerticesPerJob, vertex_count);
+    for (uint32_t i = first; i < last; ++i) {
+      std::memset(vs_state.registers, 0,
+                  sizeof(vs_state.registers[0]) * std::max(register_count, 1u));
+      std::memset(vs_state.interpolators, 0, sizeof(vs_state.interpolators));
+      vs_state.position = _mm_setzero_ps();
+      vs_state.registers[0] = _mm_set_ss(float(int32_t(unique_indices_[i])));
+      SwShaderInterpreter::Execute(*call.vertex_program, *call.vertex_context,
+                                   &vs_state);
+
+      float position[4];
+      _mm_storeu_ps(position, vs_state.position);
+      auto& vertex = vertices_[i];
+      float w = position[3];
+      vertex.culled = false;
+      if (state.w_is_reciprocal) {
+        vertex.inv_w = w;
+      } else {
+        vertex.culled = (state.xy_divide || state.z_divide) && !(w > 0.0f);
+        vertex.inv_w = w != 0.0f ? 1.0f / w : 0.0f;
+      }
+      if (state.xy_divide) {
+        position[0] *= vertex.inv_w;
+        position[1] *= vertex.inv_w;
+      }
+      if (state.z_divide) {
+        position[2] *= vertex.inv_w;
+      }
+      vertex.x = position[0] * state.viewport_scale[0] +
+                 state.viewport_offset[0];
+      vertex.y = position[1] * state.viewport_scale[1] +
+                 state.viewport_offset[1];
+      vertex.z = position[2] * state.viewport_scale[2] +
+                 state.viewport_offset[2];
+      if (!state.xy_divide && !state.z_divide) {
+        // Without a perspective divide, attributes interpolate linearly.
+        vertex.inv_w = 1.0f;
+      }
+      for (uint32_t j = 0; j < interpolator_count_; ++j) {
+        _mm_storeu_ps(vertex.interpolators[j], vs_state.interpolators[j]);
+      }
+    }
+  });
+}
+
+uint32_t SwRasterizer::CompleteRectangle(uint32_t v0, uint32_t v1,
+                                         uint32_t v2, uint32_t* out_corner) {
+  // The three vertices are corners of a rectangle; the missing one is
+  // opposite the corner with the right angle.
+  uint32_t v[3] = {v0, v1, v2};
+  uint32_t corner = 0;
+  float best = FLT_MAX;
+  for (uint32_t i = 0; i < 3; ++i) {
+    const auto& c = vertices_[v[i]];
+    const auto& a = vertices_[v[(i + 1) % 3]];
+    const auto& b = vertices_[v[(i + 2) % 3]];
+    float dot = std::abs((a.x - c.x) * (b.x - c.x) + (a.y - c.y) * (b.y - c.y));
+    if (dot < best) {
+      best = dot;
+      corner = i;
+    }
+  }
+  const ShadedVertex c = vertices_[v[corner]];
+  const ShadedVertex a = vertices_[v[(corner + 1) % 3]];
+  const ShadedVertex b = vertices_[v[(corner + 2) % 3]];
+  ShadedVertex d;
+  d.x = a.x + b.x - c.x;
+  d.y = a.y + b.y - c.y;
+  d.z = a.z + b.z - c.z;
+  d.inv_w = a.inv_w + b.inv_w - c.inv_w;
+  d.culled = a.culled || b.culled || c.culled;
+  for (uint32_t i = 0; i < interpolator_count_; ++i) {
+    for (uint32_t j = 0; j < 4; ++j) {
+      d.interpolators[i][j] =
+          a.interpolators[i][j] + b.interpolators[i][j] - c.interpolators[i][j];
+    }
+  }
+  vertices_.push_back(d);
+  *out_corner = corner;
+  return uint32_t(vertices_.size() - 1);
+}
+
+void SwRasterizer::AssembleTriangles(const SwDrawState& state) {
+  SCOPE_profile_cpu_f("gpu");
+  triangles_.clear();
+
+  // Split the index list into runs at primitive resets.
+  size_t run_start = 0;
+  while (run_start < slots_.size()) {
+    size_t run_end = run_start;
+    while (run_end < slots_.size() && slots_[run_end] != UINT32_MAX) {
+      ++run_end;
+    }
+    const uint32_t* s = slots_.data() + run_start;
+    uint32_t count = uint32_t(run_end - run_start);
+    switch (state.primitive_type) {
+      case PrimitiveType::kTriangleList:
+        for (uint32_t i = 0; i + 2 < count; i += 3) {
+          SetupTriangle(state, s[i], s[i + 1], s[i + 2]);
+        }
+        break;
+      case PrimitiveType::kTriangleStrip:
+        for (uint32_t i = 0; i + 2 < count; ++i) {
+          if (i & 1) {
+            SetupTriangle(state, s[i + 1], s[i], s[i + 2]);
+          } else {
+            SetupTriangle(state, s[i], s[i + 1], s[i + 2]);
+          }
+        }
+        break;
+      case PrimitiveType::kTriangleFan:
+        for (uint32_t i = 1; i + 1 < count; ++i) {
+          SetupTriangle(state, s[0], s[i], s[i + 1]);
+        }
+        break;
+      case PrimitiveType::kRectangleList:
+        for (uint32_t i = 0; i + 2 < count; i += 3) {
+          uint32_t corner;
+          uint32_t v3 = CompleteRectangle(s[i], s[i + 1], s[i + 2], &corner);
+          // Split along the diagonal from a to b. Rotating the vertices and
+          // mirroring the corner keeps the winding of the primitive.
+          uint32_t c = s[i + corner];
+          uint32_t a = s[i + (corner + 1) % 3];
+          uint32_t b = s[i + (corner + 2) % 3];
+          SetupTriangle(state, c, a, b);
+          SetupTriangle(state, a, v3, b);
+        }
+        break;
+      case PrimitiveType::kQuadList:
+        for (uint32_t i = 0; i + 3 < count; i += 4) {
+          SetupTriangle(state, s[i], s[i + 1], s[i + 2]);
+          SetupTriangle(state, s[i], s[i + 2], s[i + 3]);
+        }
+        break;
+      default:
+        break;
+    }
+    run_start = run_end + 1;
+  }
+}
+
+void SwRasterizer::SetupTriangle(const SwDrawState& state, uint32_t v0,
+                                 uint32_t v1, uint32_t v2) {
+  const auto* p0 = &vertices_[v0];
+  const auto* p1 = &vertices_[v1];
+  const auto* p2 = &vertices_[v2];
+  if (p0->culled || p1->culled || p2->culled) {
+    return;
+  }
+  float area = (p1->x - p0->x) * (p2->y - p0->y) -
+               (p1->y - p0->y) * (p2->x - p0->x);
+  if (!(area != 0.0f) || !std::isfinite(area)) {
+    return;
+  }
+  // With y pointing down a positive area is clockwise on screen.
+  bool is_cw = area > 0.0f;
+  bool is_front = is_cw == state.front_face_cw;
+  if ((is_front && state.cull_front) || (!is_front && state.cull_back)) {
+    return;
+  }
+
+  Triangle triangle;
+  triangle.is_front = is_front;
+  if (area < 0.0f) {
+    std::swap(v1, v2);
+    std::swap(p1, p2);
+    area = -area;
+  }
+  triangle.vertices[0] = v0;
+  triangle.vertices[1] = v1;
+  triangle.vertices[2] = v2;
+
+  const ShadedVertex* p[3] = {p0, p1, p2};
+  float inv_area = 1.0f / area;
+  for (int i = 0; i < 3; ++i) {
+    const auto* pj = p[(i + 1) % 3];
+    const auto* pk = p[(i + 2) % 3];
+    float a = pj->y - pk->y;
+    float b = pk->x - pj->x;
+    triangle.a[i] = a * inv_area;
+    triangle.b[i] = b * inv_area;
+    triangle.c[i] = -(a * pj->x + b * pj->y) * inv_area;
+    triangle.inclusive[i] = a > 0.0f || (a == 0.0f && b > 0.0f);
+  }
+
+  // Pixel bounds, clipped to the scissor before converting so huge
+  // coordinates can't overflow.
+  float min_x = std::min(std::min(p0->x, p1->x), p2->x);
+  float max_x = std::max(std::max(p0->x, p1->x), p2->x);
+  float min_y = std::min(std::min(p0->y, p1->y), p2->y);
+  float max_y = std::max(std::max(p0->y, p1->y), p2->y);
+  min_x = std::max(min_x, float(state.scissor_left));
+  min_y = std::max(min_y, float(state.scissor_top));
+  max_x = std::min(max_x, float(state.scissor_right - 1));
+  max_y = std::min(max_y, float(state.scissor_bottom - 1));
+  if (min_x > max_x || min_y > max_y) {
+    return;
+  }
+  triangle.min_x = int32_t(std::floor(min_x));
+  triangle.min_y = int32_t(std::floor(min_y));
+  triangle.max_x = int32_t(std::ceil(max_x));
+  triangle.max_y = int32_t(std::ceil(max_y));
+  triangles_.push_back(triangle);
+}
+
+void SwRasterizer::BinTriangles(const SwDrawState& state) {
+  SCOPE_profile_cpu_f("gpu");
+
+  bins_wide_ = (state.scissor_right + kTileSize - 1) / kTileSize;
+  uint32_t bins_high = (state.scissor_bottom + kTileSize - 1) / kTileSize;
+  size_t bin_count = size_t(bins_wide_) * bins_high;
+  if (bins_.size() < bin_count) {
+    bins_.resize(bin_count);
+  }
+  for (uint32_t bin_index : active_bins_) {
+    bins_[bin_index].clear();
+  }
+  active_bins_.clear();
+
+  for (uint32_t i = 0; i < uint32_t(triangles_.size()); ++i) {
+    const auto& triangle = triangles_[i];
+    uint32_t tile_x0 = uint32_t(triangle.min_x) / kTileSize;
+    uint32_t tile_y0 = uint32_t(triangle.min_y) / kTileSize;
+    uint32_t tile_x1 = uint32_t(triangle.max_x) / kTileSize;
+    uint32_t tile_y1 = uint32_t(triangle.max_y) / kTileSize;
+    for (uint32_t tile_y = tile_y0; tile_y <= tile_y1; ++tile_y) {
+      for (uint32_t tile_x = tile_x0; tile_x <= tile_x1; ++tile_x) {
+        uint32_t bin_index = tile_y * bins_wide_ + tile_x;
+        auto& bin = bins_[bin_index];
+        if (bin.empty()) {
+          active_bins_.push_back(bin_index);
+        }
+        bin.push_back(i);
+      }
+    }
+  }
+}
+
+void SwRasterizer::RasterizeTile(const SwDrawState& state,
+                                 const SwDrawCall& call, uint32_t tile_x,
+                                 uint32_t tile_y,
+                                 const std::vector<uint32_t>& bin) {
+  SwShaderState ps_state;
+  const __m128 lane_offsets = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+  const __m128 zero = _mm_setzero_ps();
+
+  int32_t tile_left = int32_t(tile_x * kTileSize);
+  int32_t tile_top = int32_t(tile_y * kTileSize);
+  for (uint32_t triangle_index : bin) {
+    const auto& triangle = triangles_[triangle_index];
+    int32_t x0 = std::max(triangle.min_x, tile_left);
+    int32_t y0 = std::max(triangle.min_y, tile_top);
+    int32_t x1 = std::min(triangle.max_x, tile_left + int32_t(kTileSize) - 1);
+    int32_t y1 = std::min(triangle.max_y, tile_top + int32_t(kTileSize) - 1);
+
+    __m128 a[3];
+    __m128 inclusive[3];
+    for (int i = 0; i < 3; ++i) {
+      a[i] = _mm_set1_ps(triangle.a[i]);
+      inclusive[i] = _mm_castsi128_ps(
+          _mm_set1_epi32(triangle.inclusive[i] ? -1 : 0));
+    }
+
+    for (int32_t y = y0; y <= y1; ++y) {
+      float py = float(y) + 0.5f;
+      for (int32_t x = x0; x <= x1; x += 4) {
+        __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), lane_offsets);
+        __m128 e[3];
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (int i = 0; i < 3; ++i) {
+          e[i] = _mm_add_ps(_mm_mul_ps(a[i], px),
+                            _mm_set1_ps(triangle.b[i] * py + triangle.c[i]));
+          __m128 covered = _mm_or_ps(
+              _mm_cmpgt_ps(e[i], zero),
+              _mm_and_ps(inclusive[i], _mm_cmpeq_ps(e[i], zero)));
+          inside = _mm_and_ps(inside, covered);
+        }
+        int mask = _mm_movemask_ps(inside);
+        if (x1 - x < 3) {
+          mask &= (1 << (x1 - x + 1)) - 1;
+        }
+        if (!mask) {
+          continue;
+        }
+        alignas(16) float barycentrics[3][4];
+        for (int i = 0; i < 3; ++i) {
+          _mm_store_ps(barycentrics[i], e[i]);
+        }
+        for (int lane = 0; lane < 4; ++lane) {
+          if (!(mask & (1 << lane))) {
+            continue;
+          }
+          float b[3] = {barycentrics[0][lane], barycentrics[1][lane],
+                        barycentrics[2][lane]};
+          ShadePixel(state, call, triangle, uint32_t(x + lane), uint32_t(y),
+                     b, &ps_state);
+        }
+      }
+    }
+  }
+}
+
+void SwRasterizer::ShadePixel(const SwDrawState& state, const SwDrawCall& call,
+                              const Triangle& triangle, uint32_t x,
+                              uint32_t y, const float barycentrics[3],
+                              SwShaderState* ps_state) {
+  const ShadedVertex* v[3] = {&vertices_[triangle.vertices[0]],
+                              &vertices_[triangle.vertices[1]],
+                              &vertices_[triangle.vertices[2]]};
+  float depth = barycentrics[0] * v[0]->z + barycentrics[1] * v[1]->z +
+                barycentrics[2] * v[2]->z;
+  depth = std::min(std::max(depth, 0.0f), 1.0f);
+
+  uint32_t depth_offset = 0;
+  if (state.depth_stencil_enable) {
+    depth_offset = Edram::GetOffset(state.depth_base, state.surface_pitch,
+                                    state.msaa_samples, false, x, y);
+  }
+
+  const SwProgram* ps = call.pixel_program;
+  bool late_depth = ps && (ps->has_kill || ps->writes_depth ||
+                           state.alpha_test_enable);
+  if (state.depth_stencil_enable && !late_depth) {
+    if (!DepthStencilTest(state, triangle.is_front, x, y, depth_offset,
+                          depth)) {
+      return;
+    }
+  }
+
+  float colors[4][4] = {};
+  if (ps) {
+    // Perspective-correct weights.
+    float w[3];
+    float w_sum = 0.0f;
+    for (int i = 0; i < 3; ++i) {
+      w[i] = barycentrics[i] * v[i]->inv_w;
+      w_sum += w[i];
+    }
+    float w_scale = w_sum != 0.0f ? 1.0f / w_sum : 0.0f;
+    __m128 w0 = _mm_set1_ps(w[0] * w_scale);
+    __m128 w1 = _mm_set1_ps(w[1] * w_scale);
+    __m128 w2 = _mm_set1_ps(w[2] * w_scale);
+
+    uint32_t register_count =
+        std::min(ps->register_count, SwShaderState::kMaxRegisters);
+    std::memset(ps_state->registers, 0,
+                sizeof(ps_state->registers[0]) * std::max(register_count, 1u));
+    for (uint32_t i = 0; i < interpolator_count_; ++i) {
+      __m128 value = _mm_mul_ps(_mm_loadu_ps(v[0]->interpolators[i]), w0);
+      value = _mm_add_ps(
+          value, _mm_mul_ps(_mm_loadu_ps(v[1]->interpolators[i]), w1));
+      value = _mm_add_ps(
+          value, _mm_mul_ps(_mm_loadu_ps(v[2]->interpolators[i]), w2));
+      ps_state->registers[i] = value;
+    }
+    if (state.ps_param_gen >= 0 &&
+        uint32_t(state.ps_param_gen) < SwShaderState::kMaxRegisters) {
+      ps_state->registers[state.ps_param_gen] =
+          _mm_set_ps(0.0f, 0.0f, float(y) + 0.5f, float(x) + 0.5f);
+    }
+    for (int i = 0; i < 4; ++i) {
+      ps_state->colors[i] = _mm_setzero_ps();
+    }
+    ps_state->depth = depth;
+    SwShaderInterpreter::Execute(*ps, *call.pixel_context, ps_state);
+    if (ps_state->killed) {
+      return;
+    }
+    for (int i = 0; i < 4; ++i) {
+      _mm_storeu_ps(colors[i], ps_state->colors[i]);
+    }
+    if (ps->writes_depth) {
+      depth = std::min(std::max(ps_state->depth, 0.0f), 1.0f);
+    }
+  }
+
+  if (state.alpha_test_enable &&
+      !Compare(state.alpha_func, colors[0][3], state.alpha_ref)) {
+    return;
+  }
+  if (state.depth_stencil_enable && late_depth) {
+    if (!DepthStencilTest(state, triangle.is_front, x, y, depth_offset,
+                          depth)) {
+      return;
+    }
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    const auto& target = state.color_targets[i];
+    if (target.enabled) {
+      WriteColor(state, target, x, y, colors[i]);
+    }
+  }
+}
+
+bool SwRasterizer::DepthStencilTest(const SwDrawState& state, bool is_front,
+                                    uint32_t x, uint32_t y,
+                                    uint32_t depth_offset, float depth) {
+  uint32_t* edram_value = edram_->data() + depth_offset;
+  uint32_t stored = *edram_value;
+  uint32_t stored_depth = stored >> 8;
+  uint32_t stored_stencil = stored & 0xFF;
+
+  uint32_t new_depth = Edram::PackDepth(state.depth_format, depth);
+  bool depth_pass =
+      !state.depth_test || Compare(state.depth_func, new_depth, stored_depth);
+
+  bool stencil_pass = true;
+  uint32_t new_stencil = stored_stencil;
+  if (state.stencil_enable) {
+    const auto& face = is_front ? state.stencil_front : state.stencil_back;
+    stencil_pass = Compare(face.func, face.ref & face.mask,
+                           stored_stencil & face.mask);
+    uint32_t op = !stencil_pass
+                      ? face.fail_op
+                      : (depth_pass ? face.pass_op : face.depth_fail_op);
+    uint32_t result = ApplyStencilOp(op, stored_stencil, face.ref);
+    new_stencil = (stored_stencil & ~face.write_mask) |
+                  (result & face.write_mask);
+  }
+
+  uint32_t result_depth =
+      stencil_pass && depth_pass && state.depth_write ? new_depth
+                                                      : stored_depth;
+  uint32_t result = (result_depth << 8) | (new_stencil & 0xFF);
+  if (result != stored) {
+    *edram_value = result;
+    // Pixels are shaded once, so every sample gets the result of sample 0.
+    uint32_t sample_count = Edram::GetSampleCount(state.msaa_samples);
+    for (uint32_t sample = 1; sample < sample_count; ++sample) {
+      edram_->data()[Edram::GetOffset(state.depth_base, state.surface_pitch,
+                                      state.msaa_samples, false, x, y,
+                                      sample)] = result;
+    }
+  }
+  return stencil_pass && depth_pass;
+}
+
+void SwRasterizer::WriteColor(const SwDrawState& state,
+                              const SwDrawState::ColorTarget& target,
+                              uint32_t x, uint32_t y, const float color[4]) {
+  uint32_t* edram_value =
+      edram_->data() + Edram::GetOffset(target.base, state.surface_pitch,
+                                        state.msaa_samples, target.is_64bpp,
+                                        x, y);
+  float src[4];
+  for (int i = 0; i < 4; ++i) {
+    src[i] = color[i] * target.exp_scale;
+  }
+
+  float result[4];
+  bool blend = state.blend_enable && target.blend_control != kBlendPassthrough;
+  if (!blend && target.write_mask == 0xF) {
+    std::memcpy(result, src, sizeof(result));
+  } else {
+    uint32_t stored[2] = {edram_value[0],
+                          target.is_64bpp ? edram_value[1] : 0};
+    float dst[4];
+    Edram::UnpackColor(target.format, stored, dst);
+    if (blend) {
+      Blend(target.blend_control, src, dst, state.blend_constant, result);
+    } else {
+      std::memcpy(result, src, sizeof(result));
+    }
+    for (int i = 0; i < 4; ++i) {
+      if (!(target.write_mask & (1 << i))) {
+        result[i] = dst[i];
+      }
+    }
+  }
+
+  // 32bpp targets only own one dword, so don't store the second.
+  uint32_t packed[2];
+  Edram::PackColor(target.format, result, packed);
+  uint32_t sample_count = Edram::GetSampleCount(state.msaa_samples);
+  for (uint32_t sample = 0; sample < sample_count; ++sample) {
+    if (sample) {
+      edram_value = edram_->data() +
+                    Edram::GetOffset(target.base, state.surface_pitch,
+                                     state.msaa_samples, target.is_64bpp, x,
+                                     y, sample);
+    }
+    edram_value[0] = packed[0];
+    if (target.is_64bpp) {
+      edram_value[1] = packed[1];
+    }
+  }
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,215 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_RASTERIZER_H_
+#define XENIA_GPU_SW_SW_RASTERIZER_H_
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/worker_pool.h"
+#include "xenia/gpu/edram.h"
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/sw/sw_shader.h"
+#include "xenia/gpu/sw/sw_shader_interpreter.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// Fixed function state of a draw, decoded once from the register file.
+struct SwDrawState {
+  PrimitiveType primitive_type = PrimitiveType::kNone;
+
+  // Viewport transform. Positions not already divided by w are divided, then
+  // scaled and offset into render target pixels.
+  bool xy_divide = true;
+  bool z_divide = true;
+  bool w_is_reciprocal = false;
+  float viewport_scale[3];
+  float viewport_offset[3];
+
+  // Scissor rectangle in render target pixels, right and bottom exclusive.
+  uint32_t scissor_left = 0;
+  uint32_t scissor_top = 0;
+  uint32_t scissor_right = 0;
+  uint32_t scissor_bottom = 0;
+
+  bool cull_front = false;
+  bool cull_back = false;
+  bool front_face_cw = false;
+
+  uint32_t surface_pitch = 0;
+  // Pixels are shaded once and written to every sample.
+  MsaaSamples msaa_samples = MsaaSamples::k1X;
+
+  struct ColorTarget {
+    bool enabled = false;
+    uint32_t base = 0;
+    ColorRenderTargetFormat format = ColorRenderTargetFormat::k_8_8_8_8;
+    bool is_64bpp = false;
+    float exp_scale = 1.0f;
+    uint32_t blend_control = 0;
+    // RGBA write mask in the low 4 bits.
+    uint32_t write_mask = 0;
+  };
+  ColorTarget color_targets[4];
+  bool blend_enable = true;
+  float blend_constant[4];
+
+  bool alpha_test_enable = false;
+  uint32_t alpha_func = 7;
+  float alpha_ref = 0.0f;
+
+  struct StencilFace {
+    uint32_t func = 7;
+    uint32_t fail_op = 0;
+    uint32_t pass_op = 0;
+    uint32_t depth_fail_op = 0;
+    uint32_t ref = 0;
+    uint32_t mask = 0xFF;
+    uint32_t write_mask = 0xFF;
+  };
+  // Whether the depth buffer is touched at all by this draw.
+  bool depth_stencil_enable = false;
+  uint32_t depth_base = 0;
+  DepthRenderTargetFormat depth_format = DepthRenderTargetFormat::kD24S8;
+  bool depth_test = false;
+  bool depth_write = false;
+  uint32_t depth_func = 7;
+  bool stencil_enable = false;
+  StencilFace stencil_front;
+  StencilFace stencil_back;
+
+  bool primitive_reset_enable = false;
+  uint32_t primitive_reset_index = 0;
+  uint32_t index_offset = 0;
+
+  // Pixel shader register receiving the pixel position, or -1.
+  int32_t ps_param_gen = -1;
+
+  // Decodes the state from the register file. Returns false if the draw
+  // doesn't write anything.
+  static bool Decode(const RegisterFile& regs, PrimitiveType primitive_type,
+                     SwDrawState* out_state);
+};
+
+// Everything a draw needs besides its fixed function state.
+struct SwDrawCall {
+  uint32_t index_count = 0;
+  // Host pointer to the guest index buffer, or nullptr for auto-indexed
+  // draws.
+  const uint8_t* index_data = nullptr;
+  IndexFormat index_format = IndexFormat::kInt16;
+  Endian index_endian = Endian::kUnspecified;
+
+  const SwProgram* vertex_program = nullptr;
+  const SwShaderContext* vertex_context = nullptr;
+  // May be null for depth-only draws.
+  const SwProgram* pixel_program = nullptr;
+  const SwShaderContext* pixel_context = nullptr;
+};
+
+// Rasterizes triangles into EDRAM.
+//
+// Unique vertices of a draw are shaded in parallel, then triangles are set up
+// and binned into 32x32 pixel tiles. Tiles are rasterized in parallel, each by
+// a single thread that walks its triangles in submission order, so ordering
+// within a pixel is preserved without locks. Coverage is evaluated for four
+// pixels at a time with SSE.
+class SwRasterizer {
+ public:
+  static const uint32_t kTileSize = 32;
+
+  explicit SwRasterizer(Edram* edram);
+  ~SwRasterizer();
+
+  void Draw(const SwDrawState& state, const SwDrawCall& call);
+
+ private:
+  static const uint32_t kMaxInterpolators = SwShaderState::kMaxInterpolators;
+
+  struct ShadedVertex {
+    // Render target pixel position and 1/w.
+    float x;
+    float y;
+    float z;
+    float inv_w;
+    // Set when w <= 0, which can't be rasterized without clipping.
+    bool culled;
+    float interpolators[kMaxInterpolators][4];
+  };
+
+  struct Triangle {
+    uint32_t vertices[3];
+    // Barycentric edge functions, e(x, y) = a * x + b * y + c for the edge
+    // opposite each vertex.
+    float a[3];
+    float b[3];
+    float c[3];
+    // Whether pixels exactly on an edge belong to this triangle, so pixels on
+    // an edge shared by two triangles are drawn once.
+    bool inclusive[3];
+    int32_t min_x;
+    int32_t min_y;
+    int32_t max_x;
+    int32_t max_y;
+    bool is_front;
+  };
+
+  void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+  // Reads the indices and maps them to unique vertex slots, with UINT32_MAX
+  // marking primitive resets.
+  void GatherIndices(const SwDrawState& state, const SwDrawCall& call);
+  void ShadeVertices(const SwDrawState& state, const SwDrawCall& call);
+  void AssembleTriangles(const SwDrawState& state);
+  void SetupTriangle(const SwDrawState& state, uint32_t v0, uint32_t v1,
+                     uint32_t v2);
+  // Adds the fourth vertex of a rectangle list primitive, opposite the
+  // corner with the right angle, and returns it. out_corner receives which
+  // of v0, v1 and v2 that corner is.
+  uint32_t CompleteRectangle(uint32_t v0, uint32_t v1, uint32_t v2,
+                             uint32_t* out_corner);
+  void BinTriangles(const SwDrawState& state);
+  void RasterizeTile(const SwDrawState& state, const SwDrawCall& call,
+                     uint32_t tile_x, uint32_t tile_y,
+                     const std::vector<uint32_t>& bin);
+  void ShadePixel(const SwDrawState& state, const SwDrawCall& call,
+                  const Triangle& triangle, uint32_t x, uint32_t y,
+                  const float barycentrics[3], SwShaderState* ps_state);
+  bool DepthStencilTest(const SwDrawState& state, bool is_front, uint32_t x,
+                        uint32_t y, uint32_t depth_offset, float depth);
+  void WriteColor(const SwDrawState& state,
+                  const SwDrawState::ColorTarget& target, uint32_t x,
+                  uint32_t y, const float color[4]);
+
+  Edram* edram_ = nullptr;
+  std::unique_ptr<threading::WorkerPool> worker_pool_;
+
+  // Per-draw scratch, kept to avoid reallocating for every draw.
+  std::vector<uint32_t> slots_;
+  std::vector<uint32_t> unique_indices_;
+  std::unordered_map<uint32_t, uint32_t> index_slots_;
+  std::vector<ShadedVertex> vertices_;
+  std::vector<Triangle> triangles_;
+  std::vector<std::vector<uint32_t>> bins_;
+  std::vector<uint32_t> active_bins_;
+  uint32_t bins_wide_ = 0;
+  uint32_t interpolator_count_ = 0;
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_RASTERIZER_H_
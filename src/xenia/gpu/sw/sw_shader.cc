@@ -0,0 +1,237 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_shader.h"
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+using namespace ucode;
+
+SwShader::SwShader(ShaderType shader_type, uint64_t data_hash,
+                   const uint32_t* dword_ptr, uint32_t dword_count)
+    : Shader(shader_type, data_hash, dword_ptr, dword_count) {}
+
+SwShader::~SwShader() = default;
+
+SwShaderTranslator::SwShaderTranslator() = default;
+
+SwShaderTranslator::~SwShaderTranslator() = default;
+
+// Exec, call and jump instructions share the same three condition types.
+template <typename T>
+static void SetCondition(const T& instr, SwInstruction* out) {
+  switch (instr.type) {
+    case T::Type::kUnconditional:
+      out->condition = SwInstruction::Condition::kAlways;
+      break;
+    case T::Type::kConditional:
+      out->condition = SwInstruction::Condition::kBoolConstant;
+      out->constant_index = instr.bool_constant_index;
+      break;
+    case T::Type::kPredicated:
+      out->condition = SwInstruction::Condition::kPredicate;
+      break;
+  }
+  out->condition_value = instr.condition;
+}
+
+void SwShaderTranslator::StartTranslation() {
+  program_ = std::make_unique<SwProgram>();
+  program_->register_count = register_count();
+  cf_instruction_indices_.clear();
+  cf_branches_.clear();
+  exec_skip_branch_ = UINT32_MAX;
+}
+
+std::vector<uint8_t> SwShaderTranslator::CompleteTranslation() {
+  // Falling off the end of the program terminates it, as does any branch
+  // past the last control flow instruction.
+  uint32_t end_index = uint32_t(program_->instructions.size());
+  program_->instructions.emplace_back();
+
+  for (uint32_t index : cf_branches_) {
+    auto& instruction = program_->instructions[index];
+    uint32_t cf_index = instruction.target;
+    if (cf_index < cf_instruction_indices_.size() &&
+        cf_instruction_indices_[cf_index] != UINT32_MAX) {
+      instruction.target = cf_instruction_indices_[cf_index];
+    } else {
+      instruction.target = end_index;
+    }
+  }
+
+  return ucode_disasm_buffer().ToBytes();
+}
+
+void SwShaderTranslator::PostTranslation(Shader* shader) {
+  if (shader->is_valid()) {
+    static_cast<SwShader*>(shader)->set_program(std::move(program_));
+  }
+  program_.reset();
+}
+
+void SwShaderTranslator::EmitControlFlowBranch(SwInstruction instruction) {
+  cf_branches_.push_back(uint32_t(program_->instructions.size()));
+  program_->instructions.push_back(instruction);
+}
+
+void SwShaderTranslator::ProcessControlFlowInstructionBegin(
+    uint32_t cf_index) {
+  if (cf_instruction_indices_.size() <= cf_index) {
+    cf_instruction_indices_.resize(cf_index + 1, UINT32_MAX);
+  }
+  cf_instruction_indices_[cf_index] =
+      uint32_t(program_->instructions.size());
+}
+
+void SwShaderTranslator::ProcessExecInstructionBegin(
+    const ParsedExecInstruction& instr) {
+  if (instr.type == ParsedExecInstruction::Type::kUnconditional) {
+    return;
+  }
+  // Skip the clause when the condition doesn't hold; the target is patched
+  // once the clause has been emitted.
+  SwInstruction skip;
+  skip.type = SwInstruction::Type::kBranch;
+  SetCondition(instr, &skip);
+  skip.condition_value = !instr.condition;
+  exec_skip_branch_ = uint32_t(program_->instructions.size());
+  program_->instructions.push_back(skip);
+}
+
+void SwShaderTranslator::ProcessExecInstructionEnd(
+    const ParsedExecInstruction& instr) {
+  if (exec_skip_branch_ != UINT32_MAX) {
+    // A skipped exec end still ends the program, so land on the kEnd below.
+    program_->instructions[exec_skip_branch_].target =
+        uint32_t(program_->instructions.size());
+    exec_skip_branch_ = UINT32_MAX;
+  }
+  if (instr.is_end) {
+    program_->instructions.emplace_back();
+  }
+}
+
+void SwShaderTranslator::ProcessLoopStartInstruction(
+    const ParsedLoopStartInstruction& instr) {
+  SwInstruction loop;
+  loop.type = SwInstruction::Type::kLoopStart;
+  loop.flag = instr.is_repeat;
+  loop.constant_index = instr.loop_constant_index;
+  loop.target = instr.loop_skip_address;
+  EmitControlFlowBranch(loop);
+}
+
+void SwShaderTranslator::ProcessLoopEndInstruction(
+    const ParsedLoopEndInstruction& instr) {
+  SwInstruction loop;
+  loop.type = SwInstruction::Type::kLoopEnd;
+  loop.flag = instr.is_predicated_break;
+  loop.condition_value = instr.predicate_condition;
+  loop.constant_index = instr.loop_constant_index;
+  loop.target = instr.loop_body_address;
+  EmitControlFlowBranch(loop);
+}
+
+void SwShaderTranslator::ProcessCallInstruction(
+    const ParsedCallInstruction& instr) {
+  SwInstruction call;
+  call.type = SwInstruction::Type::kCall;
+  SetCondition(instr, &call);
+  call.target = instr.target_address;
+  EmitControlFlowBranch(call);
+}
+
+void SwShaderTranslator::ProcessReturnInstruction(
+    const ParsedReturnInstruction& instr) {
+  SwInstruction ret;
+  ret.type = SwInstruction::Type::kReturn;
+  program_->instructions.push_back(ret);
+}
+
+void SwShaderTranslator::ProcessJumpInstruction(
+    const ParsedJumpInstruction& instr) {
+  SwInstruction jump;
+  jump.type = SwInstruction::Type::kBranch;
+  SetCondition(instr, &jump);
+  jump.target = instr.target_address;
+  EmitControlFlowBranch(jump);
+}
+
+void SwShaderTranslator::ProcessVertexFetchInstruction(
+    const ParsedVertexFetchInstruction& instr) {
+  SwInstruction fetch;
+  fetch.type = SwInstruction::Type::kVertexFetch;
+  fetch.operation_index = uint32_t(program_->vertex_fetches.size());
+  program_->vertex_fetches.push_back(instr);
+  program_->instructions.push_back(fetch);
+}
+
+void SwShaderTranslator::ProcessTextureFetchInstruction(
+    const ParsedTextureFetchInstruction& instr) {
+  SwInstruction fetch;
+  fetch.type = SwInstruction::Type::kTextureFetch;
+  fetch.operation_index = uint32_t(program_->texture_fetches.size());
+  program_->texture_fetches.push_back(instr);
+  program_->instructions.push_back(fetch);
+}
+
+void SwShaderTranslator::ProcessAluInstruction(
+    const ParsedAluInstruction& instr) {
+  if (instr.is_nop()) {
+    return;
+  }
+  if (instr.result.storage_target == InstructionStorageTarget::kExportAddress ||
+      instr.result.storage_target == InstructionStorageTarget::kExportData) {
+    // Memexport isn't implemented; the store is dropped.
+    XELOGW("SW: memexport is not supported, ignoring export");
+  }
+  if (instr.result.storage_target == InstructionStorageTarget::kDepth) {
+    program_->writes_depth = true;
+  }
+  if (instr.is_vector_type()) {
+    switch (instr.vector_opcode) {
+      case AluVectorOpcode::kKillEq:
+      case AluVectorOpcode::kKillGt:
+      case AluVectorOpcode::kKillGe:
+      case AluVectorOpcode::kKillNe:
+        program_->has_kill = true;
+        break;
+      default:
+        break;
+    }
+  } else {
+    switch (instr.scalar_opcode) {
+      case AluScalarOpcode::kKillsEq:
+      case AluScalarOpcode::kKillsGt:
+      case AluScalarOpcode::kKillsGe:
+      case AluScalarOpcode::kKillsNe:
+      case AluScalarOpcode::kKillsOne:
+        program_->has_kill = true;
+        break;
+      default:
+        break;
+    }
+  }
+
+  SwInstruction alu;
+  alu.type = SwInstruction::Type::kAlu;
+  alu.operation_index = uint32_t(program_->alu.size());
+  program_->alu.push_back(instr);
+  program_->instructions.push_back(alu);
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
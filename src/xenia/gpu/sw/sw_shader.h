@@ -0,0 +1,134 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_SHADER_H_
+#define XENIA_GPU_SW_SW_SHADER_H_
+
+#include <memory>
+#include <vector>
+
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/shader_translator.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// A single step of a flattened shader program. Xenos control flow is lowered
+// to explicit jumps between instruction indices so the interpreter runs one
+// dispatch loop with no knowledge of exec clauses.
+struct SwInstruction {
+  enum class Type : uint8_t {
+    kAlu,
+    kVertexFetch,
+    kTextureFetch,
+    kBranch,
+    kCall,
+    kReturn,
+    kLoopStart,
+    kLoopEnd,
+    kEnd,
+  };
+  enum class Condition : uint8_t {
+    kAlways,
+    kBoolConstant,
+    kPredicate,
+  };
+
+  Type type = Type::kEnd;
+  // How kBranch and kCall are conditioned.
+  Condition condition = Condition::kAlways;
+  // Value the condition must have for the branch to be taken.
+  bool condition_value = true;
+  // kLoopStart: repeat loop that keeps aL. kLoopEnd: predicated break, with
+  // condition_value holding the predicate that breaks out.
+  bool flag = false;
+  // Bool constant index for conditions, loop constant index for loops.
+  uint32_t constant_index = 0;
+  // Index into SwProgram::alu, vertex_fetches or texture_fetches.
+  uint32_t operation_index = 0;
+  // Instruction index jumped to by branches, calls and loops.
+  uint32_t target = 0;
+};
+
+struct SwProgram {
+  std::vector<SwInstruction> instructions;
+  std::vector<ParsedAluInstruction> alu;
+  std::vector<ParsedVertexFetchInstruction> vertex_fetches;
+  std::vector<ParsedTextureFetchInstruction> texture_fetches;
+  uint32_t register_count = 0;
+  // True if any instruction can discard the pixel.
+  bool has_kill = false;
+  // True if the pixel shader exports depth.
+  bool writes_depth = false;
+};
+
+class SwShader : public Shader {
+ public:
+  SwShader(ShaderType shader_type, uint64_t data_hash,
+           const uint32_t* dword_ptr, uint32_t dword_count);
+  ~SwShader() override;
+
+  // Available only if the shader is_valid.
+  const SwProgram* program() const { return program_.get(); }
+  void set_program(std::unique_ptr<SwProgram> program) {
+    program_ = std::move(program);
+  }
+
+ private:
+  std::unique_ptr<SwProgram> program_;
+};
+
+// Lowers parsed ucode into an SwProgram for SwShaderInterpreter. The
+// translated binary is the ucode disassembly, as with UcodeShaderTranslator.
+class SwShaderTranslator : public ShaderTranslator {
+ public:
+  SwShaderTranslator();
+  ~SwShaderTranslator() override;
+
+ protected:
+  void StartTranslation() override;
+  std::vector<uint8_t> CompleteTranslation() override;
+  void PostTranslation(Shader* shader) override;
+
+  void ProcessControlFlowInstructionBegin(uint32_t cf_index) override;
+  void ProcessExecInstructionBegin(const ParsedExecInstruction& instr) override;
+  void ProcessExecInstructionEnd(const ParsedExecInstruction& instr) override;
+  void ProcessLoopStartInstruction(
+      const ParsedLoopStartInstruction& instr) override;
+  void ProcessLoopEndInstruction(
+      const ParsedLoopEndInstruction& instr) override;
+  void ProcessCallInstruction(const ParsedCallInstruction& instr) override;
+  void ProcessReturnInstruction(const ParsedReturnInstruction& instr) override;
+  void ProcessJumpInstruction(const ParsedJumpInstruction& instr) override;
+  void ProcessVertexFetchInstruction(
+      const ParsedVertexFetchInstruction& instr) override;
+  void ProcessTextureFetchInstruction(
+      const ParsedTextureFetchInstruction& instr) override;
+  void ProcessAluInstruction(const ParsedAluInstruction& instr) override;
+
+ private:
+  // Appends an instruction whose target is a control flow index, patched to
+  // an instruction index once every control flow instruction is placed.
+  void EmitControlFlowBranch(SwInstruction instruction);
+
+  std::unique_ptr<SwProgram> program_;
+  // Instruction index of the start of each control flow instruction.
+  std::vector<uint32_t> cf_instruction_indices_;
+  // Instructions whose target still holds a control flow index.
+  std::vector<uint32_t> cf_branches_;
+  // Conditional exec skip branch awaiting the end of its exec, or UINT32_MAX.
+  uint32_t exec_skip_branch_ = UINT32_MAX;
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_SHADER_H_
@@ -0,0 +1,837 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_shader_interpreter.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+using namespace ucode;
+using namespace xe::gpu::xenos;
+
+namespace {
+
+// Guards against malformed programs looping forever.
+const uint32_t kMaxExecutedInstructions = 1 << 20;
+
+union Vec4 {
+  __m128 m;
+  float f[4];
+};
+
+inline __m128 Splat(float value) { return _mm_set1_ps(value); }
+
+inline float Component(__m128 value, int i) {
+  Vec4 v;
+  v.m = value;
+  return v.f[i];
+}
+
+// Returns 1.0 in components where mask is set and 0.0 elsewhere.
+inline __m128 MaskToFloat(__m128 mask) {
+  return _mm_and_ps(mask, _mm_set1_ps(1.0f));
+}
+
+struct Execution {
+  const SwProgram* program;
+  const SwShaderContext* context;
+  SwShaderState* state;
+  int32_t a0 = 0;
+  // Loop counters and aL for up to four nested loops; index 0 is current.
+  uint32_t loop_counts[4] = {0, 0, 0, 0};
+  int32_t loop_addresses[4] = {0, 0, 0, 0};
+  uint32_t call_stack[4] = {0, 0, 0, 0};
+  uint32_t call_depth = 0;
+  bool p0 = false;
+  float ps = 0.0f;
+};
+
+bool GetBoolConstant(const Execution& e, uint32_t index) {
+  return (e.context->bool_constants[index / 32] & (1u << (index % 32))) != 0;
+}
+
+__m128 LoadOperand(const Execution& e, const InstructionOperand& op) {
+  int32_t index = op.storage_index;
+  switch (op.storage_addressing_mode) {
+    case InstructionStorageAddressingMode::kAddressAbsolute:
+      index += e.a0;
+      break;
+    case InstructionStorageAddressingMode::kAddressRelative:
+      index += e.loop_addresses[0];
+      break;
+    default:
+      break;
+  }
+
+  Vec4 src;
+  if (op.storage_source == InstructionStorageSource::kConstantFloat) {
+    // Out of the 512 constant registers pixel shaders get the last 256.
+    if (e.context->is_pixel_shader) {
+      index += 256;
+    }
+    src.m = _mm_loadu_ps(&e.context->float_constants[(index & 511) * 4]);
+  } else {
+    src.m = e.state->registers[index & (SwShaderState::kMaxRegisters - 1)];
+  }
+
+  Vec4 value;
+  if (op.is_standard_swizzle()) {
+    value.m = src.m;
+  } else {
+    // Components past component_count repeat the last one.
+    int count = std::max(op.component_count, 1);
+    for (int i = 0; i < 4; ++i) {
+      auto swizzle = op.components[std::min(i, count - 1)];
+      switch (swizzle) {
+        case SwizzleSource::k0:
+          value.f[i] = 0.0f;
+          break;
+        case SwizzleSource::k1:
+          value.f[i] = 1.0f;
+          break;
+        default:
+          value.f[i] = src.f[int(swizzle)];
+          break;
+      }
+    }
+  }
+  if (op.is_absolute_value) {
+    value.m = _mm_andnot_ps(_mm_set1_ps(-0.0f), value.m);
+  }
+  if (op.is_negated) {
+    value.m = _mm_xor_ps(_mm_set1_ps(-0.0f), value.m);
+  }
+  return value.m;
+}
+
+void StoreResult(Execution& e, const InstructionResult& result,
+                 __m128 value) {
+  if (!result.has_any_writes()) {
+    return;
+  }
+  if (result.is_clamped) {
+    value = _mm_min_ps(_mm_max_ps(value, _mm_setzero_ps()), Splat(1.0f));
+  }
+
+  auto state = e.state;
+  int32_t index = result.storage_index;
+  switch (result.storage_addressing_mode) {
+    case InstructionStorageAddressingMode::kAddressAbsolute:
+      index += e.a0;
+      break;
+    case InstructionStorageAddressingMode::kAddressRelative:
+      index += e.loop_addresses[0];
+      break;
+    default:
+      break;
+  }
+
+  Vec4 scalar_target;
+  __m128* target = nullptr;
+  switch (result.storage_target) {
+    case InstructionStorageTarget::kRegister:
+      target =
+          &state->registers[index & (SwShaderState::kMaxRegisters - 1)];
+      break;
+    case InstructionStorageTarget::kInterpolant:
+      target = &state->interpolators[index &
+                                     (SwShaderState::kMaxInterpolators - 1)];
+      break;
+    case InstructionStorageTarget::kPosition:
+      target = &state->position;
+      break;
+    case InstructionStorageTarget::kColorTarget:
+      target = &state->colors[index & 3];
+      break;
+    case InstructionStorageTarget::kPointSize:
+      scalar_target.f[0] = state->point_size;
+      target = &scalar_target.m;
+      break;
+    case InstructionStorageTarget::kDepth:
+      scalar_target.f[0] = state->depth;
+      target = &scalar_target.m;
+      break;
+    default:
+      // Memexport and unused results.
+      return;
+  }
+
+  Vec4 source;
+  source.m = value;
+  Vec4 dest;
+  dest.m = *target;
+  for (int i = 0; i < 4; ++i) {
+    if (!result.write_mask[i]) {
+      continue;
+    }
+    switch (result.components[i]) {
+      case SwizzleSource::k0:
+        dest.f[i] = 0.0f;
+        break;
+      case SwizzleSource::k1:
+        dest.f[i] = 1.0f;
+        break;
+      default:
+        dest.f[i] = source.f[int(result.components[i])];
+        break;
+    }
+  }
+  *target = dest.m;
+
+  if (result.storage_target == InstructionStorageTarget::kPointSize) {
+    state->point_size = dest.f[0];
+  } else if (result.storage_target == InstructionStorageTarget::kDepth) {
+    state->depth = dest.f[0];
+  }
+}
+
+__m128 Dot(__m128 a, __m128 b, int count) {
+  Vec4 product;
+  product.m = _mm_mul_ps(a, b);
+  float sum = 0.0f;
+  for (int i = 0; i < count; ++i) {
+    sum += product.f[i];
+  }
+  return Splat(sum);
+}
+
+int32_t ToAddress(float value) {
+  return xe::clamp(int32_t(std::floor(value)), -256, 255);
+}
+
+__m128 Cube(__m128 src1) {
+  float src[3] = {Component(src1, 1), Component(src1, 0), Component(src1, 2)};
+  float abs_src[3] = {std::abs(src[0]), std::abs(src[1]), std::abs(src[2])};
+  float face_id;
+  float sc;
+  float tc;
+  float ma;
+  if (abs_src[0] > abs_src[1] && abs_src[0] > abs_src[2]) {
+    face_id = src[0] > 0.0f ? 0.0f : 1.0f;
+    sc = src[0] > 0.0f ? -abs_src[2] : abs_src[2];
+    tc = -abs_src[1];
+    ma = abs_src[0];
+  } else if (abs_src[1] > abs_src[0] && abs_src[1] > abs_src[2]) {
+    face_id = src[1] > 0.0f ? 2.0f : 3.0f;
+    sc = abs_src[0];
+    tc = src[1] > 0.0f ? abs_src[2] : -abs_src[2];
+    ma = abs_src[1];
+  } else {
+    face_id = src[2] > 0.0f ? 4.0f : 5.0f;
+    sc = src[2] > 0.0f ? abs_src[0] : -abs_src[0];
+    tc = -abs_src[1];
+    ma = abs_src[2];
+  }
+  float s = (sc / ma + 1.0f) * 0.5f;
+  float t = (tc / ma + 1.0f) * 0.5f;
+  return _mm_setr_ps(t, s, 2.0f * ma, face_id);
+}
+
+void ExecuteVectorAlu(Execution& e, const ParsedAluInstruction& instr) {
+  __m128 sources[3];
+  for (size_t i = 0; i < instr.operand_count; ++i) {
+    sources[i] = LoadOperand(e, instr.operands[i]);
+  }
+  __m128 zero = _mm_setzero_ps();
+  __m128 dest = zero;
+  switch (instr.vector_opcode) {
+    case AluVectorOpcode::kAdd:
+      dest = _mm_add_ps(sources[0], sources[1]);
+      break;
+    case AluVectorOpcode::kMul:
+      dest = _mm_mul_ps(sources[0], sources[1]);
+      break;
+    case AluVectorOpcode::kMax:
+      dest = _mm_max_ps(sources[0], sources[1]);
+      break;
+    case AluVectorOpcode::kMin:
+      dest = _mm_min_ps(sources[0], sources[1]);
+      break;
+    case AluVectorOpcode::kSeq:
+      dest = MaskToFloat(_mm_cmpeq_ps(sources[0], sources[1]));
+      break;
+    case AluVectorOpcode::kSgt:
+      dest = MaskToFloat(_mm_cmpgt_ps(sources[0], sources[1]));
+      break;
+    case AluVectorOpcode::kSge:
+      dest = MaskToFloat(_mm_cmpge_ps(sources[0], sources[1]));
+      break;
+    case AluVectorOpcode::kSne:
+      dest = MaskToFloat(_mm_cmpneq_ps(sources[0], sources[1]));
+      break;
+    case AluVectorOpcode::kFrc:
+      dest = _mm_sub_ps(sources[0], _mm_floor_ps(sources[0]));
+      break;
+    case AluVectorOpcode::kTrunc:
+      dest = _mm_round_ps(sources[0], _MM_FROUND_TO_ZERO);
+      break;
+    case AluVectorOpcode::kFloor:
+      dest = _mm_floor_ps(sources[0]);
+      break;
+    case AluVectorOpcode::kMad:
+      dest = _mm_add_ps(_mm_mul_ps(sources[0], sources[1]), sources[2]);
+      break;
+    case AluVectorOpcode::kCndEq:
+    case AluVectorOpcode::kCndGe:
+    case AluVectorOpcode::kCndGt: {
+      __m128 mask;
+      if (instr.vector_opcode == AluVectorOpcode::kCndEq) {
+        mask = _mm_cmpeq_ps(sources[0], zero);
+      } else if (instr.vector_opcode == AluVectorOpcode::kCndGe) {
+        mask = _mm_cmpge_ps(sources[0], zero);
+      } else {
+        mask = _mm_cmpgt_ps(sources[0], zero);
+      }
+      dest = _mm_blendv_ps(sources[2], sources[1], mask);
+    } break;
+    case AluVectorOpcode::kDp4:
+      dest = Dot(sources[0], sources[1], 4);
+      break;
+    case AluVectorOpcode::kDp3:
+      dest = Dot(sources[0], sources[1], 3);
+      break;
+    case AluVectorOpcode::kDp2Add:
+      dest = _mm_add_ps(Dot(sources[0], sources[1], 2),
+                        Splat(Component(sources[2], 0)));
+      break;
+    case AluVectorOpcode::kCube:
+      dest = Cube(sources[1]);
+      break;
+    case AluVectorOpcode::kMax4: {
+      Vec4 v;
+      v.m = sources[0];
+      dest = Splat(
+          std::max(std::max(v.f[0], v.f[1]), std::max(v.f[2], v.f[3])));
+    } break;
+    case AluVectorOpcode::kSetpEqPush:
+    case AluVectorOpcode::kSetpNePush:
+    case AluVectorOpcode::kSetpGtPush:
+    case AluVectorOpcode::kSetpGePush: {
+      __m128 c1;
+      switch (instr.vector_opcode) {
+        case AluVectorOpcode::kSetpEqPush:
+          c1 = _mm_cmpeq_ps(sources[1], zero);
+          break;
+        case AluVectorOpcode::kSetpNePush:
+          c1 = _mm_cmpneq_ps(sources[1], zero);
+          break;
+        case AluVectorOpcode::kSetpGtPush:
+          c1 = _mm_cmpgt_ps(sources[1], zero);
+          break;
+        default:
+          c1 = _mm_cmpge_ps(sources[1], zero);
+          break;
+      }
+      int mask =
+          _mm_movemask_ps(_mm_and_ps(_mm_cmpeq_ps(sources[0], zero), c1));
+      e.p0 = (mask & 0x8) != 0;
+      dest = (mask & 0x1) ? zero : Splat(Component(sources[0], 0) + 1.0f);
+    } break;
+    case AluVectorOpcode::kKillEq:
+    case AluVectorOpcode::kKillGt:
+    case AluVectorOpcode::kKillGe:
+    case AluVectorOpcode::kKillNe: {
+      __m128 mask;
+      switch (instr.vector_opcode) {
+        case AluVectorOpcode::kKillEq:
+          mask = _mm_cmpeq_ps(sources[0], sources[1]);
+          break;
+        case AluVectorOpcode::kKillGt:
+          mask = _mm_cmpgt_ps(sources[0], sources[1]);
+          break;
+        case AluVectorOpcode::kKillGe:
+          mask = _mm_cmpge_ps(sources[0], sources[1]);
+          break;
+        default:
+          mask = _mm_cmpneq_ps(sources[0], sources[1]);
+          break;
+      }
+      if (_mm_movemask_ps(mask)) {
+        e.state->killed = true;
+      }
+    } break;
+    case AluVectorOpcode::kDst:
+      dest = _mm_setr_ps(1.0f,
+                         Component(sources[0], 1) * Component(sources[1], 1),
+                         Component(sources[0], 2), Component(sources[1], 3));
+      break;
+    case AluVectorOpcode::kMaxA:
+      e.a0 = ToAddress(Component(sources[0], 3) + 0.5f);
+      dest = _mm_max_ps(sources[0], sources[1]);
+      break;
+    default:
+      break;
+  }
+  StoreResult(e, instr.result, dest);
+}
+
+void ExecuteScalarAlu(Execution& e, const ParsedAluInstruction& instr) {
+  // Vector operands are flattened into their components.
+  float sources[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+  for (size_t i = 0, x = 0; i < instr.operand_count && x < 4; ++i) {
+    Vec4 value;
+    value.m = LoadOperand(e, instr.operands[i]);
+    int count = std::max(instr.operands[i].component_count, 1);
+    for (int j = 0; j < count && x < 4; ++j) {
+      sources[x++] = value.f[j];
+    }
+  }
+  float s0 = sources[0];
+  float s1 = sources[1];
+  float ps = e.ps;
+  float dest = 0.0f;
+  switch (instr.scalar_opcode) {
+    case AluScalarOpcode::kAdds:
+    case AluScalarOpcode::kAddsc0:
+    case AluScalarOpcode::kAddsc1:
+      dest = s0 + s1;
+      break;
+    case AluScalarOpcode::kAddsPrev:
+      dest = s0 + ps;
+      break;
+    case AluScalarOpcode::kMuls:
+    case AluScalarOpcode::kMulsc0:
+    case AluScalarOpcode::kMulsc1:
+      dest = s0 * s1;
+      break;
+    case AluScalarOpcode::kMulsPrev:
+      dest = s0 * ps;
+      break;
+    case AluScalarOpcode::kMulsPrev2:
+      if (ps == -FLT_MAX || !std::isfinite(ps) || !std::isfinite(s1) ||
+          s1 <= 0.0f) {
+        dest = -FLT_MAX;
+      } else {
+        dest = s0 * ps;
+      }
+      break;
+    case AluScalarOpcode::kMaxs:
+      dest = s0 >= s1 ? s0 : s1;
+      break;
+    case AluScalarOpcode::kMins:
+      dest = s0 < s1 ? s0 : s1;
+      break;
+    case AluScalarOpcode::kSeqs:
+      dest = s0 == 0.0f ? 1.0f : 0.0f;
+      break;
+    case AluScalarOpcode::kSgts:
+      dest = s0 > 0.0f ? 1.0f : 0.0f;
+      break;
+    case AluScalarOpcode::kSges:
+      dest = s0 >= 0.0f ? 1.0f : 0.0f;
+      break;
+    case AluScalarOpcode::kSnes:
+      dest = s0 != 0.0f ? 1.0f : 0.0f;
+      break;
+    case AluScalarOpcode::kFrcs:
+      dest = s0 - std::floor(s0);
+      break;
+    case AluScalarOpcode::kTruncs:
+      dest = std::trunc(s0);
+      break;
+    case AluScalarOpcode::kFloors:
+      dest = std::floor(s0);
+      break;
+    case AluScalarOpcode::kExp:
+      dest = std::exp2(s0);
+      break;
+    case AluScalarOpcode::kLogc:
+      dest = std::log2(s0);
+      if (std::isinf(dest) && dest < 0.0f) {
+        dest = -FLT_MAX;
+      }
+      break;
+    case AluScalarOpcode::kLog:
+      dest = std::log2(s0);
+      break;
+    case AluScalarOpcode::kRcpc:
+      dest = xe::clamp(1.0f / s0, -FLT_MAX, FLT_MAX);
+      break;
+    case AluScalarOpcode::kRcpf:
+      dest = 1.0f / s0;
+      if (std::isinf(dest)) {
+        dest = std::copysign(0.0f, dest);
+      }
+      break;
+    case AluScalarOpcode::kRcp:
+      dest = 1.0f / s0;
+      break;
+    case AluScalarOpcode::kRsqc:
+      dest = xe::clamp(1.0f / std::sqrt(s0), -FLT_MAX, FLT_MAX);
+      break;
+    case AluScalarOpcode::kRsqf:
+      dest = 1.0f / std::sqrt(s0);
+      if (std::isinf(dest)) {
+        dest = std::copysign(0.0f, dest);
+      }
+      break;
+    case AluScalarOpcode::kRsq:
+      dest = 1.0f / std::sqrt(s0);
+      break;
+    case AluScalarOpcode::kMaxAs:
+      e.a0 = ToAddress(s0 + 0.5f);
+      dest = s0 >= s1 ? s0 : s1;
+      break;
+    case AluScalarOpcode::kMaxAsf:
+      e.a0 = ToAddress(s0);
+      dest = s0 >= s1 ? s0 : s1;
+      break;
+    case AluScalarOpcode::kSubs:
+    case AluScalarOpcode::kSubsc0:
+    case AluScalarOpcode::kSubsc1:
+      dest = s0 - s1;
+      break;
+    case AluScalarOpcode::kSubsPrev:
+      dest = s0 - ps;
+      break;
+    case AluScalarOpcode::kSetpEq:
+      e.p0 = s0 == 0.0f;
+      dest = e.p0 ? 0.0f : 1.0f;
+      break;
+    case AluScalarOpcode::kSetpNe:
+      e.p0 = s0 != 0.0f;
+      dest = e.p0 ? 0.0f : 1.0f;
+      break;
+    case AluScalarOpcode::kSetpGt:
+      e.p0 = s0 > 0.0f;
+      dest = e.p0 ? 0.0f : 1.0f;
+      break;
+    case AluScalarOpcode::kSetpGe:
+      e.p0 = s0 >= 0.0f;
+      dest = e.p0 ? 0.0f : 1.0f;
+      break;
+    case AluScalarOpcode::kSetpInv:
+      e.p0 = s0 == 1.0f;
+      dest = e.p0 ? 0.0f : (s0 == 0.0f ? 1.0f : s0);
+      break;
+    case AluScalarOpcode::kSetpPop:
+      e.p0 = s0 - 1.0f <= 0.0f;
+      dest = std::max(s0 - 1.0f, 0.0f);
+      break;
+    case AluScalarOpcode::kSetpClr:
+      e.p0 = false;
+      dest = FLT_MAX;
+      break;
+    case AluScalarOpcode::kSetpRstr:
+      e.p0 = s0 == 0.0f;
+      dest = s0;
+      break;
+    case AluScalarOpcode::kKillsEq:
+    case AluScalarOpcode::kKillsGt:
+    case AluScalarOpcode::kKillsGe:
+    case AluScalarOpcode::kKillsNe:
+    case AluScalarOpcode::kKillsOne: {
+      bool kill;
+      switch (instr.scalar_opcode) {
+        case AluScalarOpcode::kKillsEq:
+          kill = s0 == 0.0f;
+          break;
+        case AluScalarOpcode::kKillsGt:
+          kill = s0 > 0.0f;
+          break;
+        case AluScalarOpcode::kKillsGe:
+          kill = s0 >= 0.0f;
+          break;
+        case AluScalarOpcode::kKillsNe:
+          kill = s0 != 0.0f;
+          break;
+        default:
+          kill = s0 == 1.0f;
+          break;
+      }
+      if (kill) {
+        e.state->killed = true;
+      }
+      dest = kill ? 1.0f : 0.0f;
+    } break;
+    case AluScalarOpcode::kSqrt:
+      dest = std::sqrt(s0);
+      break;
+    case AluScalarOpcode::kSin:
+      dest = std::sin(s0);
+      break;
+    case AluScalarOpcode::kCos:
+      dest = std::cos(s0);
+      break;
+    case AluScalarOpcode::kRetainPrev:
+      dest = ps;
+      break;
+    default:
+      break;
+  }
+  e.ps = dest;
+  StoreResult(e, instr.result, Splat(dest));
+}
+
+// Decodes one vertex element, with the first component in the least
+// significant bits of each dword.
+void ExecuteVertexFetch(Execution& e,
+                        const ParsedVertexFetchInstruction& instr) {
+  const auto& attributes = instr.attributes;
+  uint32_t fetch_index = uint32_t(instr.operands[1].storage_index);
+  xe_gpu_vertex_fetch_t fetch;
+  fetch.dword_0 = e.context->fetch_constants[fetch_index * 2];
+  fetch.dword_1 = e.context->fetch_constants[fetch_index * 2 + 1];
+
+  float index_value = Component(LoadOperand(e, instr.operands[0]), 0);
+  if (attributes.is_index_rounded) {
+    index_value += 0.5f;
+  }
+  int32_t index = int32_t(std::floor(index_value));
+
+  uint32_t address =
+      (fetch.address << 2) +
+      uint32_t(index * attributes.stride + attributes.offset) * 4;
+  auto src = e.context->memory->TranslatePhysical<const uint8_t*>(address);
+  auto endian = Endian(fetch.endian);
+  uint32_t words[4] = {0, 0, 0, 0};
+  auto load_words = [&](int count) {
+    for (int i = 0; i < count; ++i) {
+      words[i] = GpuSwap(xe::load<uint32_t>(src + i * 4), endian);
+    }
+  };
+
+  bool is_signed = attributes.is_signed;
+  bool normalize = !attributes.is_integer;
+  auto convert = [&](uint32_t value, uint32_t bits) {
+    if (is_signed) {
+      int32_t signed_value = int32_t(value << (32 - bits)) >> (32 - bits);
+      if (!normalize) {
+        return float(signed_value);
+      }
+      double max_value = double((1ull << (bits - 1)) - 1);
+      return float(std::max(double(signed_value) / max_value, -1.0));
+    }
+    if (!normalize) {
+      return float(value);
+    }
+    return float(double(value) / double((1ull << bits) - 1));
+  };
+
+  Vec4 value;
+  value.m = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+  switch (attributes.data_format) {
+    case VertexFormat::k_8_8_8_8:
+      load_words(1);
+      for (int i = 0; i < 4; ++i) {
+        value.f[i] = convert((words[0] >> (i * 8)) & 0xFF, 8);
+      }
+      break;
+    case VertexFormat::k_2_10_10_10:
+      load_words(1);
+      for (int i = 0; i < 3; ++i) {
+        value.f[i] = convert((words[0] >> (i * 10)) & 0x3FF, 10);
+      }
+      value.f[3] = convert(words[0] >> 30, 2);
+      break;
+    case VertexFormat::k_10_11_11:
+      load_words(1);
+      value.f[0] = convert(words[0] & 0x7FF, 11);
+      value.f[1] = convert((words[0] >> 11) & 0x7FF, 11);
+      value.f[2] = convert(words[0] >> 22, 10);
+      break;
+    case VertexFormat::k_11_11_10:
+      load_words(1);
+      value.f[0] = convert(words[0] & 0x3FF, 10);
+      value.f[1] = convert((words[0] >> 10) & 0x7FF, 11);
+      value.f[2] = convert(words[0] >> 21, 11);
+      break;
+    case VertexFormat::k_16_16:
+    case VertexFormat::k_16_16_16_16: {
+      int count = attributes.data_format == VertexFormat::k_16_16 ? 2 : 4;
+      load_words(count / 2);
+      for (int i = 0; i < count; ++i) {
+        value.f[i] = convert((words[i / 2] >> ((i & 1) * 16)) & 0xFFFF, 16);
+      }
+    } break;
+    case VertexFormat::k_16_16_FLOAT:
+    case VertexFormat::k_16_16_16_16_FLOAT: {
+      int count =
+          attributes.data_format == VertexFormat::k_16_16_FLOAT ? 2 : 4;
+      load_words(count / 2);
+      for (int i = 0; i < count; ++i) {
+        value.f[i] = xe::half_to_float(
+            uint16_t(words[i / 2] >> ((i & 1) * 16)));
+      }
+    } break;
+    case VertexFormat::k_32:
+    case VertexFormat::k_32_32:
+    case VertexFormat::k_32_32_32_32: {
+      int count = GetVertexFormatComponentCount(attributes.data_format);
+      load_words(count);
+      for (int i = 0; i < count; ++i) {
+        value.f[i] = convert(words[i], 32);
+      }
+    } break;
+    case VertexFormat::k_32_FLOAT:
+    case VertexFormat::k_32_32_FLOAT:
+    case VertexFormat::k_32_32_32_FLOAT:
+    case VertexFormat::k_32_32_32_32_FLOAT: {
+      int count = GetVertexFormatComponentCount(attributes.data_format);
+      load_words(count);
+      for (int i = 0; i < count; ++i) {
+        std::memcpy(&value.f[i], &words[i], sizeof(float));
+      }
+    } break;
+    default:
+      break;
+  }
+  if (attributes.exp_adjust) {
+    value.m =
+        _mm_mul_ps(value.m, Splat(std::ldexp(1.0f, attributes.exp_adjust)));
+  }
+  StoreResult(e, instr.result, value.m);
+}
+
+void ExecuteTextureFetch(Execution& e,
+                         const ParsedTextureFetchInstruction& instr) {
+  if (!instr.has_result()) {
+    return;
+  }
+  Vec4 value;
+  value.m = _mm_setzero_ps();
+  if (instr.opcode == FetchOpcode::kTextureFetch) {
+    Vec4 coords;
+    coords.m = LoadOperand(e, instr.operands[0]);
+    uint32_t fetch_index = uint32_t(instr.operands[1].storage_index) & 31;
+    SampleTexture(e.context->textures[fetch_index], instr, coords.f, value.f);
+  }
+  StoreResult(e, instr.result, value.m);
+}
+
+bool IsConditionMet(const Execution& e, const SwInstruction& instruction) {
+  switch (instruction.condition) {
+    case SwInstruction::Condition::kBoolConstant:
+      return GetBoolConstant(e, instruction.constant_index) ==
+             instruction.condition_value;
+    case SwInstruction::Condition::kPredicate:
+      return e.p0 == instruction.condition_value;
+    default:
+      return true;
+  }
+}
+
+}  // namespace
+
+void SwShaderInterpreter::Execute(const SwProgram& program,
+                                  const SwShaderContext& context,
+                                  SwShaderState* state) {
+  Execution e;
+  e.program = &program;
+  e.context = &context;
+  e.state = state;
+  state->killed = false;
+
+  const auto& instructions = program.instructions;
+  uint32_t pc = 0;
+  for (uint32_t executed = 0; executed < kMaxExecutedInstructions;
+       ++executed) {
+    const auto& instruction = instructions[pc++];
+    switch (instruction.type) {
+      case SwInstruction::Type::kAlu: {
+        const auto& alu = program.alu[instruction.operation_index];
+        if (alu.is_predicated && e.p0 != alu.predicate_condition) {
+          break;
+        }
+        if (alu.is_vector_type()) {
+          ExecuteVectorAlu(e, alu);
+        } else {
+          ExecuteScalarAlu(e, alu);
+        }
+        if (state->killed) {
+          return;
+        }
+      } break;
+      case SwInstruction::Type::kVertexFetch: {
+        const auto& fetch =
+            program.vertex_fetches[instruction.operation_index];
+        if (!fetch.is_predicated || e.p0 == fetch.predicate_condition) {
+          ExecuteVertexFetch(e, fetch);
+        }
+      } break;
+      case SwInstruction::Type::kTextureFetch: {
+        const auto& fetch =
+            program.texture_fetches[instruction.operation_index];
+        if (!fetch.is_predicated || e.p0 == fetch.predicate_condition) {
+          ExecuteTextureFetch(e, fetch);
+        }
+      } break;
+      case SwInstruction::Type::kBranch:
+        if (IsConditionMet(e, instruction)) {
+          pc = instruction.target;
+        }
+        break;
+      case SwInstruction::Type::kCall:
+        if (IsConditionMet(e, instruction) &&
+            e.call_depth < xe::countof(e.call_stack)) {
+          e.call_stack[e.call_depth++] = pc;
+          pc = instruction.target;
+        }
+        break;
+      case SwInstruction::Type::kReturn:
+        if (!e.call_depth) {
+          return;
+        }
+        pc = e.call_stack[--e.call_depth];
+        break;
+      case SwInstruction::Type::kLoopStart: {
+        uint32_t loop_constant =
+            context.loop_constants[instruction.constant_index & 31];
+        // Push the loop state.
+        for (int i = 3; i > 0; --i) {
+          e.loop_counts[i] = e.loop_counts[i - 1];
+          e.loop_addresses[i] = e.loop_addresses[i - 1];
+        }
+        e.loop_counts[0] = loop_constant & 0xFF;
+        if (!instruction.flag) {
+          e.loop_addresses[0] = int32_t((loop_constant >> 8) & 0xFF);
+        }
+        if (!e.loop_counts[0]) {
+          pc = instruction.target;
+        }
+      } break;
+      case SwInstruction::Type::kLoopEnd: {
+        uint32_t loop_constant =
+            context.loop_constants[instruction.constant_index & 31];
+        bool exit = --e.loop_counts[0] == 0;
+        if (instruction.flag && e.p0 == instruction.condition_value) {
+          exit = true;
+        }
+        if (exit) {
+          // Pop the loop state.
+          for (int i = 0; i < 3; ++i) {
+            e.loop_counts[i] = e.loop_counts[i + 1];
+            e.loop_addresses[i] = e.loop_addresses[i + 1];
+          }
+          e.loop_counts[3] = 0;
+          e.loop_addresses[3] = 0;
+        } else {
+          e.loop_addresses[0] += int8_t((loop_constant >> 16) & 0xFF);
+          pc = instruction.target;
+        }
+      } break;
+      case SwInstruction::Type::kEnd:
+        return;
+    }
+  }
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
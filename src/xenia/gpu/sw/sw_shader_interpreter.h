@@ -0,0 +1,68 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_SHADER_INTERPRETER_H_
+#define XENIA_GPU_SW_SW_SHADER_INTERPRETER_H_
+
+#include "xenia/base/platform.h"
+#include "xenia/gpu/sw/sw_shader.h"
+#include "xenia/gpu/sw/sw_texture_cache.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// Constants and bindings shared by every invocation of a shader in a draw.
+// Everything here is read-only while invocations run, so one context is
+// shared by all worker threads.
+struct SwShaderContext {
+  // The 512 float4 constants; pixel shaders use the upper 256.
+  const float* float_constants = nullptr;
+  // 256 bool constants packed into 8 dwords.
+  const uint32_t* bool_constants = nullptr;
+  // 32 loop constants of [count, start, step] bytes.
+  const uint32_t* loop_constants = nullptr;
+  // The 32 fetch constant groups of 6 dwords each.
+  const uint32_t* fetch_constants = nullptr;
+  // Guest memory for vertex fetches.
+  Memory* memory = nullptr;
+  // Textures by fetch constant index, 32 entries.
+  const SwTextureBinding* textures = nullptr;
+  bool is_pixel_shader = false;
+};
+
+// Registers and exports of a single shader invocation. Inputs are written to
+// the registers before execution.
+struct SwShaderState {
+  static const uint32_t kMaxRegisters = 128;
+  static const uint32_t kMaxInterpolators = 16;
+
+  __m128 registers[kMaxRegisters];
+  __m128 interpolators[kMaxInterpolators];
+  __m128 position;
+  __m128 colors[4];
+  float point_size;
+  float depth;
+  bool killed;
+};
+
+// Executes an SwProgram one invocation at a time, using SSE for the four
+// components of each vector operation.
+class SwShaderInterpreter {
+ public:
+  static void Execute(const SwProgram& program, const SwShaderContext& context,
+                      SwShaderState* state);
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_SHADER_INTERPRETER_H_
@@ -0,0 +1,563 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_texture_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/sw/sw_gpu_flags.h"
+#include "xenia/gpu/texture_conversion.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+using namespace xe::gpu::xenos;
+
+namespace {
+
+// Converts an integer texture component to float according to the fetch
+// constant's sign and numeric format.
+float ConvertComponent(uint32_t value, uint32_t bits, TextureSign sign,
+                       bool is_integer) {
+  uint32_t max_value = bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1;
+  if (sign == TextureSign::kSigned) {
+    int32_t signed_value = int32_t(value << (32 - bits)) >> (32 - bits);
+    if (is_integer) {
+      return float(signed_value);
+    }
+    float signed_max = float(max_value >> 1);
+    return std::max(float(signed_value) / signed_max, -1.0f);
+  }
+  if (is_integer) {
+    return float(value);
+  }
+  float unorm = float(double(value) / double(max_value));
+  switch (sign) {
+    case TextureSign::kUnsignedBiased:
+      return unorm * 2.0f - 1.0f;
+    case TextureSign::kGamma:
+      return std::pow(unorm, 2.2f);
+    default:
+      return unorm;
+  }
+}
+
+struct PackedComponents {
+  uint32_t count;
+  uint32_t shifts[4];
+  uint32_t bits[4];
+};
+
+// Bit layout of the formats whose components are packed integers, with the
+// first component in the least significant bits.
+bool GetPackedComponents(TextureFormat format, PackedComponents* out) {
+  switch (format) {
+    case TextureFormat::k_8:
+    case TextureFormat::k_8_A:
+    case TextureFormat::k_8_B:
+      *out = {1, {0}, {8}};
+      return true;
+    case TextureFormat::k_8_8:
+      *out = {2, {0, 8}, {8, 8}};
+      return true;
+    case TextureFormat::k_8_8_8_8:
+    case TextureFormat::k_8_8_8_8_A:
+    case TextureFormat::k_8_8_8_8_GAMMA:
+    case TextureFormat::k_8_8_8_8_AS_16_16_16_16:
+      *out = {4, {0, 8, 16, 24}, {8, 8, 8, 8}};
+      return true;
+    case TextureFormat::k_1_5_5_5:
+      *out = {4, {0, 5, 10, 15}, {5, 5, 5, 1}};
+      return true;
+    case TextureFormat::k_5_6_5:
+      *out = {3, {0, 5, 11}, {5, 6, 5}};
+      return true;
+    case TextureFormat::k_6_5_5:
+      *out = {3, {0, 6, 11}, {6, 5, 5}};
+      return true;
+    case TextureFormat::k_4_4_4_4:
+      *out = {4, {0, 4, 8, 12}, {4, 4, 4, 4}};
+      return true;
+    case TextureFormat::k_2_10_10_10:
+    case TextureFormat::k_2_10_10_10_AS_16_16_16_16:
+      *out = {4, {0, 10, 20, 30}, {10, 10, 10, 2}};
+      return true;
+    case TextureFormat::k_10_11_11:
+    case TextureFormat::k_10_11_11_AS_16_16_16_16:
+      *out = {3, {0, 11, 22}, {11, 11, 10}};
+      return true;
+    case TextureFormat::k_11_11_10:
+    case TextureFormat::k_11_11_10_AS_16_16_16_16:
+      *out = {3, {0, 10, 21}, {10, 11, 11}};
+      return true;
+    case TextureFormat::k_16:
+    case TextureFormat::k_16_EXPAND:
+      *out = {1, {0}, {16}};
+      return true;
+    case TextureFormat::k_16_16:
+    case TextureFormat::k_16_16_EXPAND:
+      *out = {2, {0, 16}, {16, 16}};
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Decodes 565 endpoints and the 2 bit indices of a DXT color block.
+void DecodeDxtColorBlock(const uint8_t* block, bool allow_punchthrough,
+                         float out_texels[16][4]) {
+  uint16_t c0 = xe::load<uint16_t>(block);
+  uint16_t c1 = xe::load<uint16_t>(block + 2);
+  uint32_t indices = xe::load<uint32_t>(block + 4);
+  float palette[4][4];
+  for (int i = 0; i < 2; ++i) {
+    uint16_t c = i ? c1 : c0;
+    palette[i][0] = float((c >> 11) & 0x1F) / 31.0f;
+    palette[i][1] = float((c >> 5) & 0x3F) / 63.0f;
+    palette[i][2] = float(c & 0x1F) / 31.0f;
+    palette[i][3] = 1.0f;
+  }
+  bool four_color = !allow_punchthrough || c0 > c1;
+  for (int j = 0; j < 4; ++j) {
+    if (four_color) {
+      palette[2][j] = (2.0f * palette[0][j] + palette[1][j]) / 3.0f;
+      palette[3][j] = (palette[0][j] + 2.0f * palette[1][j]) / 3.0f;
+    } else {
+      palette[2][j] = (palette[0][j] + palette[1][j]) * 0.5f;
+      palette[3][j] = 0.0f;
+    }
+  }
+  for (int i = 0; i < 16; ++i) {
+    std::memcpy(out_texels[i], palette[(indices >> (i * 2)) & 3],
+                sizeof(float) * 4);
+  }
+}
+
+// Decodes a DXT5-style interpolated single channel block.
+void DecodeDxtAlphaBlock(const uint8_t* block, float out_values[16]) {
+  float a0 = float(block[0]) / 255.0f;
+  float a1 = float(block[1]) / 255.0f;
+  float palette[8] = {a0, a1};
+  if (block[0] > block[1]) {
+    for (int i = 1; i < 7; ++i) {
+      palette[i + 1] = (float(7 - i) * a0 + float(i) * a1) / 7.0f;
+    }
+  } else {
+    for (int i = 1; i < 5; ++i) {
+      palette[i + 1] = (float(5 - i) * a0 + float(i) * a1) / 5.0f;
+    }
+    palette[6] = 0.0f;
+    palette[7] = 1.0f;
+  }
+  uint64_t indices = 0;
+  for (int i = 0; i < 6; ++i) {
+    indices |= uint64_t(block[2 + i]) << (i * 8);
+  }
+  for (int i = 0; i < 16; ++i) {
+    out_values[i] = palette[(indices >> (i * 3)) & 7];
+  }
+}
+
+// Decodes one compressed 4x4 block. Returns false for unsupported formats.
+bool DecodeBlock(TextureFormat format, const uint8_t* block,
+                 float out_texels[16][4]) {
+  switch (format) {
+    case TextureFormat::k_DXT1:
+    case TextureFormat::k_DXT1_AS_16_16_16_16:
+      DecodeDxtColorBlock(block, true, out_texels);
+      return true;
+    case TextureFormat::k_DXT2_3:
+    case TextureFormat::k_DXT2_3_AS_16_16_16_16: {
+      DecodeDxtColorBlock(block + 8, false, out_texels);
+      uint64_t alpha = xe::load<uint64_t>(block);
+      for (int i = 0; i < 16; ++i) {
+        out_texels[i][3] = float((alpha >> (i * 4)) & 0xF) / 15.0f;
+      }
+      return true;
+    }
+    case TextureFormat::k_DXT4_5:
+    case TextureFormat::k_DXT4_5_AS_16_16_16_16: {
+      DecodeDxtColorBlock(block + 8, false, out_texels);
+      float alpha[16];
+      DecodeDxtAlphaBlock(block, alpha);
+      for (int i = 0; i < 16; ++i) {
+        out_texels[i][3] = alpha[i];
+      }
+      return true;
+    }
+    case TextureFormat::k_DXT5A: {
+      float values[16];
+      DecodeDxtAlphaBlock(block, values);
+      for (int i = 0; i < 16; ++i) {
+        out_texels[i][0] = out_texels[i][1] = values[i];
+        out_texels[i][2] = out_texels[i][3] = values[i];
+      }
+      return true;
+    }
+    case TextureFormat::k_DXN: {
+      float red[16];
+      float green[16];
+      DecodeDxtAlphaBlock(block, red);
+      DecodeDxtAlphaBlock(block + 8, green);
+      for (int i = 0; i < 16; ++i) {
+        out_texels[i][0] = red[i];
+        out_texels[i][1] = green[i];
+        out_texels[i][2] = 0.0f;
+        out_texels[i][3] = 1.0f;
+      }
+      return true;
+    }
+    default:
+      return false;
+  }
+}
+
+// Decodes one uncompressed texel. Returns false for unsupported formats.
+bool DecodeTexel(TextureFormat format, const uint8_t* src,
+                 const TextureSign signs[4], bool is_integer,
+                 float out_texel[4]) {
+  out_texel[0] = out_texel[1] = out_texel[2] = 0.0f;
+  out_texel[3] = 1.0f;
+
+  PackedComponents packed;
+  if (GetPackedComponents(format, &packed)) {
+    uint32_t value;
+    switch (packed.shifts[packed.count - 1] + packed.bits[packed.count - 1]) {
+      case 8:
+        value = *src;
+        break;
+      case 16:
+        value = xe::load<uint16_t>(src);
+        break;
+      default:
+        value = xe::load<uint32_t>(src);
+        break;
+    }
+    for (uint32_t i = 0; i < packed.count; ++i) {
+      uint32_t bits = packed.bits[i];
+      uint32_t component = (value >> packed.shifts[i]) & ((1u << bits) - 1);
+      out_texel[i] = ConvertComponent(component, bits, signs[i], is_integer);
+    }
+    return true;
+  }
+
+  switch (format) {
+    case TextureFormat::k_16_16_16_16:
+    case TextureFormat::k_16_16_16_16_EXPAND:
+      for (int i = 0; i < 4; ++i) {
+        out_texel[i] = ConvertComponent(xe::load<uint16_t>(src + i * 2), 16,
+                                        signs[i], is_integer);
+      }
+      return true;
+    case TextureFormat::k_16_FLOAT:
+    case TextureFormat::k_16_16_FLOAT:
+    case TextureFormat::k_16_16_16_16_FLOAT: {
+      int count = format == TextureFormat::k_16_FLOAT
+                      ? 1
+                      : format == TextureFormat::k_16_16_FLOAT ? 2 : 4;
+      for (int i = 0; i < count; ++i) {
+        out_texel[i] = xe::half_to_float(xe::load<uint16_t>(src + i * 2));
+      }
+      return true;
+    }
+    case TextureFormat::k_32:
+    case TextureFormat::k_32_32:
+    case TextureFormat::k_32_32_32_32: {
+      int count = format == TextureFormat::k_32
+                      ? 1
+                      : format == TextureFormat::k_32_32 ? 2 : 4;
+      for (int i = 0; i < count; ++i) {
+        out_texel[i] = ConvertComponent(xe::load<uint32_t>(src + i * 4), 32,
+                                        signs[i], is_integer);
+      }
+      return true;
+    }
+    case TextureFormat::k_32_FLOAT:
+    case TextureFormat::k_32_32_FLOAT:
+    case TextureFormat::k_32_32_32_FLOAT:
+    case TextureFormat::k_32_32_32_32_FLOAT: {
+      int count = 4;
+      if (format == TextureFormat::k_32_FLOAT) {
+        count = 1;
+      } else if (format == TextureFormat::k_32_32_FLOAT) {
+        count = 2;
+      } else if (format == TextureFormat::k_32_32_32_FLOAT) {
+        count = 3;
+      }
+      for (int i = 0; i < count; ++i) {
+        out_texel[i] = xe::load<float>(src + i * 4);
+      }
+      return true;
+    }
+    case TextureFormat::k_24_8:
+      out_texel[0] = float(xe::load<uint32_t>(src) >> 8) / float(0xFFFFFF);
+      out_texel[1] = float(xe::load<uint32_t>(src) & 0xFF);
+      return true;
+    default:
+      return false;
+  }
+}
+
+// Resolves a texel coordinate against the addressing mode. Returns false if
+// the coordinate falls on the border.
+bool AddressTexel(ClampMode mode, int32_t coord, int32_t size,
+                  int32_t* out_coord) {
+  switch (mode) {
+    case ClampMode::kRepeat:
+      coord %= size;
+      *out_coord = coord < 0 ? coord + size : coord;
+      return true;
+    case ClampMode::kMirroredRepeat: {
+      int32_t period = size * 2;
+      coord %= period;
+      if (coord < 0) {
+        coord += period;
+      }
+      *out_coord = coord < size ? coord : period - 1 - coord;
+      return true;
+    }
+    case ClampMode::kMirrorClampToEdge:
+    case ClampMode::kMirrorClampToHalfway:
+    case ClampMode::kMirrorClampToBorder:
+      coord = coord < 0 ? -coord - 1 : coord;
+      break;
+    default:
+      break;
+  }
+  if (mode == ClampMode::kClampToBorder ||
+      mode == ClampMode::kMirrorClampToBorder) {
+    if (coord < 0 || coord >= size) {
+      return false;
+    }
+  }
+  *out_coord = xe::clamp(coord, 0, size - 1);
+  return true;
+}
+
+void FetchTexel(const SwTexture& texture, const xe_gpu_texture_fetch_t& fetch,
+                int32_t x, int32_t y, float out_texel[4]) {
+  int32_t tx;
+  int32_t ty;
+  if (!AddressTexel(ClampMode(fetch.clamp_x), x, int32_t(texture.width),
+                    &tx) ||
+      !AddressTexel(ClampMode(fetch.clamp_y), y, int32_t(texture.height),
+                    &ty)) {
+    float border = fetch.border_color == 1 ? 1.0f : 0.0f;
+    out_texel[0] = out_texel[1] = out_texel[2] = out_texel[3] = border;
+    return;
+  }
+  std::memcpy(out_texel, &texture.texels[(size_t(ty) * texture.width + tx) * 4],
+              sizeof(float) * 4);
+}
+
+}  // namespace
+
+void SampleTexture(const SwTextureBinding& binding,
+                   const ParsedTextureFetchInstruction& instr,
+                   const float coords[4], float out_value[4]) {
+  const SwTexture* texture = binding.texture;
+  if (!texture || !texture->width || !texture->height) {
+    out_value[0] = out_value[1] = out_value[2] = out_value[3] = 0.0f;
+    return;
+  }
+  auto& fetch = binding.fetch;
+  const auto& attributes = instr.attributes;
+
+  float u = coords[0];
+  float v = instr.dimension == TextureDimension::k1D ? 0.0f : coords[1];
+  if (!attributes.unnormalized_coordinates) {
+    u *= float(texture->width);
+    v *= float(texture->height);
+  }
+  u += attributes.offset_x;
+  v += attributes.offset_y;
+
+  // Without derivatives there is no LOD, so the magnification filter applies.
+  TextureFilter filter = attributes.mag_filter;
+  if (filter == TextureFilter::kUseFetchConst) {
+    filter = TextureFilter(fetch.mag_filter);
+  }
+  float texel[4];
+  if (filter == TextureFilter::kLinear && FLAGS_sw_bilinear_filtering) {
+    u -= 0.5f;
+    v -= 0.5f;
+    float fu = std::floor(u);
+    float fv = std::floor(v);
+    float wu = u - fu;
+    float wv = v - fv;
+    int32_t x = int32_t(fu);
+    int32_t y = int32_t(fv);
+    float t00[4];
+    float t10[4];
+    float t01[4];
+    float t11[4];
+    FetchTexel(*texture, fetch, x, y, t00);
+    FetchTexel(*texture, fetch, x + 1, y, t10);
+    FetchTexel(*texture, fetch, x, y + 1, t01);
+    FetchTexel(*texture, fetch, x + 1, y + 1, t11);
+    for (int i = 0; i < 4; ++i) {
+      float top = t00[i] + (t10[i] - t00[i]) * wu;
+      float bottom = t01[i] + (t11[i] - t01[i]) * wu;
+      texel[i] = top + (bottom - top) * wv;
+    }
+  } else {
+    FetchTexel(*texture, fetch, int32_t(std::floor(u)),
+               int32_t(std::floor(v)), texel);
+  }
+
+  for (int i = 0; i < 4; ++i) {
+    uint32_t swizzle = (fetch.swizzle >> (i * 3)) & 0x7;
+    if (swizzle <= XE_GPU_SWIZZLE_W) {
+      out_value[i] = texel[swizzle];
+    } else {
+      out_value[i] = swizzle == XE_GPU_SWIZZLE_1 ? 1.0f : 0.0f;
+    }
+  }
+}
+
+SwTextureCache::SwTextureCache(Memory* memory) : memory_(memory) {}
+
+SwTextureCache::~SwTextureCache() = default;
+
+const SwTexture* SwTextureCache::Demand(const xe_gpu_texture_fetch_t& fetch) {
+  TextureInfo texture_info;
+  if (!TextureInfo::Prepare(fetch, &texture_info)) {
+    return nullptr;
+  }
+  // Signedness, numeric format and exponent bias are applied while decoding,
+  // so they are part of the key.
+  uint64_t key = texture_info.hash();
+  key ^= uint64_t((fetch.dword_0 >> 2) & 0xFF) << 32;
+  key ^= uint64_t(fetch.num_format) << 40;
+  key ^= uint64_t(uint32_t(fetch.exp_adjust) & 0x3F) << 48;
+  auto it = textures_.find(key);
+  if (it != textures_.end()) {
+    return it->second.get();
+  }
+
+  auto texture = std::make_unique<SwTexture>();
+  if (!Decode(texture_info, fetch, texture.get())) {
+    XELOGW("SW: unsupported texture format %s",
+           texture_info.format_info()->name);
+    texture.reset();
+  }
+  auto result = texture.get();
+  textures_.insert({key, std::move(texture)});
+  return result;
+}
+
+void SwTextureCache::Clear() { textures_.clear(); }
+
+bool SwTextureCache::Decode(const TextureInfo& texture_info,
+                            const xe_gpu_texture_fetch_t& fetch,
+                            SwTexture* texture) {
+  SCOPE_profile_cpu_f("gpu");
+
+  const FormatInfo* format_info = texture_info.format_info();
+  uint32_t mip = texture_info.mip_min_level;
+  uint32_t offset_x = 0;
+  uint32_t offset_y = 0;
+  uint32_t address =
+      texture_info.GetMipLocation(mip, &offset_x, &offset_y, true);
+  if (!address) {
+    return false;
+  }
+
+  // Untile the most detailed mip of the first face into scratch memory in the
+  // guest format.
+  auto extent = texture_info.GetMipExtent(mip, true);
+  uint32_t bytes_per_block = format_info->bytes_per_block();
+  uint32_t pitch = extent.block_pitch_h * bytes_per_block;
+  scratch_.resize(size_t(pitch) * extent.block_pitch_v);
+  auto src_mem = memory_->TranslatePhysical<const uint8_t*>(address);
+  auto endianness = texture_info.endianness;
+  if (!texture_info.is_tiled) {
+    const uint8_t* src =
+        src_mem + offset_y * pitch + offset_x * bytes_per_block;
+    for (uint32_t y = 0; y < extent.block_height; y++) {
+      texture_conversion::CopySwapBlock(endianness, &scratch_[y * pitch],
+                                        src + y * pitch, pitch);
+    }
+  } else {
+    texture_conversion::UntileInfo untile_info;
+    std::memset(&untile_info, 0, sizeof(untile_info));
+    untile_info.offset_x = offset_x;
+    untile_info.offset_y = offset_y;
+    untile_info.width = extent.block_width;
+    untile_info.height = extent.block_height;
+    untile_info.input_pitch = extent.block_pitch_h;
+    untile_info.output_pitch = extent.block_pitch_h;
+    untile_info.input_format_info = format_info;
+    untile_info.output_format_info = format_info;
+    untile_info.copy_callback = [=](auto o, auto i, auto l) {
+      texture_conversion::CopySwapBlock(endianness, o, i, l);
+    };
+    texture_conversion::Untile(scratch_.data(), src_mem, &untile_info);
+  }
+
+  uint32_t width = std::max(1u, (texture_info.width + 1) >> mip);
+  uint32_t height = std::max(1u, (texture_info.height + 1) >> mip);
+  texture->width = width;
+  texture->height = height;
+  texture->texels.resize(size_t(width) * height * 4);
+
+  TextureSign signs[4] = {TextureSign(fetch.sign_x), TextureSign(fetch.sign_y),
+                          TextureSign(fetch.sign_z),
+                          TextureSign(fetch.sign_w)};
+  bool is_integer = fetch.num_format != 0;
+  uint32_t block_width = format_info->block_width;
+  uint32_t block_height = format_info->block_height;
+  for (uint32_t by = 0; by < extent.block_height; ++by) {
+    for (uint32_t bx = 0; bx < extent.block_width; ++bx) {
+      const uint8_t* block = &scratch_[by * pitch + bx * bytes_per_block];
+      float block_texels[16][4];
+      if (block_width == 1 && block_height == 1) {
+        if (!DecodeTexel(texture_info.format, block, signs, is_integer,
+                         block_texels[0])) {
+          return false;
+        }
+      } else if (!DecodeBlock(texture_info.format, block, block_texels)) {
+        return false;
+      }
+      for (uint32_t y = 0; y < block_height; ++y) {
+        uint32_t ty = by * block_height + y;
+        if (ty >= height) {
+          break;
+        }
+        for (uint32_t x = 0; x < block_width; ++x) {
+          uint32_t tx = bx * block_width + x;
+          if (tx >= width) {
+            break;
+          }
+          std::memcpy(&texture->texels[(size_t(ty) * width + tx) * 4],
+                      block_texels[y * block_width + x], sizeof(float) * 4);
+        }
+      }
+    }
+  }
+
+  if (fetch.exp_adjust) {
+    float scale = std::ldexp(1.0f, fetch.exp_adjust);
+    for (auto& value : texture->texels) {
+      value *= scale;
+    }
+  }
+  return true;
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SW_SW_TEXTURE_CACHE_H_
+#define XENIA_GPU_SW_SW_TEXTURE_CACHE_H_
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/texture_info.h"
+#include "xenia/gpu/xenos.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// The most detailed mip of a guest texture decoded to linear float RGBA.
+struct SwTexture {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  // width * height texels of 4 floats each, before the fetch swizzle.
+  std::vector<float> texels;
+};
+
+// A texture bound to a fetch constant for the duration of a draw.
+struct SwTextureBinding {
+  const SwTexture* texture = nullptr;
+  xenos::xe_gpu_texture_fetch_t fetch;
+};
+
+// Samples a bound texture at the given coordinates, applying the fetch
+// constant's addressing, filtering and swizzle. Writes zero when nothing is
+// bound. Safe to call from multiple threads.
+void SampleTexture(const SwTextureBinding& binding,
+                   const ParsedTextureFetchInstruction& instr,
+                   const float coords[4], float out_value[4]);
+
+// Decodes textures referenced by draws. Decoded textures are kept until
+// Clear(), which the command processor calls at every swap and resolve since
+// guest memory may have changed.
+class SwTextureCache {
+ public:
+  explicit SwTextureCache(Memory* memory);
+  ~SwTextureCache();
+
+  // Returns the decoded texture for the fetch constant, decoding it on first
+  // use, or nullptr if the format is unsupported. Not thread safe.
+  const SwTexture* Demand(const xenos::xe_gpu_texture_fetch_t& fetch);
+
+  void Clear();
+
+ private:
+  bool Decode(const TextureInfo& texture_info,
+              const xenos::xe_gpu_texture_fetch_t& fetch, SwTexture* texture);
+
+  Memory* memory_ = nullptr;
+  std::unordered_map<uint64_t, std::unique_ptr<SwTexture>> textures_;
+  std::vector<uint8_t> scratch_;
+};
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SW_SW_TEXTURE_CACHE_H_
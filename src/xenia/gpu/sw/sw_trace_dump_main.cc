@@ -0,0 +1,39 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2016 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/gpu/sw/sw_graphics_system.h"
+#include "xenia/gpu/trace_dump.h"
+
+namespace xe {
+namespace gpu {
+namespace sw {
+
+// Replays a trace on the software backend and dumps the final frontbuffer,
+// so traces can be dumped on machines without a GPU.
+class SwTraceDump : public TraceDump {
+ public:
+  std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() override {
+    return std::unique_ptr<gpu::GraphicsSystem>(new SwGraphicsSystem());
+  }
+};
+
+int trace_dump_main(const std::vector<std::wstring>& args) {
+  SwTraceDump trace_dump;
+  return trace_dump.Main(args);
+}
+
+}  // namespace sw
+}  // namespace gpu
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-gpu-sw-trace-dump",
+                   L"xenia-gpu-sw-trace-dump some.trace",
+                   xe::gpu::sw::trace_dump_main);
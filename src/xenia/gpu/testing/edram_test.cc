@@ -0,0 +1,329 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/edram.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "xenia/base/math.h"
+#include "xenia/gpu/texture_conversion.h"
+
+namespace xe {
+namespace gpu {
+namespace test {
+
+namespace {
+
+// Random floats around the representable ranges of the formats, plus values
+// that must be clamped the same way by the scalar and SSE paths.
+std::vector<float> MakeColors(uint32_t pixel_count) {
+  std::mt19937 random(0x45445241);
+  std::uniform_real_distribution<float> distribution(-40.0f, 40.0f);
+  std::vector<float> colors(pixel_count * 4);
+  for (auto& value : colors) {
+    value = distribution(random);
+    if (random() % 4 == 0) {
+      value /= 40.0f;
+    }
+  }
+  const float specials[] = {0.0f,
+                            -0.0f,
+                            1.0f,
+                            0.5f,
+                            32.0f,
+                            -32.0f,
+                            1.0e9f,
+                            -1.0e9f,
+                            std::numeric_limits<float>::infinity(),
+                            -std::numeric_limits<float>::infinity(),
+                            std::numeric_limits<float>::quiet_NaN()};
+  for (size_t i = 0; i < xe::countof(specials) && i < colors.size(); ++i) {
+    colors[i * 3] = specials[i];
+  }
+  return colors;
+}
+
+}  // namespace
+
+TEST_CASE("EDRAM tile addressing", "EDRAM") {
+  // 80x16 dword tiles, laid out row of tiles by row of tiles.
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, false, 0, 0) == 0);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, false, 79, 0) == 79);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, false, 80, 0) == 1280);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, false, 0, 1) == 80);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, false, 0, 16) ==
+          16 * 1280);
+  REQUIRE(Edram::GetOffset(10, 1280, MsaaSamples::k1X, false, 0, 0) ==
+          10 * 1280);
+  // Tile indices wrap around the end of EDRAM.
+  REQUIRE(Edram::GetOffset(2047, 1280, MsaaSamples::k1X, false, 80, 0) == 0);
+
+  // 64bpp tiles are 40 pixels of two dwords.
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, true, 1, 0) == 2);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, true, 40, 0) == 1280);
+  REQUIRE(Edram::GetOffset(0, 1280, MsaaSamples::k1X, true, 0, 16) ==
+          32 * 1280);
+
+  // 2X stacks samples vertically, 4X in 2x2 blocks with twice the pitch.
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k2X, false, 0, 0, 1) == 80);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k2X, false, 0, 8, 0) ==
+          8 * 1280);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k4X, false, 0, 0, 1) == 1);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k4X, false, 0, 0, 2) == 80);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k4X, false, 0, 0, 3) == 81);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k4X, false, 40, 0, 0) ==
+          1280);
+  REQUIRE(Edram::GetOffset(0, 640, MsaaSamples::k4X, false, 0, 8, 0) ==
+          16 * 1280);
+}
+
+TEST_CASE("EDRAM color packing", "EDRAM") {
+  uint32_t value[2];
+  const float color_a[] = {1.0f, 0.5f, 0.0f, 1.0f};
+  Edram::PackColor(ColorRenderTargetFormat::k_8_8_8_8, color_a, value);
+  REQUIRE(value[0] == 0xFF0080FF);
+
+  const float color_b[] = {1.0f, 0.0f, 0.5f, 1.0f};
+  Edram::PackColor(ColorRenderTargetFormat::k_2_10_10_10, color_b, value);
+  REQUIRE(value[0] == 0xE00003FF);
+
+  const float color_c[] = {1.0f, -1.0f, 32.0f, -32.0f};
+  Edram::PackColor(ColorRenderTargetFormat::k_16_16_16_16, color_c, value);
+  REQUIRE(value[0] == 0xFC000400);
+  REQUIRE(value[1] == 0x80017FFF);
+
+  const float color_d[] = {1.0f, 0.5f, -2.0f, 0.0f};
+  Edram::PackColor(ColorRenderTargetFormat::k_16_16_16_16_FLOAT, color_d,
+                   value);
+  REQUIRE(value[0] == 0x38003C00);
+  REQUIRE(value[1] == 0x0000C000);
+
+  Edram::PackColor(ColorRenderTargetFormat::k_32_FLOAT, color_a, value);
+  REQUIRE(value[0] == 0x3F800000);
+
+  // Unpacking the packed values gives back the inputs that are exactly
+  // representable.
+  float color[4];
+  value[0] = 0xFF0080FF;
+  Edram::UnpackColor(ColorRenderTargetFormat::k_8_8_8_8, value, color);
+  REQUIRE(color[0] == 1.0f);
+  REQUIRE(color[2] == 0.0f);
+  REQUIRE(color[3] == 1.0f);
+  value[0] = 0x38003C00;
+  value[1] = 0x0000C000;
+  Edram::UnpackColor(ColorRenderTargetFormat::k_16_16_16_16_FLOAT, value,
+                     color);
+  REQUIRE(color[0] == 1.0f);
+  REQUIRE(color[1] == 0.5f);
+  REQUIRE(color[2] == -2.0f);
+  REQUIRE(color[3] == 0.0f);
+}
+
+TEST_CASE("EDRAM depth packing", "EDRAM") {
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24S8, 1.0f) ==
+          0xFFFFFF);
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24S8, 0.5f) ==
+          0x800000);
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24S8, 2.0f) ==
+          0xFFFFFF);
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24FS8, 1.0f) ==
+          0xF00000);
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24FS8, 0.5f) ==
+          0xE00000);
+  REQUIRE(Edram::PackDepth(DepthRenderTargetFormat::kD24FS8, 0.0f) == 0);
+  REQUIRE(Edram::UnpackDepth(DepthRenderTargetFormat::kD24FS8, 0xE00000) ==
+          0.5f);
+  REQUIRE(Edram::UnpackDepth(DepthRenderTargetFormat::kD24S8, 0xFFFFFF) ==
+          1.0f);
+}
+
+TEST_CASE("EDRAM span unpacking matches per-pixel", "EDRAM") {
+  const ColorRenderTargetFormat formats[] = {
+      ColorRenderTargetFormat::k_8_8_8_8,
+      ColorRenderTargetFormat::k_8_8_8_8_GAMMA,
+      ColorRenderTargetFormat::k_2_10_10_10,
+      ColorRenderTargetFormat::k_2_10_10_10_FLOAT,
+      ColorRenderTargetFormat::k_16_16,
+      ColorRenderTargetFormat::k_16_16_16_16,
+      ColorRenderTargetFormat::k_16_16_FLOAT,
+      ColorRenderTargetFormat::k_16_16_16_16_FLOAT,
+      ColorRenderTargetFormat::k_32_FLOAT,
+      ColorRenderTargetFormat::k_32_32_FLOAT,
+  };
+  // Not a multiple of 4, so the scalar tail runs too.
+  const uint32_t kPixelCount = 133;
+  std::mt19937 random(0x5350414E);
+  std::vector<uint32_t> values(kPixelCount * 2);
+  for (auto& value : values) {
+    value = uint32_t(random());
+  }
+  for (auto format : formats) {
+    uint32_t stride = Edram::IsColorFormat64bpp(format) ? 2 : 1;
+    std::vector<float> span(kPixelCount * 4);
+    std::vector<float> reference(kPixelCount * 4);
+    Edram::UnpackColorSpan(format, values.data(), span.data(), kPixelCount);
+    for (uint32_t i = 0; i < kPixelCount; ++i) {
+      Edram::UnpackColor(format, &values[i * stride], &reference[i * 4]);
+    }
+    REQUIRE(std::memcmp(span.data(), reference.data(),
+                        span.size() * sizeof(float)) == 0);
+  }
+}
+
+TEST_CASE("EDRAM span packing matches per-pixel", "EDRAM") {
+  const TextureFormat formats[] = {
+      TextureFormat::k_8_8_8_8,
+      TextureFormat::k_8_8_8_8_GAMMA,
+      TextureFormat::k_2_10_10_10,
+      TextureFormat::k_2_10_10_10_FLOAT,
+      TextureFormat::k_5_6_5,
+      TextureFormat::k_16_16,
+      TextureFormat::k_16_16_16_16,
+      TextureFormat::k_16_16_FLOAT,
+      TextureFormat::k_16_16_16_16_FLOAT,
+      TextureFormat::k_32_FLOAT,
+      TextureFormat::k_32_32_FLOAT,
+      TextureFormat::k_32_32_32_32_FLOAT,
+  };
+  const uint32_t kPixelCount = 133;
+  auto colors = MakeColors(kPixelCount);
+  for (auto format : formats) {
+    uint32_t texel_size = FormatInfo::Get(format)->bytes_per_block();
+    std::vector<uint8_t> span(kPixelCount * texel_size);
+    std::vector<uint8_t> reference(kPixelCount * texel_size);
+    REQUIRE(Edram::PackTexelSpan(format, colors.data(), span.data(),
+                                 kPixelCount));
+    for (uint32_t i = 0; i < kPixelCount; ++i) {
+      REQUIRE(Edram::PackTexel(format, &colors[i * 4],
+                               &reference[i * texel_size]));
+    }
+    REQUIRE(span == reference);
+  }
+}
+
+TEST_CASE("EDRAM resolve converts and swaps", "EDRAM") {
+  Edram edram;
+  const uint32_t kWidth = 100;
+  const uint32_t kHeight = 20;
+  // Each pixel holds its coordinates so misplaced pixels are caught.
+  for (uint32_t y = 0; y < kHeight; ++y) {
+    for (uint32_t x = 0; x < kWidth; ++x) {
+      edram.data()[Edram::GetOffset(4, kWidth, MsaaSamples::k1X, false, x,
+                                    y)] = 0xFF000000 | (y << 8) | x;
+    }
+  }
+
+  EdramResolveInfo info;
+  info.edram_base = 4;
+  info.surface_pitch = kWidth;
+  info.color_format = ColorRenderTargetFormat::k_8_8_8_8;
+  info.width = kWidth;
+  info.height = kHeight;
+  info.dest_pitch = kWidth;
+  info.dest_height = kHeight;
+  info.dest_format = TextureFormat::k_8_8_8_8;
+  info.dest_tiled = false;
+  std::vector<uint32_t> dest(kWidth * kHeight);
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(dest.data())));
+  REQUIRE(dest[0] == 0xFF000000);
+  REQUIRE(dest[5 * kWidth + 90] == (0xFF000000 | (5 << 8) | 90));
+
+  info.swap_red_blue = true;
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(dest.data())));
+  REQUIRE(dest[5 * kWidth + 90] == (0xFF000000 | (90 << 16) | (5 << 8)));
+
+  // The exponent bias scales before conversion.
+  info.swap_red_blue = false;
+  info.exp_bias = -1;
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(dest.data())));
+  REQUIRE(dest[2 * kWidth + 10] == (0x80000000 | (1 << 8) | 5));
+
+  // Tiled destinations hold the same texels once untiled.
+  info.exp_bias = 0;
+  std::vector<uint32_t> linear(dest.size());
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(linear.data())));
+  const uint32_t kTiledPitch = 128;
+  const uint32_t kTiledHeight = 32;
+  std::vector<uint32_t> tiled(kTiledPitch * kTiledHeight);
+  info.dest_pitch = kTiledPitch;
+  info.dest_height = kTiledHeight;
+  info.dest_tiled = true;
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(tiled.data())));
+  std::vector<uint32_t> untiled(kWidth * kHeight);
+  texture_conversion::UntileInfo untile_info;
+  std::memset(&untile_info, 0, sizeof(untile_info));
+  untile_info.width = kWidth;
+  untile_info.height = kHeight;
+  untile_info.input_pitch = kTiledPitch;
+  untile_info.output_pitch = kWidth;
+  untile_info.input_format_info = FormatInfo::Get(TextureFormat::k_8_8_8_8);
+  untile_info.output_format_info = untile_info.input_format_info;
+  untile_info.copy_callback = [](auto o, auto i, auto l) {
+    std::memcpy(o, i, l);
+  };
+  texture_conversion::Untile(reinterpret_cast<uint8_t*>(untiled.data()),
+                             reinterpret_cast<uint8_t*>(tiled.data()),
+                             &untile_info);
+  REQUIRE(untiled == linear);
+}
+
+TEST_CASE("EDRAM resolve selects and averages samples", "EDRAM") {
+  Edram edram;
+  // Sample i of every pixel is i + 1.
+  for (uint32_t sample = 0; sample < 4; ++sample) {
+    float value = float(sample + 1);
+    for (uint32_t y = 0; y < 4; ++y) {
+      for (uint32_t x = 0; x < 8; ++x) {
+        std::memcpy(&edram.data()[Edram::GetOffset(0, 8, MsaaSamples::k4X,
+                                                   false, x, y, sample)],
+                    &value, sizeof(value));
+      }
+    }
+  }
+
+  EdramResolveInfo info;
+  info.surface_pitch = 8;
+  info.msaa_samples = MsaaSamples::k4X;
+  info.color_format = ColorRenderTargetFormat::k_32_FLOAT;
+  info.width = 8;
+  info.height = 4;
+  info.dest_pitch = 8;
+  info.dest_height = 4;
+  info.dest_format = TextureFormat::k_32_FLOAT;
+  info.dest_tiled = false;
+  std::vector<float> dest(8 * 4);
+  const float expected[] = {1.0f, 2.0f, 3.0f, 4.0f, 1.5f, 3.5f, 2.5f};
+  for (uint32_t select = 0; select < xe::countof(expected); ++select) {
+    info.sample_select = select;
+    REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(dest.data())));
+    REQUIRE(dest[0] == expected[select]);
+    REQUIRE(dest[8 * 4 - 1] == expected[select]);
+  }
+
+  // Depth is never averaged.
+  edram.ClearDepth(100, 8, MsaaSamples::k2X, 0, 0, 8, 4, 0x12345678);
+  info.is_depth = true;
+  info.edram_base = 100;
+  info.msaa_samples = MsaaSamples::k2X;
+  info.sample_select = 6;
+  info.dest_format = TextureFormat::k_24_8;
+  std::vector<uint32_t> depth(8 * 4);
+  REQUIRE(edram.Resolve(info, reinterpret_cast<uint8_t*>(depth.data())));
+  REQUIRE(depth[0] == 0x12345678);
+  REQUIRE(depth[8 * 4 - 1] == 0x12345678);
+}
+
+}  // namespace test
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,18 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+test_suite("xenia-gpu-tests", project_root, ".", {
+  includedirs = {
+    project_root.."/third_party/gflags/src",
+  },
+  links = {
+    "glslang-spirv",
+    "snappy",
+    "spirv-tools",
+    "xenia-base",
+    "xenia-gpu",
+    "xenia-gpu-sw",
+    "xenia-ui-spirv",
+    "xxhash",
+  },
+})
@@ -0,0 +1,177 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/sw/sw_rasterizer.h"
+
+#include <vector>
+
+#include "third_party/catch/include/catch.hpp"
+#include "xenia/gpu/edram.h"
+
+namespace xe {
+namespace gpu {
+namespace test {
+
+using sw::SwDrawCall;
+using sw::SwDrawState;
+using sw::SwInstruction;
+using sw::SwProgram;
+using sw::SwRasterizer;
+using sw::SwShaderContext;
+
+namespace {
+
+const uint32_t kSurfacePitch = 80;
+const uint32_t kSurfaceHeight = 32;
+
+// mova a0, r0.x
+// max oPos, c[a0], c[a0]
+// Each vertex takes its position from the float constant at its index.
+SwProgram MakePassthroughProgram() {
+  SwProgram program;
+  program.register_count = 1;
+
+  ParsedAluInstruction mova;
+  mova.type = ParsedAluInstruction::Type::kScalar;
+  mova.scalar_opcode = ucode::AluScalarOpcode::kMaxAs;
+  mova.operand_count = 2;
+  for (int i = 0; i < 2; ++i) {
+    mova.operands[i].storage_source = InstructionStorageSource::kRegister;
+    mova.operands[i].component_count = 1;
+  }
+  program.alu.push_back(mova);
+
+  ParsedAluInstruction max;
+  max.type = ParsedAluInstruction::Type::kVector;
+  max.vector_opcode = ucode::AluVectorOpcode::kMax;
+  max.operand_count = 2;
+  for (int i = 0; i < 2; ++i) {
+    max.operands[i].storage_source = InstructionStorageSource::kConstantFloat;
+    max.operands[i].storage_addressing_mode =
+        InstructionStorageAddressingMode::kAddressAbsolute;
+    max.operands[i].component_count = 4;
+  }
+  max.result.storage_target = InstructionStorageTarget::kPosition;
+  for (int i = 0; i < 4; ++i) {
+    max.result.write_mask[i] = true;
+  }
+  program.alu.push_back(max);
+
+  for (uint32_t i = 0; i < 2; ++i) {
+    SwInstruction instruction;
+    instruction.type = SwInstruction::Type::kAlu;
+    instruction.operation_index = i;
+    program.instructions.push_back(instruction);
+  }
+  program.instructions.push_back(SwInstruction());
+  return program;
+}
+
+// Draws one rectangle list primitive that only increments stencil, and
+// returns the stencil value of every pixel of the surface.
+std::vector<uint32_t> DrawRectangle(const float (&positions)[3][2],
+                                    bool cull_back = false) {
+  SwProgram program = MakePassthroughProgram();
+  std::vector<float> float_constants(512 * 4, 0.0f);
+  for (uint32_t i = 0; i < 3; ++i) {
+    float_constants[i * 4 + 0] = positions[i][0];
+    float_constants[i * 4 + 1] = positions[i][1];
+    float_constants[i * 4 + 2] = 0.5f;
+    float_constants[i * 4 + 3] = 1.0f;
+  }
+  std::vector<uint32_t> bool_constants(8, 0);
+  std::vector<uint32_t> loop_constants(32, 0);
+  std::vector<uint32_t> fetch_constants(32 * 6, 0);
+  SwShaderContext context;
+  context.float_constants = float_constants.data();
+  context.bool_constants = bool_constants.data();
+  context.loop_constants = loop_constants.data();
+  context.fetch_constants = fetch_constants.data();
+
+  SwDrawState state;
+  state.primitive_type = PrimitiveType::kRectangleList;
+  state.xy_divide = false;
+  state.z_divide = false;
+  for (int i = 0; i < 3; ++i) {
+    state.viewport_scale[i] = 1.0f;
+    state.viewport_offset[i] = 0.0f;
+  }
+  state.scissor_right = kSurfacePitch;
+  state.scissor_bottom = kSurfaceHeight;
+  state.cull_back = cull_back;
+  state.surface_pitch = kSurfacePitch;
+  state.depth_stencil_enable = true;
+  state.stencil_enable = true;
+  state.stencil_front.pass_op = 3;
+  state.stencil_back.pass_op = 3;
+
+  SwDrawCall call;
+  call.index_count = 3;
+  call.vertex_program = &program;
+  call.vertex_context = &context;
+
+  Edram edram;
+  SwRasterizer rasterizer(&edram);
+  rasterizer.Draw(state, call);
+
+  std::vector<uint32_t> stencil(kSurfacePitch * kSurfaceHeight);
+  for (uint32_t y = 0; y < kSurfaceHeight; ++y) {
+    for (uint32_t x = 0; x < kSurfacePitch; ++x) {
+      uint32_t offset = Edram::GetOffset(0, kSurfacePitch, MsaaSamples::k1X,
+                                         false, x, y);
+      stencil[y * kSurfacePitch + x] = edram.data()[offset] & 0xFF;
+    }
+  }
+  return stencil;
+}
+
+// Pixel centers at [8, 40) x [4, 20) are covered.
+const float kLeft = 8.0f, kTop = 4.0f, kRight = 40.0f, kBottom = 20.0f;
+const uint32_t kRectanglePixels = 32 * 16;
+
+// The corner with the right angle is first, second and third.
+const float kRectangles[3][3][2] = {
+    {{kLeft, kTop}, {kRight, kTop}, {kLeft, kBottom}},
+    {{kRight, kTop}, {kLeft, kTop}, {kLeft, kBottom}},
+    {{kRight, kTop}, {kLeft, kBottom}, {kLeft, kTop}},
+};
+
+}  // namespace
+
+TEST_CASE("SW rectangle list covers the rectangle once", "SW") {
+  for (const auto& positions : kRectangles) {
+    std::vector<uint32_t> stencil = DrawRectangle(positions);
+    uint32_t mismatches = 0;
+    for (uint32_t y = 0; y < kSurfaceHeight; ++y) {
+      for (uint32_t x = 0; x < kSurfacePitch; ++x) {
+        bool inside = x >= kLeft && x < kRight && y >= kTop && y < kBottom;
+        if (stencil[y * kSurfacePitch + x] != (inside ? 1u : 0u)) {
+          ++mismatches;
+        }
+      }
+    }
+    REQUIRE(mismatches == 0);
+  }
+}
+
+TEST_CASE("SW rectangle list halves share the winding", "SW") {
+  // Culling keeps or drops the whole rectangle, never one triangle.
+  for (const auto& positions : kRectangles) {
+    std::vector<uint32_t> stencil = DrawRectangle(positions, true);
+    uint32_t covered = 0;
+    for (uint32_t value : stencil) {
+      covered += value;
+    }
+    REQUIRE((covered == 0 || covered == kRectanglePixels));
+  }
+}
+
+}  // namespace test
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,188 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <gflags/gflags.h>
+
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/base/math.h"
+#include "xenia/base/worker_pool.h"
+#include "xenia/gpu/texture_conversion.h"
+#include "xenia/gpu/texture_info.h"
+
+DEFINE_int32(texture_bench_size, 1024,
+             "Width and height in texels of the synthetic textures.");
+DEFINE_int32(texture_bench_slices, 6,
+             "Number of slices used by the multi-slice (cube/3D) runs.");
+DEFINE_int32(texture_bench_iterations, 20,
+             "Number of times each conversion is repeated.");
+
+namespace xe {
+namespace gpu {
+
+using namespace xe::gpu::xenos;
+
+// CPU-only benchmark of the texture_conversion entry points used by texture
+// uploads. Inputs are random data, so only throughput is meaningful.
+class TextureBench {
+ public:
+  TextureBench() : pool_("Texture Bench") {}
+
+  void Run() {
+    XELOGI("Texture conversion benchmark: %dx%d, %d slices, %d iterations, "
+           "%u threads",
+           FLAGS_texture_bench_size, FLAGS_texture_bench_size,
+           FLAGS_texture_bench_slices, FLAGS_texture_bench_iterations,
+           pool_.concurrency());
+
+    const Endian endians[] = {Endian::kUnspecified, Endian::k8in16,
+                              Endian::k8in32, Endian::k16in32};
+    const char* endian_names[] = {"none", "8in16", "8in32", "16in32"};
+    for (size_t i = 0; i < xe::countof(endians); ++i) {
+      BenchCopySwapBlock(endians[i], endian_names[i]);
+    }
+
+    const TextureFormat formats[] = {
+        TextureFormat::k_8_8_8_8, TextureFormat::k_16_16_16_16,
+        TextureFormat::k_DXT1, TextureFormat::k_DXT4_5};
+    for (auto format : formats) {
+      BenchUntile(FormatInfo::Get(format), false);
+      BenchUntile(FormatInfo::Get(format), true);
+    }
+  }
+
+ private:
+  struct Surface {
+    const FormatInfo* format_info;
+    uint32_t block_width;
+    uint32_t block_height;
+    uint32_t block_pitch;
+    size_t slice_length;
+  };
+
+  Surface MakeSurface(const FormatInfo* format_info) {
+    Surface surface;
+    surface.format_info = format_info;
+    surface.block_width = xe::round_up(uint32_t(FLAGS_texture_bench_size),
+                                       format_info->block_width) /
+                          format_info->block_width;
+    surface.block_height = xe::round_up(uint32_t(FLAGS_texture_bench_size),
+                                        format_info->block_height) /
+                           format_info->block_height;
+    // Tiled surfaces are stored in 32x32 block tiles.
+    surface.block_pitch = xe::round_up(surface.block_width, 32u);
+    uint32_t block_pitch_v = xe::round_up(surface.block_height, 32u);
+    surface.slice_length =
+        size_t(surface.block_pitch) * block_pitch_v *
+        format_info->bytes_per_block();
+    return surface;
+  }
+
+  void FillRandom(std::vector<uint8_t>* data) {
+    std::mt19937 random(0x58454E49);
+    for (auto& value : *data) {
+      value = uint8_t(random());
+    }
+  }
+
+  // Runs fn iterations times and logs the throughput for bytes per run.
+  void Measure(const std::string& name, size_t bytes,
+               const std::function<void()>& fn) {
+    // Warm up caches and the page tables.
+    fn();
+    uint64_t start = Clock::QueryHostTickCount();
+    for (int i = 0; i < FLAGS_texture_bench_iterations; ++i) {
+      fn();
+    }
+    uint64_t ticks = Clock::QueryHostTickCount() - start;
+    double seconds = double(ticks) / double(Clock::host_tick_frequency());
+    double per_run_ms = seconds * 1000.0 / FLAGS_texture_bench_iterations;
+    double mb_per_second =
+        double(bytes) * FLAGS_texture_bench_iterations / seconds / 1.0e6;
+    XELOGI("  %-44s %9.3f ms %10.1f MB/s", name.c_str(), per_run_ms,
+           mb_per_second);
+  }
+
+  void BenchCopySwapBlock(Endian endian, const char* endian_name) {
+    auto surface = MakeSurface(FormatInfo::Get(TextureFormat::k_8_8_8_8));
+    std::vector<uint8_t> input(surface.slice_length);
+    std::vector<uint8_t> output(surface.slice_length);
+    FillRandom(&input);
+
+    uint32_t pitch = surface.block_pitch * 4;
+    Measure(std::string("CopySwapBlock linear ") + endian_name,
+            surface.slice_length, [&]() {
+              for (uint32_t y = 0; y < surface.block_height; ++y) {
+                texture_conversion::CopySwapBlock(
+                    endian, output.data() + y * pitch,
+                    input.data() + y * pitch, pitch);
+              }
+            });
+  }
+
+  void BenchUntile(const FormatInfo* format_info, bool sliced) {
+    auto surface = MakeSurface(format_info);
+    uint32_t slice_count = sliced ? uint32_t(FLAGS_texture_bench_slices) : 1;
+    std::vector<uint8_t> input(surface.slice_length * slice_count);
+    std::vector<uint8_t> output(surface.slice_length * slice_count);
+    FillRandom(&input);
+
+    texture_conversion::UntileInfo untile_info;
+    std::memset(&untile_info, 0, sizeof(untile_info));
+    untile_info.width = surface.block_width;
+    untile_info.height = surface.block_height;
+    untile_info.input_pitch = surface.block_pitch;
+    untile_info.output_pitch = surface.block_pitch;
+    untile_info.input_format_info = format_info;
+    untile_info.output_format_info = format_info;
+    untile_info.copy_callback = [](auto o, auto i, auto l) {
+      texture_conversion::CopySwapBlock(Endian::k8in32, o, i, l);
+    };
+    auto untile_slice = [&](size_t slice) {
+      size_t offset = slice * surface.slice_length;
+      texture_conversion::Untile(output.data() + offset, input.data() + offset,
+                                 &untile_info);
+    };
+
+    std::string name =
+        std::string("Untile ") + format_info->name +
+        (sliced ? " x" + std::to_string(slice_count) + " slices" : "");
+    size_t bytes = surface.slice_length * slice_count;
+    Measure(name + " serial", bytes, [&]() {
+      for (uint32_t slice = 0; slice < slice_count; ++slice) {
+        untile_slice(slice);
+      }
+    });
+    if (sliced) {
+      Measure(name + " parallel", bytes,
+              [&]() { pool_.ParallelFor(slice_count, untile_slice); });
+    }
+  }
+
+  xe::threading::WorkerPool pool_;
+};
+
+int texture_bench_main(const std::vector<std::wstring>& args) {
+  TextureBench bench;
+  bench.Run();
+  return 0;
+}
+
+}  // namespace gpu
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-gpu-texture-bench", L"xenia-gpu-texture-bench",
+                   xe::gpu::texture_bench_main);
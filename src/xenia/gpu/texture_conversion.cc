@@ -37,7 +37,7 @@ void CopySwapBlock(Endian endian, void* output, const void* input,
       xe::copy_and_swap_32_unaligned(output, input, length / 4);
       break;
     case Endian::k16in32:  // Swap high and low 16 bits within a 32 bit word
-      xe::copy_and_swap_16_in_32_unaligned(output, input, length);
+      xe::copy_and_swap_16_in_32_unaligned(output, input, length / 4);
       break;
     default:
     case Endian::kUnspecified:
@@ -151,6 +151,46 @@ void Untile(uint8_t* output_buffer, const uint8_t* input_buffer,
   }
 }
 
+void Tile(uint8_t* output_buffer, const uint8_t* input_buffer,
+          const UntileInfo* tile_info) {
+  SCOPE_profile_cpu_f("gpu");
+  assert_not_null(tile_info);
+  assert_not_null(tile_info->input_format_info);
+  assert_not_null(tile_info->output_format_info);
+
+  uint32_t input_bytes_per_block =
+      tile_info->input_format_info->bytes_per_block();
+  uint32_t output_bytes_per_block =
+      tile_info->output_format_info->bytes_per_block();
+  uint32_t input_pitch = tile_info->input_pitch * input_bytes_per_block;
+
+  auto log2_bpp =
+      (output_bytes_per_block / 4) +
+      ((output_bytes_per_block / 2) >> (output_bytes_per_block / 4));
+
+  uint32_t input_row_offset = 0;
+  for (uint32_t y = 0; y < tile_info->height; y++) {
+    auto output_row_offset = TiledOffset2DRow(
+        tile_info->offset_y + y, tile_info->output_pitch, log2_bpp);
+
+    uint32_t input_offset = input_row_offset;
+    for (uint32_t x = 0; x < tile_info->width; x++) {
+      auto output_offset =
+          TiledOffset2DColumn(tile_info->offset_x + x, tile_info->offset_y + y,
+                              log2_bpp, output_row_offset);
+      output_offset >>= log2_bpp;
+
+      tile_info->copy_callback(
+          &output_buffer[output_offset * output_bytes_per_block],
+          &input_buffer[input_offset], output_bytes_per_block);
+
+      input_offset += input_bytes_per_block;
+    }
+
+    input_row_offset += input_pitch;
+  }
+}
+
 }  //  namespace texture_conversion
 }  //  namespace gpu
 }  //  namespace xe
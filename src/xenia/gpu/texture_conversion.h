@@ -49,6 +49,12 @@ typedef struct UntileInfo {
 void Untile(uint8_t* output_buffer, const uint8_t* input_buffer,
             const UntileInfo* untile_info);
 
+// The inverse of Untile: copies a linear input_pitch-wide image into the tiled
+// output_pitch-wide layout at offset_x/offset_y of the output. The callback is
+// invoked with (tiled output, linear input, bytes per block).
+void Tile(uint8_t* output_buffer, const uint8_t* input_buffer,
+          const UntileInfo* tile_info);
+
 }  // namespace texture_conversion
 }  // namespace gpu
 }  // namespace xe
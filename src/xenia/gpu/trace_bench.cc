@@ -0,0 +1,281 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/trace_bench.h"
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/graphics_system.h"
+#include "xenia/gpu/packet_disassembler.h"
+#include "xenia/gpu/trace_protocol.h"
+#include "xenia/memory.h"
+
+DEFINE_string(target_trace_file, "", "Specifies the trace file to load.");
+DEFINE_int32(trace_bench_iterations, 1,
+             "Number of times to replay the trace. Statistics are reported "
+             "for all iterations combined.");
+
+namespace xe {
+namespace gpu {
+
+// TraceReader exposes the memory decompression only to subclasses.
+class TraceBench::Player : public TraceReader {
+ public:
+  explicit Player(GraphicsSystem* graphics_system)
+      : graphics_system_(graphics_system) {
+    // Need to allocate all of physical memory so that we can write to it
+    // during playback.
+    graphics_system_->memory()
+        ->LookupHeapByType(true, 4096)
+        ->AllocFixed(0, 0x1FFFFFFF, 4096,
+                     kMemoryAllocationReserve | kMemoryAllocationCommit,
+                     kMemoryProtectRead | kMemoryProtectWrite);
+  }
+
+  // Must be called on the command processor thread.
+  void Play(Stats* stats);
+
+ private:
+  GraphicsSystem* graphics_system_;
+};
+
+void TraceBench::Player::Play(Stats* stats) {
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
+
+  command_processor->set_swap_mode(SwapMode::kIgnored);
+
+  uint64_t start_ticks = Clock::QueryHostTickCount();
+  auto trace_ptr = trace_data_;
+  auto trace_end = trace_data_ + trace_size_;
+  const PacketStartCommand* pending_packet = nullptr;
+  while (trace_ptr < trace_end) {
+    auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
+    switch (type) {
+      case TraceCommandType::kPrimaryBufferStart: {
+        auto cmd =
+            reinterpret_cast<const PrimaryBufferStartCommand*>(trace_ptr);
+        trace_ptr += sizeof(*cmd) + cmd->count * 4;
+        break;
+      }
+      case TraceCommandType::kPrimaryBufferEnd: {
+        trace_ptr += sizeof(PrimaryBufferEndCommand);
+        break;
+      }
+      case TraceCommandType::kIndirectBufferStart: {
+        auto cmd =
+            reinterpret_cast<const IndirectBufferStartCommand*>(trace_ptr);
+        trace_ptr += sizeof(*cmd) + cmd->count * 4;
+        break;
+      }
+      case TraceCommandType::kIndirectBufferEnd: {
+        trace_ptr += sizeof(IndirectBufferEndCommand);
+        break;
+      }
+      case TraceCommandType::kPacketStart: {
+        auto cmd = reinterpret_cast<const PacketStartCommand*>(trace_ptr);
+        trace_ptr += sizeof(*cmd);
+        std::memcpy(memory->TranslatePhysical(cmd->base_ptr), trace_ptr,
+                    cmd->count * 4);
+        trace_ptr += cmd->count * 4;
+        pending_packet = cmd;
+        break;
+      }
+      case TraceCommandType::kPacketEnd: {
+        trace_ptr += sizeof(PacketEndCommand);
+        if (!pending_packet) {
+          break;
+        }
+
+        uint64_t packet_start = Clock::QueryHostTickCount();
+        command_processor->ExecutePacket(pending_packet->base_ptr,
+                                         pending_packet->count);
+        uint64_t packet_ticks = Clock::QueryHostTickCount() - packet_start;
+
+        // Classify after timing so disassembly isn't charged to the packet.
+        PacketInfo packet_info;
+        auto packet_data = reinterpret_cast<const uint8_t*>(pending_packet) +
+                           sizeof(PacketStartCommand);
+        const char* name = "UNKNOWN";
+        if (PacketDisassembler::DisasmPacket(packet_data, &packet_info)) {
+          name = packet_info.type_info->name;
+          switch (packet_info.type_info->category) {
+            case PacketCategory::kDraw:
+              ++stats->draw_count;
+              break;
+            case PacketCategory::kSwap:
+              ++stats->frame_count;
+              break;
+            default:
+              break;
+          }
+        }
+        auto& packet_stats = stats->packets[name];
+        packet_stats.name = name;
+        ++packet_stats.count;
+        packet_stats.ticks += packet_ticks;
+        ++stats->packet_count;
+        stats->packet_ticks += packet_ticks;
+        pending_packet = nullptr;
+        break;
+      }
+      case TraceCommandType::kMemoryRead: {
+        auto cmd = reinterpret_cast<const MemoryCommand*>(trace_ptr);
+        trace_ptr += sizeof(*cmd);
+        DecompressMemory(cmd->encoding_format, trace_ptr, cmd->encoded_length,
+                         memory->TranslatePhysical(cmd->base_ptr),
+                         cmd->decoded_length);
+        trace_ptr += cmd->encoded_length;
+        break;
+      }
+      case TraceCommandType::kMemoryWrite: {
+        auto cmd = reinterpret_cast<const MemoryCommand*>(trace_ptr);
+        trace_ptr += sizeof(*cmd) + cmd->encoded_length;
+        break;
+      }
+      case TraceCommandType::kEvent: {
+        trace_ptr += sizeof(EventCommand);
+        break;
+      }
+    }
+  }
+  stats->total_ticks += Clock::QueryHostTickCount() - start_ticks;
+
+  command_processor->set_swap_mode(SwapMode::kNormal);
+}
+
+TraceBench::TraceBench() = default;
+
+TraceBench::~TraceBench() = default;
+
+int TraceBench::Main(const std::vector<std::wstring>& args) {
+  // Grab path from the flag or unnamed argument.
+  std::wstring path;
+  if (!FLAGS_target_trace_file.empty()) {
+    path = xe::to_wstring(FLAGS_target_trace_file);
+  } else if (args.size() >= 2) {
+    path = args[1];
+  }
+
+  if (path.empty()) {
+    XELOGE("No trace file specified");
+    return 5;
+  }
+
+  // Normalize the path and make absolute.
+  auto abs_path = xe::to_absolute_path(path);
+  XELOGI("Loading trace file %ls...", abs_path.c_str());
+
+  if (!Setup()) {
+    XELOGE("Unable to setup trace bench tool");
+    return 4;
+  }
+  if (!Load(abs_path)) {
+    XELOGE("Unable to load trace file; not found?");
+    return 5;
+  }
+
+  return Run();
+}
+
+bool TraceBench::Setup() {
+  // No window: the graphics system must be able to run headless.
+  emulator_ = std::make_unique<Emulator>(L"");
+  X_STATUS result = emulator_->Setup(
+      nullptr, nullptr, [this]() { return CreateGraphicsSystem(); }, nullptr);
+  if (XFAILED(result)) {
+    XELOGE("Failed to setup emulator: %.8X", result);
+    return false;
+  }
+  graphics_system_ = emulator_->graphics_system();
+  player_ = std::make_unique<Player>(graphics_system_);
+  return true;
+}
+
+bool TraceBench::Load(const std::wstring& trace_file_path) {
+  if (!player_->Open(trace_file_path)) {
+    XELOGE("Could not load trace file");
+    return false;
+  }
+  return true;
+}
+
+int TraceBench::Run() {
+  auto command_processor = graphics_system_->command_processor();
+  auto done_event = xe::threading::Event::CreateAutoResetEvent(false);
+
+  Stats stats;
+  int iterations = std::max(1, FLAGS_trace_bench_iterations);
+  for (int i = 0; i < iterations; ++i) {
+    uint64_t previous_ticks = stats.total_ticks;
+    command_processor->CallInThread([&]() {
+      player_->Play(&stats);
+      done_event->Set();
+    });
+    xe::threading::Wait(done_event.get(), true);
+    XELOGI("Iteration %d: %.3f ms", i,
+           double(stats.total_ticks - previous_ticks) * 1000.0 /
+               double(Clock::host_tick_frequency()));
+  }
+
+  Report(stats);
+
+  player_.reset();
+  emulator_.reset();
+  return 0;
+}
+
+void TraceBench::Report(const Stats& stats) {
+  double frequency = double(Clock::host_tick_frequency());
+  double packet_seconds = double(stats.packet_ticks) / frequency;
+  double total_seconds = double(stats.total_ticks) / frequency;
+
+  XELOGI("Replayed %" PRIu64 " packets, %" PRIu64 " draws, %" PRIu64
+         " swaps in %.3f ms (%.3f ms executing packets)",
+         stats.packet_count, stats.draw_count, stats.frame_count,
+         total_seconds * 1000.0, packet_seconds * 1000.0);
+  if (packet_seconds > 0.0) {
+    XELOGI("  %.0f packets/sec, %.0f draws/sec",
+           double(stats.packet_count) / packet_seconds,
+           double(stats.draw_count) / packet_seconds);
+  }
+
+  // Most expensive packet types first.
+  std::vector<const PacketStats*> sorted;
+  sorted.reserve(stats.packets.size());
+  for (auto& it : stats.packets) {
+    sorted.push_back(&it.second);
+  }
+  std::sort(sorted.begin(), sorted.end(),
+            [](const PacketStats* a, const PacketStats* b) {
+              return a->ticks > b->ticks;
+            });
+
+  XELOGI("  %-28s %10s %12s %10s %6s", "packet", "count", "total (ms)",
+         "avg (us)", "%");
+  for (auto packet_stats : sorted) {
+    double seconds = double(packet_stats->ticks) / frequency;
+    XELOGI("  %-28s %10" PRIu64 " %12.3f %10.3f %6.2f", packet_stats->name,
+           packet_stats->count, seconds * 1000.0,
+           seconds * 1000000.0 / double(packet_stats->count),
+           packet_seconds > 0.0 ? seconds * 100.0 / packet_seconds : 0.0);
+  }
+}
+
+}  //  namespace gpu
+}  //  namespace xe
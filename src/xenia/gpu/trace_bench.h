@@ -0,0 +1,71 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_TRACE_BENCH_H_
+#define XENIA_GPU_TRACE_BENCH_H_
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/emulator.h"
+#include "xenia/gpu/trace_reader.h"
+
+namespace xe {
+namespace gpu {
+
+// Replays a trace as fast as possible with no presentation and reports how
+// long the command processor spent on each packet type. Backends provide the
+// graphics system; the null backend makes this a pure CPU benchmark.
+class TraceBench {
+ public:
+  virtual ~TraceBench();
+
+  int Main(const std::vector<std::wstring>& args);
+
+ protected:
+  TraceBench();
+
+  virtual std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() = 0;
+
+  std::unique_ptr<Emulator> emulator_;
+  GraphicsSystem* graphics_system_ = nullptr;
+
+ private:
+  struct PacketStats {
+    const char* name = nullptr;
+    uint64_t count = 0;
+    uint64_t ticks = 0;
+  };
+  struct Stats {
+    uint64_t packet_count = 0;
+    uint64_t draw_count = 0;
+    uint64_t frame_count = 0;
+    // Ticks spent inside ExecutePacket.
+    uint64_t packet_ticks = 0;
+    // Ticks spent replaying, including memory uploads.
+    uint64_t total_ticks = 0;
+    // Keyed by the static packet type name.
+    std::unordered_map<const char*, PacketStats> packets;
+  };
+  class Player;
+
+  bool Setup();
+  bool Load(const std::wstring& trace_file_path);
+  int Run();
+  void Report(const Stats& stats);
+
+  std::unique_ptr<Player> player_;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_TRACE_BENCH_H_
@@ -23,7 +23,7 @@ static const wchar_t kTraceExtension[] = L"xtr";
 // Other changes besides the file format may require bumps, such as
 // anything that changes what is recorded into the files (new GPU
 // command processor commands, etc).
-constexpr uint32_t kTraceFormatVersion = 1;
+constexpr uint32_t kTraceFormatVersion = 3;
 
 // Trace file header identifying information about the trace.
 // This must be positioned at the start of the file and must only occur once.
@@ -92,8 +92,25 @@ enum class MemoryEncodingFormat {
   kNone,
   // Data is compressed with third_party/snappy.
   kSnappy,
+  // Data is split into kTraceMemoryChunkSize blocks that are each compressed
+  // with third_party/snappy so they can be decompressed independently.
+  // The encoded data starts with a uint32_t compressed length per chunk.
+  kSnappyChunked,
+  // Data is identical to that of an earlier memory command.
+  // The encoded data is a MemoryReference.
+  kReference,
 };
 
+// Payload of a kReference memory command.
+struct MemoryReference {
+  // Byte offset from the start of the file of the MemoryCommand holding the
+  // data. That command is never itself a kReference.
+  uint64_t command_offset;
+};
+
+// Size of a decoded kSnappyChunked block. The last block may be smaller.
+constexpr uint32_t kTraceMemoryChunkSize = 256 * 1024;
+
 // Represents the GPU reading or writing data from or to memory.
 // Used for both TraceCommandType::kMemoryRead and kMemoryWrite.
 struct MemoryCommand {
@@ -121,6 +138,33 @@ struct EventCommand {
   Type event_type;
 };
 
+// Describes where a frame lives in the trace file.
+// A frame ends with the packet following a swap event, same as the reader
+// splits frames when parsing the command stream.
+struct TraceFrameIndexEntry {
+  // Byte offsets from the start of the file, end exclusive.
+  uint64_t start_offset;
+  uint64_t end_offset;
+  // Number of draw and swap packets in the frame.
+  uint32_t command_count;
+  uint32_t reserved;
+};
+
+constexpr uint32_t kTraceFooterMagic = 0x58455449;  // 'XETI'
+
+// Optional footer at the very end of the file, written when the trace is
+// closed cleanly. It points at an array of frame_count TraceFrameIndexEntry
+// that immediately follows the command stream, so readers can seek to any
+// frame without parsing the whole trace. Traces without a footer (for example
+// from a crashed capture) are still readable by parsing the stream.
+struct TraceFooter {
+  uint64_t frame_index_offset;
+  uint32_t frame_count;
+  // Must be the last 4 bytes of the file.
+  // Set to kTraceFooterMagic.
+  uint32_t magic;
+};
+
 }  // namespace gpu
 }  // namespace xe
 
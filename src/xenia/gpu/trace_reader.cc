@@ -9,13 +9,17 @@
 
 #include "xenia/gpu/trace_reader.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cinttypes>
+#include <thread>
 
 #include "third_party/snappy/snappy.h"
 
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/math.h"
+#include "xenia/base/threading.h"
 #include "xenia/gpu/packet_disassembler.h"
 #include "xenia/gpu/trace_protocol.h"
 #include "xenia/memory.h"
@@ -53,34 +57,99 @@ bool TraceReader::Open(const std::wstring& path) {
   XELOGI("    Commit: %s", commit_str.c_str());
   XELOGI("  Title ID: %u", header->title_id);
 
-  ParseTrace();
+  if (ReadFrameIndex()) {
+    XELOGI("    Frames: %d (indexed)", frame_count());
+  } else {
+    ParseTrace();
+  }
 
   return true;
 }
 
 void TraceReader::Close() {
+  frames_.clear();
   mmap_.reset();
   trace_data_ = nullptr;
   trace_size_ = 0;
 }
 
+const TraceReader::Frame* TraceReader::frame(int n) const {
+  auto frame = &frames_[n];
+  if (!frame->command_tree) {
+    ParseFrame(frame->start_ptr, frame->end_ptr, frame);
+  }
+  return frame;
+}
+
+bool TraceReader::ReadFrameIndex() {
+  if (trace_size_ < sizeof(TraceHeader) + sizeof(TraceFooter)) {
+    return false;
+  }
+  auto footer = reinterpret_cast<const TraceFooter*>(
+      trace_data_ + trace_size_ - sizeof(TraceFooter));
+  if (footer->magic != kTraceFooterMagic) {
+    return false;
+  }
+  uint64_t index_size =
+      uint64_t(footer->frame_count) * sizeof(TraceFrameIndexEntry);
+  if (footer->frame_index_offset < sizeof(TraceHeader) ||
+      footer->frame_index_offset + index_size + sizeof(TraceFooter) !=
+          trace_size_) {
+    XELOGW("Trace footer is corrupt; parsing the whole trace");
+    return false;
+  }
+
+  auto entries = reinterpret_cast<const TraceFrameIndexEntry*>(
+      trace_data_ + footer->frame_index_offset);
+  for (uint32_t i = 0; i < footer->frame_count; ++i) {
+    auto& entry = entries[i];
+    if (entry.start_offset > entry.end_offset ||
+        entry.end_offset > footer->frame_index_offset) {
+      XELOGW("Trace frame index is corrupt; parsing the whole trace");
+      frames_.clear();
+      return false;
+    }
+    Frame frame;
+    frame.start_ptr = trace_data_ + entry.start_offset;
+    frame.end_ptr = trace_data_ + entry.end_offset;
+    frame.commands.reserve(entry.command_count);
+    frames_.push_back(std::move(frame));
+  }
+
+  // Hide the index from anything walking the command stream.
+  trace_size_ = size_t(footer->frame_index_offset);
+  return true;
+}
+
 void TraceReader::ParseTrace() {
   // Skip file header.
   auto trace_ptr = trace_data_;
   trace_ptr += sizeof(TraceHeader);
 
-  Frame current_frame;
-  current_frame.start_ptr = trace_ptr;
+  auto trace_end = trace_data_ + trace_size_;
+  while (trace_ptr < trace_end) {
+    Frame frame;
+    trace_ptr = ParseFrame(trace_ptr, trace_end, &frame);
+    frames_.push_back(std::move(frame));
+  }
+}
+
+const uint8_t* TraceReader::ParseFrame(const uint8_t* trace_ptr,
+                                       const uint8_t* trace_end,
+                                       Frame* frame) const {
+  frame->start_ptr = trace_ptr;
+  frame->end_ptr = nullptr;
+  frame->command_count = 0;
+  frame->commands.clear();
   const PacketStartCommand* packet_start = nullptr;
   const uint8_t* packet_start_ptr = nullptr;
   const uint8_t* last_ptr = trace_ptr;
   bool pending_break = false;
   auto current_command_buffer = new CommandBuffer();
-  current_frame.command_tree =
-      std::unique_ptr<CommandBuffer>(current_command_buffer);
+  frame->command_tree = std::unique_ptr<CommandBuffer>(current_command_buffer);
 
-  while (trace_ptr < trace_data_ + trace_size_) {
-    ++current_frame.command_count;
+  while (trace_ptr < trace_end) {
+    ++frame->command_count;
     auto type = static_cast<TraceCommandType>(xe::load<uint32_t>(trace_ptr));
     switch (type) {
       case TraceCommandType::kPrimaryBufferStart: {
@@ -145,10 +214,10 @@ void TraceReader::ParseTrace() {
             command.head_ptr = packet_start_ptr;
             command.start_ptr = last_ptr;
             command.end_ptr = trace_ptr;
-            current_frame.commands.push_back(std::move(command));
+            frame->commands.push_back(std::move(command));
             last_ptr = trace_ptr;
             current_command_buffer->commands.push_back(CommandBuffer::Command(
-                uint32_t(current_frame.commands.size() - 1)));
+                uint32_t(frame->commands.size() - 1)));
             break;
           }
           case PacketCategory::kSwap: {
@@ -157,10 +226,10 @@ void TraceReader::ParseTrace() {
             command.head_ptr = packet_start_ptr;
             command.start_ptr = last_ptr;
             command.end_ptr = trace_ptr;
-            current_frame.commands.push_back(std::move(command));
+            frame->commands.push_back(std::move(command));
             last_ptr = trace_ptr;
             current_command_buffer->commands.push_back(CommandBuffer::Command(
-                uint32_t(current_frame.commands.size() - 1)));
+                uint32_t(frame->commands.size() - 1)));
           } break;
           case PacketCategory::kGeneric: {
             // Ignored.
@@ -168,15 +237,8 @@ void TraceReader::ParseTrace() {
           }
         }
         if (pending_break) {
-          current_frame.end_ptr = trace_ptr;
-          frames_.push_back(std::move(current_frame));
-          current_command_buffer = new CommandBuffer();
-          current_frame.command_tree =
-              std::unique_ptr<CommandBuffer>(current_command_buffer);
-          current_frame.start_ptr = trace_ptr;
-          current_frame.end_ptr = nullptr;
-          current_frame.command_count = 0;
-          pending_break = false;
+          frame->end_ptr = trace_ptr;
+          return trace_ptr;
         }
         break;
       }
@@ -207,10 +269,8 @@ void TraceReader::ParseTrace() {
         break;
     }
   }
-  if (pending_break || current_frame.command_count) {
-    current_frame.end_ptr = trace_ptr;
-    frames_.push_back(std::move(current_frame));
-  }
+  frame->end_ptr = trace_ptr;
+  return trace_ptr;
 }
 
 bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
@@ -224,11 +284,82 @@ bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
     case MemoryEncodingFormat::kSnappy:
       return snappy::RawUncompress(reinterpret_cast<const char*>(src), src_size,
                                    reinterpret_cast<char*>(dest));
+    case MemoryEncodingFormat::kSnappyChunked:
+      return DecompressChunkedMemory(src, src_size, dest, dest_size);
+    case MemoryEncodingFormat::kReference: {
+      // Decode the data from the memory command it points at.
+      assert_true(src_size == sizeof(MemoryReference));
+      auto reference = reinterpret_cast<const MemoryReference*>(src);
+      if (reference->command_offset + sizeof(MemoryCommand) > trace_size_) {
+        return false;
+      }
+      auto cmd = reinterpret_cast<const MemoryCommand*>(
+          trace_data_ + reference->command_offset);
+      if (cmd->encoding_format == MemoryEncodingFormat::kReference ||
+          cmd->decoded_length != dest_size) {
+        return false;
+      }
+      return DecompressMemory(cmd->encoding_format,
+                              reinterpret_cast<const uint8_t*>(cmd + 1),
+                              cmd->encoded_length, dest, dest_size);
+    }
     default:
       assert_unhandled_case(encoding_format);
       return false;
   }
 }
 
+bool TraceReader::DecompressChunkedMemory(const uint8_t* src, size_t src_size,
+                                          uint8_t* dest, size_t dest_size) {
+  size_t chunk_count =
+      (dest_size + kTraceMemoryChunkSize - 1) / kTraceMemoryChunkSize;
+  size_t lengths_size = chunk_count * sizeof(uint32_t);
+  if (src_size < lengths_size) {
+    return false;
+  }
+
+  // Resolve where each chunk starts up front so workers can run in any order.
+  auto chunk_lengths = reinterpret_cast<const uint32_t*>(src);
+  std::vector<size_t> chunk_offsets(chunk_count);
+  size_t offset = lengths_size;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    chunk_offsets[i] = offset;
+    offset += chunk_lengths[i];
+  }
+  if (offset != src_size) {
+    return false;
+  }
+
+  std::atomic<size_t> next_chunk(0);
+  std::atomic<bool> succeeded(true);
+  auto worker = [&]() {
+    size_t i;
+    while ((i = next_chunk.fetch_add(1)) < chunk_count) {
+      if (!snappy::RawUncompress(
+              reinterpret_cast<const char*>(src + chunk_offsets[i]),
+              chunk_lengths[i],
+              reinterpret_cast<char*>(dest + i * kTraceMemoryChunkSize))) {
+        succeeded = false;
+      }
+    }
+  };
+
+  // Small reads aren't worth waking up other threads for.
+  size_t thread_count =
+      std::min(size_t(xe::threading::logical_processor_count()), chunk_count);
+  std::vector<std::thread> threads;
+  if (thread_count > 1 && chunk_count >= 4) {
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+      threads.emplace_back(worker);
+    }
+  }
+  worker();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  return succeeded;
+}
+
 }  // namespace gpu
 }  // namespace xe
@@ -126,7 +126,8 @@ class TraceReader {
     return reinterpret_cast<const TraceHeader*>(trace_data_);
   }
 
-  const Frame* frame(int n) const { return &frames_[n]; }
+  // Frames found through the trace footer are parsed on first access.
+  const Frame* frame(int n) const;
   int frame_count() const { return int(frames_.size()); }
 
   bool Open(const std::wstring& path);
@@ -134,15 +135,23 @@ class TraceReader {
   void Close();
 
  protected:
+  bool ReadFrameIndex();
   void ParseTrace();
+  // Parses commands from trace_ptr until the end of the frame or trace_end.
+  // Returns the pointer just past the end of the frame.
+  const uint8_t* ParseFrame(const uint8_t* trace_ptr, const uint8_t* trace_end,
+                            Frame* frame) const;
   bool DecompressMemory(MemoryEncodingFormat encoding_format,
                         const uint8_t* src, size_t src_size, uint8_t* dest,
                         size_t dest_size);
+  bool DecompressChunkedMemory(const uint8_t* src, size_t src_size,
+                               uint8_t* dest, size_t dest_size);
 
   std::unique_ptr<MappedMemory> mmap_;
   const uint8_t* trace_data_ = nullptr;
+  // Size of the command stream, excluding the frame index and footer.
   size_t trace_size_ = 0;
-  std::vector<Frame> frames_;
+  mutable std::vector<Frame> frames_;
 };
 
 }  // namespace gpu
@@ -9,10 +9,12 @@
 
 #include "xenia/gpu/trace_writer.h"
 
+#include <algorithm>
+#include <cinttypes>
 #include <cstring>
 
-#include "third_party/snappy/snappy-sinksource.h"
 #include "third_party/snappy/snappy.h"
+#include "third_party/xxhash/xxhash.h"
 
 #include "build/version.h"
 #include "xenia/base/assert.h"
@@ -45,9 +47,18 @@ bool TraceWriter::Open(const std::wstring& path, uint32_t title_id) {
   std::memcpy(header.build_commit_sha, XE_BUILD_COMMIT,
               sizeof(header.build_commit_sha));
   header.title_id = title_id;
-  fwrite(&header, sizeof(header), 1, file_);
+  file_offset_ = 0;
+  Write(&header, sizeof(header));
 
   cached_memory_reads_.clear();
+  memory_blocks_.clear();
+  deduped_bytes_ = 0;
+  frame_index_.clear();
+  current_frame_ = {};
+  current_frame_.start_offset = file_offset_;
+  has_packet_start_ = false;
+  pending_frame_break_ = false;
+  skip_packet_end_ = false;
   return true;
 }
 
@@ -61,6 +72,15 @@ void TraceWriter::Close() {
   if (file_) {
     cached_memory_reads_.clear();
 
+    WriteFrameIndex();
+    if (deduped_bytes_) {
+      XELOGI("Trace deduplicated %" PRIu64 "b of memory across %zu blocks",
+             deduped_bytes_, memory_blocks_.size());
+    }
+    memory_blocks_.clear();
+    compression_buffer_.clear();
+    compression_buffer_.shrink_to_fit();
+
     fflush(file_);
     fclose(file_);
     file_ = nullptr;
@@ -76,7 +96,7 @@ void TraceWriter::WritePrimaryBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WritePrimaryBufferEnd() {
@@ -86,7 +106,7 @@ void TraceWriter::WritePrimaryBufferEnd() {
   PrimaryBufferEndCommand cmd = {
       TraceCommandType::kPrimaryBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
@@ -98,7 +118,7 @@ void TraceWriter::WriteIndirectBufferStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       0,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
 }
 
 void TraceWriter::WriteIndirectBufferEnd() {
@@ -108,7 +128,11 @@ void TraceWriter::WriteIndirectBufferEnd() {
   IndirectBufferEndCommand cmd = {
       TraceCommandType::kIndirectBufferEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
+
+  // The indirect buffer packet is wrapped in a kPacketStart/kPacketEnd and
+  // readers consume its end as part of this command.
+  skip_packet_end_ = true;
 }
 
 void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
@@ -120,8 +144,12 @@ void TraceWriter::WritePacketStart(uint32_t base_ptr, uint32_t count) {
       base_ptr,
       count,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
-  fwrite(membase_ + base_ptr, 4, count, file_);
+  Write(&cmd, sizeof(cmd));
+  Write(membase_ + base_ptr, count * 4);
+
+  has_packet_start_ = true;
+  packet_category_ =
+      PacketDisassembler::GetPacketCategory(membase_ + base_ptr);
 }
 
 void TraceWriter::WritePacketEnd() {
@@ -131,7 +159,21 @@ void TraceWriter::WritePacketEnd() {
   PacketEndCommand cmd = {
       TraceCommandType::kPacketEnd,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
+
+  if (skip_packet_end_) {
+    skip_packet_end_ = false;
+    return;
+  }
+  if (!has_packet_start_) {
+    return;
+  }
+  if (packet_category_ != PacketCategory::kGeneric) {
+    ++current_frame_.command_count;
+  }
+  if (pending_frame_break_) {
+    EndFrame();
+  }
 }
 
 void TraceWriter::WriteMemoryRead(uint32_t base_ptr, size_t length) {
@@ -173,17 +215,10 @@ void TraceWriter::WriteMemoryWrite(uint32_t base_ptr, size_t length) {
   WriteMemoryCommand(TraceCommandType::kMemoryWrite, base_ptr, length);
 }
 
-class SnappySink : public snappy::Sink {
- public:
-  SnappySink(FILE* file) : file_(file) {}
-
-  void Append(const char* bytes, size_t n) override {
-    fwrite(bytes, 1, n, file_);
-  }
-
- private:
-  FILE* file_ = nullptr;
-};
+void TraceWriter::Write(const void* data, size_t length) {
+  fwrite(data, 1, length, file_);
+  file_offset_ += length;
+}
 
 void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                                      size_t length) {
@@ -193,32 +228,74 @@ void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
   cmd.encoding_format = MemoryEncodingFormat::kNone;
   cmd.encoded_length = cmd.decoded_length = static_cast<uint32_t>(length);
 
+  auto src = reinterpret_cast<const char*>(membase_ + cmd.base_ptr);
+  if (length >= dedupe_threshold_) {
+    // Reference the earlier copy if we've already written this data.
+    uint64_t hash = XXH64(src, length, length);
+    auto it = memory_blocks_.find(hash);
+    if (it != memory_blocks_.end()) {
+      MemoryReference reference;
+      reference.command_offset = it->second;
+      cmd.encoding_format = MemoryEncodingFormat::kReference;
+      cmd.encoded_length = sizeof(reference);
+      Write(&cmd, sizeof(cmd));
+      Write(&reference, sizeof(reference));
+      deduped_bytes_ += length;
+      return;
+    }
+    memory_blocks_.insert({hash, file_offset_});
+  }
+
   bool compress = compress_output_ && length > compression_threshold_;
-  if (compress) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(membase_ + cmd.base_ptr),
-        cmd.decoded_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
-  } else {
+  if (!compress) {
     // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    fwrite(membase_ + cmd.base_ptr, 1, cmd.decoded_length, file_);
+    Write(&cmd, sizeof(cmd));
+    Write(src, cmd.decoded_length);
+    return;
+  }
+
+  if (length <= kTraceMemoryChunkSize) {
+    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
+    size_t max_size = snappy::MaxCompressedLength(length);
+    compression_buffer_.resize(std::max(compression_buffer_.size(), max_size));
+    size_t compressed_length = 0;
+    snappy::RawCompress(src, length,
+                        reinterpret_cast<char*>(compression_buffer_.data()),
+                        &compressed_length);
+    cmd.encoded_length = static_cast<uint32_t>(compressed_length);
+    Write(&cmd, sizeof(cmd));
+    Write(compression_buffer_.data(), compressed_length);
+    return;
+  }
+
+  // Large reads (mostly textures) are split so the reader can decompress the
+  // chunks in parallel. The chunk lengths go first, then the chunk data.
+  cmd.encoding_format = MemoryEncodingFormat::kSnappyChunked;
+  size_t chunk_count =
+      (length + kTraceMemoryChunkSize - 1) / kTraceMemoryChunkSize;
+  size_t lengths_size = chunk_count * sizeof(uint32_t);
+  size_t max_size =
+      lengths_size +
+      chunk_count * snappy::MaxCompressedLength(kTraceMemoryChunkSize);
+  compression_buffer_.resize(std::max(compression_buffer_.size(), max_size));
+
+  auto chunk_lengths = reinterpret_cast<uint32_t*>(compression_buffer_.data());
+  size_t encoded_length = lengths_size;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    size_t chunk_offset = i * kTraceMemoryChunkSize;
+    size_t chunk_length =
+        std::min(size_t(kTraceMemoryChunkSize), length - chunk_offset);
+    size_t compressed_length = 0;
+    snappy::RawCompress(
+        src + chunk_offset, chunk_length,
+        reinterpret_cast<char*>(compression_buffer_.data() + encoded_length),
+        &compressed_length);
+    chunk_lengths[i] = static_cast<uint32_t>(compressed_length);
+    encoded_length += compressed_length;
   }
+  cmd.encoded_length = static_cast<uint32_t>(encoded_length);
+  Write(&cmd, sizeof(cmd));
+  Write(compression_buffer_.data(), encoded_length);
 }
 
 void TraceWriter::WriteEvent(EventCommand::Type event_type) {
@@ -229,7 +306,37 @@ void TraceWriter::WriteEvent(EventCommand::Type event_type) {
       TraceCommandType::kEvent,
       event_type,
   };
-  fwrite(&cmd, 1, sizeof(cmd), file_);
+  Write(&cmd, sizeof(cmd));
+
+  if (event_type == EventCommand::Type::kSwap) {
+    // The frame ends with the next packet.
+    pending_frame_break_ = true;
+  }
+}
+
+void TraceWriter::EndFrame() {
+  current_frame_.end_offset = file_offset_;
+  frame_index_.push_back(current_frame_);
+  current_frame_ = {};
+  current_frame_.start_offset = file_offset_;
+  pending_frame_break_ = false;
+}
+
+void TraceWriter::WriteFrameIndex() {
+  if (file_offset_ > current_frame_.start_offset) {
+    EndFrame();
+  }
+
+  TraceFooter footer;
+  footer.frame_index_offset = file_offset_;
+  footer.frame_count = static_cast<uint32_t>(frame_index_.size());
+  footer.magic = kTraceFooterMagic;
+  if (!frame_index_.empty()) {
+    Write(frame_index_.data(),
+          frame_index_.size() * sizeof(TraceFrameIndexEntry));
+  }
+  Write(&footer, sizeof(footer));
+  frame_index_.clear();
 }
 
 }  //  namespace gpu
@@ -12,8 +12,11 @@
 
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "xenia/base/filesystem.h"
+#include "xenia/gpu/packet_disassembler.h"
 #include "xenia/gpu/trace_protocol.h"
 
 namespace xe {
@@ -43,12 +46,33 @@ class TraceWriter {
   void WriteEvent(EventCommand::Type event_type);
 
  private:
+  void Write(const void* data, size_t length);
   void WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                           size_t length);
+  void EndFrame();
+  void WriteFrameIndex();
 
   std::set<uint64_t> cached_memory_reads_;
   uint8_t* membase_;
   FILE* file_;
+  // Bytes written so far. Tracked manually as ftell is 32-bit on some hosts.
+  uint64_t file_offset_ = 0;
+
+  // Frame index written into the footer on Close.
+  std::vector<TraceFrameIndexEntry> frame_index_;
+  TraceFrameIndexEntry current_frame_ = {};
+  bool has_packet_start_ = false;
+  PacketCategory packet_category_ = PacketCategory::kGeneric;
+  bool pending_frame_break_ = false;
+  bool skip_packet_end_ = false;
+
+  std::vector<uint8_t> compression_buffer_;
+
+  // Memory command offsets keyed by XXH64 of their decoded data, so repeated
+  // payloads are written as references.
+  std::unordered_map<uint64_t, uint64_t> memory_blocks_;
+  size_t dedupe_threshold_ = 64;  // Min. number of bytes to dedupe.
+  uint64_t deduped_bytes_ = 0;
 
   bool compress_output_ = true;
   size_t compression_threshold_ = 1024;  // Min. number of bytes to compress.
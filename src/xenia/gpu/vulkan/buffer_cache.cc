@@ -9,6 +9,8 @@
 
 #include "xenia/gpu/vulkan/buffer_cache.h"
 
+#include <algorithm>
+
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
@@ -23,78 +25,30 @@ namespace xe {
 namespace gpu {
 namespace vulkan {
 
-#if XE_ARCH_AMD64
-void copy_cmp_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
-                                uint16_t cmp_value, size_t count) {
-  auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint16_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x0E, 0x0F, 0x0C, 0x0D, 0x0A, 0x0B, 0x08, 0x09, 0x06, 0x07,
-                   0x04, 0x05, 0x02, 0x03, 0x00, 0x01);
-  __m128i cmpval = _mm_set1_epi16(cmp_value);
-
-  size_t i;
-  for (i = 0; i + 8 <= count; i += 8) {
-    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-
-    __m128i mask = _mm_cmpeq_epi16(output, cmpval);
-    output = _mm_or_si128(output, mask);
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-  }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
-  }
-}
-
-void copy_cmp_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                uint32_t cmp_value, size_t count) {
-  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  __m128i shufmask =
-      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
-                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
-  __m128i cmpval = _mm_set1_epi32(cmp_value);
-
-  size_t i;
-  for (i = 0; i + 4 <= count; i += 4) {
-    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-    __m128i output = _mm_shuffle_epi8(input, shufmask);
-
-    __m128i mask = _mm_cmpeq_epi32(output, cmpval);
-    output = _mm_or_si128(output, mask);
-    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-  }
-  for (; i < count; ++i) {  // handle residual elements
-    dest[i] = byte_swap(src[i]);
-  }
-}
-#else
-void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
-                                uint16_t cmp_value, size_t count) {
-  auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint16_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    uint16_t value = byte_swap(src[i]);
-    dest[i] = value == cmp_value ? 0xFFFF : value;
-  }
-}
-
-void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                uint32_t cmp_value, size_t count) {
-  auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
-  auto src = reinterpret_cast<const uint32_t*>(src_ptr);
-  for (size_t i = 0; i < count; ++i) {
-    uint32_t value = byte_swap(src[i]);
-    dest[i] = value == cmp_value ? 0xFFFFFFFF : value;
-  }
-}
-#endif
-
 using xe::ui::vulkan::CheckResult;
 
 constexpr VkDeviceSize kConstantRegisterUniformRange =
     512 * 4 * 4 + 8 * 4 + 32 * 4;
+// Float, bool and loop constant registers copied by UploadConstantRegisters.
+constexpr uint32_t kConstantRegisterFirst = XE_GPU_REG_SHADER_CONSTANT_000_X;
+constexpr uint32_t kConstantRegisterCount =
+    XE_GPU_REG_SHADER_CONSTANT_LOOP_31 - XE_GPU_REG_SHADER_CONSTANT_000_X + 1;
+// Fetch constant registers hashed by PrepareVertexSet.
+constexpr uint32_t kFetchConstantRegisterFirst =
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0;
+constexpr uint32_t kFetchConstantRegisterCount =
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5 -
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + 1;
+
+// Guest buffers smaller than this are cheaper to upload again than to mirror.
+constexpr uint32_t kMinMirrorLength = 4096;
+// Mirrors are watched in 64 KiB blocks, the large page size guests usually
+// allocate physical memory with, which keeps the MMIO watch list short.
+constexpr uint32_t kMirrorWatchBlockSize = 64 * 1024;
+constexpr uint32_t kMirrorWatchBlockCount = 0x20000000 / kMirrorWatchBlockSize;
+constexpr uint32_t kMirrorBlockNeverConverted = UINT32_MAX;
+// Mirrors not drawn from for this many frames are freed.
+constexpr uint64_t kMirrorMaxIdleFrames = 120;
 
 BufferCache::BufferCache(RegisterFile* register_file, Memory* memory,
                          ui::vulkan::VulkanDevice* device, size_t capacity)
@@ -104,6 +58,7 @@ BufferCache::BufferCache(RegisterFile* register_file, Memory* memory,
       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
       capacity, 256);
+  mirror_watch_blocks_.reset(new MirrorWatchBlock[kMirrorWatchBlockCount]());
 }
 
 BufferCache::~BufferCache() { Shutdown(); }
@@ -305,6 +260,14 @@ void BufferCache::FreeConstantDescriptorSet() {
 }
 
 void BufferCache::Shutdown() {
+  ClearMirrors();
+  for (uint32_t i = 0; i < kMirrorWatchBlockCount; ++i) {
+    uintptr_t watch_handle = mirror_watch_blocks_[i].watch_handle.exchange(0);
+    if (watch_handle) {
+      memory_->CancelAccessWatch(watch_handle);
+    }
+  }
+
   if (mem_allocator_) {
     vmaDestroyAllocator(mem_allocator_);
     mem_allocator_ = nullptr;
@@ -328,11 +291,24 @@ std::pair<VkDeviceSize, VkDeviceSize> BufferCache::UploadConstantRegisters(
   //   uint bool[8];
   //   uint loop[32];
   // };
+  // If no constant changed since the last upload in this batch it can be
+  // bound again, which also lets the draws using it be batched together.
+  if (last_constant_offset_ != VK_WHOLE_SIZE &&
+      last_constant_fence_ == fence &&
+      !register_file_->IsRangeDirty(kConstantRegisterFirst,
+                                    kConstantRegisterCount,
+                                    last_constant_serial_)) {
+    return {last_constant_offset_, last_constant_offset_};
+  }
+
   auto offset = AllocateTransientData(kConstantRegisterUniformRange, fence);
   if (offset == VK_WHOLE_SIZE) {
     // OOM.
     return {VK_WHOLE_SIZE, VK_WHOLE_SIZE};
   }
+  last_constant_offset_ = offset;
+  last_constant_fence_ = fence;
+  last_constant_serial_ = register_file_->dirty_serial();
 
   // Copy over all the registers.
   const auto& values = register_file_->values;
@@ -421,6 +397,38 @@ std::pair<VkDeviceSize, VkDeviceSize> BufferCache::UploadConstantRegisters(
 std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadIndexBuffer(
     VkCommandBuffer command_buffer, uint32_t source_addr,
     uint32_t source_length, IndexFormat format, VkFence fence) {
+  uint32_t prim_reset_index =
+      register_file_->values[XE_GPU_REG_VGT_MULTI_PRIM_IB_RESET_INDX].u32;
+  bool prim_reset_enabled =
+      !!(register_file_->values[XE_GPU_REG_PA_SU_SC_MODE_CNTL].u32 & (1 << 21));
+
+  // If primitive reset is enabled, translate any primitive reset indices to
+  // something Vulkan understands.
+  uint64_t format_key;
+  if (format == IndexFormat::kInt16) {
+    // Endian::k8in16, swap half-words.
+    format_key = prim_reset_enabled
+                     ? MakeFormatKey(GuestDataSwap::k8in16Restart,
+                                     static_cast<uint16_t>(prim_reset_index))
+                     : MakeFormatKey(GuestDataSwap::k8in16);
+  } else {
+    // Endian::k8in32, swap words.
+    format_key = prim_reset_enabled
+                     ? MakeFormatKey(GuestDataSwap::k8in32Restart,
+                                     prim_reset_index)
+                     : MakeFormatKey(GuestDataSwap::k8in32);
+  }
+
+  if (FLAGS_vulkan_mirror_guest_buffers) {
+    auto buffer_ref = UploadMirroredData(
+        command_buffer, source_addr, source_length, format_key,
+        format == IndexFormat::kInt16 ? 2 : 4, VK_ACCESS_INDEX_READ_BIT,
+        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, fence);
+    if (buffer_ref.second != VK_WHOLE_SIZE) {
+      return buffer_ref;
+    }
+  }
+
   // Allocate space in the buffer for our data.
   auto offset = AllocateTransientData(source_length, fence);
   if (offset == VK_WHOLE_SIZE) {
@@ -430,37 +438,10 @@ std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadIndexBuffer(
 
   const void* source_ptr = memory_->TranslatePhysical(source_addr);
 
-  uint32_t prim_reset_index =
-      register_file_->values[XE_GPU_REG_VGT_MULTI_PRIM_IB_RESET_INDX].u32;
-  bool prim_reset_enabled =
-      !!(register_file_->values[XE_GPU_REG_PA_SU_SC_MODE_CNTL].u32 & (1 << 21));
-
-  // Copy data into the buffer. If primitive reset is enabled, translate any
-  // primitive reset indices to something Vulkan understands.
+  // Copy data into the buffer.
   // TODO(benvanik): memcpy then use compute shaders to swap?
-  if (prim_reset_enabled) {
-    if (format == IndexFormat::kInt16) {
-      // Endian::k8in16, swap half-words.
-      copy_cmp_swap_16_unaligned(
-          transient_buffer_->host_base() + offset, source_ptr,
-          static_cast<uint16_t>(prim_reset_index), source_length / 2);
-    } else if (format == IndexFormat::kInt32) {
-      // Endian::k8in32, swap words.
-      copy_cmp_swap_32_unaligned(transient_buffer_->host_base() + offset,
-                                 source_ptr, prim_reset_index,
-                                 source_length / 4);
-    }
-  } else {
-    if (format == IndexFormat::kInt16) {
-      // Endian::k8in16, swap half-words.
-      xe::copy_and_swap_16_unaligned(transient_buffer_->host_base() + offset,
-                                     source_ptr, source_length / 2);
-    } else if (format == IndexFormat::kInt32) {
-      // Endian::k8in32, swap words.
-      xe::copy_and_swap_32_unaligned(transient_buffer_->host_base() + offset,
-                                     source_ptr, source_length / 4);
-    }
-  }
+  CopyGuestData(transient_buffer_->host_base() + offset, source_ptr,
+                source_length, format_key);
 
   transient_buffer_->Flush(offset, source_length);
 
@@ -486,6 +467,34 @@ std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadIndexBuffer(
 std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadVertexBuffer(
     VkCommandBuffer command_buffer, uint32_t source_addr,
     uint32_t source_length, Endian endian, VkFence fence) {
+  uint64_t format_key;
+  switch (endian) {
+    case Endian::k8in16:
+      format_key = MakeFormatKey(GuestDataSwap::k8in16);
+      break;
+    case Endian::k8in32:
+      format_key = MakeFormatKey(GuestDataSwap::k8in32);
+      break;
+    case Endian::k16in32:
+      format_key = MakeFormatKey(GuestDataSwap::k16in32);
+      break;
+    default:
+      format_key = MakeFormatKey(GuestDataSwap::kNone);
+      break;
+  }
+
+  if (FLAGS_vulkan_mirror_guest_buffers) {
+    // Bound as a storage buffer, so the offset must be aligned accordingly.
+    auto& limits = device_->device_info().properties.limits;
+    auto buffer_ref = UploadMirroredData(
+        command_buffer, source_addr, source_length, format_key,
+        limits.minStorageBufferOffsetAlignment, VK_ACCESS_SHADER_READ_BIT,
+        VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, fence);
+    if (buffer_ref.second != VK_WHOLE_SIZE) {
+      return buffer_ref;
+    }
+  }
+
   auto offset = FindCachedTransientData(source_addr, source_length);
   if (offset != VK_WHOLE_SIZE) {
     return {transient_buffer_->gpu_buffer(), offset};
@@ -518,16 +527,8 @@ std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadVertexBuffer(
 
   // Copy data into the buffer.
   // TODO(benvanik): memcpy then use compute shaders to swap?
-  if (endian == Endian::k8in32) {
-    // Endian::k8in32, swap words.
-    xe::copy_and_swap_32_unaligned(transient_buffer_->host_base() + offset,
-                                   upload_ptr, source_length / 4);
-  } else if (endian == Endian::k16in32) {
-    xe::copy_and_swap_16_in_32_unaligned(
-        transient_buffer_->host_base() + offset, upload_ptr, source_length / 4);
-  } else {
-    assert_always();
-  }
+  CopyGuestData(transient_buffer_->host_base() + offset, upload_ptr,
+                source_length, format_key);
 
   transient_buffer_->Flush(offset, upload_size);
 
@@ -584,6 +585,15 @@ void BufferCache::HashVertexBindings(
 VkDescriptorSet BufferCache::PrepareVertexSet(
     VkCommandBuffer command_buffer, VkFence fence,
     const std::vector<Shader::VertexBinding>& vertex_bindings) {
+  // The same bindings with none of the fetch constants written since the
+  // previous call would hash the same, so skip hashing them again.
+  if (last_vertex_set_ && &vertex_bindings == last_vertex_bindings_ &&
+      !register_file_->IsRangeDirty(kFetchConstantRegisterFirst,
+                                    kFetchConstantRegisterCount,
+                                    last_vertex_set_serial_)) {
+    return last_vertex_set_;
+  }
+
   // (quickly) Generate a hash.
   XXH64_state_t hash_state;
   XXH64_reset(&hash_state, 0);
@@ -593,6 +603,9 @@ VkDescriptorSet BufferCache::PrepareVertexSet(
   uint64_t hash = XXH64_digest(&hash_state);
   for (auto it = vertex_sets_.find(hash); it != vertex_sets_.end(); ++it) {
     // TODO(DrChat): We need to compare the bindings and ensure they're equal.
+    last_vertex_bindings_ = &vertex_bindings;
+    last_vertex_set_serial_ = register_file_->dirty_serial();
+    last_vertex_set_ = it->second;
     return it->second;
   }
 
@@ -673,6 +686,9 @@ VkDescriptorSet BufferCache::PrepareVertexSet(
 
   vkUpdateDescriptorSets(*device_, 1, &descriptor_write, 0, nullptr);
   vertex_sets_[hash] = set;
+  last_vertex_bindings_ = &vertex_bindings;
+  last_vertex_set_serial_ = register_file_->dirty_serial();
+  last_vertex_set_ = set;
   return set;
 }
 
@@ -743,6 +759,231 @@ void BufferCache::CacheTransientData(uint32_t guest_address,
   }
 }
 
+uint64_t BufferCache::MakeFormatKey(GuestDataSwap swap,
+                                   uint32_t prim_reset_index) {
+  return (uint64_t(swap) << 32) | prim_reset_index;
+}
+
+void BufferCache::CopyGuestData(void* dest, const void* source,
+                                uint32_t length, uint64_t format_key) {
+  uint32_t prim_reset_index = uint32_t(format_key);
+  switch (GuestDataSwap(format_key >> 32)) {
+    case GuestDataSwap::kNone:
+      std::memcpy(dest, source, length);
+      break;
+    case GuestDataSwap::k8in16:
+      xe::copy_and_swap_16_unaligned(dest, source, length / 2);
+      break;
+    case GuestDataSwap::k8in32:
+      xe::copy_and_swap_32_unaligned(dest, source, length / 4);
+      break;
+    case GuestDataSwap::k16in32:
+      xe::copy_and_swap_16_in_32_unaligned(dest, source, length / 4);
+      break;
+    case GuestDataSwap::k8in16Restart:
+      xe::copy_cmp_swap_16_unaligned(dest, source,
+                                     static_cast<uint16_t>(prim_reset_index),
+                                     length / 2);
+      break;
+    case GuestDataSwap::k8in32Restart:
+      xe::copy_cmp_swap_32_unaligned(dest, source, prim_reset_index,
+                                     length / 4);
+      break;
+  }
+}
+
+std::pair<VkBuffer, VkDeviceSize> BufferCache::UploadMirroredData(
+    VkCommandBuffer command_buffer, uint32_t source_addr,
+    uint32_t source_length, uint64_t format_key, VkDeviceSize offset_alignment,
+    VkAccessFlags dst_access_mask, VkPipelineStageFlags dst_stage_mask,
+    VkFence fence) {
+  source_addr &= 0x1FFFFFFF;
+  // Watch blocks are split on element boundaries only if the data is
+  // aligned to the largest element size.
+  if (source_length < kMinMirrorLength || (source_addr & 3) ||
+      uint64_t(source_addr) + source_length > 0x20000000) {
+    return {nullptr, VK_WHOLE_SIZE};
+  }
+
+  auto& mirrors = mirrors_[format_key];
+  GuestBufferMirror* mirror = nullptr;
+  auto it = mirrors.upper_bound(source_addr);
+  if (it != mirrors.begin()) {
+    auto candidate = std::prev(it)->second;
+    if (candidate->guest_address + candidate->guest_length >=
+            source_addr + source_length &&
+        (source_addr - candidate->guest_address) % offset_alignment == 0) {
+      mirror = candidate;
+    }
+  }
+
+  if (!mirror) {
+    mirror = CreateMirror(source_addr, source_length, format_key);
+    if (!mirror) {
+      return {nullptr, VK_WHOLE_SIZE};
+    }
+    // A mirror at the same address is too short, replace it once the GPU is
+    // done with it.
+    auto& slot = mirrors[source_addr];
+    if (slot) {
+      retired_mirrors_.push_back(slot);
+    }
+    slot = mirror;
+  }
+
+  if (!RefreshMirror(command_buffer, mirror, dst_access_mask,
+                     dst_stage_mask)) {
+    return {nullptr, VK_WHOLE_SIZE};
+  }
+
+  mirror->in_flight_fence = fence;
+  mirror->last_used_frame = frame_count_;
+  return {mirror->buffer, source_addr - mirror->guest_address};
+}
+
+BufferCache::GuestBufferMirror* BufferCache::CreateMirror(
+    uint32_t guest_address, uint32_t guest_length, uint64_t format_key) {
+  VkBufferCreateInfo buffer_info;
+  buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  buffer_info.pNext = nullptr;
+  buffer_info.flags = 0;
+  buffer_info.size = guest_length;
+  buffer_info.usage =
+      VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+  buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  buffer_info.queueFamilyIndexCount = 0;
+  buffer_info.pQueueFamilyIndices = nullptr;
+
+  // Converted on the host straight into the mapping, like transient data.
+  VmaAllocationCreateInfo alloc_create_info = {};
+  alloc_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+  alloc_create_info.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+  alloc_create_info.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+  auto mirror = new GuestBufferMirror();
+  VkResult status =
+      vmaCreateBuffer(mem_allocator_, &buffer_info, &alloc_create_info,
+                      &mirror->buffer, &mirror->alloc, &mirror->alloc_info);
+  if (status != VK_SUCCESS) {
+    XELOGW("Failed to allocate a %u byte guest buffer mirror", guest_length);
+    delete mirror;
+    return nullptr;
+  }
+
+  mirror->guest_address = guest_address;
+  mirror->guest_length = guest_length;
+  mirror->format_key = format_key;
+  uint32_t first_block = guest_address / kMirrorWatchBlockSize;
+  uint32_t last_block = (guest_address + guest_length - 1) /
+                        kMirrorWatchBlockSize;
+  mirror->block_generations.resize(last_block - first_block + 1,
+                                   kMirrorBlockNeverConverted);
+  mirror->in_flight_fence = nullptr;
+  mirror->last_used_frame = frame_count_;
+  return mirror;
+}
+
+bool BufferCache::RefreshMirror(VkCommandBuffer command_buffer,
+                                GuestBufferMirror* mirror,
+                                VkAccessFlags dst_access_mask,
+                                VkPipelineStageFlags dst_stage_mask) {
+  uint32_t guest_end = mirror->guest_address + mirror->guest_length;
+  uint32_t first_block = mirror->guest_address / kMirrorWatchBlockSize;
+  uint32_t dirty_start = guest_end;
+  uint32_t dirty_end = mirror->guest_address;
+  for (size_t i = 0; i < mirror->block_generations.size(); ++i) {
+    uint32_t block_index = first_block + uint32_t(i);
+    if (mirror->block_generations[i] ==
+        mirror_watch_blocks_[block_index].generation.load()) {
+      continue;
+    }
+
+    if (dirty_start == guest_end && mirror->in_flight_fence &&
+        vkGetFenceStatus(*device_, mirror->in_flight_fence) != VK_SUCCESS) {
+      // Earlier draws in the batch may still read the old contents.
+      return false;
+    }
+
+    // Watch before reading so writes during the conversion are not lost.
+    uint32_t generation = ArmMirrorWatch(block_index);
+    uint32_t block_start =
+        std::max(block_index * kMirrorWatchBlockSize, mirror->guest_address);
+    uint32_t block_end =
+        std::min((block_index + 1) * kMirrorWatchBlockSize, guest_end);
+    CopyGuestData(static_cast<uint8_t*>(mirror->alloc_info.pMappedData) +
+                      (block_start - mirror->guest_address),
+                  memory_->TranslatePhysical(block_start),
+                  block_end - block_start, mirror->format_key);
+    mirror->block_generations[i] = generation;
+    dirty_start = std::min(dirty_start, block_start);
+    dirty_end = std::max(dirty_end, block_end);
+  }
+
+  if (dirty_start < dirty_end) {
+    // Append a barrier to the command buffer.
+    VkBufferMemoryBarrier barrier = {
+        VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+        nullptr,
+        VK_ACCESS_HOST_WRITE_BIT,
+        dst_access_mask,
+        VK_QUEUE_FAMILY_IGNORED,
+        VK_QUEUE_FAMILY_IGNORED,
+        mirror->buffer,
+        dirty_start - mirror->guest_address,
+        dirty_end - dirty_start,
+    };
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_HOST_BIT,
+                         dst_stage_mask, 0, 0, nullptr, 1, &barrier, 0,
+                         nullptr);
+  }
+  return true;
+}
+
+uint32_t BufferCache::ArmMirrorWatch(uint32_t block_index) {
+  auto& block = mirror_watch_blocks_[block_index];
+  uint32_t generation = block.generation.load();
+  if (block.watch_handle.load()) {
+    return generation;
+  }
+
+  uintptr_t watch_handle = memory_->AddPhysicalAccessWatch(
+      block_index * kMirrorWatchBlockSize, kMirrorWatchBlockSize,
+      cpu::MMIOHandler::kWatchWrite, &MirrorWatchCallback, this, &block);
+  block.watch_handle.store(watch_handle);
+  if (block.generation.load() != generation) {
+    // Fired before the handle was stored, so the watch is already gone.
+    block.watch_handle.compare_exchange_strong(watch_handle, 0);
+  }
+  return generation;
+}
+
+void BufferCache::MirrorWatchCallback(void* context_ptr, void* data_ptr,
+                                      uint32_t address) {
+  auto block = reinterpret_cast<MirrorWatchBlock*>(data_ptr);
+  // Bump the generation before dropping the handle, see ArmMirrorWatch.
+  block->generation.fetch_add(1);
+  block->watch_handle.store(0);
+}
+
+void BufferCache::FreeMirror(GuestBufferMirror* mirror) {
+  vmaDestroyBuffer(mem_allocator_, mirror->buffer, mirror->alloc);
+  delete mirror;
+}
+
+void BufferCache::ClearMirrors() {
+  for (auto& format_mirrors : mirrors_) {
+    for (auto& it : format_mirrors.second) {
+      FreeMirror(it.second);
+    }
+  }
+  mirrors_.clear();
+  for (auto mirror : retired_mirrors_) {
+    FreeMirror(mirror);
+  }
+  retired_mirrors_.clear();
+}
+
 void BufferCache::Flush(VkCommandBuffer command_buffer) {
   // If we are flushing a big enough chunk queue up an event.
   // We don't want to do this for everything but often enough so that we won't
@@ -766,21 +1007,48 @@ void BufferCache::Flush(VkCommandBuffer command_buffer) {
 
 void BufferCache::InvalidateCache() {
   // Called by VulkanCommandProcessor::MakeCoherent()
-  // Discard everything?
+  // Discard everything? Mirrors are kept, write watches track them.
   transient_cache_.clear();
 }
 
-void BufferCache::ClearCache() { transient_cache_.clear(); }
+void BufferCache::ClearCache() {
+  transient_cache_.clear();
+  last_constant_offset_ = VK_WHOLE_SIZE;
+  last_vertex_set_ = nullptr;
+  ClearMirrors();
+}
 
 void BufferCache::Scavenge() {
   SCOPE_profile_cpu_f("gpu");
 
   transient_cache_.clear();
+  last_constant_offset_ = VK_WHOLE_SIZE;
   transient_buffer_->Scavenge();
 
+  // The frame's batch has completed, so no mirror is in flight anymore.
+  for (auto mirror : retired_mirrors_) {
+    FreeMirror(mirror);
+  }
+  retired_mirrors_.clear();
+  for (auto& format_mirrors : mirrors_) {
+    auto& mirrors = format_mirrors.second;
+    for (auto it = mirrors.begin(); it != mirrors.end();) {
+      auto mirror = it->second;
+      if (frame_count_ - mirror->last_used_frame > kMirrorMaxIdleFrames) {
+        FreeMirror(mirror);
+        it = mirrors.erase(it);
+        continue;
+      }
+      mirror->in_flight_fence = nullptr;
+      ++it;
+    }
+  }
+  ++frame_count_;
+
   // TODO(DrChat): These could persist across frames, we just need a smart way
   // to delete unused ones.
   vertex_sets_.clear();
+  last_vertex_set_ = nullptr;
   if (vertex_descriptor_pool_->has_open_batch()) {
     vertex_descriptor_pool_->EndBatch();
   }
@@ -22,8 +22,11 @@
 #include "third_party/vulkan/vk_mem_alloc.h"
 #include "third_party/xxhash/xxhash.h"
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace xe {
 namespace gpu {
@@ -65,7 +68,8 @@ class BufferCache {
   // The registers are tightly packed in order as [floats, ints, bools].
   // Returns an offset that can be used with the transient_descriptor_set or
   // VK_WHOLE_SIZE if the constants could not be uploaded (OOM).
-  // The returned offsets may alias.
+  // The returned offsets may alias. While no constant register changes the
+  // previous upload of the same batch is returned again.
   std::pair<VkDeviceSize, VkDeviceSize> UploadConstantRegisters(
       VkCommandBuffer command_buffer,
       const Shader::ConstantRegisterMap& vertex_constant_register_map,
@@ -120,6 +124,44 @@ class BufferCache {
     VmaAllocationInfo alloc_info;
   };
 
+  // Byte swaps applied when copying guest vertex and index data. Combined
+  // with the primitive restart index into a format key, see MakeFormatKey.
+  enum class GuestDataSwap : uint32_t {
+    kNone,
+    k8in16,
+    k8in32,
+    k16in32,
+    k8in16Restart,
+    k8in32Restart,
+  };
+
+  // Persistent host copy of a guest memory range used as vertex or index
+  // data, already converted to the host format. Mirrors live across frames
+  // and only the watch blocks the guest wrote to are converted again.
+  struct GuestBufferMirror {
+    uint32_t guest_address;
+    uint32_t guest_length;
+    uint64_t format_key;
+
+    VkBuffer buffer;
+    VmaAllocation alloc;
+    VmaAllocationInfo alloc_info;
+
+    // Generation of each overlapped watch block when it was last converted.
+    std::vector<uint32_t> block_generations;
+    // Fence of the last batch that read the mirror.
+    VkFence in_flight_fence;
+    uint64_t last_used_frame;
+  };
+
+  // Write watch over one kMirrorWatchBlockSize block of guest physical
+  // memory, shared by all mirrors overlapping it. The generation is bumped
+  // from the guest thread whenever the watch fires.
+  struct MirrorWatchBlock {
+    std::atomic<uint32_t> generation;
+    std::atomic<uintptr_t> watch_handle;
+  };
+
   VkResult CreateVertexDescriptorPool();
   void FreeVertexDescriptorPool();
 
@@ -145,6 +187,38 @@ class BufferCache {
   void CacheTransientData(uint32_t guest_address, uint32_t guest_length,
                           VkDeviceSize offset);
 
+  static uint64_t MakeFormatKey(GuestDataSwap swap,
+                                uint32_t prim_reset_index = 0);
+  // Copies length bytes of guest data, converting them as the format key
+  // describes.
+  static void CopyGuestData(void* dest, const void* source, uint32_t length,
+                            uint64_t format_key);
+
+  // Returns a mirror containing the given guest range at an offset aligned
+  // to offset_alignment, refreshing any blocks written since its last use.
+  // Size will be VK_WHOLE_SIZE if the data should go through the transient
+  // buffer instead: the range is too small to mirror, or a stale mirror is
+  // still being read by the GPU.
+  std::pair<VkBuffer, VkDeviceSize> UploadMirroredData(
+      VkCommandBuffer command_buffer, uint32_t source_addr,
+      uint32_t source_length, uint64_t format_key,
+      VkDeviceSize offset_alignment, VkAccessFlags dst_access_mask,
+      VkPipelineStageFlags dst_stage_mask, VkFence fence);
+  GuestBufferMirror* CreateMirror(uint32_t guest_address,
+                                  uint32_t guest_length, uint64_t format_key);
+  // Converts the stale blocks of the mirror again. Returns false if it is
+  // stale but cannot be written because the GPU may still be reading it.
+  bool RefreshMirror(VkCommandBuffer command_buffer, GuestBufferMirror* mirror,
+                     VkAccessFlags dst_access_mask,
+                     VkPipelineStageFlags dst_stage_mask);
+  // Ensures the block is watched and returns its generation from before the
+  // watch was placed.
+  uint32_t ArmMirrorWatch(uint32_t block_index);
+  void FreeMirror(GuestBufferMirror* mirror);
+  void ClearMirrors();
+  static void MirrorWatchCallback(void* context_ptr, void* data_ptr,
+                                  uint32_t address);
+
   RegisterFile* register_file_ = nullptr;
   Memory* memory_ = nullptr;
   ui::vulkan::VulkanDevice* device_ = nullptr;
@@ -156,6 +230,20 @@ class BufferCache {
   // plan on keeping past the current frame.
   std::unique_ptr<ui::vulkan::CircularBuffer> transient_buffer_ = nullptr;
   std::map<uint32_t, std::pair<uint32_t, VkDeviceSize>> transient_cache_;
+  // Last constant register upload, reused until a constant register changes
+  // or the batch it was made for ends.
+  VkDeviceSize last_constant_offset_ = VK_WHOLE_SIZE;
+  VkFence last_constant_fence_ = nullptr;
+  uint64_t last_constant_serial_ = 0;
+
+  // Guest buffer mirrors by format key, then by guest address.
+  std::unordered_map<uint64_t, std::map<uint32_t, GuestBufferMirror*>>
+      mirrors_;
+  // Mirrors replaced during the frame, freed once its batch completes.
+  std::vector<GuestBufferMirror*> retired_mirrors_;
+  // One entry per kMirrorWatchBlockSize block of physical memory.
+  std::unique_ptr<MirrorWatchBlock[]> mirror_watch_blocks_;
+  uint64_t frame_count_ = 0;
 
   // Vertex buffer descriptors
   std::unique_ptr<ui::vulkan::DescriptorPool> vertex_descriptor_pool_ = nullptr;
@@ -163,6 +251,11 @@ class BufferCache {
 
   // Current frame vertex sets.
   std::unordered_map<uint64_t, VkDescriptorSet> vertex_sets_;
+  // Set returned by the last PrepareVertexSet, the bindings it was for and
+  // the register file dirty serial at that time.
+  const std::vector<Shader::VertexBinding>* last_vertex_bindings_ = nullptr;
+  uint64_t last_vertex_set_serial_ = 0;
+  VkDescriptorSet last_vertex_set_ = nullptr;
 
   // Descriptor set used to hold vertex/pixel shader float constants
   VkDescriptorPool constant_descriptor_pool_ = nullptr;
@@ -26,6 +26,12 @@ namespace vulkan {
 
 using xe::ui::vulkan::CheckResult;
 
+// All registers read by the pipeline and dynamic state updates live in the
+// context block between RB_SURFACE_INFO and the polygon offset registers.
+const uint32_t kStateRegisterFirst = XE_GPU_REG_RB_SURFACE_INFO;
+const uint32_t kStateRegisterCount =
+    XE_GPU_REG_PA_SU_POLY_OFFSET_BACK_OFFSET - XE_GPU_REG_RB_SURFACE_INFO + 1;
+
 // Generated with `xenia-build genspirv`.
 #include "xenia/gpu/vulkan/shaders/bin/dummy_frag.h"
 #include "xenia/gpu/vulkan/shaders/bin/line_quad_list_geom.h"
@@ -236,6 +242,18 @@ PipelineCache::UpdateStatus PipelineCache::ConfigurePipeline(
 
   assert_not_null(pipeline_out);
 
+  // If none of the state registers changed since the last full pass and the
+  // shaders and topology match, the previous pipeline is still valid.
+  auto& stage_regs = update_shader_stages_regs_;
+  if (current_pipeline_ && stage_regs.vertex_shader == vertex_shader &&
+      stage_regs.pixel_shader == pixel_shader &&
+      stage_regs.primitive_type == primitive_type &&
+      !register_file_->IsRangeDirty(kStateRegisterFirst, kStateRegisterCount,
+                                    update_state_serial_)) {
+    *pipeline_out = current_pipeline_;
+    return UpdateStatus::kCompatible;
+  }
+
   // Perform a pass over all registers and state updating our cached structures.
   // This will tell us if anything has changed that requires us to either build
   // a new pipeline or use an existing one.
@@ -256,8 +274,10 @@ PipelineCache::UpdateStatus PipelineCache::ConfigurePipeline(
       // Error updating state - bail out.
       // We are in an indeterminate state, so reset things for the next attempt.
       current_pipeline_ = nullptr;
+      update_state_serial_ = 0;
       return update_status;
   }
+  update_state_serial_ = register_file_->dirty_serial();
   if (!pipeline) {
     // Should have a hash key produced by the UpdateState pass.
     uint64_t hash_key = XXH64_digest(&hash_state_);
@@ -265,6 +285,7 @@ PipelineCache::UpdateStatus PipelineCache::ConfigurePipeline(
     current_pipeline_ = pipeline;
     if (!pipeline) {
       // Unable to create pipeline.
+      update_state_serial_ = 0;
       return UpdateStatus::kError;
     }
   }
@@ -280,6 +301,9 @@ void PipelineCache::ClearCache() {
   }
   cached_pipelines_.clear();
   COUNT_profile_set("gpu/pipeline_cache/pipelines", 0);
+  current_pipeline_ = nullptr;
+  update_state_serial_ = 0;
+  dynamic_state_serial_ = 0;
 
   // Destroy all shaders.
   for (auto it : shader_map_) {
@@ -573,6 +597,14 @@ bool PipelineCache::SetDynamicState(VkCommandBuffer command_buffer,
   SCOPE_profile_cpu_f("gpu");
 #endif  // FINE_GRAINED_DRAW_SCOPES
 
+  // Nothing to do if no state registers changed since the last call.
+  if (!full_update &&
+      !register_file_->IsRangeDirty(kStateRegisterFirst, kStateRegisterCount,
+                                    dynamic_state_serial_)) {
+    return true;
+  }
+  dynamic_state_serial_ = register_file_->dirty_serial();
+
   auto& regs = set_dynamic_state_registers_;
 
   bool window_offset_dirty = SetShadowRegister(&regs.pa_sc_window_offset,
@@ -931,6 +963,11 @@ bool PipelineCache::SetDynamicState(VkCommandBuffer command_buffer,
   return true;
 }
 
+bool PipelineCache::IsDynamicStateDirty() const {
+  return register_file_->IsRangeDirty(kStateRegisterFirst, kStateRegisterCount,
+                                      dynamic_state_serial_);
+}
+
 bool PipelineCache::SetShadowRegister(uint32_t* dest, uint32_t register_name) {
   uint32_t value = register_file_->values[register_name].u32;
   if (*dest == value) {
@@ -67,6 +67,9 @@ class PipelineCache {
   // Only state that has changed since the last call will be set unless
   // full_update is true.
   bool SetDynamicState(VkCommandBuffer command_buffer, bool full_update);
+  // Returns whether SetDynamicState without a full update may record any
+  // commands, that is whether a state register changed since its last call.
+  bool IsDynamicStateDirty() const;
 
   // Pipeline layout shared by all pipelines.
   VkPipelineLayout pipeline_layout() const { return pipeline_layout_; }
@@ -128,6 +131,12 @@ class PipelineCache {
   // and allows us to quickly(ish) reuse the pipeline if no registers have
   // changed.
   VkPipeline current_pipeline_ = nullptr;
+  // Register file dirty serial at the time of the last full UpdateState pass.
+  // If no render state register changed since then the previous pipeline is
+  // reused without re-reading or re-hashing the registers.
+  uint64_t update_state_serial_ = 0;
+  // Register file dirty serial at the time of the last SetDynamicState.
+  uint64_t dynamic_state_serial_ = 0;
 
  private:
   UpdateStatus UpdateState(VulkanShader* vertex_shader,
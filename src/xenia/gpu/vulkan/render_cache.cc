@@ -28,6 +28,11 @@ using xe::ui::vulkan::CheckResult;
 
 constexpr uint32_t kEdramBufferCapacity = 10 * 1024 * 1024;
 
+// Range of registers shadowed in ShadowRegisters.
+constexpr uint32_t kShadowRegisterFirst = XE_GPU_REG_RB_SURFACE_INFO;
+constexpr uint32_t kShadowRegisterCount =
+    XE_GPU_REG_RB_MODECONTROL - XE_GPU_REG_RB_SURFACE_INFO + 1;
+
 ColorRenderTargetFormat GetBaseRTFormat(ColorRenderTargetFormat format) {
   switch (format) {
     case ColorRenderTargetFormat::k_8_8_8_8_GAMMA:
@@ -645,6 +650,11 @@ bool RenderCache::dirty() const {
   auto& regs = *register_file_;
   auto& cur_regs = shadow_registers_;
 
+  if (!regs.IsRangeDirty(kShadowRegisterFirst, kShadowRegisterCount,
+                         shadow_registers_serial_)) {
+    return false;
+  }
+
   bool dirty = false;
   dirty |= cur_regs.rb_modecontrol.value != regs[XE_GPU_REG_RB_MODECONTROL].u32;
   dirty |=
@@ -677,24 +687,28 @@ const RenderState* RenderCache::BeginRenderPass(VkCommandBuffer command_buffer,
   CachedFramebuffer* framebuffer = nullptr;
   auto& regs = shadow_registers_;
   bool dirty = false;
-  dirty |=
-      SetShadowRegister(&regs.rb_modecontrol.value, XE_GPU_REG_RB_MODECONTROL);
-  dirty |= SetShadowRegister(&regs.rb_surface_info.value,
-                             XE_GPU_REG_RB_SURFACE_INFO);
-  dirty |=
-      SetShadowRegister(&regs.rb_color_info.value, XE_GPU_REG_RB_COLOR_INFO);
-  dirty |=
-      SetShadowRegister(&regs.rb_color1_info.value, XE_GPU_REG_RB_COLOR1_INFO);
-  dirty |=
-      SetShadowRegister(&regs.rb_color2_info.value, XE_GPU_REG_RB_COLOR2_INFO);
-  dirty |=
-      SetShadowRegister(&regs.rb_color3_info.value, XE_GPU_REG_RB_COLOR3_INFO);
-  dirty |=
-      SetShadowRegister(&regs.rb_depth_info.value, XE_GPU_REG_RB_DEPTH_INFO);
-  dirty |= SetShadowRegister(&regs.pa_sc_window_scissor_tl,
-                             XE_GPU_REG_PA_SC_WINDOW_SCISSOR_TL);
-  dirty |= SetShadowRegister(&regs.pa_sc_window_scissor_br,
-                             XE_GPU_REG_PA_SC_WINDOW_SCISSOR_BR);
+  if (register_file_->IsRangeDirty(kShadowRegisterFirst, kShadowRegisterCount,
+                                   shadow_registers_serial_)) {
+    dirty |= SetShadowRegister(&regs.rb_modecontrol.value,
+                               XE_GPU_REG_RB_MODECONTROL);
+    dirty |= SetShadowRegister(&regs.rb_surface_info.value,
+                               XE_GPU_REG_RB_SURFACE_INFO);
+    dirty |=
+        SetShadowRegister(&regs.rb_color_info.value, XE_GPU_REG_RB_COLOR_INFO);
+    dirty |= SetShadowRegister(&regs.rb_color1_info.value,
+                               XE_GPU_REG_RB_COLOR1_INFO);
+    dirty |= SetShadowRegister(&regs.rb_color2_info.value,
+                               XE_GPU_REG_RB_COLOR2_INFO);
+    dirty |= SetShadowRegister(&regs.rb_color3_info.value,
+                               XE_GPU_REG_RB_COLOR3_INFO);
+    dirty |=
+        SetShadowRegister(&regs.rb_depth_info.value, XE_GPU_REG_RB_DEPTH_INFO);
+    dirty |= SetShadowRegister(&regs.pa_sc_window_scissor_tl,
+                               XE_GPU_REG_PA_SC_WINDOW_SCISSOR_TL);
+    dirty |= SetShadowRegister(&regs.pa_sc_window_scissor_br,
+                               XE_GPU_REG_PA_SC_WINDOW_SCISSOR_BR);
+    shadow_registers_serial_ = register_file_->dirty_serial();
+  }
   if (!dirty && current_state_.render_pass) {
     // No registers have changed so we can reuse the previous render pass -
     // just begin with what we had.
@@ -386,6 +386,8 @@ class RenderCache {
     ShadowRegisters() { Reset(); }
     void Reset() { std::memset(this, 0, sizeof(*this)); }
   } shadow_registers_;
+  // Register file dirty serial when the shadow registers were last synced.
+  uint64_t shadow_registers_serial_ = 0;
   bool SetShadowRegister(uint32_t* dest, uint32_t register_name);
 
   // Configuration used for the current/previous Begin/End, representing the
@@ -10,6 +10,8 @@
 #include "xenia/gpu/vulkan/texture_cache.h"
 #include "xenia/gpu/vulkan/texture_config.h"
 
+#include <algorithm>
+
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
@@ -33,7 +35,21 @@ namespace vulkan {
 using xe::ui::vulkan::CheckResult;
 
 constexpr uint32_t kMaxTextureSamplers = 32;
+// Texture descriptor sets allocated from each descriptor pool.
+constexpr uint32_t kTextureSetsPerPool = 1024;
+// Texture descriptor sets unused for this many frames are recycled.
+constexpr uint64_t kTextureSetMaxIdleFrames = 60;
+// Fetch constant registers hashed by PrepareTextureSet.
+constexpr uint32_t kFetchConstantRegisterFirst =
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0;
+constexpr uint32_t kFetchConstantRegisterCount =
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5 -
+    XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + 1;
 constexpr VkDeviceSize kStagingBufferSize = 64 * 1024 * 1024;
+// Uploads at least this large are converted on the worker pool.
+constexpr size_t kParallelConversionThreshold = 256 * 1024;
+// Evicted textures remembered for the reupload statistics.
+constexpr size_t kMaxEvictedTextureHashes = 4096;
 
 const char* get_dimension_name(Dimension dimension) {
   static const char* names[] = {
@@ -59,21 +75,15 @@ TextureCache::TextureCache(Memory* memory, RegisterFile* register_file,
       staging_buffer_(device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
                       kStagingBufferSize),
       wb_staging_buffer_(device, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                         kStagingBufferSize) {}
+                         kStagingBufferSize),
+      conversion_pool_(std::make_unique<xe::threading::WorkerPool>(
+          "Texture Conversion")) {}
 
 TextureCache::~TextureCache() { Shutdown(); }
 
 VkResult TextureCache::Initialize() {
   VkResult status = VK_SUCCESS;
 
-  // Descriptor pool used for all of our cached descriptors.
-  VkDescriptorPoolSize pool_sizes[1];
-  pool_sizes[0].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-  pool_sizes[0].descriptorCount = 32768;
-  descriptor_pool_ = std::make_unique<ui::vulkan::DescriptorPool>(
-      *device_, 32768,
-      std::vector<VkDescriptorPoolSize>(pool_sizes, std::end(pool_sizes)));
-
   wb_command_pool_ = std::make_unique<ui::vulkan::CommandBufferPool>(
       *device_, device_->queue_family_index());
 
@@ -159,6 +169,14 @@ void TextureCache::Shutdown() {
   ClearCache();
   Scavenge();
 
+  // Destroying the pools frees every texture descriptor set.
+  for (auto pool : texture_set_pools_) {
+    vkDestroyDescriptorPool(*device_, pool, nullptr);
+  }
+  texture_set_pools_.clear();
+  free_texture_sets_.clear();
+  retired_texture_sets_.clear();
+
   if (mem_allocator_ != nullptr) {
     vmaDestroyAllocator(mem_allocator_);
     mem_allocator_ = nullptr;
@@ -292,6 +310,32 @@ TextureCache::Texture* TextureCache::AllocateTexture(
   texture->usage_flags = image_info.usage;
   texture->access_watch_handle = 0;
   texture->texture_info = texture_info;
+  texture->last_used_frame = frame_count_;
+  texture->image_owner = nullptr;
+  texture->image_ref_count = 1;
+  texture->image_resident_count = 0;
+  texture->content_hash = 0;
+  return texture;
+}
+
+TextureCache::Texture* TextureCache::AliasTexture(
+    Texture* owner, const TextureInfo& texture_info) {
+  auto texture = new Texture();
+  texture->format = owner->format;
+  texture->image = owner->image;
+  texture->image_layout = owner->image_layout;
+  texture->alloc = owner->alloc;
+  texture->alloc_info = owner->alloc_info;
+  texture->framebuffer = nullptr;
+  texture->usage_flags = owner->usage_flags;
+  texture->access_watch_handle = 0;
+  texture->texture_info = texture_info;
+  texture->last_used_frame = frame_count_;
+  texture->image_owner = owner;
+  texture->image_ref_count = 0;
+  texture->image_resident_count = 0;
+  texture->content_hash = 0;
+  ++owner->image_ref_count;
   return texture;
 }
 
@@ -318,8 +362,18 @@ bool TextureCache::FreeTexture(Texture* texture) {
     texture->access_watch_handle = 0;
   }
 
-  vmaDestroyImage(mem_allocator_, texture->image, texture->alloc);
-  delete texture;
+  // The owner of a shared image is kept until every alias is gone.
+  Texture* owner = texture->image_owner ? texture->image_owner : texture;
+  bool image_unused = --owner->image_ref_count == 0;
+  if (image_unused) {
+    vmaDestroyImage(mem_allocator_, owner->image, owner->alloc);
+  }
+  if (texture != owner) {
+    delete texture;
+  }
+  if (image_unused) {
+    delete owner;
+  }
   return true;
 }
 
@@ -355,6 +409,24 @@ TextureCache::Texture* TextureCache::DemandResolveTexture(
         break;
       }
 
+      auto texture = it->second;
+      if (texture->image_owner || texture->image_ref_count > 1) {
+        // Rendering into a shared image would change every texture using it,
+        // so drop this one and give the resolve an image of its own.
+        texture->pending_invalidation = true;
+        if (texture->access_watch_handle) {
+          memory_->CancelAccessWatch(texture->access_watch_handle);
+          texture->access_watch_handle = 0;
+        }
+        textures_.erase(it);
+        RemoveTextureContent(texture);
+        RemoveResidentTexture(texture);
+        pending_delete_textures_.push_back(texture);
+        break;
+      }
+
+      it->second->last_used_frame = frame_count_;
+
       // Tell the trace writer to "cache" this memory (but not read it)
       if (texture_info.memory.base_address) {
         trace_writer_->WriteMemoryReadCached(texture_info.memory.base_address,
@@ -384,6 +456,7 @@ TextureCache::Texture* TextureCache::DemandResolveTexture(
     XELOGE("Vulkan Texture Cache: Failed to allocate texture!");
     return nullptr;
   }
+  texture->is_resolve_target = true;
 
   // Setup a debug name for the texture.
   device_->DbgSetObjectName(
@@ -407,7 +480,8 @@ TextureCache::Texture* TextureCache::DemandResolveTexture(
   }
 
   textures_[texture_hash] = texture;
-  COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+  AddResidentTexture(texture);
+  UpdateResidencyCounters();
   return texture;
 }
 
@@ -424,6 +498,7 @@ TextureCache::Texture* TextureCache::Demand(const TextureInfo& texture_info,
         break;
       }
 
+      it->second->last_used_frame = frame_count_;
       if (texture_info.memory.base_address) {
         trace_writer_->WriteMemoryReadCached(texture_info.memory.base_address,
                                              texture_info.memory.base_size);
@@ -442,26 +517,6 @@ TextureCache::Texture* TextureCache::Demand(const TextureInfo& texture_info,
     return nullptr;
   }
 
-  // Create a new texture and cache it.
-  auto texture = AllocateTexture(texture_info);
-  if (!texture) {
-    // Failed to allocate texture (out of memory)
-    XELOGE("Vulkan Texture Cache: Failed to allocate texture!");
-    return nullptr;
-  }
-
-  // Though we didn't find an exact match, that doesn't mean we're out of the
-  // woods yet. This texture could either be a portion of another texture or
-  // vice versa. Copy any overlapping textures into this texture.
-  // TODO: Byte count -> pixel count (on x and y axes)
-  VkOffset2D offset;
-  auto collide_tex = LookupAddress(
-      texture_info.memory.base_address, texture_info.width + 1,
-      texture_info.height + 1, texture_info.format_info()->format, &offset);
-  if (collide_tex != nullptr) {
-    // assert_always();
-  }
-
   if (texture_info.memory.base_address) {
     trace_writer_->WriteMemoryReadCached(texture_info.memory.base_address,
                                          texture_info.memory.base_size);
@@ -471,23 +526,74 @@ TextureCache::Texture* TextureCache::Demand(const TextureInfo& texture_info,
                                          texture_info.memory.mip_size);
   }
 
-  if (!UploadTexture(command_buffer, completion_fence, texture, texture_info)) {
-    FreeTexture(texture);
-    return nullptr;
+  // The same data may already be uploaded from another address, such as an
+  // earlier slot of a streaming pool. Share its image instead of converting.
+  Texture* texture = nullptr;
+  uint64_t content_hash = 0;
+  if (FLAGS_vulkan_texture_dedup) {
+    content_hash = HashTextureContents(texture_info);
+    ++statistics_.dedup_lookups;
+    auto content_it = content_textures_.find(content_hash);
+    if (content_it != content_textures_.end() &&
+        GetContentLayout(content_it->second->texture_info) ==
+            GetContentLayout(texture_info)) {
+      texture = AliasTexture(content_it->second, texture_info);
+      ++statistics_.dedup_hits;
+      statistics_.dedup_bytes +=
+          texture_info.memory.base_size + texture_info.memory.mip_size;
+    }
   }
 
-  // Setup a debug name for the texture.
-  device_->DbgSetObjectName(
-      reinterpret_cast<uint64_t>(texture->image),
-      VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
-      xe::format_string(
-          "T: 0x%.8X - 0x%.8X (%s, %s)", texture_info.memory.base_address,
-          texture_info.memory.base_address + texture_info.memory.base_size,
-          texture_info.format_info()->name,
-          get_dimension_name(texture_info.dimension)));
+  if (!texture) {
+    // Create a new texture and cache it.
+    texture = AllocateTexture(texture_info);
+    if (!texture) {
+      // Failed to allocate texture (out of memory)
+      XELOGE("Vulkan Texture Cache: Failed to allocate texture!");
+      return nullptr;
+    }
+
+    // Though we didn't find an exact match, that doesn't mean we're out of
+    // the woods yet. This texture could either be a portion of another
+    // texture or vice versa. Copy any overlapping textures into this texture.
+    // TODO: Byte count -> pixel count (on x and y axes)
+    VkOffset2D offset;
+    auto collide_tex = LookupAddress(
+        texture_info.memory.base_address, texture_info.width + 1,
+        texture_info.height + 1, texture_info.format_info()->format, &offset);
+    if (collide_tex != nullptr) {
+      // assert_always();
+    }
+
+    if (!UploadTexture(command_buffer, completion_fence, texture,
+                       texture_info)) {
+      FreeTexture(texture);
+      return nullptr;
+    }
+    ++statistics_.uploaded_textures;
+    if (evicted_texture_hashes_.erase(texture_hash)) {
+      ++statistics_.reuploaded_textures;
+    }
+
+    if (content_hash) {
+      texture->content_hash = content_hash;
+      content_textures_[content_hash] = texture;
+    }
+
+    // Setup a debug name for the texture.
+    device_->DbgSetObjectName(
+        reinterpret_cast<uint64_t>(texture->image),
+        VK_DEBUG_REPORT_OBJECT_TYPE_IMAGE_EXT,
+        xe::format_string(
+            "T: 0x%.8X - 0x%.8X (%s, %s)", texture_info.memory.base_address,
+            texture_info.memory.base_address + texture_info.memory.base_size,
+            texture_info.format_info()->name,
+            get_dimension_name(texture_info.dimension)));
+  }
 
   textures_[texture_hash] = texture;
-  COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+  AddResidentTexture(texture);
+  UpdateResidencyCounters();
 
   // Okay. Put a writewatch on it to tell us if it's been modified from the
   // guest.
@@ -504,6 +610,61 @@ TextureCache::Texture* TextureCache::Demand(const TextureInfo& texture_info,
   return texture;
 }
 
+uint64_t TextureCache::HashTextureContents(const TextureInfo& texture_info) {
+  XXH64_state_t hash_state;
+  XXH64_reset(&hash_state, 0);
+  TextureInfo layout = GetContentLayout(texture_info);
+  XXH64_update(&hash_state, &layout, sizeof(layout));
+  HashGuestRange(&hash_state, texture_info.memory.base_address,
+                 texture_info.memory.base_size);
+  HashGuestRange(&hash_state, texture_info.memory.mip_address,
+                 texture_info.memory.mip_size);
+  // Zero marks textures without a content hash.
+  uint64_t hash = XXH64_digest(&hash_state);
+  return hash ? hash : 1;
+}
+
+void TextureCache::HashGuestRange(XXH64_state_t* hash_state, uint32_t address,
+                                  uint32_t length) {
+  // Ranges up to this size are hashed in full; larger ones are sampled in
+  // evenly spaced chunks plus the end, which is far cheaper than converting.
+  const uint32_t kFullHashLength = 1024 * 1024;
+  const uint32_t kSampleCount = 64;
+  const uint32_t kSampleLength = 4096;
+
+  if (!address || !length) {
+    return;
+  }
+  auto data = memory_->TranslatePhysical<const uint8_t*>(address);
+  if (length <= kFullHashLength) {
+    XXH64_update(hash_state, data, length);
+    return;
+  }
+  uint32_t stride = length / kSampleCount;
+  for (uint32_t i = 0; i < kSampleCount; ++i) {
+    XXH64_update(hash_state, data + i * stride, kSampleLength);
+  }
+  XXH64_update(hash_state, data + length - kSampleLength, kSampleLength);
+}
+
+TextureInfo TextureCache::GetContentLayout(const TextureInfo& texture_info) {
+  TextureInfo layout = texture_info;
+  layout.memory.base_address = layout.memory.base_address ? 1 : 0;
+  layout.memory.mip_address = layout.memory.mip_address ? 1 : 0;
+  return layout;
+}
+
+void TextureCache::RemoveTextureContent(Texture* texture) {
+  if (!texture->content_hash) {
+    return;
+  }
+  auto it = content_textures_.find(texture->content_hash);
+  if (it != content_textures_.end() && it->second == texture) {
+    content_textures_.erase(it);
+  }
+  texture->content_hash = 0;
+}
+
 TextureCache::TextureView* TextureCache::DemandView(Texture* texture,
                                                     uint16_t swizzle) {
   for (auto it = texture->views.begin(); it != texture->views.end(); ++it) {
@@ -606,6 +767,7 @@ TextureCache::Sampler* TextureCache::Demand(const SamplerInfo& sampler_info) {
   for (auto it = samplers_.find(sampler_hash); it != samplers_.end(); ++it) {
     if (it->second->sampler_info == sampler_info) {
       // Found a compatible sampler.
+      it->second->last_used_frame = frame_count_;
       return it->second;
     }
   }
@@ -732,6 +894,7 @@ TextureCache::Sampler* TextureCache::Demand(const SamplerInfo& sampler_info) {
   auto sampler = new Sampler();
   sampler->sampler = vk_sampler;
   sampler->sampler_info = sampler_info;
+  sampler->last_used_frame = frame_count_;
   samplers_[sampler_hash] = sampler;
 
   return sampler;
@@ -870,8 +1033,8 @@ void TextureCache::FlushPendingCommands(VkCommandBuffer command_buffer,
   vkBeginCommandBuffer(command_buffer, &begin_info);
 }
 
-bool TextureCache::ConvertTexture(uint8_t* dest, VkBufferImageCopy* copy_region,
-                                  uint32_t mip, const TextureInfo& src) {
+bool TextureCache::ConvertTextureSlice(uint8_t* dest, uint32_t mip,
+                                       uint32_t slice, const TextureInfo& src) {
 #if FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
 #endif  // FINE_GRAINED_DRAW_SCOPES
@@ -882,9 +1045,6 @@ bool TextureCache::ConvertTexture(uint8_t* dest, VkBufferImageCopy* copy_region,
     return false;
   }
 
-  void* host_address = memory_->TranslatePhysical(address);
-
-  auto is_cube = src.dimension == Dimension::kCube;
   auto src_extent = src.GetMipExtent(mip, true);
   auto dst_extent = GetMipExtent(src, mip);
 
@@ -895,41 +1055,41 @@ bool TextureCache::ConvertTexture(uint8_t* dest, VkBufferImageCopy* copy_region,
 
   auto copy_block = GetFormatCopyBlock(src.format);
 
-  const uint8_t* src_mem = reinterpret_cast<const uint8_t*>(host_address);
+  const uint8_t* src_mem = memory_->TranslatePhysical(address);
+  src_mem += slice * src_pitch * src_extent.block_pitch_v;
+  dest += slice * dst_pitch * dst_extent.block_pitch_v;
   if (!src.is_tiled) {
-    for (uint32_t face = 0; face < dst_extent.depth; face++) {
-      src_mem += offset_y * src_pitch;
-      src_mem += offset_x * src.format_info()->bytes_per_block();
-      for (uint32_t y = 0; y < dst_extent.block_height; y++) {
-        copy_block(src.endianness, dest + y * dst_pitch,
-                   src_mem + y * src_pitch, dst_pitch);
-      }
-      src_mem += src_pitch * src_extent.block_pitch_v;
-      dest += dst_pitch * dst_extent.block_pitch_v;
+    src_mem += offset_y * src_pitch;
+    src_mem += offset_x * src.format_info()->bytes_per_block();
+    for (uint32_t y = 0; y < dst_extent.block_height; y++) {
+      copy_block(src.endianness, dest + y * dst_pitch, src_mem + y * src_pitch,
+                 dst_pitch);
     }
   } else {
     // Untile image.
     // We could do this in a shader to speed things up, as this is pretty slow.
-    for (uint32_t face = 0; face < dst_extent.depth; face++) {
-      texture_conversion::UntileInfo untile_info;
-      std::memset(&untile_info, 0, sizeof(untile_info));
-      untile_info.offset_x = offset_x;
-      untile_info.offset_y = offset_y;
-      untile_info.width = src_extent.block_width;
-      untile_info.height = src_extent.block_height;
-      untile_info.input_pitch = src_extent.block_pitch_h;
-      untile_info.output_pitch = dst_extent.block_pitch_h;
-      untile_info.input_format_info = src.format_info();
-      untile_info.output_format_info = GetFormatInfo(src.format);
-      untile_info.copy_callback = [=](auto o, auto i, auto l) {
-        copy_block(src.endianness, o, i, l);
-      };
-      texture_conversion::Untile(dest, src_mem, &untile_info);
-      src_mem += src_pitch * src_extent.block_pitch_v;
-      dest += dst_pitch * dst_extent.block_pitch_v;
-    }
+    texture_conversion::UntileInfo untile_info;
+    std::memset(&untile_info, 0, sizeof(untile_info));
+    untile_info.offset_x = offset_x;
+    untile_info.offset_y = offset_y;
+    untile_info.width = src_extent.block_width;
+    untile_info.height = src_extent.block_height;
+    untile_info.input_pitch = src_extent.block_pitch_h;
+    untile_info.output_pitch = dst_extent.block_pitch_h;
+    untile_info.input_format_info = src.format_info();
+    untile_info.output_format_info = GetFormatInfo(src.format);
+    untile_info.copy_callback = [=](auto o, auto i, auto l) {
+      copy_block(src.endianness, o, i, l);
+    };
+    texture_conversion::Untile(dest, src_mem, &untile_info);
   }
+  return true;
+}
 
+void TextureCache::GetMipCopyRegion(VkBufferImageCopy* copy_region,
+                                    uint32_t mip, const TextureInfo& src) {
+  auto is_cube = src.dimension == Dimension::kCube;
+  auto dst_extent = GetMipExtent(src, mip);
   copy_region->bufferRowLength = dst_extent.pitch;
   copy_region->bufferImageHeight = dst_extent.height;
   copy_region->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -939,7 +1099,6 @@ bool TextureCache::ConvertTexture(uint8_t* dest, VkBufferImageCopy* copy_region,
   copy_region->imageExtent.width = std::max(1u, (src.width + 1) >> mip);
   copy_region->imageExtent.height = std::max(1u, (src.height + 1) >> mip);
   copy_region->imageExtent.depth = !is_cube ? dst_extent.depth : 1;
-  return true;
 }
 
 bool TextureCache::UploadTexture(VkCommandBuffer command_buffer,
@@ -1017,16 +1176,25 @@ bool TextureCache::UploadTexture(VkCommandBuffer command_buffer,
   uint32_t copy_region_count = src.mip_levels();
   std::vector<VkBufferImageCopy> copy_regions(copy_region_count);
 
-  // Upload all mips.
+  // Split conversion into one job per mip slice, each writing straight into
+  // its place in the staging buffer.
+  struct ConversionJob {
+    uint8_t* dest;
+    uint32_t mip;
+    uint32_t slice;
+  };
+  std::vector<ConversionJob> jobs;
   auto unpack_buffer = reinterpret_cast<uint8_t*>(alloc->host_ptr);
   VkDeviceSize unpack_offset = 0;
   for (uint32_t mip = src.mip_min_level, region = 0; mip <= src.mip_max_level;
        mip++, region++) {
-    if (!ConvertTexture(&unpack_buffer[unpack_offset], &copy_regions[region],
-                        mip, src)) {
+    uint32_t offset_x = 0;
+    uint32_t offset_y = 0;
+    if (!src.GetMipLocation(mip, &offset_x, &offset_y, true)) {
       XELOGW("Failed to convert texture mip %u!", mip);
       return false;
     }
+    GetMipCopyRegion(&copy_regions[region], mip, src);
     copy_regions[region].bufferOffset = alloc->offset + unpack_offset;
     copy_regions[region].imageOffset = {0, 0, 0};
 
@@ -1037,9 +1205,34 @@ bool TextureCache::UploadTexture(VkCommandBuffer command_buffer,
              copy_regions[region].imageExtent.depth, unpack_offset);
     */
 
+    uint32_t slice_count = GetMipExtent(src, mip).depth;
+    for (uint32_t slice = 0; slice < slice_count; slice++) {
+      jobs.push_back({&unpack_buffer[unpack_offset], mip, slice});
+    }
     unpack_offset += ComputeMipStorage(src, mip);
   }
 
+  // Small textures aren't worth the hand-off to the workers. Either way all
+  // jobs are done before the copy is recorded.
+  std::atomic<bool> converted(true);
+  auto convert_job = [&](size_t i) {
+    auto& job = jobs[i];
+    if (!ConvertTextureSlice(job.dest, job.mip, job.slice, src)) {
+      converted = false;
+    }
+  };
+  if (unpack_length >= kParallelConversionThreshold) {
+    conversion_pool_->ParallelFor(jobs.size(), convert_job);
+  } else {
+    for (size_t i = 0; i < jobs.size(); i++) {
+      convert_job(i);
+    }
+  }
+  if (!converted) {
+    XELOGW("Failed to convert texture!");
+    return false;
+  }
+
   if (FLAGS_texture_dump) {
     TextureDump(src, unpack_buffer, unpack_length);
   }
@@ -1265,42 +1458,63 @@ void TextureCache::WritebackTexture(Texture* texture) {
   wb_staging_buffer_.Scavenge();
 }
 
-void TextureCache::HashTextureBindings(
-    XXH64_state_t* hash_state, uint32_t& fetch_mask,
-    const std::vector<Shader::TextureBinding>& bindings) {
-  for (auto& binding : bindings) {
-    uint32_t fetch_bit = 1 << binding.fetch_constant;
-    if (fetch_mask & fetch_bit) {
-      // We've covered this binding.
-      continue;
-    }
-    fetch_mask |= fetch_bit;
-
-    auto& regs = *register_file_;
-    int r = XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + binding.fetch_constant * 6;
-    auto group =
-        reinterpret_cast<const xenos::xe_gpu_fetch_group_t*>(&regs.values[r]);
-    auto& fetch = group->texture_fetch;
-
-    XXH64_update(hash_state, &fetch, sizeof(fetch));
-  }
-}
-
 VkDescriptorSet TextureCache::PrepareTextureSet(
     VkCommandBuffer command_buffer, VkFence completion_fence,
-    const std::vector<Shader::TextureBinding>& vertex_bindings,
-    const std::vector<Shader::TextureBinding>& pixel_bindings) {
-  XXH64_state_t hash_state;
-  XXH64_reset(&hash_state, 0);
-
-  // (quickly) Generate a hash.
-  uint32_t fetch_mask = 0;
-  HashTextureBindings(&hash_state, fetch_mask, vertex_bindings);
-  HashTextureBindings(&hash_state, fetch_mask, pixel_bindings);
-  uint64_t hash = XXH64_digest(&hash_state);
-  for (auto it = texture_sets_.find(hash); it != texture_sets_.end(); ++it) {
-    // TODO(DrChat): We need to compare the bindings and ensure they're equal.
-    return it->second;
+    const Shader* vertex_shader, const Shader* pixel_shader) {
+  static const std::vector<Shader::TextureBinding> dummy_bindings;
+  const auto& vertex_bindings = vertex_shader->texture_bindings();
+  const auto& pixel_bindings =
+      pixel_shader ? pixel_shader->texture_bindings() : dummy_bindings;
+
+  // (quickly) Generate a hash. The fetch constants used by the shaders are
+  // known from their parsed ucode, so only those are visited, once each.
+  // If none of the fetch constants were written since the previous call and
+  // the same ones are used the hash can't have changed.
+  uint32_t fetch_mask = vertex_shader->texture_fetch_mask();
+  if (pixel_shader) {
+    fetch_mask |= pixel_shader->texture_fetch_mask();
+  }
+  auto& regs = *register_file_;
+  uint64_t hash;
+  if (fetch_mask == last_texture_set_fetch_mask_ &&
+      !regs.IsRangeDirty(kFetchConstantRegisterFirst,
+                         kFetchConstantRegisterCount,
+                         last_texture_set_serial_)) {
+    hash = last_texture_set_hash_;
+  } else {
+    XXH64_state_t hash_state;
+    XXH64_reset(&hash_state, 0);
+    XXH64_update(&hash_state, &fetch_mask, sizeof(fetch_mask));
+    uint32_t fetch_index;
+    uint32_t remaining_mask = fetch_mask;
+    while (xe::bit_scan_forward(remaining_mask, &fetch_index)) {
+      remaining_mask &= ~(1u << fetch_index);
+      int r = XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 + fetch_index * 6;
+      auto group = reinterpret_cast<const xenos::xe_gpu_fetch_group_t*>(
+          &regs.values[r]);
+      XXH64_update(&hash_state, &group->texture_fetch,
+                   sizeof(group->texture_fetch));
+    }
+    hash = XXH64_digest(&hash_state);
+    last_texture_set_hash_ = hash;
+    last_texture_set_fetch_mask_ = fetch_mask;
+    last_texture_set_serial_ = regs.dirty_serial();
+  }
+
+  auto it = texture_sets_.find(hash);
+  if (it != texture_sets_.end()) {
+    auto& texture_set = it->second;
+    if (texture_set.last_used_frame == frame_count_) {
+      // TODO(DrChat): We need to compare the bindings and ensure they're
+      // equal.
+      return texture_set.set;
+    }
+    if (ReuseTextureSet(&texture_set, completion_fence)) {
+      ++statistics_.texture_sets_reused;
+      return texture_set.set;
+    }
+    RetireTextureSet(texture_set);
+    texture_sets_.erase(it);
   }
 
   // Clear state.
@@ -1325,13 +1539,7 @@ VkDescriptorSet TextureCache::PrepareTextureSet(
     // TODO(benvanik): actually bail out here?
   }
 
-  // Open a new batch of descriptor sets (for this frame)
-  if (!descriptor_pool_->has_open_batch()) {
-    descriptor_pool_->BeginBatch(completion_fence);
-  }
-
-  auto descriptor_set =
-      descriptor_pool_->AcquireEntry(texture_descriptor_set_layout_);
+  auto descriptor_set = AcquireTextureSet();
   if (!descriptor_set) {
     return nullptr;
   }
@@ -1345,11 +1553,143 @@ VkDescriptorSet TextureCache::PrepareTextureSet(
     vkUpdateDescriptorSets(*device_, update_set_info->image_write_count,
                            update_set_info->image_writes, 0, nullptr);
   }
+  ++statistics_.texture_sets_written;
+
+  auto& texture_set = texture_sets_[hash];
+  texture_set.set = descriptor_set;
+  texture_set.in_flight_fence = completion_fence;
+  texture_set.last_used_frame = frame_count_;
+  texture_set.complete = !any_failed;
+  texture_set.bindings.resize(update_set_info->image_write_count);
+  for (uint32_t i = 0; i < update_set_info->image_write_count; i++) {
+    auto& binding = texture_set.bindings[i];
+    binding.texture = update_set_info->textures[i];
+    binding.image_layout = update_set_info->image_infos[i].imageLayout;
+    binding.sampler = update_set_info->samplers[i];
+  }
+  return descriptor_set;
+}
+
+VkDescriptorSet TextureCache::AcquireTextureSet() {
+  if (!free_texture_sets_.empty()) {
+    auto descriptor_set = free_texture_sets_.back();
+    free_texture_sets_.pop_back();
+    return descriptor_set;
+  }
+
+  VkDescriptorSetAllocateInfo set_alloc_info;
+  set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  set_alloc_info.pNext = nullptr;
+  set_alloc_info.descriptorSetCount = 1;
+  set_alloc_info.pSetLayouts = &texture_descriptor_set_layout_;
+  VkDescriptorSet descriptor_set = nullptr;
+  if (!texture_set_pools_.empty()) {
+    set_alloc_info.descriptorPool = texture_set_pools_.back();
+    if (vkAllocateDescriptorSets(*device_, &set_alloc_info,
+                                 &descriptor_set) == VK_SUCCESS) {
+      return descriptor_set;
+    }
+  }
+
+  // The newest pool is full, start another one.
+  VkDescriptorPoolSize pool_size;
+  pool_size.type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+  pool_size.descriptorCount = kTextureSetsPerPool * kMaxTextureSamplers;
+  VkDescriptorPoolCreateInfo pool_info;
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.pNext = nullptr;
+  pool_info.flags = 0;
+  pool_info.maxSets = kTextureSetsPerPool;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  VkDescriptorPool pool = nullptr;
+  VkResult status =
+      vkCreateDescriptorPool(*device_, &pool_info, nullptr, &pool);
+  CheckResult(status, "vkCreateDescriptorPool");
+  if (status != VK_SUCCESS) {
+    return nullptr;
+  }
+  texture_set_pools_.push_back(pool);
+  COUNT_profile_set("gpu/texture_cache/texture_set_pools",
+                    texture_set_pools_.size());
 
-  texture_sets_[hash] = descriptor_set;
+  set_alloc_info.descriptorPool = pool;
+  status = vkAllocateDescriptorSets(*device_, &set_alloc_info, &descriptor_set);
+  CheckResult(status, "vkAllocateDescriptorSets");
+  if (status != VK_SUCCESS) {
+    return nullptr;
+  }
   return descriptor_set;
 }
 
+bool TextureCache::ReuseTextureSet(TextureSet* texture_set,
+                                   VkFence completion_fence) {
+  // Traces need the memory reads the texture lookups would have recorded.
+  if (!texture_set->complete || trace_writer_->is_open()) {
+    return false;
+  }
+  for (const auto& binding : texture_set->bindings) {
+    if (binding.texture->pending_invalidation ||
+        binding.texture->image_layout != binding.image_layout) {
+      return false;
+    }
+  }
+
+  // Keep everything referenced alive for as long as the new batch uses it.
+  for (const auto& binding : texture_set->bindings) {
+    binding.texture->last_used_frame = frame_count_;
+    binding.texture->in_flight_fence = completion_fence;
+    binding.sampler->last_used_frame = frame_count_;
+  }
+  texture_set->in_flight_fence = completion_fence;
+  texture_set->last_used_frame = frame_count_;
+  return true;
+}
+
+void TextureCache::RetireTextureSet(const TextureSet& texture_set) {
+  retired_texture_sets_.emplace_back(texture_set.set,
+                                     texture_set.in_flight_fence);
+}
+
+void TextureCache::ScavengeTextureSets() {
+  // Sets referencing textures that are about to be freed must go now, as
+  // their texture pointers would dangle.
+  for (auto it = texture_sets_.begin(); it != texture_sets_.end();) {
+    const auto& texture_set = it->second;
+    bool retire =
+        texture_set.last_used_frame + kTextureSetMaxIdleFrames < frame_count_;
+    for (const auto& binding : texture_set.bindings) {
+      retire |= binding.texture->pending_invalidation;
+    }
+    if (retire) {
+      RetireTextureSet(texture_set);
+      it = texture_sets_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+
+  for (auto it = retired_texture_sets_.begin();
+       it != retired_texture_sets_.end();) {
+    if (it->second) {
+      VkResult status = vkGetFenceStatus(*device_, it->second);
+      if (status != VK_SUCCESS && status != VK_ERROR_DEVICE_LOST) {
+        // Still in flight.
+        ++it;
+        continue;
+      }
+    }
+    free_texture_sets_.push_back(it->first);
+    it = retired_texture_sets_.erase(it);
+  }
+
+  COUNT_profile_set("gpu/texture_cache/texture_sets", texture_sets_.size());
+  COUNT_profile_set("gpu/texture_cache/texture_sets_written",
+                    statistics_.texture_sets_written);
+  COUNT_profile_set("gpu/texture_cache/texture_sets_reused",
+                    statistics_.texture_sets_reused);
+}
+
 bool TextureCache::SetupTextureBindings(
     VkCommandBuffer command_buffer, VkFence completion_fence,
     UpdateSetInfo* update_set_info,
@@ -1437,6 +1777,8 @@ bool TextureCache::SetupTextureBinding(VkCommandBuffer command_buffer,
   image_info->imageLayout = texture->image_layout;
   image_info->sampler = sampler->sampler;
   texture->in_flight_fence = completion_fence;
+  update_set_info->textures[update_set_info->image_write_count - 1] = texture;
+  update_set_info->samplers[update_set_info->image_write_count - 1] = sampler;
 
   return true;
 }
@@ -1459,9 +1801,11 @@ void TextureCache::RemoveInvalidatedTextures() {
          it != invalidated_textures.end(); ++it) {
       pending_delete_textures_.push_back(*it);
       textures_.erase((*it)->texture_info.hash());
+      RemoveTextureContent(*it);
+      RemoveResidentTexture(*it);
     }
 
-    COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+    UpdateResidencyCounters();
     COUNT_profile_set("gpu/texture_cache/pending_deletes",
                       pending_delete_textures_.size());
     invalidated_textures.clear();
@@ -1469,6 +1813,13 @@ void TextureCache::RemoveInvalidatedTextures() {
 }
 
 void TextureCache::ClearCache() {
+  // Every set references textures or samplers freed below.
+  for (auto& it : texture_sets_) {
+    RetireTextureSet(it.second);
+  }
+  texture_sets_.clear();
+  last_texture_set_serial_ = 0;
+
   RemoveInvalidatedTextures();
   for (auto it = textures_.begin(); it != textures_.end(); ++it) {
     while (!FreeTexture(it->second)) {
@@ -1477,7 +1828,11 @@ void TextureCache::ClearCache() {
     }
   }
   textures_.clear();
-  COUNT_profile_set("gpu/texture_cache/textures", 0);
+  content_textures_.clear();
+  evicted_texture_hashes_.clear();
+  evicted_texture_hash_order_.clear();
+  statistics_.resident_bytes = 0;
+  UpdateResidencyCounters();
 
   for (auto it = samplers_.begin(); it != samplers_.end(); ++it) {
     vkDestroySampler(*device_, it->second->sampler, nullptr);
@@ -1489,20 +1844,13 @@ void TextureCache::ClearCache() {
 void TextureCache::Scavenge() {
   SCOPE_profile_cpu_f("gpu");
 
-  // Close any open descriptor pool batches
-  if (descriptor_pool_->has_open_batch()) {
-    descriptor_pool_->EndBatch();
-  }
-
-  // Free unused descriptor sets
-  // TODO(DrChat): These sets could persist across frames, we just need a smart
-  // way to detect if they're unused and free them.
-  texture_sets_.clear();
-  descriptor_pool_->Scavenge();
   staging_buffer_.Scavenge();
 
   // Kill all pending delete textures.
   RemoveInvalidatedTextures();
+  EvictTextures();
+  EvictSamplers();
+  ScavengeTextureSets();
   if (!pending_delete_textures_.empty()) {
     for (auto it = pending_delete_textures_.begin();
          it != pending_delete_textures_.end();) {
@@ -1516,6 +1864,112 @@ void TextureCache::Scavenge() {
     COUNT_profile_set("gpu/texture_cache/pending_deletes",
                       pending_delete_textures_.size());
   }
+
+  ++frame_count_;
+}
+
+void TextureCache::EvictTextures() {
+  uint64_t budget = uint64_t(std::max(FLAGS_vulkan_texture_cache_budget_mb, 0))
+                    << 20;
+  if (!budget || statistics_.resident_bytes <= budget) {
+    return;
+  }
+
+  // Textures used in the frame being finished or the one before may still be
+  // bound by cached descriptor sets, keep them regardless of the budget.
+  std::vector<Texture*> candidates;
+  for (auto it = textures_.begin(); it != textures_.end(); ++it) {
+    auto texture = it->second;
+    if (!texture->is_resolve_target && !texture->pending_invalidation &&
+        texture->last_used_frame + 1 < frame_count_) {
+      candidates.push_back(texture);
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const Texture* a, const Texture* b) {
+              return a->last_used_frame < b->last_used_frame;
+            });
+
+  for (auto texture : candidates) {
+    if (statistics_.resident_bytes <= budget) {
+      break;
+    }
+
+    // Keep the watch callback from queueing the texture a second time.
+    texture->pending_invalidation = true;
+    if (texture->access_watch_handle) {
+      memory_->CancelAccessWatch(texture->access_watch_handle);
+      texture->access_watch_handle = 0;
+    }
+
+    uint64_t texture_hash = texture->texture_info.hash();
+    textures_.erase(texture_hash);
+    RemoveTextureContent(texture);
+    if (evicted_texture_hashes_.insert(texture_hash).second) {
+      // Reuploads leave the hash queued, so a texture evicted again is
+      // forgotten at its first eviction. That only loses a statistic.
+      evicted_texture_hash_order_.push_back(texture_hash);
+      if (evicted_texture_hash_order_.size() > kMaxEvictedTextureHashes) {
+        evicted_texture_hashes_.erase(evicted_texture_hash_order_.front());
+        evicted_texture_hash_order_.pop_front();
+      }
+    }
+    pending_delete_textures_.push_back(texture);
+    ++statistics_.evicted_textures;
+    statistics_.evicted_bytes += RemoveResidentTexture(texture);
+  }
+
+  UpdateResidencyCounters();
+  COUNT_profile_set("gpu/texture_cache/pending_deletes",
+                    pending_delete_textures_.size());
+}
+
+void TextureCache::EvictSamplers() {
+  // Samplers are tiny, but drivers limit how many may exist at once.
+  const uint64_t kSamplerMaxIdleFrames = 600;
+  for (auto it = samplers_.begin(); it != samplers_.end();) {
+    auto sampler = it->second;
+    if (sampler->last_used_frame + kSamplerMaxIdleFrames < frame_count_) {
+      vkDestroySampler(*device_, sampler->sampler, nullptr);
+      delete sampler;
+      it = samplers_.erase(it);
+      ++statistics_.evicted_samplers;
+      continue;
+    }
+    ++it;
+  }
+  COUNT_profile_set("gpu/texture_cache/samplers", samplers_.size());
+}
+
+void TextureCache::AddResidentTexture(Texture* texture) {
+  Texture* owner = texture->image_owner ? texture->image_owner : texture;
+  if (owner->image_resident_count++ == 0) {
+    statistics_.resident_bytes += owner->alloc_info.size;
+  }
+}
+
+VkDeviceSize TextureCache::RemoveResidentTexture(Texture* texture) {
+  Texture* owner = texture->image_owner ? texture->image_owner : texture;
+  assert_not_zero(owner->image_resident_count);
+  if (--owner->image_resident_count != 0) {
+    return 0;
+  }
+  statistics_.resident_bytes -= owner->alloc_info.size;
+  return owner->alloc_info.size;
+}
+
+void TextureCache::UpdateResidencyCounters() {
+  statistics_.resident_textures = uint32_t(textures_.size());
+  COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+  COUNT_profile_set("gpu/texture_cache/resident_kb",
+                    statistics_.resident_bytes >> 10);
+  COUNT_profile_set("gpu/texture_cache/evicted_textures",
+                    statistics_.evicted_textures);
+  COUNT_profile_set("gpu/texture_cache/reuploaded_textures",
+                    statistics_.reuploaded_textures);
+  COUNT_profile_set("gpu/texture_cache/dedup_lookups",
+                    statistics_.dedup_lookups);
+  COUNT_profile_set("gpu/texture_cache/dedup_hits", statistics_.dedup_hits);
 }
 
 }  // namespace vulkan
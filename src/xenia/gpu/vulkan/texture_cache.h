@@ -10,9 +10,11 @@
 #ifndef XENIA_GPU_VULKAN_TEXTURE_CACHE_H_
 #define XENIA_GPU_VULKAN_TEXTURE_CACHE_H_
 
+#include <deque>
 #include <unordered_map>
 #include <unordered_set>
 
+#include "xenia/base/worker_pool.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/sampler_info.h"
 #include "xenia/gpu/shader.h"
@@ -52,9 +54,25 @@ class TextureCache {
 
     uintptr_t access_watch_handle;
     bool pending_invalidation;
+    // Resolve targets hold data that only exists on the host, so they are
+    // never evicted.
+    bool is_resolve_target;
 
     // Pointer to the latest usage fence.
     VkFence in_flight_fence;
+    // Frame the texture was last demanded in, for LRU eviction.
+    uint64_t last_used_frame;
+
+    // Texture whose image this one shares because the guest data is
+    // identical, or null if the image is its own. The owner counts every
+    // texture using its image and outlives them.
+    Texture* image_owner;
+    uint32_t image_ref_count;
+    // Textures in the cache using the image, counted on the owner. The
+    // image counts against the budget while any is.
+    uint32_t image_resident_count;
+    // Key in the content index if other textures may share this image.
+    uint64_t content_hash;
   };
 
   struct TextureView {
@@ -94,8 +112,7 @@ class TextureCache {
   // using the returned descriptor set.
   VkDescriptorSet PrepareTextureSet(
       VkCommandBuffer setup_command_buffer, VkFence completion_fence,
-      const std::vector<Shader::TextureBinding>& vertex_bindings,
-      const std::vector<Shader::TextureBinding>& pixel_bindings);
+      const Shader* vertex_shader, const Shader* pixel_shader);
 
   // TODO(benvanik): ReadTexture.
 
@@ -116,6 +133,30 @@ class TextureCache {
   // creates a new texture or returns a previously created texture.
   Texture* DemandResolveTexture(const TextureInfo& texture_info);
 
+  // Residency and eviction counters, for tuning the memory budget.
+  struct Statistics {
+    // Textures currently cached and the host memory backing them.
+    uint32_t resident_textures;
+    uint64_t resident_bytes;
+    // Textures evicted to stay within the budget, and their memory.
+    uint64_t evicted_textures;
+    uint64_t evicted_bytes;
+    // Textures uploaded, and how many of those had been evicted before.
+    uint64_t uploaded_textures;
+    uint64_t reuploaded_textures;
+    uint64_t evicted_samplers;
+    // Content hash lookups made for new textures, how many found an image
+    // to share, and the guest bytes those did not have to convert.
+    uint64_t dedup_lookups;
+    uint64_t dedup_hits;
+    uint64_t dedup_bytes;
+    // Texture descriptor sets written, and lookups served by a set written
+    // in an earlier frame.
+    uint64_t texture_sets_written;
+    uint64_t texture_sets_reused;
+  };
+  const Statistics& statistics() const { return statistics_; }
+
   // Clears all cached content.
   void ClearCache();
 
@@ -129,6 +170,25 @@ class TextureCache {
   struct Sampler {
     SamplerInfo sampler_info;
     VkSampler sampler;
+    uint64_t last_used_frame;
+  };
+
+  // Texture descriptor set written for one hash of the fetch constants used
+  // by a shader pair. Sets outlive the frame they were written in and are
+  // reused while none of the textures they reference are invalidated.
+  struct TextureSet {
+    struct Binding {
+      Texture* texture;
+      VkImageLayout image_layout;
+      Sampler* sampler;
+    };
+    VkDescriptorSet set;
+    VkFence in_flight_fence;
+    uint64_t last_used_frame;
+    // False if some binding failed to set up, such sets are not reused
+    // across frames.
+    bool complete;
+    std::vector<Binding> bindings;
   };
 
   // Allocates a new texture and memory to back it on the GPU.
@@ -136,6 +196,21 @@ class TextureCache {
                            VkFormatFeatureFlags required_flags =
                                VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
   bool FreeTexture(Texture* texture);
+  // Creates a texture for texture_info that shares the image of owner.
+  Texture* AliasTexture(Texture* owner, const TextureInfo& texture_info);
+  // Count a texture entering or leaving the cache against the budget. A
+  // shared image counts once, so removal returns the memory it releases,
+  // which is 0 while other cached textures still use the image.
+  void AddResidentTexture(Texture* texture);
+  VkDeviceSize RemoveResidentTexture(Texture* texture);
+
+  // Hashes the layout of a texture, without its guest addresses, and its
+  // guest data. Large ranges are sampled rather than hashed in full.
+  uint64_t HashTextureContents(const TextureInfo& texture_info);
+  void HashGuestRange(XXH64_state_t* hash_state, uint32_t address,
+                      uint32_t length);
+  static TextureInfo GetContentLayout(const TextureInfo& texture_info);
+  void RemoveTextureContent(Texture* texture);
 
   static void WatchCallback(void* context_ptr, void* data_ptr,
                             uint32_t address);
@@ -150,8 +225,12 @@ class TextureCache {
   void FlushPendingCommands(VkCommandBuffer command_buffer,
                             VkFence completion_fence);
 
-  bool ConvertTexture(uint8_t* dest, VkBufferImageCopy* copy_region,
-                      uint32_t mip, const TextureInfo& src);
+  // Converts one face or depth slice of a mip. dest points at the start of
+  // the converted mip. Safe to call from multiple threads at once.
+  bool ConvertTextureSlice(uint8_t* dest, uint32_t mip, uint32_t slice,
+                           const TextureInfo& src);
+  static void GetMipCopyRegion(VkBufferImageCopy* copy_region, uint32_t mip,
+                               const TextureInfo& src);
 
   static const FormatInfo* GetFormatInfo(TextureFormat format);
   static texture_conversion::CopyBlockCallback GetFormatCopyBlock(
@@ -173,8 +252,18 @@ class TextureCache {
   bool UploadTexture(VkCommandBuffer command_buffer, VkFence completion_fence,
                      Texture* dest, const TextureInfo& src);
 
-  void HashTextureBindings(XXH64_state_t* hash_state, uint32_t& fetch_mask,
-                           const std::vector<Shader::TextureBinding>& bindings);
+  // Returns an unused texture descriptor set, allocating one if none is free.
+  VkDescriptorSet AcquireTextureSet();
+  // Revalidates a set written in an earlier frame for use by the current
+  // one, marking everything it references as used. Returns false if it is
+  // stale.
+  bool ReuseTextureSet(TextureSet* texture_set, VkFence completion_fence);
+  // Queues the set to be recycled once the GPU is done with it.
+  void RetireTextureSet(const TextureSet& texture_set);
+  // Retires idle sets and those referencing textures about to be deleted and
+  // recycles retired sets whose batch completed.
+  void ScavengeTextureSets();
+
   bool SetupTextureBindings(
       VkCommandBuffer command_buffer, VkFence completion_fence,
       UpdateSetInfo* update_set_info,
@@ -186,6 +275,11 @@ class TextureCache {
 
   // Removes invalidated textures from the cache, queues them for delete.
   void RemoveInvalidatedTextures();
+  // Queues the least recently used textures for delete until the cache fits
+  // in the memory budget, and frees long unused samplers.
+  void EvictTextures();
+  void EvictSamplers();
+  void UpdateResidencyCounters();
 
   Memory* memory_ = nullptr;
 
@@ -195,18 +289,38 @@ class TextureCache {
   VkQueue device_queue_ = nullptr;
 
   std::unique_ptr<xe::ui::vulkan::CommandBufferPool> wb_command_pool_ = nullptr;
-  std::unique_ptr<xe::ui::vulkan::DescriptorPool> descriptor_pool_ = nullptr;
-  std::unordered_map<uint64_t, VkDescriptorSet> texture_sets_;
+  // Pools texture descriptor sets are allocated from. Sets are never freed
+  // individually, only recycled through free_texture_sets_.
+  std::vector<VkDescriptorPool> texture_set_pools_;
+  std::unordered_map<uint64_t, TextureSet> texture_sets_;
+  std::vector<VkDescriptorSet> free_texture_sets_;
+  std::vector<std::pair<VkDescriptorSet, VkFence>> retired_texture_sets_;
+  // Hash computed by the last PrepareTextureSet, the fetch constant mask it
+  // covered and the register file dirty serial at that time.
+  uint64_t last_texture_set_hash_ = 0;
+  uint32_t last_texture_set_fetch_mask_ = 0;
+  uint64_t last_texture_set_serial_ = 0;
   VkDescriptorSetLayout texture_descriptor_set_layout_ = nullptr;
 
   VmaAllocator mem_allocator_ = nullptr;
 
   ui::vulkan::CircularBuffer staging_buffer_;
   ui::vulkan::CircularBuffer wb_staging_buffer_;
+  std::unique_ptr<xe::threading::WorkerPool> conversion_pool_;
   std::unordered_map<uint64_t, Texture*> textures_;
   std::unordered_map<uint64_t, Sampler*> samplers_;
   std::list<Texture*> pending_delete_textures_;
 
+  uint64_t frame_count_ = 0;
+  Statistics statistics_ = {};
+  // Hashes of recently evicted textures, to count uploads caused by
+  // eviction, and the order they were evicted in so the oldest can be
+  // forgotten.
+  std::unordered_set<uint64_t> evicted_texture_hashes_;
+  std::deque<uint64_t> evicted_texture_hash_order_;
+  // Uploaded textures by content hash, for sharing images across addresses.
+  std::unordered_map<uint64_t, Texture*> content_textures_;
+
   std::mutex invalidated_textures_mutex_;
   std::unordered_set<Texture*>* invalidated_textures_;
   std::unordered_set<Texture*> invalidated_textures_sets_[2];
@@ -218,6 +332,9 @@ class TextureCache {
     uint32_t image_write_count = 0;
     VkWriteDescriptorSet image_writes[32];
     VkDescriptorImageInfo image_infos[32];
+    // Texture and sampler of each image write.
+    Texture* textures[32];
+    Sampler* samplers[32];
   } update_set_info_;
 };
 
@@ -229,6 +229,42 @@ void VulkanCommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
   }
 }
 
+void VulkanCommandProcessor::WriteRegisterRangeFromMem(uint32_t start_index,
+                                                       const uint32_t* base,
+                                                       uint32_t count) {
+  CommandProcessor::WriteRegisterRangeFromMem(start_index, base, count);
+  if (!count) {
+    return;
+  }
+
+  // Bulk writes bypass WriteRegister, so flag all constants in the range.
+  uint32_t last_index = start_index + count - 1;
+  uint32_t first, last;
+  first = std::max(start_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_000_X));
+  last = std::min(last_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_511_W));
+  if (first <= last) {
+    uint32_t first_block = (first - XE_GPU_REG_SHADER_CONSTANT_000_X) / 16;
+    uint32_t last_block = (last - XE_GPU_REG_SHADER_CONSTANT_000_X) / 16;
+    for (uint32_t block = first_block; block <= last_block; ++block) {
+      dirty_float_constants_ |= (1ull << (block ^ 0x3F));
+    }
+  }
+  first = std::max(start_index,
+                   uint32_t(XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031));
+  last =
+      std::min(last_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_BOOL_224_255));
+  for (uint32_t i = first; i <= last; ++i) {
+    uint32_t offset = i - XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031;
+    dirty_bool_constants_ |= (1 << (offset ^ 0x7));
+  }
+  first = std::max(start_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_LOOP_00));
+  last = std::min(last_index, uint32_t(XE_GPU_REG_SHADER_CONSTANT_LOOP_31));
+  for (uint32_t i = first; i <= last; ++i) {
+    uint32_t offset = i - XE_GPU_REG_SHADER_CONSTANT_LOOP_00;
+    dirty_loop_constants_ |= (1 << (offset ^ 0x1F));
+  }
+}
+
 void VulkanCommandProcessor::CreateSwapImage(VkCommandBuffer setup_buffer,
                                              VkExtent2D extents) {
   VkImageCreateInfo image_info;
@@ -370,10 +406,23 @@ void VulkanCommandProcessor::BeginFrame() {
     }
   }
 
+  ResetBoundState();
   frame_open_ = true;
 }
 
 void VulkanCommandProcessor::EndFrame() {
+  FlushPendingDraw();
+
+  auto& stats = draw_batch_stats_;
+  COUNT_profile_set("gpu/draw_batching/draws", stats.draws);
+  COUNT_profile_set("gpu/draw_batching/recorded_draws", stats.recorded_draws);
+  COUNT_profile_set("gpu/draw_batching/instanced_draws",
+                    stats.instanced_draws);
+  COUNT_profile_set("gpu/draw_batching/concatenated_draws",
+                    stats.concatenated_draws);
+  COUNT_profile_set("gpu/draw_batching/skipped_binds", stats.skipped_binds);
+  stats = {};
+
   if (current_render_state_) {
     render_cache_->EndRenderPass();
     current_render_state_ = nullptr;
@@ -639,11 +688,15 @@ bool VulkanCommandProcessor::IssueDraw(PrimitiveType primitive_type,
   }
   auto command_buffer = current_command_buffer_;
   auto setup_buffer = current_setup_buffer_;
+  if (!FLAGS_vulkan_batch_draws) {
+    ResetBoundState();
+  }
 
   // Begin the render pass.
   // This will setup our framebuffer and begin the pass in the command buffer.
   // This reuses a previous render pass if one is already open.
   if (render_cache_->dirty() || !current_render_state_) {
+    FlushPendingDraw();
     if (current_render_state_) {
       render_cache_->EndRenderPass();
       current_render_state_ = nullptr;
@@ -655,6 +708,7 @@ bool VulkanCommandProcessor::IssueDraw(PrimitiveType primitive_type,
     if (!current_render_state_) {
       return false;
     }
+    ResetBoundState();
   }
 
   // Configure the pipeline for drawing.
@@ -666,12 +720,17 @@ bool VulkanCommandProcessor::IssueDraw(PrimitiveType primitive_type,
       primitive_type, &pipeline);
   if (pipeline_status == PipelineCache::UpdateStatus::kError) {
     return false;
-  } else if (pipeline_status == PipelineCache::UpdateStatus::kMismatch ||
-             full_update) {
+  }
+  if (pipeline != bound_state_.pipeline) {
+    FlushPendingDraw();
     vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                       pipeline);
+    bound_state_.pipeline = pipeline;
+  }
+  if (full_update || pipeline_cache_->IsDynamicStateDirty()) {
+    FlushPendingDraw();
+    pipeline_cache_->SetDynamicState(command_buffer, full_update);
   }
-  pipeline_cache_->SetDynamicState(command_buffer, full_update);
 
   // Pass registers to the shaders.
   if (!PopulateConstants(command_buffer, vertex_shader, pixel_shader)) {
@@ -679,7 +738,8 @@ bool VulkanCommandProcessor::IssueDraw(PrimitiveType primitive_type,
   }
 
   // Upload and bind index buffer data (if we have any).
-  if (!PopulateIndexBuffer(command_buffer, index_buffer_info)) {
+  uint32_t first_index = 0;
+  if (!PopulateIndexBuffer(command_buffer, index_buffer_info, &first_index)) {
     return false;
   }
 
@@ -696,29 +756,117 @@ bool VulkanCommandProcessor::IssueDraw(PrimitiveType primitive_type,
     return false;
   }
 
-  // Actually issue the draw.
-  if (!index_buffer_info) {
+  // Actually issue the draw. All state it needs is bound by now, so it may be
+  // merged with the previous draw and recorded later.
+  uint32_t index_offset = regs[XE_GPU_REG_VGT_INDX_OFFSET].u32;
+  PendingDraw draw;
+  draw.indexed = index_buffer_info != nullptr;
+  draw.primitive_type = primitive_type;
+  if (!draw.indexed) {
     // Auto-indexed draw.
-    uint32_t instance_count = 1;
-    uint32_t first_vertex =
-        register_file_->values[XE_GPU_REG_VGT_INDX_OFFSET].u32;
-    uint32_t first_instance = 0;
-    vkCmdDraw(command_buffer, index_count, instance_count, first_vertex,
-              first_instance);
+    draw.first = index_offset;
+    draw.vertex_offset = 0;
   } else {
     // Index buffer draw.
-    uint32_t instance_count = 1;
-    uint32_t first_index = 0;
-    uint32_t vertex_offset =
-        register_file_->values[XE_GPU_REG_VGT_INDX_OFFSET].u32;
-    uint32_t first_instance = 0;
-    vkCmdDrawIndexed(command_buffer, index_count, instance_count, first_index,
-                     vertex_offset, first_instance);
+    draw.first = first_index;
+    draw.vertex_offset = static_cast<int32_t>(index_offset);
+  }
+  draw.count = index_count;
+  draw.instance_count = 1;
+  QueueDraw(draw);
+
+  return true;
+}
+
+void VulkanCommandProcessor::QueueDraw(const PendingDraw& draw) {
+  ++draw_batch_stats_.draws;
+  if (has_pending_draw_) {
+    if (MergePendingDraw(draw)) {
+      return;
+    }
+    FlushPendingDraw();
+  }
+  pending_draw_ = draw;
+  has_pending_draw_ = true;
+  if (!FLAGS_vulkan_batch_draws) {
+    FlushPendingDraw();
+  }
+}
+
+bool VulkanCommandProcessor::MergePendingDraw(const PendingDraw& draw) {
+  auto& pending = pending_draw_;
+  if (draw.indexed != pending.indexed ||
+      draw.primitive_type != pending.primitive_type ||
+      draw.vertex_offset != pending.vertex_offset) {
+    return false;
+  }
+
+  // Translated shaders never read the instance index, so drawing the same
+  // range again is the same as drawing one more instance of it.
+  if (draw.first == pending.first && draw.count == pending.count) {
+    ++pending.instance_count;
+    ++draw_batch_stats_.instanced_draws;
+    return true;
   }
 
+  // Ranges continuing the pending one can be appended to it as long as the
+  // primitives are independent and the pending range has no partial one.
+  uint32_t primitive_size;
+  switch (pending.primitive_type) {
+    case PrimitiveType::kPointList:
+      primitive_size = 1;
+      break;
+    case PrimitiveType::kLineList:
+      primitive_size = 2;
+      break;
+    case PrimitiveType::kTriangleList:
+    case PrimitiveType::kRectangleList:
+      primitive_size = 3;
+      break;
+    case PrimitiveType::kQuadList:
+      primitive_size = 4;
+      break;
+    default:
+      return false;
+  }
+  if (pending.instance_count != 1 || pending.count % primitive_size ||
+      draw.first != pending.first + pending.count) {
+    return false;
+  }
+  pending.count += draw.count;
+  ++draw_batch_stats_.concatenated_draws;
   return true;
 }
 
+void VulkanCommandProcessor::FlushPendingDraw() {
+  if (!has_pending_draw_) {
+    return;
+  }
+  has_pending_draw_ = false;
+  ++draw_batch_stats_.recorded_draws;
+
+  auto& draw = pending_draw_;
+  if (!draw.indexed) {
+    vkCmdDraw(current_command_buffer_, draw.count, draw.instance_count,
+              draw.first, 0);
+  } else {
+    vkCmdDrawIndexed(current_command_buffer_, draw.count, draw.instance_count,
+                     draw.first, draw.vertex_offset, 0);
+  }
+}
+
+void VulkanCommandProcessor::ResetBoundState() {
+  assert_false(has_pending_draw_);
+  bound_state_.pipeline = nullptr;
+  bound_state_.constant_offsets[0] = UINT32_MAX;
+  bound_state_.constant_offsets[1] = UINT32_MAX;
+  bound_state_.vertex_set = nullptr;
+  bound_state_.texture_set = nullptr;
+  bound_state_.index_buffer = nullptr;
+  bound_state_.index_offset = 0;
+  bound_state_.index_type = VK_INDEX_TYPE_MAX_ENUM;
+}
+
 bool VulkanCommandProcessor::PopulateConstants(VkCommandBuffer command_buffer,
                                                VulkanShader* vertex_shader,
                                                VulkanShader* pixel_shader) {
@@ -747,6 +895,14 @@ bool VulkanCommandProcessor::PopulateConstants(VkCommandBuffer command_buffer,
   uint32_t set_constant_offsets[2] = {
       static_cast<uint32_t>(constant_offsets.first),
       static_cast<uint32_t>(constant_offsets.second)};
+  if (set_constant_offsets[0] == bound_state_.constant_offsets[0] &&
+      set_constant_offsets[1] == bound_state_.constant_offsets[1]) {
+    ++draw_batch_stats_.skipped_binds;
+    return true;
+  }
+  FlushPendingDraw();
+  bound_state_.constant_offsets[0] = set_constant_offsets[0];
+  bound_state_.constant_offsets[1] = set_constant_offsets[1];
   vkCmdBindDescriptorSets(
       command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1,
       &constant_descriptor_set,
@@ -757,7 +913,8 @@ bool VulkanCommandProcessor::PopulateConstants(VkCommandBuffer command_buffer,
 }
 
 bool VulkanCommandProcessor::PopulateIndexBuffer(
-    VkCommandBuffer command_buffer, IndexBufferInfo* index_buffer_info) {
+    VkCommandBuffer command_buffer, IndexBufferInfo* index_buffer_info,
+    uint32_t* first_index_out) {
   auto& regs = *register_file_;
   if (!index_buffer_info || !index_buffer_info->guest_base) {
     // No index buffer or auto draw.
@@ -794,12 +951,28 @@ bool VulkanCommandProcessor::PopulateIndexBuffer(
     return false;
   }
 
-  // Bind the buffer.
+  // Bind the buffer. Later ranges of an already bound buffer are reached
+  // with the first index instead, so draws from it can be batched.
   VkIndexType index_type = info.format == IndexFormat::kInt32
                                ? VK_INDEX_TYPE_UINT32
                                : VK_INDEX_TYPE_UINT16;
+  VkDeviceSize index_size =
+      info.format == IndexFormat::kInt32 ? sizeof(uint32_t) : sizeof(uint16_t);
+  if (buffer_ref.first == bound_state_.index_buffer &&
+      index_type == bound_state_.index_type &&
+      buffer_ref.second >= bound_state_.index_offset &&
+      (buffer_ref.second - bound_state_.index_offset) % index_size == 0) {
+    *first_index_out = static_cast<uint32_t>(
+        (buffer_ref.second - bound_state_.index_offset) / index_size);
+    ++draw_batch_stats_.skipped_binds;
+    return true;
+  }
+  FlushPendingDraw();
   vkCmdBindIndexBuffer(command_buffer, buffer_ref.first, buffer_ref.second,
                        index_type);
+  bound_state_.index_buffer = buffer_ref.first;
+  bound_state_.index_offset = buffer_ref.second;
+  bound_state_.index_type = index_type;
 
   return true;
 }
@@ -826,7 +999,13 @@ bool VulkanCommandProcessor::PopulateVertexBuffers(
     XELOGW("Failed to prepare vertex set!");
     return false;
   }
+  if (descriptor_set == bound_state_.vertex_set) {
+    ++draw_batch_stats_.skipped_binds;
+    return true;
+  }
 
+  FlushPendingDraw();
+  bound_state_.vertex_set = descriptor_set;
   vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           pipeline_cache_->pipeline_layout(), 2, 1,
                           &descriptor_set, 0, nullptr);
@@ -841,16 +1020,20 @@ bool VulkanCommandProcessor::PopulateSamplers(VkCommandBuffer command_buffer,
   SCOPE_profile_cpu_f("gpu");
 #endif  // FINE_GRAINED_DRAW_SCOPES
 
-  std::vector<xe::gpu::Shader::TextureBinding> dummy_bindings;
   auto descriptor_set = texture_cache_->PrepareTextureSet(
-      setup_buffer, current_batch_fence_, vertex_shader->texture_bindings(),
-      pixel_shader ? pixel_shader->texture_bindings() : dummy_bindings);
+      setup_buffer, current_batch_fence_, vertex_shader, pixel_shader);
   if (!descriptor_set) {
     // Unable to bind set.
     XELOGW("Failed to prepare texture set!");
     return false;
   }
+  if (descriptor_set == bound_state_.texture_set) {
+    ++draw_batch_stats_.skipped_binds;
+    return true;
+  }
 
+  FlushPendingDraw();
+  bound_state_.texture_set = descriptor_set;
   vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
                           pipeline_cache_->pipeline_layout(), 1, 1,
                           &descriptor_set, 0, nullptr);
@@ -1054,6 +1237,7 @@ bool VulkanCommandProcessor::IssueCopy() {
     BeginFrame();
   } else if (current_render_state_) {
     // Copy commands cannot be issued within a render pass.
+    FlushPendingDraw();
     render_cache_->EndRenderPass();
     current_render_state_ = nullptr;
   }
@@ -64,10 +64,34 @@ class VulkanCommandProcessor : public CommandProcessor {
   void ReturnFromWait() override;
 
   void WriteRegister(uint32_t index, uint32_t value) override;
+  void WriteRegisterRangeFromMem(uint32_t start_index, const uint32_t* base,
+                                 uint32_t count) override;
 
   void BeginFrame();
   void EndFrame();
 
+  // A draw that has passed all state setup but is not yet recorded, kept so
+  // that following draws with the same state can be merged into it.
+  struct PendingDraw {
+    bool indexed;
+    PrimitiveType primitive_type;
+    // First vertex for auto-indexed draws, first index otherwise.
+    uint32_t first;
+    uint32_t count;
+    uint32_t instance_count;
+    int32_t vertex_offset;
+  };
+  // Records the draw or merges it into the pending one.
+  void QueueDraw(const PendingDraw& draw);
+  bool MergePendingDraw(const PendingDraw& draw);
+  // Records the pending draw, if any. Must be called before anything else is
+  // recorded into current_command_buffer_. Uploads and their barriers go to
+  // current_setup_buffer_, which is submitted ahead of every draw of the
+  // batch, so they may be recorded while a draw is pending.
+  void FlushPendingDraw();
+  // Forgets what is bound so the next draw binds everything again.
+  void ResetBoundState();
+
   void CreateSwapImage(VkCommandBuffer setup_buffer, VkExtent2D extents);
   void DestroySwapImage();
 
@@ -84,7 +108,8 @@ class VulkanCommandProcessor : public CommandProcessor {
                          VulkanShader* vertex_shader,
                          VulkanShader* pixel_shader);
   bool PopulateIndexBuffer(VkCommandBuffer command_buffer,
-                           IndexBufferInfo* index_buffer_info);
+                           IndexBufferInfo* index_buffer_info,
+                           uint32_t* first_index_out);
   bool PopulateVertexBuffers(VkCommandBuffer command_buffer,
                              VkCommandBuffer setup_buffer,
                              VulkanShader* vertex_shader);
@@ -137,6 +162,29 @@ class VulkanCommandProcessor : public CommandProcessor {
   VkCommandBuffer current_command_buffer_ = nullptr;
   VkCommandBuffer current_setup_buffer_ = nullptr;
   VkFence current_batch_fence_;
+
+  bool has_pending_draw_ = false;
+  PendingDraw pending_draw_;
+
+  // State bound in the current command buffer, to skip redundant binds.
+  struct {
+    VkPipeline pipeline;
+    uint32_t constant_offsets[2];
+    VkDescriptorSet vertex_set;
+    VkDescriptorSet texture_set;
+    VkBuffer index_buffer;
+    VkDeviceSize index_offset;
+    VkIndexType index_type;
+  } bound_state_ = {};
+
+  // Draw batching counters for the current frame.
+  struct {
+    uint32_t draws;
+    uint32_t recorded_draws;
+    uint32_t instanced_draws;
+    uint32_t concatenated_draws;
+    uint32_t skipped_binds;
+  } draw_batch_stats_ = {};
 };
 
 }  // namespace vulkan
@@ -14,3 +14,16 @@ DEFINE_bool(vulkan_renderdoc_capture_all, false,
 DEFINE_bool(vulkan_native_msaa, false, "Use native MSAA");
 DEFINE_bool(vulkan_dump_disasm, false,
             "Dump shader disassembly. NVIDIA only supported.");
+DEFINE_int32(vulkan_texture_cache_budget_mb, 1024,
+             "Host memory budget for cached guest textures, in MiB. The least "
+             "recently used textures are evicted above it. 0 for no limit.");
+DEFINE_bool(vulkan_texture_dedup, false,
+            "Share one host image between textures with identical contents at "
+            "different guest addresses, found by hashing the guest data.");
+DEFINE_bool(vulkan_mirror_guest_buffers, true,
+            "Keep persistent copies of guest vertex and index buffers that "
+            "are only updated where the guest writes, instead of uploading "
+            "them for every draw.");
+DEFINE_bool(vulkan_batch_draws, true,
+            "Merge consecutive draws with identical state into one instanced "
+            "or longer draw and skip binding state that is already bound.");
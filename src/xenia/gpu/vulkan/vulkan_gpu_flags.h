@@ -17,5 +17,9 @@
 DECLARE_bool(vulkan_renderdoc_capture_all);
 DECLARE_bool(vulkan_native_msaa);
 DECLARE_bool(vulkan_dump_disasm);
+DECLARE_int32(vulkan_texture_cache_budget_mb);
+DECLARE_bool(vulkan_texture_dedup);
+DECLARE_bool(vulkan_mirror_guest_buffers);
+DECLARE_bool(vulkan_batch_draws);
 
 #endif  // XENIA_GPU_VULKAN_VULKAN_GPU_FLAGS_H_
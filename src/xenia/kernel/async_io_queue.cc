@@ -0,0 +1,82 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/async_io_queue.h"
+
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace kernel {
+
+AsyncIoQueue::AsyncIoQueue(uint32_t thread_count) {
+  threads_.reserve(thread_count);
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    threads_.emplace_back([this]() { WorkerMain(); });
+    threading::set_name(threads_.back().native_handle(),
+                        xe::format_string("Kernel Async I/O %u", i));
+  }
+}
+
+AsyncIoQueue::~AsyncIoQueue() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    shutting_down_ = true;
+  }
+  work_cv_.notify_all();
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+void AsyncIoQueue::Submit(std::function<void()> request) {
+  if (threads_.empty()) {
+    request();
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.push_back(std::move(request));
+  }
+  work_cv_.notify_one();
+}
+
+void AsyncIoQueue::Drain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_cv_.wait(lock,
+                [this]() { return requests_.empty() && !active_requests_; });
+}
+
+void AsyncIoQueue::WorkerMain() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_cv_.wait(lock,
+                  [this]() { return shutting_down_ || !requests_.empty(); });
+    // Outstanding requests still run when shutting down, as they hold
+    // references to guest objects and memory the guest is waiting on.
+    if (requests_.empty()) {
+      return;
+    }
+    auto request = std::move(requests_.front());
+    requests_.pop_front();
+    ++active_requests_;
+    lock.unlock();
+    request();
+    // Drop the references the request holds outside the lock.
+    request = nullptr;
+    lock.lock();
+    --active_requests_;
+    if (requests_.empty() && !active_requests_) {
+      idle_cv_.notify_all();
+    }
+  }
+}
+
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,59 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_ASYNC_IO_QUEUE_H_
+#define XENIA_KERNEL_ASYNC_IO_QUEUE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace xe {
+namespace kernel {
+
+// Host threads running file requests issued by guest threads for overlapped
+// I/O, so the issuing thread can keep executing while the host disk works.
+// Requests are started in submission order but may complete in any order.
+class AsyncIoQueue {
+ public:
+  // A thread_count of 0 disables the queue; callers then complete their
+  // requests synchronously.
+  explicit AsyncIoQueue(uint32_t thread_count);
+  // Completes all outstanding requests before returning.
+  ~AsyncIoQueue();
+
+  bool enabled() const { return !threads_.empty(); }
+
+  void Submit(std::function<void()> request);
+
+  // Blocks until every request submitted so far has completed.
+  void Drain();
+
+ private:
+  void WorkerMain();
+
+  std::vector<std::thread> threads_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  std::condition_variable work_cv_;
+  std::condition_variable idle_cv_;
+  std::deque<std::function<void()>> requests_;
+  size_t active_requests_ = 0;
+  bool shutting_down_ = false;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_ASYNC_IO_QUEUE_H_
@@ -11,6 +11,7 @@
 
 #include <gflags/gflags.h>
 
+#include <algorithm>
 #include <string>
 
 #include "xenia/base/assert.h"
@@ -33,6 +34,9 @@ DEFINE_bool(headless, false,
             "Don't display any UI, using defaults for prompts as needed.");
 DEFINE_string(content_root, "content",
               "Root path for content (save/etc) storage.");
+DEFINE_int32(async_io_threads, 2,
+             "Host threads completing overlapped file I/O. 0 completes it "
+             "synchronously on the issuing guest thread.");
 
 namespace xe {
 namespace kernel {
@@ -61,6 +65,9 @@ KernelState::KernelState(Emulator* emulator)
   content_root = xe::to_absolute_path(content_root);
   content_manager_ = std::make_unique<xam::ContentManager>(this, content_root);
 
+  async_io_queue_ = std::make_unique<AsyncIoQueue>(
+      uint32_t(std::max(FLAGS_async_io_threads, 0)));
+
   assert_null(shared_kernel_state_);
   shared_kernel_state_ = this;
 
@@ -79,6 +86,9 @@ KernelState::~KernelState() {
     dispatch_thread_->Wait(0, 0, 0, nullptr);
   }
 
+  // Outstanding I/O holds references to files and events.
+  async_io_queue_.reset();
+
   executable_module_.reset();
   user_modules_.clear();
   kernel_modules_.clear();
@@ -691,6 +701,8 @@ void KernelState::CompleteOverlappedDeferredEx(
 
 bool KernelState::Save(ByteStream* stream) {
   XELOGD("Serializing the kernel...");
+  // Let outstanding I/O land in guest memory before it is saved.
+  async_io_queue_->Drain();
   stream->Write('KRNL');
 
   // Save the object table
@@ -22,6 +22,7 @@
 #include "xenia/base/bit_map.h"
 #include "xenia/base/mutex.h"
 #include "xenia/cpu/export_resolver.h"
+#include "xenia/kernel/async_io_queue.h"
 #include "xenia/kernel/util/native_list.h"
 #include "xenia/kernel/util/object_table.h"
 #include "xenia/kernel/xam/app_manager.h"
@@ -107,6 +108,9 @@ class KernelState {
   }
   xam::UserProfile* user_profile() const { return user_profile_.get(); }
 
+  // Host threads completing overlapped file I/O.
+  AsyncIoQueue* async_io_queue() const { return async_io_queue_.get(); }
+
   // Access must be guarded by the global critical region.
   util::ObjectTable* object_table() { return &object_table_; }
 
@@ -190,6 +194,7 @@ class KernelState {
   std::unique_ptr<xam::AppManager> app_manager_;
   std::unique_ptr<xam::ContentManager> content_manager_;
   std::unique_ptr<xam::UserProfile> user_profile_;
+  std::unique_ptr<AsyncIoQueue> async_io_queue_;
 
   xe::global_critical_region global_critical_region_;
 
@@ -22,3 +22,28 @@ project("xenia-kernel")
   files({
     "debug_visualizers.natvis",
   })
+
+group("src")
+project("xenia-kernel-xex-bench")
+  uuid("c3f5e7a9-2d41-4b86-8e0f-6a9b1d3c5e72")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "capstone",
+    "gflags",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-cpu-backend-x64",
+    "xenia-kernel",
+    "xenia-ui",
+  })
+  defines({
+  })
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+  files({
+    "util/xex2_bench_main.cc",
+    "../base/main_"..platform_suffix..".cc",
+  })
@@ -25,10 +25,25 @@
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/worker_pool.h"
+
+#if XE_ARCH_AMD64
+#if XE_COMPILER_MSVC
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif  // XE_COMPILER_MSVC
+#include <wmmintrin.h>
+#endif  // XE_ARCH_AMD64
 
 namespace xe {}  // namespace xe
 
 DEFINE_bool(xex_dev_key, false, "Use the devkit key.");
+DEFINE_int32(xex_load_threads, 0,
+             "Host threads decrypting and copying XEX image data, including "
+             "the loading thread. 0 uses every logical processor.");
+DEFINE_bool(xex_aes_ni, true,
+            "Decrypt XEX images with AES-NI when the host supports it.");
 
 typedef struct xe_xex2 {
   xe::Memory* memory;
@@ -515,18 +530,139 @@ struct mspack_system* mspack_memory_sys_create() {
 }
 void mspack_memory_sys_destroy(struct mspack_system* sys) { free(sys); }
 
-void xe_xex2_decrypt_buffer(const uint8_t* session_key,
-                            const uint8_t* input_buffer,
-                            const size_t input_size, uint8_t* output_buffer,
-                            const size_t output_size) {
+#if XE_ARCH_AMD64
+#if XE_COMPILER_MSVC
+#define XE_TARGET_AES
+#else
+#define XE_TARGET_AES __attribute__((target("aes")))
+#endif  // XE_COMPILER_MSVC
+#endif  // XE_ARCH_AMD64
+
+// Session key schedule for decrypting image data with AES-128-CBC.
+typedef struct xe_xex2_aes {
   uint32_t rk[4 * (MAXNR + 1)];
-  uint8_t ivec[16] = {0};
-  int32_t Nr = rijndaelKeySetupDec(rk, session_key, 128);
-  const uint8_t* ct = input_buffer;
-  uint8_t* pt = output_buffer;
-  for (size_t n = 0; n < input_size; n += 16, ct += 16, pt += 16) {
+  int32_t nr;
+  bool use_aes_ni;
+#if XE_ARCH_AMD64
+  // Round keys for the AES-NI equivalent inverse cipher, in use order.
+  __m128i aes_ni_keys[11];
+#endif  // XE_ARCH_AMD64
+} xe_xex2_aes_t;
+
+static const uint8_t xe_xex2_zero_iv[16] = {0};
+
+#if XE_ARCH_AMD64
+static bool xe_xex2_host_has_aes_ni() {
+  uint32_t regs[4];
+#if XE_COMPILER_MSVC
+  __cpuidex(reinterpret_cast<int*>(regs), 1, 0);
+#else
+  __cpuid_count(1, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif  // XE_COMPILER_MSVC
+  return (regs[2] & (1u << 25)) != 0;
+}
+
+XE_TARGET_AES static void xe_xex2_aes_init_aes_ni(xe_xex2_aes_t* aes,
+                                                  const uint8_t* key) {
+  // AESDEC takes the encryption round keys in reverse, with InvMixColumns
+  // applied to all but the first and the last.
+  uint32_t ek[4 * (MAXNR + 1)];
+  rijndaelKeySetupEnc(ek, key, 128);
+  __m128i round_keys[11];
+  for (int r = 0; r < 11; r++) {
+    uint8_t round_key[16];
+    for (int i = 0; i < 4; i++) {
+      xe::store_and_swap<uint32_t>(round_key + i * 4, ek[r * 4 + i]);
+    }
+    round_keys[r] =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(round_key));
+  }
+  aes->aes_ni_keys[0] = round_keys[10];
+  for (int r = 1; r < 10; r++) {
+    aes->aes_ni_keys[r] = _mm_aesimc_si128(round_keys[10 - r]);
+  }
+  aes->aes_ni_keys[10] = round_keys[0];
+}
+
+XE_TARGET_AES static void xe_xex2_aes_cbc_decrypt_aes_ni(
+    const xe_xex2_aes_t* aes, const uint8_t* iv, const uint8_t* input,
+    uint8_t* output, size_t block_count) {
+  const __m128i* keys = aes->aes_ni_keys;
+  const __m128i* ct = reinterpret_cast<const __m128i*>(input);
+  __m128i* pt = reinterpret_cast<__m128i*>(output);
+  __m128i prev = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+  size_t n = 0;
+  // CBC decryption of each block only depends on ciphertext, so four blocks
+  // are kept in flight to hide the latency of AESDEC.
+  for (; n + 4 <= block_count; n += 4, ct += 4, pt += 4) {
+    __m128i c0 = _mm_loadu_si128(ct);
+    __m128i c1 = _mm_loadu_si128(ct + 1);
+    __m128i c2 = _mm_loadu_si128(ct + 2);
+    __m128i c3 = _mm_loadu_si128(ct + 3);
+    __m128i b0 = _mm_xor_si128(c0, keys[0]);
+    __m128i b1 = _mm_xor_si128(c1, keys[0]);
+    __m128i b2 = _mm_xor_si128(c2, keys[0]);
+    __m128i b3 = _mm_xor_si128(c3, keys[0]);
+    for (int r = 1; r < 10; r++) {
+      b0 = _mm_aesdec_si128(b0, keys[r]);
+      b1 = _mm_aesdec_si128(b1, keys[r]);
+      b2 = _mm_aesdec_si128(b2, keys[r]);
+      b3 = _mm_aesdec_si128(b3, keys[r]);
+    }
+    b0 = _mm_aesdeclast_si128(b0, keys[10]);
+    b1 = _mm_aesdeclast_si128(b1, keys[10]);
+    b2 = _mm_aesdeclast_si128(b2, keys[10]);
+    b3 = _mm_aesdeclast_si128(b3, keys[10]);
+    _mm_storeu_si128(pt, _mm_xor_si128(b0, prev));
+    _mm_storeu_si128(pt + 1, _mm_xor_si128(b1, c0));
+    _mm_storeu_si128(pt + 2, _mm_xor_si128(b2, c1));
+    _mm_storeu_si128(pt + 3, _mm_xor_si128(b3, c2));
+    prev = c3;
+  }
+  for (; n < block_count; n++, ct++, pt++) {
+    __m128i c = _mm_loadu_si128(ct);
+    __m128i b = _mm_xor_si128(c, keys[0]);
+    for (int r = 1; r < 10; r++) {
+      b = _mm_aesdec_si128(b, keys[r]);
+    }
+    b = _mm_aesdeclast_si128(b, keys[10]);
+    _mm_storeu_si128(pt, _mm_xor_si128(b, prev));
+    prev = c;
+  }
+}
+#endif  // XE_ARCH_AMD64
+
+void xe_xex2_aes_init(xe_xex2_aes_t* aes, const uint8_t* session_key) {
+  aes->nr = rijndaelKeySetupDec(aes->rk, session_key, 128);
+  aes->use_aes_ni = false;
+#if XE_ARCH_AMD64
+  static const bool host_has_aes_ni = xe_xex2_host_has_aes_ni();
+  if (FLAGS_xex_aes_ni && host_has_aes_ni) {
+    xe_xex2_aes_init_aes_ni(aes, session_key);
+    aes->use_aes_ni = true;
+  }
+#endif  // XE_ARCH_AMD64
+}
+
+// Decrypts length bytes continuing the CBC chain from iv. A trailing partial
+// block is decrypted whole.
+void xe_xex2_aes_cbc_decrypt(const xe_xex2_aes_t* aes, const uint8_t* iv,
+                             const uint8_t* input, uint8_t* output,
+                             size_t length) {
+  const size_t block_count = (length + 15) / 16;
+#if XE_ARCH_AMD64
+  if (aes->use_aes_ni) {
+    xe_xex2_aes_cbc_decrypt_aes_ni(aes, iv, input, output, block_count);
+    return;
+  }
+#endif  // XE_ARCH_AMD64
+  uint8_t ivec[16];
+  std::memcpy(ivec, iv, 16);
+  const uint8_t* ct = input;
+  uint8_t* pt = output;
+  for (size_t n = 0; n < block_count; n++, ct += 16, pt += 16) {
     // Decrypt 16 uint8_ts from input -> output.
-    rijndaelDecrypt(rk, Nr, ct, pt);
+    rijndaelDecrypt(aes->rk, aes->nr, ct, pt);
     for (size_t i = 0; i < 16; i++) {
       // XOR with previous.
       pt[i] ^= ivec[i];
@@ -536,6 +672,67 @@ void xe_xex2_decrypt_buffer(const uint8_t* session_key,
   }
 }
 
+// A span of image data that is decrypted (or just copied, without a key)
+// independently of all others: CBC only needs the previous ciphertext block
+// as the IV, and the ciphertext is all available up front.
+typedef struct xe_xex2_image_run {
+  const uint8_t* iv;
+  const uint8_t* src;
+  uint8_t* dest;
+  size_t length;
+} xe_xex2_image_run_t;
+
+// Multiple of the AES block size, large enough to amortize dispatch.
+static const size_t kXexImageRunSize = 256 * 1024;
+
+void xe_xex2_add_image_runs(std::vector<xe_xex2_image_run_t>* runs,
+                            const uint8_t* iv, const uint8_t* src,
+                            uint8_t* dest, size_t length) {
+  for (size_t offset = 0; offset < length; offset += kXexImageRunSize) {
+    xe_xex2_image_run_t run;
+    run.iv = offset ? src + offset - 16 : iv;
+    run.src = src + offset;
+    run.dest = dest + offset;
+    run.length = std::min(kXexImageRunSize, length - offset);
+    runs->push_back(run);
+  }
+}
+
+void xe_xex2_process_image_runs(const xe_xex2_aes_t* aes,
+                                const std::vector<xe_xex2_image_run_t>& runs) {
+  auto process_run = [aes, &runs](size_t i) {
+    const xe_xex2_image_run_t& run = runs[i];
+    if (aes) {
+      xe_xex2_aes_cbc_decrypt(aes, run.iv, run.src, run.dest, run.length);
+    } else {
+      std::memcpy(run.dest, run.src, run.length);
+    }
+  };
+  if (runs.size() < 2 || FLAGS_xex_load_threads == 1) {
+    for (size_t i = 0; i < runs.size(); i++) {
+      process_run(i);
+    }
+    return;
+  }
+  // The pool counts worker threads in addition to the loading thread.
+  uint32_t thread_count =
+      FLAGS_xex_load_threads > 1 ? uint32_t(FLAGS_xex_load_threads - 1) : 0;
+  xe::threading::WorkerPool pool("XEX Image Loader", thread_count);
+  pool.ParallelFor(runs.size(), process_run);
+}
+
+void xe_xex2_decrypt_buffer(const uint8_t* session_key,
+                            const uint8_t* input_buffer,
+                            const size_t input_size, uint8_t* output_buffer,
+                            const size_t output_size) {
+  xe_xex2_aes_t aes;
+  xe_xex2_aes_init(&aes, session_key);
+  std::vector<xe_xex2_image_run_t> runs;
+  xe_xex2_add_image_runs(&runs, xe_xex2_zero_iv, input_buffer, output_buffer,
+                         input_size);
+  xe_xex2_process_image_runs(&aes, runs);
+}
+
 int xe_xex2_read_image_uncompressed(const xe_xex2_header_t* header,
                                     const uint8_t* xex_addr,
                                     const uint32_t xex_length,
@@ -559,12 +756,14 @@ int xe_xex2_read_image_uncompressed(const xe_xex2_header_t* header,
 
   const uint8_t* p = (const uint8_t*)xex_addr + header->exe_offset;
 
+  std::vector<xe_xex2_image_run_t> runs;
   switch (header->file_format_info.encryption_type) {
     case XEX_ENCRYPTION_NONE:
       if (exe_length > uncompressed_size) {
         return 1;
       }
-      memcpy(buffer, p, exe_length);
+      xe_xex2_add_image_runs(&runs, nullptr, p, buffer, exe_length);
+      xe_xex2_process_image_runs(nullptr, runs);
       return 0;
     case XEX_ENCRYPTION_NORMAL:
       xe_xex2_decrypt_buffer(header->session_key, p, exe_length, buffer,
@@ -620,44 +819,41 @@ int xe_xex2_read_image_basic_compressed(const xe_xex2_header_t* header,
   std::memset(buffer, 0, total_size);  // Quickly zero the contents.
   uint8_t* d = buffer;
 
-  uint32_t rk[4 * (MAXNR + 1)];
-  uint8_t ivec[16] = {0};
-  int32_t Nr = rijndaelKeySetupDec(rk, header->session_key, 128);
+  xe_xex2_aes_t aes;
+  const xe_xex2_aes_t* block_aes = nullptr;
+  switch (header->file_format_info.encryption_type) {
+    case XEX_ENCRYPTION_NONE:
+      break;
+    case XEX_ENCRYPTION_NORMAL:
+      xe_xex2_aes_init(&aes, header->session_key);
+      block_aes = &aes;
+      break;
+    default:
+      assert_always();
+      return 1;
+  }
 
+  // The CBC chain runs across blocks, so the IV of each block is the last
+  // ciphertext block of the previous one.
+  std::vector<xe_xex2_image_run_t> runs;
+  const uint8_t* iv = xe_xex2_zero_iv;
   for (size_t n = 0; n < comp_info->block_count; n++) {
     const uint32_t data_size = comp_info->blocks[n].data_size;
     const uint32_t zero_size = comp_info->blocks[n].zero_size;
 
-    switch (header->file_format_info.encryption_type) {
-      case XEX_ENCRYPTION_NONE:
-        if (data_size > uncompressed_size - (d - buffer)) {
-          // Overflow.
-          return 1;
-        }
-        memcpy(d, p, data_size);
-        break;
-      case XEX_ENCRYPTION_NORMAL: {
-        const uint8_t* ct = p;
-        uint8_t* pt = d;
-        for (size_t m = 0; m < data_size; m += 16, ct += 16, pt += 16) {
-          // Decrypt 16 uint8_ts from input -> output.
-          rijndaelDecrypt(rk, Nr, ct, pt);
-          for (size_t i = 0; i < 16; i++) {
-            // XOR with previous.
-            pt[i] ^= ivec[i];
-            // Set previous.
-            ivec[i] = ct[i];
-          }
-        }
-      } break;
-      default:
-        assert_always();
-        return 1;
+    if (!block_aes && data_size > uncompressed_size - (d - buffer)) {
+      // Overflow.
+      return 1;
+    }
+    xe_xex2_add_image_runs(&runs, iv, p, d, data_size);
+    if (data_size) {
+      iv = p + xe::round_up(data_size, 16u) - 16;
     }
 
     p += data_size;
     d += data_size + zero_size;
   }
+  xe_xex2_process_image_runs(block_aes, runs);
 
   return 0;
 }
@@ -682,7 +878,6 @@ int xe_xex2_read_image_compressed(const xe_xex2_header_t* header,
   uint8_t* compress_buffer = NULL;
   const uint8_t* p = NULL;
   uint8_t* d = NULL;
-  uint8_t* deblock_buffer = NULL;
   size_t block_size = 0;
   uint32_t uncompressed_size = 0;
   struct mspack_system* sys = NULL;
@@ -700,8 +895,10 @@ int xe_xex2_read_image_compressed(const xe_xex2_header_t* header,
       break;
     case XEX_ENCRYPTION_NORMAL:
       // TODO: a way to do without a copy/alloc?
+      // Decrypted up front on all cores, as deblocking and decompression
+      // are serial. Whole AES blocks are written, so round up the size.
       free_input = true;
-      input_buffer = (const uint8_t*)calloc(1, input_size);
+      input_buffer = (const uint8_t*)calloc(1, xe::round_up(input_size, 16));
       xe_xex2_decrypt_buffer(header->session_key, exe_buffer, exe_length,
                              (uint8_t*)input_buffer, input_size);
       break;
@@ -716,7 +913,6 @@ int xe_xex2_read_image_compressed(const xe_xex2_header_t* header,
   d = compress_buffer;
 
   // De-block.
-  deblock_buffer = (uint8_t*)calloc(1, input_size);
   block_size = header->file_format_info.compression_info.normal.block_size;
   while (block_size) {
     const uint8_t* pnext = p + block_size;
@@ -787,7 +983,6 @@ int xe_xex2_read_image_compressed(const xe_xex2_header_t* header,
     sys = NULL;
   }
   free(compress_buffer);
-  free(deblock_buffer);
   if (free_input) {
     free((void*)input_buffer);
   }
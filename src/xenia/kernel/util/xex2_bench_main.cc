@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <gflags/gflags.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/base/mapped_memory.h"
+#include "xenia/base/string.h"
+#include "xenia/kernel/util/xex2.h"
+#include "xenia/memory.h"
+
+DECLARE_int32(xex_load_threads);
+DECLARE_bool(xex_aes_ni);
+
+DEFINE_int32(xex_bench_iterations, 10,
+             "Number of times each image is loaded per configuration.");
+
+namespace xe {
+namespace kernel {
+
+// Times xe_xex2_load (decryption, decompression and PE parsing into guest
+// memory) of the XEX images given on the command line, serially with the
+// table-based AES and with the host threading and AES-NI paths.
+class XexBench {
+ public:
+  bool Setup() {
+    memory_ = std::make_unique<Memory>();
+    return memory_->Initialize();
+  }
+
+  void Run(const std::wstring& path) {
+    auto mmap = MappedMemory::Open(path, MappedMemory::Mode::kRead);
+    if (!mmap) {
+      XELOGE("Unable to map %s", xe::to_string(path).c_str());
+      return;
+    }
+    XELOGI("%s: %zu bytes, %d iterations", xe::to_string(path).c_str(),
+           mmap->size(), FLAGS_xex_bench_iterations);
+
+    struct Configuration {
+      const char* name;
+      int32_t threads;
+      bool aes_ni;
+    };
+    static const Configuration kConfigurations[] = {
+        {"serial, table AES", 1, false},
+        {"serial, AES-NI", 1, true},
+        {"all threads, table AES", 0, false},
+        {"all threads, AES-NI", 0, true},
+    };
+    for (const auto& configuration : kConfigurations) {
+      FLAGS_xex_load_threads = configuration.threads;
+      FLAGS_xex_aes_ni = configuration.aes_ni;
+      if (!Measure(configuration.name, mmap.get())) {
+        break;
+      }
+    }
+  }
+
+ private:
+  bool Measure(const char* name, MappedMemory* mmap) {
+    double total_seconds = 0.0;
+    for (int32_t i = 0; i < FLAGS_xex_bench_iterations; ++i) {
+      uint64_t start = Clock::QueryHostTickCount();
+      xe_xex2_ref xex =
+          xe_xex2_load(memory_.get(), mmap->data(), mmap->size(), {0});
+      uint64_t ticks = Clock::QueryHostTickCount() - start;
+      if (!xex) {
+        XELOGE("  %s: load failed", name);
+        return false;
+      }
+      total_seconds += double(ticks) / double(Clock::host_tick_frequency());
+      // Free the image so the next load can map it at the same address.
+      uint32_t exe_address = xe_xex2_get_header(xex)->exe_address;
+      xe_xex2_dealloc(xex);
+      memory_->LookupHeap(exe_address)->Release(exe_address);
+    }
+    double per_load_ms =
+        total_seconds * 1000.0 / double(FLAGS_xex_bench_iterations);
+    XELOGI("  %-24s %9.3f ms %9.1f MB/s", name, per_load_ms,
+           double(mmap->size()) / (per_load_ms * 1000.0));
+    return true;
+  }
+
+  std::unique_ptr<Memory> memory_;
+};
+
+int xex_bench_main(const std::vector<std::wstring>& args) {
+  if (args.size() < 2) {
+    XELOGE("Usage: xenia-kernel-xex-bench some.xex [other.xex ...]");
+    return 1;
+  }
+  XexBench bench;
+  if (!bench.Setup()) {
+    XELOGE("Unable to initialize guest memory");
+    return 1;
+  }
+  for (size_t i = 1; i < args.size(); ++i) {
+    bench.Run(args[i]);
+  }
+  return 0;
+}
+
+}  // namespace kernel
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-kernel-xex-bench",
+                   L"xenia-kernel-xex-bench some.xex [other.xex ...]",
+                   xe::kernel::xex_bench_main);
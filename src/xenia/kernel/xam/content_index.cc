@@ -0,0 +1,242 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/xam/content_index.h"
+
+#include <cstring>
+#include <utility>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/mapped_memory.h"
+#include "xenia/base/string.h"
+
+namespace xe {
+namespace kernel {
+namespace xam {
+
+namespace {
+
+const uint32_t kContentIndexMagic = 'XCIX';
+const uint32_t kContentIndexVersion = 1;
+
+// Some hosts only keep write times to the second, so a folder modified in
+// the same second as it was listed may have changed again unnoticed.
+const uint64_t kSettleTime = 2 * 10000000ull;
+
+struct ContentIndexHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint64_t write_timestamp;
+  uint32_t package_count;
+  uint32_t string_data_size;
+};
+
+// Followed by the UTF-8 names the records point at.
+struct ContentIndexRecord {
+  uint32_t file_name_offset;
+  uint32_t file_name_length;
+  uint32_t display_name_offset;
+  uint32_t display_name_length;
+};
+
+}  // namespace
+
+ContentIndex::ContentIndex(std::wstring root_path)
+    : root_path_(std::move(root_path)) {
+  // content_root/title_id/type_name.index
+  index_path_ = root_path_;
+  while (!index_path_.empty() && index_path_.back() == xe::kWPathSeparator) {
+    index_path_.pop_back();
+  }
+  index_path_ += L".index";
+}
+
+void ContentIndex::Refresh() {
+  xe::filesystem::FileInfo info;
+  if (!xe::filesystem::GetInfo(root_path_, &info)) {
+    // Nothing was ever created.
+    loaded_ = true;
+    write_timestamp_ = 0;
+    SetPackages({});
+    return;
+  }
+  if (write_timestamp_ && info.write_timestamp == write_timestamp_) {
+    return;
+  }
+  if (!loaded_) {
+    loaded_ = true;
+    if (Load(info.write_timestamp)) {
+      return;
+    }
+  }
+  Rescan(info.write_timestamp);
+}
+
+const ContentIndex::Package* ContentIndex::Find(
+    const std::string& file_name) const {
+  auto it = package_indices_.find(file_name);
+  return it != package_indices_.end() ? &packages_[it->second] : nullptr;
+}
+
+void ContentIndex::Add(const std::string& file_name,
+                       const std::wstring& display_name) {
+  auto it = package_indices_.find(file_name);
+  if (it != package_indices_.end()) {
+    packages_[it->second].display_name = display_name;
+  } else {
+    package_indices_[file_name] = packages_.size();
+    packages_.push_back({file_name, display_name});
+  }
+  xe::filesystem::FileInfo info;
+  write_timestamp_ = xe::filesystem::GetInfo(root_path_, &info)
+                         ? info.write_timestamp
+                         : 0;
+  Save();
+}
+
+void ContentIndex::Remove(const std::string& file_name) {
+  auto it = package_indices_.find(file_name);
+  if (it != package_indices_.end()) {
+    size_t index = it->second;
+    package_indices_.erase(it);
+    if (index != packages_.size() - 1) {
+      packages_[index] = std::move(packages_.back());
+      package_indices_[packages_[index].file_name] = index;
+    }
+    packages_.pop_back();
+  }
+  xe::filesystem::FileInfo info;
+  write_timestamp_ = xe::filesystem::GetInfo(root_path_, &info)
+                         ? info.write_timestamp
+                         : 0;
+  Save();
+}
+
+bool ContentIndex::Load(uint64_t write_timestamp) {
+  auto mmap = MappedMemory::Open(index_path_, MappedMemory::Mode::kRead);
+  if (!mmap || mmap->size() < sizeof(ContentIndexHeader)) {
+    return false;
+  }
+  // Anything unexpected discards the whole index.
+  auto header = reinterpret_cast<const ContentIndexHeader*>(mmap->data());
+  size_t records_size =
+      size_t(header->package_count) * sizeof(ContentIndexRecord);
+  if (header->magic != kContentIndexMagic ||
+      header->version != kContentIndexVersion ||
+      mmap->size() != sizeof(ContentIndexHeader) + records_size +
+                          header->string_data_size) {
+    return false;
+  }
+  auto records = reinterpret_cast<const ContentIndexRecord*>(header + 1);
+  auto string_data = reinterpret_cast<const char*>(mmap->data()) +
+                     sizeof(ContentIndexHeader) + records_size;
+  uint32_t string_data_size = header->string_data_size;
+  auto in_bounds = [string_data_size](uint32_t offset, uint32_t length) {
+    return offset <= string_data_size && length <= string_data_size - offset;
+  };
+  std::vector<Package> packages(header->package_count);
+  for (uint32_t i = 0; i < header->package_count; ++i) {
+    auto& record = records[i];
+    if (!in_bounds(record.file_name_offset, record.file_name_length) ||
+        !in_bounds(record.display_name_offset, record.display_name_length)) {
+      return false;
+    }
+    packages[i].file_name.assign(string_data + record.file_name_offset,
+                                 record.file_name_length);
+    packages[i].display_name = xe::to_wstring(
+        std::string(string_data + record.display_name_offset,
+                    record.display_name_length));
+  }
+  // Even if the folder changed since, the display names are still good.
+  SetPackages(std::move(packages));
+  if (!header->write_timestamp || header->write_timestamp != write_timestamp) {
+    return false;
+  }
+  write_timestamp_ = write_timestamp;
+  return true;
+}
+
+void ContentIndex::Save() {
+  std::vector<ContentIndexRecord> records(packages_.size());
+  std::string string_data;
+  for (size_t i = 0; i < packages_.size(); ++i) {
+    auto& record = records[i];
+    record.file_name_offset = uint32_t(string_data.size());
+    record.file_name_length = uint32_t(packages_[i].file_name.size());
+    string_data += packages_[i].file_name;
+    auto display_name = xe::to_string(packages_[i].display_name);
+    record.display_name_offset = uint32_t(string_data.size());
+    record.display_name_length = uint32_t(display_name.size());
+    string_data += display_name;
+  }
+
+  FILE* file = xe::filesystem::OpenFile(index_path_, "wb");
+  if (!file) {
+    XELOGW("Unable to write the content index %s",
+           xe::to_string(index_path_).c_str());
+    return;
+  }
+  // Written invalid, then given the folder's write time once the index is
+  // known to be newer than it by enough to tell.
+  ContentIndexHeader header;
+  header.magic = kContentIndexMagic;
+  header.version = kContentIndexVersion;
+  header.write_timestamp = 0;
+  header.package_count = uint32_t(records.size());
+  header.string_data_size = uint32_t(string_data.size());
+  fwrite(&header, sizeof(header), 1, file);
+  fwrite(records.data(), sizeof(ContentIndexRecord), records.size(), file);
+  fwrite(string_data.data(), 1, string_data.size(), file);
+  fflush(file);
+
+  xe::filesystem::FileInfo index_info;
+  if (write_timestamp_ &&
+      xe::filesystem::GetInfo(index_path_, &index_info) &&
+      index_info.write_timestamp >= write_timestamp_ + kSettleTime) {
+    header.write_timestamp = write_timestamp_;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+  } else {
+    // Rescan on the next refresh, by when it may have settled.
+    write_timestamp_ = 0;
+  }
+  fclose(file);
+}
+
+void ContentIndex::Rescan(uint64_t write_timestamp) {
+  // Packages are folders; display names are only known for those created
+  // through the index, and others are shown under their folder name.
+  std::vector<Package> packages;
+  for (const auto& file_info : xe::filesystem::ListFiles(root_path_)) {
+    if (file_info.type != xe::filesystem::FileInfo::Type::kDirectory) {
+      continue;
+    }
+    Package package;
+    package.file_name = xe::to_string(file_info.name);
+    auto known = Find(package.file_name);
+    package.display_name = known ? known->display_name : file_info.name;
+    packages.push_back(std::move(package));
+  }
+  write_timestamp_ = write_timestamp;
+  SetPackages(std::move(packages));
+  Save();
+}
+
+void ContentIndex::SetPackages(std::vector<Package> packages) {
+  packages_ = std::move(packages);
+  package_indices_.clear();
+  for (size_t i = 0; i < packages_.size(); ++i) {
+    package_indices_[packages_[i].file_name] = i;
+  }
+}
+
+}  // namespace xam
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,78 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_XAM_CONTENT_INDEX_H_
+#define XENIA_KERNEL_XAM_CONTENT_INDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/platform.h"
+#include "xenia/vfs/entry.h"
+
+namespace xe {
+namespace kernel {
+namespace xam {
+
+// The packages in one content_root/title_id/type_name/ folder, with the
+// display names titles created them with. Kept in a packed .index file beside
+// the folder, so listing packages and checking for one only costs a stat of
+// the folder while it is unchanged, including in later sessions.
+// Not thread safe.
+class ContentIndex {
+ public:
+  struct Package {
+    std::string file_name;
+    std::wstring display_name;
+  };
+
+  // root_path is the folder of the packages, ending in a separator.
+  explicit ContentIndex(std::wstring root_path);
+
+  // Rescans the folder if it was modified since the index was built.
+  void Refresh();
+
+  const std::vector<Package>& packages() const { return packages_; }
+  const Package* Find(const std::string& file_name) const;
+
+  // Records a package folder that was just created or deleted. Refresh
+  // before changing the folder, so the change isn't taken for another.
+  void Add(const std::string& file_name, const std::wstring& display_name);
+  void Remove(const std::string& file_name);
+
+ private:
+  // Returns false if there is no index, or if it is out of date.
+  bool Load(uint64_t write_timestamp);
+  void Save();
+  void Rescan(uint64_t write_timestamp);
+  void SetPackages(std::vector<Package> packages);
+
+  std::wstring root_path_;
+  std::wstring index_path_;
+  bool loaded_ = false;
+  // Write time of the folder the packages were listed at, or 0 if it was
+  // modified too recently for the time to tell later changes apart.
+  uint64_t write_timestamp_ = 0;
+  std::vector<Package> packages_;
+  // Names are looked up the way the host file system would find them.
+#if XE_PLATFORM_WIN32
+  std::unordered_map<std::string, size_t, vfs::EntryNameHash,
+                     vfs::EntryNameEqual>
+      package_indices_;
+#else
+  std::unordered_map<std::string, size_t> package_indices_;
+#endif  // XE_PLATFORM_WIN32
+};
+
+}  // namespace xam
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_XAM_CONTENT_INDEX_H_
@@ -9,6 +9,8 @@
 
 #include "xenia/kernel/xam/content_manager.h"
 
+#include <gflags/gflags.h>
+
 #include <string>
 
 #include "xenia/base/filesystem.h"
@@ -17,6 +19,11 @@
 #include "xenia/kernel/xobject.h"
 #include "xenia/vfs/devices/host_path_device.h"
 
+DEFINE_bool(content_index, true,
+            "Keep an index of the content packages of each title beside its "
+            "content folders, rather than listing the folders on every "
+            "enumeration.");
+
 namespace xe {
 namespace kernel {
 namespace xam {
@@ -96,10 +103,37 @@ std::wstring ContentManager::ResolvePackagePath(const XCONTENT_DATA& data) {
   return package_path;
 }
 
+ContentIndex* ContentManager::GetContentIndex(uint32_t content_type) {
+  if (!FLAGS_content_index) {
+    return nullptr;
+  }
+  auto package_root = ResolvePackageRoot(content_type);
+  auto& index = content_indices_[package_root];
+  if (!index) {
+    index = std::make_unique<ContentIndex>(package_root);
+  }
+  index->Refresh();
+  return index.get();
+}
+
 std::vector<XCONTENT_DATA> ContentManager::ListContent(uint32_t device_id,
                                                        uint32_t content_type) {
   std::vector<XCONTENT_DATA> result;
 
+  auto global_lock = global_critical_region_.Acquire();
+  auto index = GetContentIndex(content_type);
+  if (index) {
+    for (const auto& package : index->packages()) {
+      XCONTENT_DATA content_data;
+      content_data.device_id = device_id;
+      content_data.content_type = content_type;
+      content_data.display_name = package.display_name;
+      content_data.file_name = package.file_name;
+      result.emplace_back(std::move(content_data));
+    }
+    return result;
+  }
+
   // Search path:
   // content_root/title_id/type_name/*
   auto package_root = ResolvePackageRoot(content_type);
@@ -135,6 +169,11 @@ std::unique_ptr<ContentPackage> ContentManager::ResolvePackage(
 }
 
 bool ContentManager::ContentExists(const XCONTENT_DATA& data) {
+  auto global_lock = global_critical_region_.Acquire();
+  auto index = GetContentIndex(data.content_type);
+  if (index) {
+    return index->Find(data.file_name) != nullptr;
+  }
   auto path = ResolvePackagePath(data);
   return xe::filesystem::PathExists(path);
 }
@@ -154,9 +193,13 @@ X_RESULT ContentManager::CreateContent(std::string root_name,
     return X_ERROR_ALREADY_EXISTS;
   }
 
+  auto index = GetContentIndex(data.content_type);
   if (!xe::filesystem::CreateFolder(package_path)) {
     return X_ERROR_ACCESS_DENIED;
   }
+  if (index) {
+    index->Add(data.file_name, data.display_name);
+  }
 
   auto package = ResolvePackage(root_name, data);
   assert_not_null(package);
@@ -245,7 +288,11 @@ X_RESULT ContentManager::DeleteContent(const XCONTENT_DATA& data) {
 
   auto package_path = ResolvePackagePath(data);
   if (xe::filesystem::PathExists(package_path)) {
+    auto index = GetContentIndex(data.content_type);
     xe::filesystem::DeleteFolder(package_path);
+    if (index) {
+      index->Remove(data.file_name);
+    }
     return X_ERROR_SUCCESS;
   } else {
     return X_ERROR_FILE_NOT_FOUND;
@@ -17,6 +17,7 @@
 
 #include "xenia/base/memory.h"
 #include "xenia/base/mutex.h"
+#include "xenia/kernel/xam/content_index.h"
 #include "xenia/xbox.h"
 
 namespace xe {
@@ -88,6 +89,9 @@ class ContentManager {
  private:
   std::wstring ResolvePackageRoot(uint32_t content_type);
   std::wstring ResolvePackagePath(const XCONTENT_DATA& data);
+  // Returns the up to date index of the packages of the content type, or
+  // nullptr if indexing is disabled. Call with the lock held.
+  ContentIndex* GetContentIndex(uint32_t content_type);
 
   KernelState* kernel_state_;
   std::wstring root_path_;
@@ -95,6 +99,9 @@ class ContentManager {
   // TODO(benvanik): remove use of global lock, it's bad here!
   xe::global_critical_region global_critical_region_;
   std::unordered_map<std::string, ContentPackage*> open_packages_;
+  // By package root, as the title may change.
+  std::unordered_map<std::wstring, std::unique_ptr<ContentIndex>>
+      content_indices_;
 };
 
 }  // namespace xam
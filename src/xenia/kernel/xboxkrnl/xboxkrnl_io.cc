@@ -18,6 +18,7 @@
 #include "xenia/kernel/xiocompletion.h"
 #include "xenia/kernel/xthread.h"
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/io_trace.h"
 #include "xenia/xbox.h"
 
 namespace xe {
@@ -107,9 +108,14 @@ dword_result_t NtCreateFile(lpdword_t handle_out, dword_t desired_access,
   // Attempt open (or create).
   vfs::File* vfs_file;
   vfs::FileAction file_action;
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
   X_STATUS result = kernel_state()->file_system()->OpenFile(
       target_path, vfs::FileDisposition((uint32_t)creation_disposition),
       desired_access, &vfs_file, &file_action);
+  vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kOpen,
+                       XSUCCEEDED(result) ? vfs_file->entry()->absolute_path()
+                                          : target_path,
+                       0, 0, result);
   object_ref<XFile> file = nullptr;
 
   X_HANDLE handle = X_INVALID_HANDLE_VALUE;
@@ -146,6 +152,37 @@ dword_result_t NtOpenFile(lpdword_t handle_out, dword_t desired_access,
 }
 DECLARE_XBOXKRNL_EXPORT(NtOpenFile, ExportTag::kImplemented);
 
+// Builds the completion of an asynchronous NtReadFile or NtWriteFile, run on
+// a host I/O thread. It mirrors what the synchronous path does inline.
+XFile::AsyncCompletion MakeAsyncCompletion(object_ref<XEvent> ev,
+                                           uint32_t apc_routine,
+                                           uint32_t apc_context,
+                                           uint32_t io_status_block_ptr) {
+  object_ref<XThread> thread;
+  // Low bit probably means do not queue to IO ports.
+  if ((apc_routine & ~1u) && apc_context) {
+    thread = retain_object(XThread::GetCurrentThread());
+  }
+  return [ev, thread, apc_routine, apc_context, io_status_block_ptr](
+             X_STATUS result, size_t bytes_transferred) {
+    if (io_status_block_ptr) {
+      auto io_status_block =
+          kernel_memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+              io_status_block_ptr);
+      io_status_block->status = result;
+      io_status_block->information =
+          XSUCCEEDED(result) ? static_cast<uint32_t>(bytes_transferred) : 0;
+    }
+    if (thread) {
+      thread->EnqueueApc(apc_routine & ~1u, apc_context, io_status_block_ptr,
+                         0);
+    }
+    if (ev) {
+      ev->Set(0, false);
+    }
+  };
+}
+
 dword_result_t NtReadFile(dword_t file_handle, dword_t event_handle,
                           lpvoid_t apc_routine_ptr, lpvoid_t apc_context,
                           pointer_t<X_IO_STATUS_BLOCK> io_status_block,
@@ -165,21 +202,13 @@ dword_result_t NtReadFile(dword_t file_handle, dword_t event_handle,
   }
 
   if (XSUCCEEDED(result)) {
-    if (true || file->is_synchronous()) {
-      // some games NtReadFile() directly into texture memory
-      // TODO(rick): better checking of physical address
-      if (buffer.guest_address() >= 0xA0000000) {
-        auto heap = kernel_memory()->LookupHeap(buffer.guest_address());
-        cpu::MMIOHandler::global_handler()->InvalidateRange(
-            heap->GetPhysicalAddress(buffer.guest_address()), buffer_length);
-      }
-
+    size_t byte_offset =
+        byte_offset_ptr ? static_cast<size_t>(*byte_offset_ptr) : -1;
+    if (!file->CanCompleteAsync(byte_offset)) {
       // Synchronous.
       size_t bytes_read = 0;
-      result = file->Read(
-          buffer, buffer_length,
-          byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1,
-          &bytes_read, apc_context);
+      result = file->Read(buffer, buffer_length, byte_offset, &bytes_read,
+                          apc_context);
       if (io_status_block) {
         io_status_block->status = result;
         io_status_block->information = static_cast<uint32_t>(bytes_read);
@@ -204,22 +233,18 @@ dword_result_t NtReadFile(dword_t file_handle, dword_t event_handle,
       // we have written the info out.
       signal_event = true;
     } else {
-      // TODO(benvanik): async.
-
-      // X_STATUS_PENDING if not returning immediately.
-      // XFile is waitable and signalled after each async req completes.
-      // reset the input event (->Reset())
-      /*xeNtReadFileState* call_state = new xeNtReadFileState();
-      XAsyncRequest* request = new XAsyncRequest(
-      state, file,
-      (XAsyncRequest::CompletionCallback)xeNtReadFileCompleted,
-      call_state);*/
-      // result = file->Read(buffer, buffer_length, byte_offset, request);
+      // The host I/O threads fill the status block, queue the APC and signal
+      // the event once the data is in place.
       if (io_status_block) {
         io_status_block->status = X_STATUS_PENDING;
         io_status_block->information = 0;
       }
-
+      if (ev) {
+        ev->Reset();
+      }
+      file->ReadAsync(buffer, buffer_length, byte_offset, apc_context,
+                      MakeAsyncCompletion(ev, apc_routine_ptr, apc_context,
+                                          io_status_block.guest_address()));
       result = X_STATUS_PENDING;
     }
   }
@@ -243,9 +268,6 @@ dword_result_t NtWriteFile(dword_t file_handle, dword_t event_handle,
                            pointer_t<X_IO_STATUS_BLOCK> io_status_block,
                            lpvoid_t buffer, dword_t buffer_length,
                            lpqword_t byte_offset_ptr) {
-  // Async not supported yet.
-  assert_zero(apc_routine);
-
   X_STATUS result = X_STATUS_SUCCESS;
   uint32_t info = 0;
 
@@ -264,14 +286,14 @@ dword_result_t NtWriteFile(dword_t file_handle, dword_t event_handle,
 
   // Execute write.
   if (XSUCCEEDED(result)) {
-    // TODO(benvanik): async path.
-    if (true || file->is_synchronous()) {
+    uint32_t apc_routine_ptr = static_cast<uint32_t>(apc_routine);
+    size_t byte_offset =
+        byte_offset_ptr ? static_cast<size_t>(*byte_offset_ptr) : -1;
+    if (!file->CanCompleteAsync(byte_offset)) {
       // Synchronous request.
       size_t bytes_written = 0;
-      result = file->Write(
-          buffer, buffer_length,
-          byte_offset_ptr ? static_cast<uint64_t>(*byte_offset_ptr) : -1,
-          &bytes_written, apc_context);
+      result = file->Write(buffer, buffer_length, byte_offset, &bytes_written,
+                           apc_context);
       if (XSUCCEEDED(result)) {
         info = (int32_t)bytes_written;
       }
@@ -285,18 +307,30 @@ dword_result_t NtWriteFile(dword_t file_handle, dword_t event_handle,
         io_status_block->information = info;
       }
 
+      // Queue the APC callback, as for reads.
+      if (apc_routine_ptr & ~1) {
+        if (apc_context) {
+          auto thread = XThread::GetCurrentThread();
+          thread->EnqueueApc(apc_routine_ptr & ~1u, apc_context,
+                             io_status_block, 0);
+        }
+      }
+
       // Mark that we should signal the event now. We do this after
       // we have written the info out.
       signal_event = true;
     } else {
-      // X_STATUS_PENDING if not returning immediately.
-      result = X_STATUS_PENDING;
-      info = 0;
-
       if (io_status_block) {
-        io_status_block->status = X_STATUS_SUCCESS;
-        io_status_block->information = info;
+        io_status_block->status = X_STATUS_PENDING;
+        io_status_block->information = 0;
       }
+      if (ev) {
+        ev->Reset();
+      }
+      file->WriteAsync(buffer, buffer_length, byte_offset, apc_context,
+                       MakeAsyncCompletion(ev, apc_routine_ptr, apc_context,
+                                           io_status_block.guest_address()));
+      result = X_STATUS_PENDING;
     }
   }
 
@@ -570,8 +604,12 @@ dword_result_t NtQueryFullAttributesFile(
   }
 
   // Resolve the file using the virtual file system.
-  auto entry = kernel_state()->file_system()->ResolvePath(
-      object_name->to_string(kernel_memory()->virtual_membase()));
+  auto path = object_name->to_string(kernel_memory()->virtual_membase());
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
+  auto entry = kernel_state()->file_system()->ResolvePath(path);
+  vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kQueryAttributes,
+                       entry ? entry->absolute_path() : path, 0, 0,
+                       entry ? X_STATUS_SUCCESS : X_STATUS_NO_SUCH_FILE);
   if (entry) {
     // Found.
     file_info->creation_time = entry->create_timestamp();
@@ -681,9 +719,18 @@ dword_result_t NtQueryDirectoryFile(
       file_name ? file_name->to_string(kernel_memory()->virtual_membase()) : "";
   if (file) {
     X_FILE_DIRECTORY_INFORMATION dir_info = {0};
+    uint64_t trace_ticks = vfs::IoTrace::Begin();
     result = file->QueryDirectory(file_info_ptr, length,
                                   !name.empty() ? name.c_str() : nullptr,
                                   restart_scan != 0);
+    if (trace_ticks) {
+      // A name filter always restarts the scan.
+      const auto& path = file->file()->entry()->absolute_path();
+      vfs::IoTrace::Append(
+          trace_ticks, vfs::IoTraceRecord::Op::kQueryDirectory,
+          name.empty() ? path : xe::join_paths(path, name),
+          restart_scan || !name.empty() ? 1 : 0, name.size(), result);
+    }
     if (XSUCCEEDED(result)) {
       info = length;
     }
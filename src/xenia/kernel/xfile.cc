@@ -12,8 +12,10 @@
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/cpu/mmio_handler.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/xevent.h"
+#include "xenia/vfs/io_trace.h"
 
 namespace xe {
 namespace kernel {
@@ -96,8 +98,13 @@ X_STATUS XFile::Read(void* buffer, size_t buffer_length, size_t byte_offset,
   }
 
   size_t bytes_read = 0;
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
+  InvalidatePhysicalBuffer(buffer, buffer_length);
   X_STATUS result =
       file_->ReadSync(buffer, buffer_length, byte_offset, &bytes_read);
+  vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kRead,
+                       file_->entry()->absolute_path(), byte_offset,
+                       buffer_length, result);
   if (XSUCCEEDED(result)) {
     position_ += bytes_read;
   }
@@ -126,8 +133,12 @@ X_STATUS XFile::Write(const void* buffer, size_t buffer_length,
   }
 
   size_t bytes_written = 0;
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
   X_STATUS result =
       file_->WriteSync(buffer, buffer_length, byte_offset, &bytes_written);
+  vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kWrite,
+                       file_->entry()->absolute_path(), byte_offset,
+                       buffer_length, result);
   if (XSUCCEEDED(result)) {
     position_ += bytes_written;
   }
@@ -147,6 +158,84 @@ X_STATUS XFile::Write(const void* buffer, size_t buffer_length,
   return result;
 }
 
+bool XFile::CanCompleteAsync(size_t byte_offset) const {
+  return !is_synchronous_ && byte_offset != size_t(-1) &&
+         kernel_state()->async_io_queue()->enabled();
+}
+
+void XFile::ReadAsync(void* buffer, size_t buffer_length, size_t byte_offset,
+                      uint32_t apc_context, AsyncCompletion completion) {
+  assert_true(CanCompleteAsync(byte_offset));
+  async_event_->Reset();
+  auto file = retain_object(this);
+  // Traced from submission, so time spent queued counts towards latency.
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
+  kernel_state()->async_io_queue()->Submit([file, buffer, buffer_length,
+                                            byte_offset, apc_context,
+                                            completion, trace_ticks]() {
+    size_t bytes_read = 0;
+    // Not at submission, or the GPU could cache the old contents again
+    // before the read lands.
+    file->InvalidatePhysicalBuffer(buffer, buffer_length);
+    X_STATUS result = file->file_->ReadSync(buffer, buffer_length, byte_offset,
+                                            &bytes_read);
+    vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kRead,
+                         file->file_->entry()->absolute_path(), byte_offset,
+                         buffer_length, result);
+    file->CompleteAsync(result, bytes_read, apc_context, completion);
+  });
+}
+
+void XFile::WriteAsync(const void* buffer, size_t buffer_length,
+                       size_t byte_offset, uint32_t apc_context,
+                       AsyncCompletion completion) {
+  assert_true(CanCompleteAsync(byte_offset));
+  async_event_->Reset();
+  auto file = retain_object(this);
+  uint64_t trace_ticks = vfs::IoTrace::Begin();
+  kernel_state()->async_io_queue()->Submit([file, buffer, buffer_length,
+                                            byte_offset, apc_context,
+                                            completion, trace_ticks]() {
+    size_t bytes_written = 0;
+    X_STATUS result = file->file_->WriteSync(buffer, buffer_length,
+                                             byte_offset, &bytes_written);
+    vfs::IoTrace::Append(trace_ticks, vfs::IoTraceRecord::Op::kWrite,
+                         file->file_->entry()->absolute_path(), byte_offset,
+                         buffer_length, result);
+    file->CompleteAsync(result, bytes_written, apc_context, completion);
+  });
+}
+
+void XFile::InvalidatePhysicalBuffer(const void* buffer,
+                                     size_t buffer_length) {
+  // TODO(rick): better checking of physical address
+  auto host_address = reinterpret_cast<const uint8_t*>(buffer);
+  auto membase = memory()->virtual_membase();
+  if (host_address < membase + 0xA0000000 ||
+      host_address >= membase + 0x100000000ull) {
+    return;
+  }
+  uint32_t guest_address = uint32_t(host_address - membase);
+  auto heap = memory()->LookupHeap(guest_address);
+  cpu::MMIOHandler::global_handler()->InvalidateRange(
+      heap->GetPhysicalAddress(guest_address), uint32_t(buffer_length));
+}
+
+void XFile::CompleteAsync(X_STATUS result, size_t bytes_transferred,
+                          uint32_t apc_context,
+                          const AsyncCompletion& completion) {
+  // The status block must be written before anyone waiting is released.
+  completion(result, bytes_transferred);
+
+  XIOCompletion::IONotification notify;
+  notify.apc_context = apc_context;
+  notify.num_bytes = uint32_t(bytes_transferred);
+  notify.status = result;
+  NotifyIOCompletionPorts(notify);
+
+  async_event_->Set();
+}
+
 X_STATUS XFile::SetLength(size_t length) { return file_->SetLength(length); }
 
 void XFile::RegisterIOCompletionPort(uint32_t key,
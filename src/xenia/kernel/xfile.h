@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XFILE_H_
 #define XENIA_KERNEL_XFILE_H_
 
+#include <functional>
 #include <string>
 
 #include "xenia/base/filesystem.h"
@@ -81,6 +82,11 @@ class XFile : public XObject {
  public:
   static const Type kType = kTypeFile;
 
+  // Called on an I/O thread with the outcome of an asynchronous request,
+  // before completion ports are notified and the file is signalled.
+  typedef std::function<void(X_STATUS result, size_t bytes_transferred)>
+      AsyncCompletion;
+
   XFile(KernelState* kernel_state, vfs::File* file, bool synchronous);
   ~XFile() override;
 
@@ -104,6 +110,19 @@ class XFile : public XObject {
   X_STATUS Write(const void* buffer, size_t buffer_length, size_t byte_offset,
                  size_t* out_bytes_written, uint32_t apc_context);
 
+  // Whether a request at byte_offset (-1 for the current position) may be
+  // completed asynchronously. Synchronous files and requests relative to the
+  // current position must go through Read and Write.
+  bool CanCompleteAsync(size_t byte_offset) const;
+
+  // Queues a request on the kernel I/O threads. The buffer must stay valid
+  // until completion is called. The file position is left untouched, as for
+  // overlapped I/O on the console.
+  void ReadAsync(void* buffer, size_t buffer_length, size_t byte_offset,
+                 uint32_t apc_context, AsyncCompletion completion);
+  void WriteAsync(const void* buffer, size_t buffer_length, size_t byte_offset,
+                  uint32_t apc_context, AsyncCompletion completion);
+
   X_STATUS SetLength(size_t length);
 
   void RegisterIOCompletionPort(uint32_t key, object_ref<XIOCompletion> port);
@@ -117,6 +136,11 @@ class XFile : public XObject {
 
  protected:
   void NotifyIOCompletionPorts(XIOCompletion::IONotification& notification);
+  void CompleteAsync(X_STATUS result, size_t bytes_transferred,
+                     uint32_t apc_context, const AsyncCompletion& completion);
+  // Some games read directly into texture memory, so GPU caches of physical
+  // memory must drop the buffer right before it is read into.
+  void InvalidatePhysicalBuffer(const void* buffer, size_t buffer_length);
 
   xe::threading::WaitHandle* GetWaitHandle() override {
     return async_event_.get();
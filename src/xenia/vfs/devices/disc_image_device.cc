@@ -9,6 +9,7 @@
 
 #include "xenia/vfs/devices/disc_image_device.h"
 
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/vfs/devices/disc_image_entry.h"
@@ -25,6 +26,7 @@ DiscImageDevice::DiscImageDevice(const std::string& mount_path,
 DiscImageDevice::~DiscImageDevice() = default;
 
 bool DiscImageDevice::Initialize() {
+  uint64_t start_ticks = Clock::QueryHostTickCount();
   mmap_ = MappedMemory::Open(local_path_, MappedMemory::Mode::kRead);
   if (!mmap_) {
     XELOGE("Disc image could not be mapped");
@@ -40,12 +42,22 @@ bool DiscImageDevice::Initialize() {
     return false;
   }
 
-  result = ReadAllEntries(&state, state.ptr + state.root_offset);
-  if (result != Error::kSuccess) {
-    XELOGE("Failed to read all GDFX entries: %d", result);
+  // Only the root directory is read when mounting; the others are read from
+  // the image when first looked up or enumerated.
+  game_offset_ = state.game_offset;
+  auto root_entry = new DiscImageEntry(this, nullptr, "", mmap_.get());
+  root_entry->attributes_ = kFileAttributeDirectory;
+  root_entry_ = std::unique_ptr<Entry>(root_entry);
+  if (!ReadEntry(state.ptr + state.root_offset, state.root_size, 0,
+                 root_entry)) {
+    XELOGE("Failed to read GDFX root directory");
     return false;
   }
 
+  double mount_ms = double(Clock::QueryHostTickCount() - start_ticks) *
+                    1000.0 / double(Clock::host_tick_frequency());
+  XELOGI("Disc image mounted in %.2f ms: %zu root entries", mount_ms,
+         entry_count());
   return true;
 }
 
@@ -102,7 +114,8 @@ DiscImageDevice::Error DiscImageDevice::Verify(ParseState* state) {
   state->root_size = xe::load<uint32_t>(fs_ptr + 24);
   state->root_offset =
       state->game_offset + (state->root_sector * kXESectorSize);
-  if (state->root_size < 13 || state->root_size > 32 * 1024 * 1024) {
+  if (state->root_size < 13 || state->root_size > 32 * 1024 * 1024 ||
+      state->root_offset + state->root_size > state->size) {
     return Error::kErrorDamagedFile;
   }
 
@@ -118,23 +131,22 @@ bool DiscImageDevice::VerifyMagic(ParseState* state, size_t offset) {
   return std::memcmp(state->ptr + offset, "MICROSOFT*XBOX*MEDIA", 20) == 0;
 }
 
-DiscImageDevice::Error DiscImageDevice::ReadAllEntries(
-    ParseState* state, const uint8_t* root_buffer) {
-  auto root_entry = new DiscImageEntry(this, nullptr, "", mmap_.get());
-  root_entry->attributes_ = kFileAttributeDirectory;
-  root_entry_ = std::unique_ptr<Entry>(root_entry);
-
-  if (!ReadEntry(state, root_buffer, 0, root_entry)) {
-    return Error::kErrorOutOfMemory;
+void DiscImageDevice::ReadDirectory(DiscImageEntry* parent) {
+  const uint8_t* buffer = mmap_->data() + parent->directory_offset_;
+  if (!ReadEntry(buffer, parent->directory_size_, 0, parent)) {
+    XELOGE("Failed to read GDFX directory %s", parent->path().c_str());
   }
-
-  return Error::kSuccess;
 }
 
-bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
+bool DiscImageDevice::ReadEntry(const uint8_t* buffer, size_t buffer_size,
                                 uint16_t entry_ordinal,
                                 DiscImageEntry* parent) {
-  const uint8_t* p = buffer + (entry_ordinal * 4);
+  const size_t entry_offset = entry_ordinal * 4;
+  if (entry_offset + 14 > buffer_size) {
+    // Out of bounds read.
+    return false;
+  }
+  const uint8_t* p = buffer + entry_offset;
 
   uint16_t node_l = xe::load<uint16_t>(p + 0);
   uint16_t node_r = xe::load<uint16_t>(p + 2);
@@ -143,8 +155,11 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
   uint8_t attributes = xe::load<uint8_t>(p + 12);
   uint8_t name_length = xe::load<uint8_t>(p + 13);
   auto name = reinterpret_cast<const char*>(p + 14);
+  if (entry_offset + 14 + name_length > buffer_size) {
+    return false;
+  }
 
-  if (node_l && !ReadEntry(state, buffer, node_l, parent)) {
+  if (node_l && !ReadEntry(buffer, buffer_size, node_l, parent)) {
     return false;
   }
 
@@ -164,29 +179,28 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
     entry->data_offset_ = 0;
     entry->data_size_ = 0;
     if (length) {
-      // Not a leaf - read in children.
-      if (state->size < state->game_offset + (sector * kXESectorSize)) {
+      // Not a leaf - the child list is read on first access.
+      size_t directory_offset = game_offset_ + (sector * kXESectorSize);
+      if (directory_offset + length > mmap_->size()) {
         // Out of bounds read.
         return false;
       }
-      // Read child list.
-      uint8_t* folder_ptr =
-          state->ptr + state->game_offset + (sector * kXESectorSize);
-      if (!ReadEntry(state, folder_ptr, 0, entry.get())) {
-        return false;
-      }
+      entry->directory_offset_ = directory_offset;
+      entry->directory_size_ = length;
+      entry->MarkChildrenUnpopulated();
     }
   } else {
     // File.
-    entry->data_offset_ = state->game_offset + (sector * kXESectorSize);
+    entry->data_offset_ = game_offset_ + (sector * kXESectorSize);
     entry->data_size_ = length;
   }
 
   // Add to parent.
-  parent->children_.emplace_back(std::move(entry));
+  parent->AddPopulatedChild(std::move(entry));
+  entry_count_.fetch_add(1, std::memory_order_relaxed);
 
   // Read next file in the list.
-  if (node_r && !ReadEntry(state, buffer, node_r, parent)) {
+  if (node_r && !ReadEntry(buffer, buffer_size, node_r, parent)) {
     return false;
   }
 
@@ -10,6 +10,7 @@
 #ifndef XENIA_VFS_DEVICES_DISC_IMAGE_DEVICE_H_
 #define XENIA_VFS_DEVICES_DISC_IMAGE_DEVICE_H_
 
+#include <atomic>
 #include <memory>
 #include <string>
 
@@ -39,7 +40,13 @@ class DiscImageDevice : public Device {
   uint32_t sectors_per_allocation_unit() const override { return 1; }
   uint32_t bytes_per_sector() const override { return 2 * 1024; }
 
+  // Number of entries read from the image so far. Directories are read on
+  // first access, so this grows as the title walks the disc.
+  size_t entry_count() const { return entry_count_.load(); }
+
  private:
+  friend class DiscImageEntry;
+
   enum class Error {
     kSuccess = 0,
     kErrorOutOfMemory = -1,
@@ -51,6 +58,8 @@ class DiscImageDevice : public Device {
   std::wstring local_path_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<MappedMemory> mmap_;
+  size_t game_offset_ = 0;
+  std::atomic<size_t> entry_count_ = {0};
 
   typedef struct {
     uint8_t* ptr;
@@ -63,8 +72,9 @@ class DiscImageDevice : public Device {
 
   Error Verify(ParseState* state);
   bool VerifyMagic(ParseState* state, size_t offset);
-  Error ReadAllEntries(ParseState* state, const uint8_t* root_buffer);
-  bool ReadEntry(ParseState* state, const uint8_t* buffer,
+  // Reads the child table of a directory not read yet into its children.
+  void ReadDirectory(DiscImageEntry* parent);
+  bool ReadEntry(const uint8_t* buffer, size_t buffer_size,
                  uint16_t entry_ordinal, DiscImageEntry* parent);
 };
 
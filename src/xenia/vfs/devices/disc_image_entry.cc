@@ -12,6 +12,7 @@
 #include <algorithm>
 
 #include "xenia/base/math.h"
+#include "xenia/vfs/devices/disc_image_device.h"
 #include "xenia/vfs/devices/disc_image_file.h"
 
 namespace xe {
@@ -22,7 +23,9 @@ DiscImageEntry::DiscImageEntry(Device* device, Entry* parent, std::string path,
     : Entry(device, parent, path),
       mmap_(mmap),
       data_offset_(0),
-      data_size_(0) {}
+      data_size_(0),
+      directory_offset_(0),
+      directory_size_(0) {}
 
 DiscImageEntry::~DiscImageEntry() = default;
 
@@ -36,6 +39,10 @@ std::unique_ptr<DiscImageEntry> DiscImageEntry::Create(Device* device,
   return std::move(entry);
 }
 
+void DiscImageEntry::PopulateChildren() {
+  static_cast<DiscImageDevice*>(device_)->ReadDirectory(this);
+}
+
 X_STATUS DiscImageEntry::Open(uint32_t desired_access, File** out_file) {
   *out_file = new DiscImageFile(desired_access, this);
   return X_STATUS_SUCCESS;
@@ -46,9 +46,15 @@ class DiscImageEntry : public Entry {
  private:
   friend class DiscImageDevice;
 
+  void PopulateChildren() override;
+
   MappedMemory* mmap_;
   size_t data_offset_;
   size_t data_size_;
+  // Image offset and size of the child table of a directory that has not
+  // been read yet.
+  size_t directory_offset_;
+  size_t directory_size_;
 };
 
 }  // namespace vfs
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 
+#include "xenia/base/memory.h"
 #include "xenia/vfs/devices/disc_image_entry.h"
 
 namespace xe {
@@ -31,10 +32,16 @@ X_STATUS DiscImageFile::ReadSync(void* buffer, size_t buffer_length,
   size_t real_offset = entry_->data_offset() + byte_offset;
   size_t real_length =
       std::min(buffer_length, entry_->data_size() - byte_offset);
-  std::memcpy(buffer, entry_->mmap()->data() + real_offset, real_length);
+  TrackRead(byte_offset, real_length);
+  CopyFromMapping(buffer, entry_->mmap()->data() + real_offset, real_length);
   *out_bytes_read = real_length;
   return X_STATUS_SUCCESS;
 }
 
+void DiscImageFile::PrefetchRange(size_t byte_offset, size_t length) {
+  xe::memory::Prefetch(
+      entry_->mmap()->data() + entry_->data_offset() + byte_offset, length);
+}
+
 }  // namespace vfs
 }  // namespace xe
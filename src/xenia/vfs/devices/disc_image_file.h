@@ -33,6 +33,8 @@ class DiscImageFile : public File {
   X_STATUS SetLength(size_t length) override { return X_STATUS_ACCESS_DENIED; }
 
  private:
+  void PrefetchRange(size_t byte_offset, size_t length) override;
+
   DiscImageEntry* entry_;
 };
 
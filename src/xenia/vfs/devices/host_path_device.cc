@@ -14,6 +14,7 @@
 #include "xenia/base/math.h"
 #include "xenia/kernel/xfile.h"
 #include "xenia/vfs/devices/host_path_entry.h"
+#include "xenia/vfs/vfs_flags.h"
 
 namespace xe {
 namespace vfs {
@@ -22,7 +23,7 @@ HostPathDevice::HostPathDevice(const std::string& mount_path,
                                const std::wstring& local_path, bool read_only)
     : Device(mount_path), local_path_(local_path), read_only_(read_only) {}
 
-HostPathDevice::~HostPathDevice() = default;
+HostPathDevice::~HostPathDevice() { watcher_.reset(); }
 
 bool HostPathDevice::Initialize() {
   if (!xe::filesystem::PathExists(local_path_)) {
@@ -35,10 +36,17 @@ bool HostPathDevice::Initialize() {
     }
   }
 
+  if (FLAGS_vfs_host_path_watch) {
+    watcher_ = HostPathWatcher::Create(
+        [this](HostPathEntry* directory, const std::wstring& name) {
+          OnHostChange(directory, name);
+        });
+  }
+
   auto root_entry = new HostPathEntry(this, nullptr, "", local_path_);
   root_entry->attributes_ = kFileAttributeDirectory;
+  root_entry->MarkChildrenUnpopulated();
   root_entry_ = std::unique_ptr<Entry>(root_entry);
-  PopulateEntry(root_entry);
 
   return true;
 }
@@ -70,16 +78,132 @@ Entry* HostPathDevice::ResolvePath(std::string path) {
 }
 
 void HostPathDevice::PopulateEntry(HostPathEntry* parent_entry) {
+  // This runs under the entry populate lock, which is taken after the global
+  // lock, so the global lock must not be taken here.
+  // Watch first, so changes made while listing are not missed.
+  if (watcher_) {
+    watcher_->Watch(parent_entry);
+    watched_directories_.insert(parent_entry);
+  }
   auto child_infos = xe::filesystem::ListFiles(parent_entry->local_path());
   for (auto& child_info : child_infos) {
     auto child = HostPathEntry::Create(
         this, parent_entry,
         xe::join_paths(parent_entry->local_path(), child_info.name),
         child_info);
-    parent_entry->children_.push_back(std::unique_ptr<Entry>(child));
+    parent_entry->AddPopulatedChild(std::unique_ptr<Entry>(child));
+  }
+}
+
+void HostPathDevice::OnHostChange(HostPathEntry* directory,
+                                  const std::wstring& name) {
+  {
+    std::lock_guard<std::mutex> lock(host_changes_mutex_);
+    host_changes_.emplace_back(directory, name);
+    has_host_changes_.store(true, std::memory_order_release);
+  }
+  // Cached paths would skip the lookup that applies the change.
+  HostPathEntry::InvalidateResolvedPaths();
+}
 
-    if (child_info.type == xe::filesystem::FileInfo::Type::kDirectory) {
-      PopulateEntry(child);
+void HostPathDevice::ApplyHostChanges() {
+  if (!has_host_changes_.load(std::memory_order_acquire)) {
+    return;
+  }
+  // Lookups may hold the file system lock, which is taken after the global
+  // one, so guest changes to the tree are kept out with the populate lock.
+  std::lock_guard<std::recursive_mutex> lock(
+      HostPathEntry::populate_mutex());
+  if (applying_host_changes_) {
+    return;
+  }
+  std::vector<std::pair<HostPathEntry*, std::wstring>> changes;
+  {
+    std::lock_guard<std::mutex> changes_lock(host_changes_mutex_);
+    changes.swap(host_changes_);
+    has_host_changes_.store(false, std::memory_order_relaxed);
+  }
+  applying_host_changes_ = true;
+  for (auto& change : changes) {
+    HostPathEntry* directory = change.first;
+    if (!watched_directories_.count(directory)) {
+      continue;
+    }
+    if (!change.second.empty()) {
+      RefreshChild(directory, change.second);
+      continue;
+    }
+    // Changes were missed: refresh everything on the host and in the tree.
+    std::vector<std::wstring> names;
+    for (auto& child_info :
+         xe::filesystem::ListFiles(directory->local_path())) {
+      names.push_back(child_info.name);
+    }
+    for (auto& child : directory->children()) {
+      names.push_back(xe::to_wstring(child->name()));
+    }
+    for (auto& child_name : names) {
+      // An earlier refresh may have removed the directory.
+      if (!watched_directories_.count(directory)) {
+        break;
+      }
+      RefreshChild(directory, child_name);
+    }
+  }
+  applying_host_changes_ = false;
+}
+
+void HostPathDevice::RefreshChild(HostPathEntry* directory,
+                                  const std::wstring& name) {
+  // Host names are case sensitive, unlike GetChild.
+  std::string entry_name = xe::to_string(name);
+  HostPathEntry* existing = nullptr;
+  for (auto& child : directory->children()) {
+    if (child->name() == entry_name) {
+      existing = static_cast<HostPathEntry*>(child.get());
+      break;
+    }
+  }
+
+  auto full_path = xe::join_paths(directory->local_path(), name);
+  xe::filesystem::FileInfo file_info;
+  bool exists = xe::filesystem::GetInfo(full_path, &file_info);
+  bool is_directory =
+      exists && file_info.type == xe::filesystem::FileInfo::Type::kDirectory;
+  if (existing && exists &&
+      is_directory == bool(existing->attributes() & kFileAttributeDirectory)) {
+    existing->UpdateInfo(file_info);
+    return;
+  }
+
+  if (existing) {
+    if (existing->attributes() & kFileAttributeDirectory) {
+      UnwatchDirectory(existing);
+    }
+    removed_entries_.push_back(directory->RemoveChild(existing));
+  }
+  if (exists) {
+    directory->AddChild(std::unique_ptr<Entry>(
+        HostPathEntry::Create(this, directory, full_path, file_info)));
+  }
+}
+
+void HostPathDevice::UnwatchDirectory(HostPathEntry* directory) {
+  if (!watcher_) {
+    return;
+  }
+  watcher_->Unwatch(directory);
+  const std::wstring& prefix = directory->local_path();
+  for (auto it = watched_directories_.begin();
+       it != watched_directories_.end();) {
+    const std::wstring& path = (*it)->local_path();
+    bool below = path.size() > prefix.size() &&
+                 path.compare(0, prefix.size(), prefix) == 0 &&
+                 path[prefix.size()] == xe::kWPathSeparator;
+    if (*it == directory || below) {
+      it = watched_directories_.erase(it);
+    } else {
+      ++it;
     }
   }
 }
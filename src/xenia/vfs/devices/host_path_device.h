@@ -10,9 +10,16 @@
 #ifndef XENIA_VFS_DEVICES_HOST_PATH_DEVICE_H_
 #define XENIA_VFS_DEVICES_HOST_PATH_DEVICE_H_
 
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/host_path_watcher.h"
 
 namespace xe {
 namespace vfs {
@@ -37,11 +44,39 @@ class HostPathDevice : public Device {
   uint32_t bytes_per_sector() const override { return 2 * 1024; }
 
  private:
+  friend class HostPathEntry;
+
+  // Lists a directory on its first access. Its entries then hold the host
+  // metadata until the watcher reports a change.
   void PopulateEntry(HostPathEntry* parent_entry);
+  // Called on the watcher thread, which the destructor joins, possibly with
+  // the global lock held. So changes are only queued here, and applied by
+  // ApplyHostChanges before the next lookup or enumeration of any entry.
+  void OnHostChange(HostPathEntry* directory, const std::wstring& name);
+  void ApplyHostChanges();
+  void RefreshChild(HostPathEntry* directory, const std::wstring& name);
+  // Stops watching the directory and every directory below it. Changes
+  // still queued for them are then dropped, as they may have been deleted.
+  void UnwatchDirectory(HostPathEntry* directory);
 
   std::wstring local_path_;
   std::unique_ptr<Entry> root_entry_;
   bool read_only_;
+  // Entries removed from the host by other processes. They are kept alive
+  // as guest file objects may still reference them.
+  std::vector<std::unique_ptr<Entry>> removed_entries_;
+  // Directories changes are applied to. Guarded by the entry populate lock.
+  std::unordered_set<HostPathEntry*> watched_directories_;
+  // Set while ApplyHostChanges runs, as refreshing enumerates children.
+  // Guarded by the entry populate lock.
+  bool applying_host_changes_ = false;
+  std::mutex host_changes_mutex_;
+  std::vector<std::pair<HostPathEntry*, std::wstring>> host_changes_;
+  // Whether host_changes_ may be non-empty, checked on every lookup without
+  // taking the mutex.
+  std::atomic<bool> has_host_changes_{false};
+  // Declared last so its thread stops before the entries go away.
+  std::unique_ptr<HostPathWatcher> watcher_;
 };
 
 }  // namespace vfs
@@ -15,6 +15,7 @@
 #include "xenia/base/math.h"
 #include "xenia/base/string.h"
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/host_path_device.h"
 #include "xenia/vfs/devices/host_path_file.h"
 
 namespace xe {
@@ -31,22 +32,37 @@ HostPathEntry* HostPathEntry::Create(Device* device, Entry* parent,
                                      xe::filesystem::FileInfo file_info) {
   auto path = xe::join_paths(parent->path(), xe::to_string(file_info.name));
   auto entry = new HostPathEntry(device, parent, path, full_path);
+  entry->UpdateInfo(file_info);
+  if (file_info.type == xe::filesystem::FileInfo::Type::kDirectory) {
+    // Listed when first accessed.
+    entry->MarkChildrenUnpopulated();
+  }
+  return entry;
+}
 
-  entry->create_timestamp_ = file_info.create_timestamp;
-  entry->access_timestamp_ = file_info.access_timestamp;
-  entry->write_timestamp_ = file_info.write_timestamp;
+void HostPathEntry::UpdateInfo(const xe::filesystem::FileInfo& file_info) {
+  create_timestamp_ = file_info.create_timestamp;
+  access_timestamp_ = file_info.access_timestamp;
+  write_timestamp_ = file_info.write_timestamp;
   if (file_info.type == xe::filesystem::FileInfo::Type::kDirectory) {
-    entry->attributes_ = kFileAttributeDirectory;
+    attributes_ = kFileAttributeDirectory;
   } else {
-    entry->attributes_ = kFileAttributeNormal;
-    if (device->is_read_only()) {
-      entry->attributes_ |= kFileAttributeReadOnly;
+    attributes_ = kFileAttributeNormal;
+    if (device_->is_read_only()) {
+      attributes_ |= kFileAttributeReadOnly;
     }
-    entry->size_ = file_info.total_size;
-    entry->allocation_size_ =
-        xe::round_up(file_info.total_size, device->bytes_per_sector());
+    size_ = file_info.total_size;
+    allocation_size_ =
+        xe::round_up(file_info.total_size, device_->bytes_per_sector());
   }
-  return entry;
+}
+
+void HostPathEntry::PopulateChildren() {
+  static_cast<HostPathDevice*>(device_)->PopulateEntry(this);
+}
+
+void HostPathEntry::UpdateChildren() {
+  static_cast<HostPathDevice*>(device_)->ApplyHostChanges();
 }
 
 X_STATUS HostPathEntry::Open(uint32_t desired_access, File** out_file) {
@@ -97,7 +113,13 @@ bool HostPathEntry::DeleteEntryInternal(Entry* entry) {
   auto full_path = xe::join_paths(local_path_, xe::to_wstring(entry->name()));
   if (entry->attributes() & kFileAttributeDirectory) {
     // Delete entire directory and contents.
-    return xe::filesystem::DeleteFolder(full_path);
+    if (!xe::filesystem::DeleteFolder(full_path)) {
+      return false;
+    }
+    // The entry is destroyed once removed, so it must not be watched.
+    static_cast<HostPathDevice*>(device_)->UnwatchDirectory(
+        static_cast<HostPathEntry*>(entry));
+    return true;
   } else {
     // Delete file.
     return xe::filesystem::DeleteFile(full_path);
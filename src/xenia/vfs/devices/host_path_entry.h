@@ -42,6 +42,10 @@ class HostPathEntry : public Entry {
  private:
   friend class HostPathDevice;
 
+  void UpdateInfo(const xe::filesystem::FileInfo& file_info);
+
+  void PopulateChildren() override;
+  void UpdateChildren() override;
   std::unique_ptr<Entry> CreateEntryInternal(std::string name,
                                              uint32_t attributes) override;
   bool DeleteEntryInternal(Entry* entry) override;
@@ -29,6 +29,7 @@ X_STATUS HostPathFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_ACCESS_DENIED;
   }
 
+  TrackRead(byte_offset, buffer_length);
   if (file_handle_->Read(byte_offset, buffer, buffer_length, out_bytes_read)) {
     return X_STATUS_SUCCESS;
   } else {
@@ -36,6 +37,10 @@ X_STATUS HostPathFile::ReadSync(void* buffer, size_t buffer_length,
   }
 }
 
+void HostPathFile::PrefetchRange(size_t byte_offset, size_t length) {
+  file_handle_->ReadAhead(byte_offset, length);
+}
+
 X_STATUS HostPathFile::WriteSync(const void* buffer, size_t buffer_length,
                                  size_t byte_offset,
                                  size_t* out_bytes_written) {
@@ -35,6 +35,8 @@ class HostPathFile : public File {
   X_STATUS SetLength(size_t length) override;
 
  private:
+  void PrefetchRange(size_t byte_offset, size_t length) override;
+
   std::unique_ptr<xe::filesystem::FileHandle> file_handle_;
 };
 
@@ -0,0 +1,48 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_DEVICES_HOST_PATH_WATCHER_H_
+#define XENIA_VFS_DEVICES_HOST_PATH_WATCHER_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace xe {
+namespace vfs {
+
+class HostPathEntry;
+
+// Reports changes made to watched host directories, so a HostPathDevice can
+// keep the metadata it has read instead of querying the host again.
+class HostPathWatcher {
+ public:
+  // Called on the watcher thread with the directory and the name of the
+  // child that was added, removed or modified. The name is empty when
+  // changes may have been missed and the whole directory must be rescanned.
+  typedef std::function<void(HostPathEntry* directory,
+                             const std::wstring& name)>
+      ChangeCallback;
+
+  // Returns nullptr if the host can't report changes.
+  static std::unique_ptr<HostPathWatcher> Create(ChangeCallback callback);
+
+  virtual ~HostPathWatcher() = default;
+
+  // Starts reporting changes to the children of the directory. Call before
+  // listing it, so no change is missed in between.
+  virtual void Watch(HostPathEntry* directory) = 0;
+  // Stops reporting changes to the directory and every directory below it.
+  virtual void Unwatch(HostPathEntry* directory) = 0;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_DEVICES_HOST_PATH_WATCHER_H_
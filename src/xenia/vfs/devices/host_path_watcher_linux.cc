@@ -0,0 +1,163 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/host_path_watcher.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+#include "xenia/vfs/devices/host_path_entry.h"
+
+namespace xe {
+namespace vfs {
+
+class InotifyHostPathWatcher : public HostPathWatcher {
+ public:
+  InotifyHostPathWatcher(ChangeCallback callback, int inotify_fd,
+                         int shutdown_fd)
+      : callback_(std::move(callback)),
+        inotify_fd_(inotify_fd),
+        shutdown_fd_(shutdown_fd) {
+    thread_ = std::thread([this]() { WorkerMain(); });
+    threading::set_name(thread_.native_handle(), "Host Path Watcher");
+  }
+
+  ~InotifyHostPathWatcher() override {
+    uint64_t value = 1;
+    if (write(shutdown_fd_, &value, sizeof(value)) != sizeof(value)) {
+      XELOGE("Unable to signal the host path watcher to stop");
+    }
+    thread_.join();
+    close(inotify_fd_);
+    close(shutdown_fd_);
+  }
+
+  void Watch(HostPathEntry* directory) override {
+    // Metadata and size changes are picked up once the writer closes the
+    // file, rather than on every write.
+    const uint32_t mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                          IN_MOVED_TO | IN_CLOSE_WRITE | IN_ATTRIB |
+                          IN_ONLYDIR;
+    std::lock_guard<std::mutex> lock(mutex_);
+    int wd = inotify_add_watch(
+        inotify_fd_, xe::to_string(directory->local_path()).c_str(), mask);
+    if (wd < 0) {
+      XELOGW("Unable to watch host path %s for changes",
+             xe::to_string(directory->local_path()).c_str());
+      return;
+    }
+    directories_[wd] = directory;
+  }
+
+  void Unwatch(HostPathEntry* directory) override {
+    const std::wstring& prefix = directory->local_path();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = directories_.begin(); it != directories_.end();) {
+      const std::wstring& path = it->second->local_path();
+      bool below = path.size() > prefix.size() &&
+                   path.compare(0, prefix.size(), prefix) == 0 &&
+                   path[prefix.size()] == xe::kWPathSeparator;
+      if (it->second == directory || below) {
+        inotify_rm_watch(inotify_fd_, it->first);
+        it = directories_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+ private:
+  void WorkerMain() {
+    alignas(struct inotify_event) uint8_t buffer[64 * 1024];
+    pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {shutdown_fd_, POLLIN, 0}};
+    while (true) {
+      if (poll(fds, 2, -1) < 0) {
+        continue;
+      }
+      if (fds[1].revents) {
+        return;
+      }
+      ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+      if (length <= 0) {
+        continue;
+      }
+
+      // Changes are reported once the lock is dropped, so lookups that watch
+      // or unwatch directories only wait for the events to be parsed.
+      std::vector<std::pair<HostPathEntry*, std::wstring>> changes;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (ssize_t offset = 0; offset < length;) {
+          auto event = reinterpret_cast<inotify_event*>(buffer + offset);
+          offset += sizeof(inotify_event) + event->len;
+          if (event->mask & IN_Q_OVERFLOW) {
+            XELOGW("Host path change queue overflowed; rescanning");
+            for (auto& it : directories_) {
+              changes.emplace_back(it.second, std::wstring());
+            }
+            continue;
+          }
+          auto it = directories_.find(event->wd);
+          if (it == directories_.end()) {
+            continue;
+          }
+          if (event->mask & IN_IGNORED) {
+            // The directory itself is gone.
+            directories_.erase(it);
+            continue;
+          }
+          if (event->len) {
+            changes.emplace_back(it->second, xe::to_wstring(event->name));
+          }
+        }
+      }
+      for (auto& change : changes) {
+        callback_(change.first, change.second);
+      }
+    }
+  }
+
+  ChangeCallback callback_;
+  int inotify_fd_;
+  int shutdown_fd_;
+  std::thread thread_;
+
+  // Guards directories_.
+  std::mutex mutex_;
+  std::unordered_map<int, HostPathEntry*> directories_;
+};
+
+std::unique_ptr<HostPathWatcher> HostPathWatcher::Create(
+    ChangeCallback callback) {
+  int inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  if (inotify_fd < 0) {
+    return nullptr;
+  }
+  int shutdown_fd = eventfd(0, EFD_CLOEXEC);
+  if (shutdown_fd < 0) {
+    close(inotify_fd);
+    return nullptr;
+  }
+  return std::make_unique<InotifyHostPathWatcher>(std::move(callback),
+                                                  inotify_fd, shutdown_fd);
+}
+
+}  // namespace vfs
+}  // namespace xe
@@ -0,0 +1,238 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/host_path_watcher.h"
+
+#include <cwchar>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/platform_win.h"
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+#include "xenia/vfs/devices/host_path_entry.h"
+
+namespace xe {
+namespace vfs {
+
+// Watches the whole tree below the first directory watched, which is the
+// device root, with a single handle. Open handles to subdirectories would
+// keep them from being deleted along with their parents.
+class Win32HostPathWatcher : public HostPathWatcher {
+ public:
+  Win32HostPathWatcher(ChangeCallback callback, HANDLE port)
+      : callback_(std::move(callback)), port_(port) {
+    thread_ = std::thread([this]() { WorkerMain(); });
+    threading::set_name(thread_.native_handle(), "Host Path Watcher");
+  }
+
+  ~Win32HostPathWatcher() override {
+    if (!PostQueuedCompletionStatus(port_, 0, kShutdownKey, nullptr)) {
+      XELOGE("Unable to signal the host path watcher to stop");
+    }
+    thread_.join();
+    CloseRoot();
+    CloseHandle(port_);
+  }
+
+  void Watch(HostPathEntry* directory) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (root_handle_ == INVALID_HANDLE_VALUE && !OpenRoot(directory)) {
+      XELOGW("Unable to watch host path %s for changes",
+             xe::to_string(directory->local_path()).c_str());
+      return;
+    }
+    std::wstring relative_path;
+    if (!GetRelativePath(directory->local_path(), &relative_path)) {
+      return;
+    }
+    directories_[relative_path] = directory;
+  }
+
+  void Unwatch(HostPathEntry* directory) override {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::wstring prefix;
+    if (!GetRelativePath(directory->local_path(), &prefix)) {
+      return;
+    }
+    for (auto it = directories_.begin(); it != directories_.end();) {
+      const std::wstring& path = it->first;
+      bool below = path.size() > prefix.size() &&
+                   path.compare(0, prefix.size(), prefix) == 0 &&
+                   (prefix.empty() || path[prefix.size()] == L'\\');
+      if (it->second == directory || below) {
+        it = directories_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+
+ private:
+  static const ULONG_PTR kShutdownKey = 0;
+  static const ULONG_PTR kRootKey = 1;
+
+  bool OpenRoot(HostPathEntry* directory) {
+    root_handle_ = CreateFileW(
+        directory->local_path().c_str(), FILE_LIST_DIRECTORY,
+        FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+        nullptr);
+    if (root_handle_ == INVALID_HANDLE_VALUE) {
+      return false;
+    }
+    root_path_ = directory->local_path();
+    while (!root_path_.empty() && root_path_.back() == L'\\') {
+      root_path_.pop_back();
+    }
+    if (!CreateIoCompletionPort(root_handle_, port_, kRootKey, 0) ||
+        !IssueRead()) {
+      CloseRoot();
+      return false;
+    }
+    return true;
+  }
+
+  // Cancels the pending read and waits for it, as it writes to buffer_.
+  void CloseRoot() {
+    if (root_handle_ == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    DWORD bytes_transferred;
+    if (CancelIoEx(root_handle_, &overlapped_) ||
+        GetLastError() != ERROR_NOT_FOUND) {
+      GetOverlappedResult(root_handle_, &overlapped_, &bytes_transferred,
+                          TRUE);
+    }
+    CloseHandle(root_handle_);
+    root_handle_ = INVALID_HANDLE_VALUE;
+  }
+
+  bool IssueRead() {
+    // Metadata and size changes are reported as they are made, as there is
+    // no notification of the writer closing the file.
+    const DWORD filter =
+        FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+        FILE_NOTIFY_CHANGE_ATTRIBUTES | FILE_NOTIFY_CHANGE_SIZE |
+        FILE_NOTIFY_CHANGE_LAST_WRITE;
+    overlapped_ = {};
+    return ReadDirectoryChangesW(root_handle_, buffer_, sizeof(buffer_), TRUE,
+                                 filter, nullptr, &overlapped_,
+                                 nullptr) != FALSE;
+  }
+
+  // Paths are relative to the root, without a leading separator.
+  bool GetRelativePath(const std::wstring& path, std::wstring* out_path) {
+    if (path.size() < root_path_.size() ||
+        _wcsnicmp(path.c_str(), root_path_.c_str(), root_path_.size()) != 0 ||
+        (path.size() > root_path_.size() &&
+         path[root_path_.size()] != L'\\')) {
+      return false;
+    }
+    size_t start = root_path_.size();
+    while (start < path.size() && path[start] == L'\\') {
+      ++start;
+    }
+    *out_path = path.substr(start);
+    return true;
+  }
+
+  void WorkerMain() {
+    while (true) {
+      DWORD length = 0;
+      ULONG_PTR key = 0;
+      OVERLAPPED* overlapped = nullptr;
+      BOOL succeeded = GetQueuedCompletionStatus(port_, &length, &key,
+                                                 &overlapped, INFINITE);
+      DWORD error = succeeded ? ERROR_SUCCESS : GetLastError();
+      if (key == kShutdownKey) {
+        return;
+      }
+      if (!overlapped) {
+        continue;
+      }
+
+      // Changes are reported once the lock is dropped, so lookups that watch
+      // or unwatch directories only wait for the events to be parsed.
+      std::vector<std::pair<HostPathEntry*, std::wstring>> changes;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (error == ERROR_NOTIFY_ENUM_DIR || (succeeded && !length)) {
+          XELOGW("Host path change buffer overflowed; rescanning");
+          for (auto& it : directories_) {
+            changes.emplace_back(it.second, std::wstring());
+          }
+        } else if (succeeded) {
+          for (DWORD offset = 0; offset < length;) {
+            auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(
+                buffer_ + offset);
+            std::wstring path(info->FileName,
+                              info->FileNameLength / sizeof(WCHAR));
+            // Reported by path from the root, while changes are reported
+            // to the directory containing them.
+            size_t separator = path.find_last_of(L'\\');
+            std::wstring parent_path = separator != std::wstring::npos
+                                           ? path.substr(0, separator)
+                                           : std::wstring();
+            auto it = directories_.find(parent_path);
+            if (it != directories_.end()) {
+              changes.emplace_back(it->second,
+                                   separator != std::wstring::npos
+                                       ? path.substr(separator + 1)
+                                       : path);
+            }
+            if (!info->NextEntryOffset) {
+              break;
+            }
+            offset += info->NextEntryOffset;
+          }
+        }
+        if ((!succeeded && error != ERROR_NOTIFY_ENUM_DIR) || !IssueRead()) {
+          // The root itself is gone, or was closed.
+          XELOGW("Stopped watching host path %s for changes",
+                 xe::to_string(root_path_).c_str());
+          directories_.clear();
+        }
+      }
+      for (auto& change : changes) {
+        callback_(change.first, change.second);
+      }
+    }
+  }
+
+  ChangeCallback callback_;
+  HANDLE port_;
+  std::thread thread_;
+
+  // Guards everything below.
+  std::mutex mutex_;
+  HANDLE root_handle_ = INVALID_HANDLE_VALUE;
+  std::wstring root_path_;
+  OVERLAPPED overlapped_ = {};
+  // Filled with FILE_NOTIFY_INFORMATION records, which are DWORD aligned.
+  alignas(DWORD) uint8_t buffer_[64 * 1024];
+  // Watched directories by path relative to the root.
+  std::unordered_map<std::wstring, HostPathEntry*> directories_;
+};
+
+std::unique_ptr<HostPathWatcher> HostPathWatcher::Create(
+    ChangeCallback callback) {
+  HANDLE port = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+  if (!port) {
+    return nullptr;
+  }
+  return std::make_unique<Win32HostPathWatcher>(std::move(callback), port);
+}
+
+}  // namespace vfs
+}  // namespace xe
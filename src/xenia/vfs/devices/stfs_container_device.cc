@@ -13,9 +13,11 @@
 #include <queue>
 #include <vector>
 
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/vfs/devices/stfs_container_entry.h"
+#include "xenia/vfs/vfs_flags.h"
 
 #if XE_PLATFORM_WIN32
 #include "xenia/base/platform_win.h"
@@ -80,16 +82,43 @@ bool StfsContainerDevice::Initialize() {
     return false;
   }
 
+  uint64_t start_ticks = Clock::QueryHostTickCount();
+  if (FLAGS_vfs_stfs_extent_cache) {
+    LoadExtentCache();
+  }
+  bool extent_cache_loaded = !cached_extents_.empty();
+
+  Error result;
   switch (header_.descriptor_type) {
     case StfsDescriptorType::kStfs:
-      return ReadSTFS() == Error::kSuccess;
+      result = ReadSTFS();
       break;
     case StfsDescriptorType::kSvod:
-      return ReadSVOD() == Error::kSuccess;
+      result = ReadSVOD();
+      break;
     default:
       XELOGE("Unknown STFS Descriptor Type: %d", header_.descriptor_type);
       return false;
   }
+  if (result != Error::kSuccess) {
+    return false;
+  }
+
+  bool extent_cache_hit = extent_cache_loaded && !extent_cache_misses_ &&
+                          next_cached_extents_ == cached_extents_.size();
+  if (FLAGS_vfs_stfs_extent_cache && !extent_cache_hit &&
+      !mounted_files_.empty()) {
+    SaveExtentCache();
+  }
+  double mount_ms = double(Clock::QueryHostTickCount() - start_ticks) *
+                    1000.0 / double(Clock::host_tick_frequency());
+  XELOGI("STFS container mounted in %.2f ms: %zu files in %zu extents (%s)",
+         mount_ms, mounted_files_.size(), mounted_extent_count_,
+         extent_cache_hit ? "extent cache hit" : "extents computed");
+
+  cached_extents_ = std::vector<CachedExtents>();
+  mounted_files_ = std::vector<MountedFile>();
+  return true;
 }
 
 StfsContainerDevice::Error StfsContainerDevice::MapFiles() {
@@ -358,7 +387,8 @@ StfsContainerDevice::Error StfsContainerDevice::ReadEntrySVOD(
     entry->write_timestamp_ = root_entry_->create_timestamp();
 
     // Fill in all block records, sector by sector.
-    if (entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) {
+    if ((entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) &&
+        !TakeCachedExtents(entry.get(), data_block, length)) {
       uint32_t block_index = data_block;
       size_t remaining_size = xe::round_up(length, 0x800);
 
@@ -380,14 +410,15 @@ StfsContainerDevice::Error StfsContainerDevice::ReadEntrySVOD(
           continue;
         }
 
-        entry->block_list_.push_back({file_index, offset, BLOCK_SIZE});
+        entry->block_list_.push_back({file_index, offset, BLOCK_SIZE, 0});
         last_record = entry->block_list_.size() - 1;
         last_offset = offset;
       }
     }
+    FinishExtents(entry.get(), data_block, length);
   }
 
-  parent->children_.emplace_back(std::move(entry));
+  parent->AddChild(std::move(entry));
 
   // Read the right node.
   if (node_r) {
@@ -524,11 +555,13 @@ StfsContainerDevice::Error StfsContainerDevice::ReadSTFS() {
 
       all_entries.push_back(entry.get());
 
-      // Fill in all block records.
+      // Fill in all block records, merging physically contiguous blocks.
       // It's easier to do this now and just look them up later, at the cost
-      // of some memory. Nasty chain walk.
+      // of some memory. Nasty chain walk, so the result is cached.
       // TODO(benvanik): optimize if flag 0x40 (consecutive) is set.
-      if (entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) {
+      if ((entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) &&
+          !TakeCachedExtents(entry.get(), start_block_index, file_size)) {
+        auto& block_list = entry->block_list_;
         uint32_t block_index = start_block_index;
         size_t remaining_size = file_size;
         uint32_t info = 0x80;
@@ -536,7 +569,12 @@ StfsContainerDevice::Error StfsContainerDevice::ReadSTFS() {
           size_t block_size =
               std::min(static_cast<size_t>(0x1000), remaining_size);
           size_t offset = BlockToOffsetSTFS(block_index);
-          entry->block_list_.push_back({0, offset, block_size});
+          if (!block_list.empty() &&
+              block_list.back().offset + block_list.back().length == offset) {
+            block_list.back().length += block_size;
+          } else {
+            block_list.push_back({0, offset, block_size, 0});
+          }
           remaining_size -= block_size;
           auto block_hash = GetBlockHash(data, block_index, 0);
           if (table_size_shift_ && block_hash.info < 0x80) {
@@ -546,8 +584,11 @@ StfsContainerDevice::Error StfsContainerDevice::ReadSTFS() {
           info = block_hash.info;
         }
       }
+      if (entry->attributes() & X_FILE_ATTRIBUTE_NORMAL) {
+        FinishExtents(entry.get(), start_block_index, file_size);
+      }
 
-      parent_entry->children_.emplace_back(std::move(entry));
+      parent_entry->AddChild(std::move(entry));
     }
 
     auto block_hash = GetBlockHash(data, table_block_index, 0);
@@ -608,6 +649,165 @@ StfsContainerDevice::BlockHash StfsContainerDevice::GetBlockHash(
   return {next_block_index, info};
 }
 
+namespace {
+
+const uint32_t kExtentCacheMagic = 'XSEC';
+const uint32_t kExtentCacheVersion = 1;
+
+struct ExtentCacheHeader {
+  uint32_t magic;
+  uint32_t version;
+  // Identifies the package the cache was built from.
+  uint64_t package_size;
+  uint64_t package_write_timestamp;
+  uint64_t data_file_combined_size;
+  uint64_t file_count;
+};
+
+// Followed by record_count records of file, offset and length.
+struct ExtentCacheFile {
+  uint64_t block;
+  uint64_t size;
+  uint64_t record_count;
+};
+
+}  // namespace
+
+void StfsContainerDevice::LoadExtentCache() {
+  filesystem::FileInfo package_info;
+  if (!filesystem::GetInfo(local_path_, &package_info)) {
+    return;
+  }
+  auto path = extent_cache_path();
+  FILE* file = filesystem::OpenFile(path, "rb");
+  if (!file) {
+    return;
+  }
+  std::vector<uint8_t> data;
+  uint8_t chunk[64 * 1024];
+  size_t chunk_size;
+  while ((chunk_size = fread(chunk, 1, sizeof(chunk), file)) != 0) {
+    data.insert(data.end(), chunk, chunk + chunk_size);
+  }
+  fclose(file);
+
+  // Anything unexpected discards the whole cache.
+  size_t offset = 0;
+  auto read = [&](void* out, size_t size) {
+    if (data.size() - offset < size) {
+      return false;
+    }
+    std::memcpy(out, data.data() + offset, size);
+    offset += size;
+    return true;
+  };
+  ExtentCacheHeader header;
+  if (!read(&header, sizeof(header)) || header.magic != kExtentCacheMagic ||
+      header.version != kExtentCacheVersion ||
+      header.package_size != package_info.total_size ||
+      header.package_write_timestamp != package_info.write_timestamp ||
+      header.data_file_combined_size != header_.data_file_combined_size) {
+    return;
+  }
+  std::vector<CachedExtents> cached_extents;
+  for (uint64_t i = 0; i < header.file_count; ++i) {
+    ExtentCacheFile cache_file;
+    if (!read(&cache_file, sizeof(cache_file)) ||
+        cache_file.record_count > (data.size() - offset) / 24) {
+      return;
+    }
+    CachedExtents extents;
+    extents.block = cache_file.block;
+    extents.size = cache_file.size;
+    extents.records.resize(size_t(cache_file.record_count));
+    for (auto& record : extents.records) {
+      uint64_t values[3];
+      read(values, sizeof(values));
+      record.file = size_t(values[0]);
+      record.offset = size_t(values[1]);
+      record.length = size_t(values[2]);
+      record.data_offset = 0;
+    }
+    cached_extents.push_back(std::move(extents));
+  }
+  cached_extents_ = std::move(cached_extents);
+}
+
+void StfsContainerDevice::SaveExtentCache() {
+  filesystem::FileInfo package_info;
+  if (!filesystem::GetInfo(local_path_, &package_info)) {
+    return;
+  }
+  auto path = extent_cache_path();
+  FILE* file = filesystem::OpenFile(path, "wb");
+  if (!file) {
+    // Packages on read-only media simply aren't cached.
+    XELOGW("Unable to write the STFS extent cache %s",
+           xe::to_string(path).c_str());
+    return;
+  }
+  ExtentCacheHeader header;
+  header.magic = kExtentCacheMagic;
+  header.version = kExtentCacheVersion;
+  header.package_size = package_info.total_size;
+  header.package_write_timestamp = package_info.write_timestamp;
+  header.data_file_combined_size = header_.data_file_combined_size;
+  header.file_count = mounted_files_.size();
+  fwrite(&header, sizeof(header), 1, file);
+  for (auto& mounted_file : mounted_files_) {
+    auto& block_list = mounted_file.entry->block_list();
+    ExtentCacheFile cache_file;
+    cache_file.block = mounted_file.block;
+    cache_file.size = mounted_file.size;
+    cache_file.record_count = block_list.size();
+    fwrite(&cache_file, sizeof(cache_file), 1, file);
+    for (auto& record : block_list) {
+      uint64_t values[3] = {record.file, record.offset, record.length};
+      fwrite(values, sizeof(values), 1, file);
+    }
+  }
+  fclose(file);
+}
+
+bool StfsContainerDevice::TakeCachedExtents(StfsContainerEntry* entry,
+                                            uint64_t block, uint64_t size) {
+  if (next_cached_extents_ >= cached_extents_.size()) {
+    ++extent_cache_misses_;
+    return false;
+  }
+  auto& cached = cached_extents_[next_cached_extents_++];
+  bool valid = cached.block == block && cached.size == size;
+  uint64_t total_length = 0;
+  for (size_t i = 0; valid && i < cached.records.size(); ++i) {
+    auto& record = cached.records[i];
+    auto mmap_it = mmap_.find(record.file);
+    valid = mmap_it != mmap_.end() &&
+            record.offset <= mmap_it->second->size() &&
+            record.length <= mmap_it->second->size() - record.offset;
+    total_length += record.length;
+  }
+  if (!valid || total_length < size) {
+    // Out of step with the package, so nothing after this can be trusted.
+    ++extent_cache_misses_;
+    cached_extents_.clear();
+    next_cached_extents_ = 0;
+    return false;
+  }
+  entry->block_list_ = std::move(cached.records);
+  return true;
+}
+
+void StfsContainerDevice::FinishExtents(StfsContainerEntry* entry,
+                                        uint64_t block, uint64_t size) {
+  size_t data_offset = 0;
+  for (auto& record : entry->block_list_) {
+    record.data_offset = data_offset;
+    data_offset += record.length;
+  }
+  mounted_extent_count_ += entry->block_list_.size();
+  mounted_files_.push_back({entry, block, size});
+}
+
 bool StfsVolumeDescriptor::Read(const uint8_t* p) {
   descriptor_size = xe::load_and_swap<uint8_t>(p + 0x00);
   if (descriptor_size != 0x24) {
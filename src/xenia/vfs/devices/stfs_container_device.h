@@ -13,17 +13,17 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "xenia/base/mapped_memory.h"
 #include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/stfs_container_entry.h"
 
 namespace xe {
 namespace vfs {
 
 // http://www.free60.org/wiki/STFS
 
-class StfsContainerEntry;
-
 enum class StfsPackageType {
   kCon,
   kPirs,
@@ -214,6 +214,30 @@ class StfsContainerDevice : public Device {
   BlockHash GetBlockHash(const uint8_t* map_ptr, uint32_t block_index,
                          uint32_t table_offset);
 
+  // The extent index of every file is cached beside the package, in the
+  // order ReadSTFS and ReadSVOD create the files, so remounting skips the
+  // block chain walks.
+  struct CachedExtents {
+    uint64_t block;
+    uint64_t size;
+    std::vector<StfsContainerEntry::BlockRecord> records;
+  };
+  struct MountedFile {
+    StfsContainerEntry* entry;
+    uint64_t block;
+    uint64_t size;
+  };
+  std::wstring extent_cache_path() const { return local_path_ + L".extents"; }
+  void LoadExtentCache();
+  void SaveExtentCache();
+  // Fills the block list of the next file from the cache if it is there and
+  // matches the file's first block and size.
+  bool TakeCachedExtents(StfsContainerEntry* entry, uint64_t block,
+                         uint64_t size);
+  // Sets the data offsets of a file's completed block list.
+  void FinishExtents(StfsContainerEntry* entry, uint64_t block,
+                     uint64_t size);
+
   std::wstring local_path_;
   std::map<size_t, std::unique_ptr<MappedMemory>> mmap_;
   size_t mmap_total_size_;
@@ -224,6 +248,13 @@ class StfsContainerDevice : public Device {
   StfsPackageType package_type_;
   StfsHeader header_;
   uint32_t table_size_shift_;
+
+  // Only used while mounting.
+  std::vector<CachedExtents> cached_extents_;
+  size_t next_cached_extents_ = 0;
+  size_t extent_cache_misses_ = 0;
+  std::vector<MountedFile> mounted_files_;
+  size_t mounted_extent_count_ = 0;
 };
 
 }  // namespace vfs
@@ -43,11 +43,15 @@ class StfsContainerEntry : public Entry {
 
   X_STATUS Open(uint32_t desired_access, File** out_file) override;
 
+  // A physically contiguous extent of the file's data.
   struct BlockRecord {
     size_t file;
     size_t offset;
     size_t length;
+    // Offset of the extent within the file's data.
+    size_t data_offset;
   };
+  // Extents in data order, for binary searching by data_offset.
   const std::vector<BlockRecord>& block_list() const { return block_list_; }
 
  private:
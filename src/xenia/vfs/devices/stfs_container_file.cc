@@ -13,6 +13,7 @@
 #include <cmath>
 
 #include "xenia/base/math.h"
+#include "xenia/base/memory.h"
 #include "xenia/vfs/devices/stfs_container_entry.h"
 
 namespace xe {
@@ -33,37 +34,70 @@ X_STATUS StfsContainerFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_END_OF_FILE;
   }
 
-  size_t src_offset = 0;
   uint8_t* p = reinterpret_cast<uint8_t*>(buffer);
-  size_t remaining_length =
-      std::min(buffer_length, entry_->size() - byte_offset);
-  *out_bytes_read = remaining_length;
-
-  for (size_t i = 0; i < entry_->block_list().size(); i++) {
-    auto& record = entry_->block_list()[i];
-    if (src_offset + record.length <= byte_offset) {
-      // Doesn't begin in this region. Skip it.
-      src_offset += record.length;
-      continue;
-    }
+  size_t read_length = std::min(buffer_length, entry_->size() - byte_offset);
+  *out_bytes_read = read_length;
+  TrackRead(byte_offset, read_length);
+
+  // Physically contiguous records are copied, and prefetched, as one run.
+  ForEachRun(byte_offset, read_length,
+             [&p](const uint8_t* src, size_t length) {
+               CopyFromMapping(p, src, length);
+               p += length;
+             });
+
+  return X_STATUS_SUCCESS;
+}
+
+void StfsContainerFile::PrefetchRange(size_t byte_offset, size_t length) {
+  ForEachRun(byte_offset, length, [](const uint8_t* src, size_t length) {
+    xe::memory::Prefetch(src, length);
+  });
+}
 
+void StfsContainerFile::ForEachRun(
+    size_t byte_offset, size_t length,
+    const std::function<void(const uint8_t* src, size_t length)>& fn) {
+  const uint8_t* run_src = nullptr;
+  size_t run_length = 0;
+  size_t remaining_length = length;
+
+  // Find the extent holding byte_offset, then walk from it onwards.
+  auto& block_list = entry_->block_list();
+  auto it = std::upper_bound(
+      block_list.begin(), block_list.end(), byte_offset,
+      [](size_t offset, const StfsContainerEntry::BlockRecord& record) {
+        return offset < record.data_offset;
+      });
+  if (it != block_list.begin()) {
+    --it;
+  }
+  for (; it != block_list.end() && remaining_length; ++it) {
+    auto& record = *it;
     uint8_t* src = entry_->mmap()->at(record.file)->data();
 
-    size_t read_offset =
-        (byte_offset > src_offset) ? byte_offset - src_offset : 0;
+    size_t read_offset = byte_offset > record.data_offset
+                             ? byte_offset - record.data_offset
+                             : 0;
+    if (read_offset >= record.length) {
+      continue;
+    }
     size_t read_length =
         std::min(record.length - read_offset, remaining_length);
-    std::memcpy(p, src + record.offset + read_offset, read_length);
-
-    p += read_length;
-    src_offset += record.length;
-    remaining_length -= read_length;
-    if (remaining_length == 0) {
-      break;
+    const uint8_t* read_src = src + record.offset + read_offset;
+    if (run_length && run_src + run_length != read_src) {
+      fn(run_src, run_length);
+      run_length = 0;
+    }
+    if (!run_length) {
+      run_src = read_src;
     }
+    run_length += read_length;
+    remaining_length -= read_length;
+  }
+  if (run_length) {
+    fn(run_src, run_length);
   }
-
-  return X_STATUS_SUCCESS;
 }
 
 }  // namespace vfs
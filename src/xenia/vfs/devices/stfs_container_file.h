@@ -10,6 +10,8 @@
 #ifndef XENIA_VFS_DEVICES_STFS_CONTAINER_FILE_H_
 #define XENIA_VFS_DEVICES_STFS_CONTAINER_FILE_H_
 
+#include <functional>
+
 #include "xenia/vfs/file.h"
 
 #include "xenia/xbox.h"
@@ -35,6 +37,14 @@ class StfsContainerFile : public File {
   X_STATUS SetLength(size_t length) override { return X_STATUS_ACCESS_DENIED; }
 
  private:
+  void PrefetchRange(size_t byte_offset, size_t length) override;
+
+  // Calls fn with each physically contiguous run of mapped data holding the
+  // given range of the file, in file order.
+  void ForEachRun(size_t byte_offset, size_t length,
+                  const std::function<void(const uint8_t* src,
+                                           size_t length)>& fn);
+
   StfsContainerEntry* entry_;
 };
 
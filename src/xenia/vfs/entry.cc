@@ -16,6 +16,40 @@
 namespace xe {
 namespace vfs {
 
+namespace {
+
+inline char FoldNameChar(char c) {
+  return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+}  // namespace
+
+size_t EntryNameHash::operator()(const std::string& name) const {
+  // FNV-1a over the case-folded name.
+  uint64_t hash = 0xCBF29CE484222325ull;
+  for (char c : name) {
+    hash ^= uint8_t(FoldNameChar(c));
+    hash *= 0x100000001B3ull;
+  }
+  return size_t(hash);
+}
+
+bool EntryNameEqual::operator()(const std::string& a,
+                                const std::string& b) const {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (FoldNameChar(a[i]) != FoldNameChar(b[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::atomic<uint64_t> Entry::tree_generation_(0);
+std::recursive_mutex Entry::populate_mutex_;
+
 Entry::Entry(Device* device, Entry* parent, const std::string& path)
     : device_(device),
       parent_(parent),
@@ -25,7 +59,8 @@ Entry::Entry(Device* device, Entry* parent, const std::string& path)
       allocation_size_(0),
       create_timestamp_(0),
       access_timestamp_(0),
-      write_timestamp_(0) {
+      write_timestamp_(0),
+      children_populated_(true) {
   assert_not_null(device);
   absolute_path_ = xe::join_paths(device->mount_path(), path);
   name_ = xe::find_name_from_path(path);
@@ -39,27 +74,55 @@ void Entry::Dump(xe::StringBuffer* string_buffer, int indent) {
   }
   string_buffer->Append(name());
   string_buffer->Append('\n');
-  for (auto& child : children_) {
+  for (auto& child : children()) {
     child->Dump(string_buffer, indent + 2);
   }
 }
 
 bool Entry::is_read_only() const { return device_->is_read_only(); }
 
-Entry* Entry::GetChild(std::string name) {
-  auto global_lock = global_critical_region_.Acquire();
-  // TODO(benvanik): a faster search
-  for (auto& child : children_) {
-    if (strcasecmp(child->name().c_str(), name.c_str()) == 0) {
-      return child.get();
-    }
+Entry* Entry::GetChild(const std::string& name) {
+  EnsureChildrenPopulated();
+  std::shared_lock<std::shared_timed_mutex> lock(children_mutex_);
+  auto it = child_index_.find(name);
+  return it != child_index_.end() ? it->second : nullptr;
+}
+
+Entry* Entry::AddChild(std::unique_ptr<Entry> child) {
+  auto child_ptr = InsertChild(std::move(child));
+  tree_generation_.fetch_add(1, std::memory_order_release);
+  return child_ptr;
+}
+
+Entry* Entry::AddPopulatedChild(std::unique_ptr<Entry> child) {
+  return InsertChild(std::move(child));
+}
+
+Entry* Entry::InsertChild(std::unique_ptr<Entry> child) {
+  std::unique_lock<std::shared_timed_mutex> lock(children_mutex_);
+  auto child_ptr = child.get();
+  child_index_.emplace(child_ptr->name(), child_ptr);
+  children_.push_back(std::move(child));
+  return child_ptr;
+}
+
+void Entry::EnsureChildrenPopulated() {
+  UpdateChildren();
+  if (children_populated_.load(std::memory_order_acquire)) {
+    return;
   }
-  return nullptr;
+  std::lock_guard<std::recursive_mutex> lock(populate_mutex_);
+  if (children_populated_.load(std::memory_order_relaxed)) {
+    return;
+  }
+  PopulateChildren();
+  children_populated_.store(true, std::memory_order_release);
 }
 
 Entry* Entry::IterateChildren(const xe::filesystem::WildcardEngine& engine,
                               size_t* current_index) {
-  auto global_lock = global_critical_region_.Acquire();
+  EnsureChildrenPopulated();
+  std::shared_lock<std::shared_timed_mutex> lock(children_mutex_);
   while (*current_index < children_.size()) {
     auto& child = children_[*current_index];
     *current_index = *current_index + 1;
@@ -72,6 +135,7 @@ Entry* Entry::IterateChildren(const xe::filesystem::WildcardEngine& engine,
 
 Entry* Entry::CreateEntry(std::string name, uint32_t attributes) {
   auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<std::recursive_mutex> populate_lock(populate_mutex_);
   if (is_read_only()) {
     return nullptr;
   }
@@ -83,14 +147,15 @@ Entry* Entry::CreateEntry(std::string name, uint32_t attributes) {
   if (!entry) {
     return nullptr;
   }
-  children_.push_back(std::move(entry));
   // TODO(benvanik): resort? would break iteration?
+  auto entry_ptr = AddChild(std::move(entry));
   Touch();
-  return children_.back().get();
+  return entry_ptr;
 }
 
 bool Entry::Delete(Entry* entry) {
   auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<std::recursive_mutex> populate_lock(populate_mutex_);
   if (is_read_only()) {
     return false;
   }
@@ -100,14 +165,39 @@ bool Entry::Delete(Entry* entry) {
   if (!DeleteEntryInternal(entry)) {
     return false;
   }
+  RemoveChild(entry);
+  Touch();
+  return true;
+}
+
+std::unique_ptr<Entry> Entry::RemoveChild(Entry* entry) {
+  std::unique_ptr<Entry> removed;
+  std::unique_lock<std::shared_timed_mutex> lock(children_mutex_);
+  std::string entry_name = entry->name();
+  auto index_it = child_index_.find(entry_name);
+  bool was_indexed =
+      index_it != child_index_.end() && index_it->second == entry;
+  if (was_indexed) {
+    child_index_.erase(index_it);
+  }
   for (auto it = children_.begin(); it != children_.end(); ++it) {
     if (it->get() == entry) {
+      removed = std::move(*it);
       children_.erase(it);
       break;
     }
   }
-  Touch();
-  return true;
+  if (was_indexed) {
+    // Index the next child with the same name, if there is one.
+    for (auto& child : children_) {
+      if (EntryNameEqual()(child->name(), entry_name)) {
+        child_index_.emplace(child->name(), child.get());
+        break;
+      }
+    }
+  }
+  tree_generation_.fetch_add(1, std::memory_order_release);
+  return removed;
 }
 
 bool Entry::Delete() {
@@ -10,8 +10,12 @@
 #ifndef XENIA_VFS_ENTRY_H_
 #define XENIA_VFS_ENTRY_H_
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "xenia/base/filesystem.h"
@@ -76,6 +80,15 @@ enum FileAttributeFlags : uint32_t {
   kFileAttributeEncrypted = 0x4000,
 };
 
+// Hashing and comparison of entry names, which like strcasecmp ignore ASCII
+// case.
+struct EntryNameHash {
+  size_t operator()(const std::string& name) const;
+};
+struct EntryNameEqual {
+  bool operator()(const std::string& a, const std::string& b) const;
+};
+
 class Entry {
  public:
   virtual ~Entry();
@@ -96,12 +109,19 @@ class Entry {
 
   bool is_read_only() const;
 
-  Entry* GetChild(std::string name);
+  // Finds a child by case-insensitive name through a hashed index. Lookups
+  // only take a shared lock on this entry, so they may run concurrently.
+  Entry* GetChild(const std::string& name);
 
-  const std::vector<std::unique_ptr<Entry>>& children() const {
+  // Lazily populated directories read their children in on first access.
+  const std::vector<std::unique_ptr<Entry>>& children() {
+    EnsureChildrenPopulated();
     return children_;
   }
-  size_t child_count() const { return children_.size(); }
+  size_t child_count() {
+    EnsureChildrenPopulated();
+    return children_.size();
+  }
   Entry* IterateChildren(const xe::filesystem::WildcardEngine& engine,
                          size_t* current_index);
 
@@ -110,6 +130,12 @@ class Entry {
   bool Delete();
   void Touch();
 
+  // Incremented whenever a child is added to or removed from any entry, so
+  // caches of resolved paths know when to drop their contents.
+  static uint64_t tree_generation() {
+    return tree_generation_.load(std::memory_order_acquire);
+  }
+
   // If successful, out_file points to a new file. When finished, call
   // file->Destroy()
   virtual X_STATUS Open(uint32_t desired_access, File** out_file) = 0;
@@ -130,6 +156,37 @@ class Entry {
   }
   virtual bool DeleteEntryInternal(Entry* entry) { return false; }
 
+  // Appends a child and adds it to the name index. Devices populating their
+  // trees must add children through this.
+  Entry* AddChild(std::unique_ptr<Entry> child);
+
+  // Devices that read directories on demand call MarkChildrenUnpopulated on
+  // them and override PopulateChildren, which is called once before the
+  // children are first looked up or enumerated. It adds them with
+  // AddPopulatedChild, as they existed all along and so leave resolved path
+  // caches valid.
+  void MarkChildrenUnpopulated() {
+    children_populated_.store(false, std::memory_order_release);
+  }
+  virtual void PopulateChildren() {}
+  Entry* AddPopulatedChild(std::unique_ptr<Entry> child);
+  // Called before every lookup or enumeration of the children, without any
+  // entry lock held, for devices to apply changes made behind their back.
+  virtual void UpdateChildren() {}
+
+  // Held while populating any entry and while the guest creates or deletes
+  // children, so devices may change their trees under it without the global
+  // lock. Taken after the global lock, if both are.
+  static std::recursive_mutex& populate_mutex() { return populate_mutex_; }
+  // Drops resolved path caches ahead of a tree change a device has deferred.
+  static void InvalidateResolvedPaths() {
+    tree_generation_.fetch_add(1, std::memory_order_release);
+  }
+
+  // Detaches a child from the tree without touching the backing storage,
+  // returning ownership of it.
+  std::unique_ptr<Entry> RemoveChild(Entry* entry);
+
   xe::global_critical_region global_critical_region_;
   Device* device_;
   Entry* parent_;
@@ -143,6 +200,24 @@ class Entry {
   uint64_t access_timestamp_;
   uint64_t write_timestamp_;
   std::vector<std::unique_ptr<Entry>> children_;
+
+ private:
+  void EnsureChildrenPopulated();
+  Entry* InsertChild(std::unique_ptr<Entry> child);
+
+  std::atomic<bool> children_populated_;
+  // Each directory is populated once, so contention is rare.
+  static std::recursive_mutex populate_mutex_;
+
+  // Guards children_ and child_index_: shared for lookups and iteration,
+  // exclusive for changes.
+  std::shared_timed_mutex children_mutex_;
+  // Children by name. With several children differing only in case the
+  // first one is indexed, as a linear search would have found.
+  std::unordered_map<std::string, Entry*, EntryNameHash, EntryNameEqual>
+      child_index_;
+
+  static std::atomic<uint64_t> tree_generation_;
 };
 
 }  // namespace vfs
@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/file.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstring>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
+#include "xenia/vfs/entry.h"
+#include "xenia/vfs/vfs_flags.h"
+
+namespace xe {
+namespace vfs {
+
+namespace {
+
+// Number of sequential reads in a row before prefetching starts, so files
+// read once in one request or at random offsets are not prefetched.
+const uint32_t kReadAheadMinSequentialReads = 2;
+
+std::atomic<uint64_t> read_ahead_reads(0);
+std::atomic<uint64_t> read_ahead_sequential_reads(0);
+std::atomic<uint64_t> read_ahead_hits(0);
+std::atomic<uint64_t> read_ahead_misses(0);
+std::atomic<uint64_t> read_ahead_prefetches(0);
+std::atomic<uint64_t> read_ahead_prefetched_bytes(0);
+
+}  // namespace
+
+ReadAheadStats File::read_ahead_stats() {
+  ReadAheadStats stats;
+  stats.reads = read_ahead_reads.load(std::memory_order_relaxed);
+  stats.sequential_reads =
+      read_ahead_sequential_reads.load(std::memory_order_relaxed);
+  stats.hits = read_ahead_hits.load(std::memory_order_relaxed);
+  stats.misses = read_ahead_misses.load(std::memory_order_relaxed);
+  stats.prefetches = read_ahead_prefetches.load(std::memory_order_relaxed);
+  stats.prefetched_bytes =
+      read_ahead_prefetched_bytes.load(std::memory_order_relaxed);
+  return stats;
+}
+
+void File::ResetReadAheadStats() {
+  read_ahead_reads.store(0, std::memory_order_relaxed);
+  read_ahead_sequential_reads.store(0, std::memory_order_relaxed);
+  read_ahead_hits.store(0, std::memory_order_relaxed);
+  read_ahead_misses.store(0, std::memory_order_relaxed);
+  read_ahead_prefetches.store(0, std::memory_order_relaxed);
+  read_ahead_prefetched_bytes.store(0, std::memory_order_relaxed);
+}
+
+void File::LogReadAheadStats() {
+  ReadAheadStats stats = read_ahead_stats();
+  if (!stats.reads) {
+    return;
+  }
+  XELOGI("VFS read-ahead: %" PRIu64 " reads, %" PRIu64 " sequential, %" PRIu64
+         " hits, %" PRIu64 " misses, %" PRIu64 " prefetches of %" PRIu64
+         " KiB",
+         stats.reads, stats.sequential_reads, stats.hits, stats.misses,
+         stats.prefetches, stats.prefetched_bytes / 1024);
+}
+
+void File::TrackRead(size_t byte_offset, size_t length) {
+  if (!FLAGS_vfs_read_ahead || !length) {
+    return;
+  }
+  read_ahead_reads.fetch_add(1, std::memory_order_relaxed);
+  size_t read_end = byte_offset + length;
+  size_t prefetch_offset = 0;
+  size_t prefetch_length = 0;
+  {
+    std::lock_guard<std::mutex> lock(read_ahead_mutex_);
+    bool sequential = byte_offset == next_read_offset_;
+    next_read_offset_ = read_end;
+    if (!sequential) {
+      sequential_read_count_ = 0;
+      return;
+    }
+    ++sequential_read_count_;
+    read_ahead_sequential_reads.fetch_add(1, std::memory_order_relaxed);
+    if (byte_offset >= prefetch_start_ && read_end <= prefetch_end_) {
+      read_ahead_hits.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      read_ahead_misses.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (sequential_read_count_ < kReadAheadMinSequentialReads) {
+      return;
+    }
+
+    // Top the window up once the reader is halfway through it, so the host
+    // has time to load the next part before it is needed.
+    size_t window_size = size_t(std::max(FLAGS_vfs_read_ahead_size, 0));
+    if (prefetch_end_ >= read_end + window_size / 2) {
+      return;
+    }
+    size_t window_end = std::min(read_end + window_size, entry_->size());
+    if (prefetch_end_ < read_end || prefetch_start_ > byte_offset) {
+      // A new stream, or one that overtook the window.
+      prefetch_start_ = read_end;
+      prefetch_end_ = read_end;
+    }
+    if (window_end <= prefetch_end_) {
+      return;
+    }
+    prefetch_offset = prefetch_end_;
+    prefetch_length = window_end - prefetch_end_;
+    prefetch_end_ = window_end;
+  }
+  read_ahead_prefetches.fetch_add(1, std::memory_order_relaxed);
+  read_ahead_prefetched_bytes.fetch_add(prefetch_length,
+                                        std::memory_order_relaxed);
+  PrefetchRange(prefetch_offset, prefetch_length);
+}
+
+void File::CopyFromMapping(void* dest, const uint8_t* src, size_t length) {
+  // A copy from cold pages faults them in one readahead window at a time;
+  // hinting the whole range first lets the host issue large reads instead.
+  if (FLAGS_vfs_read_prefetch &&
+      length >= size_t(FLAGS_vfs_read_prefetch_min_size)) {
+    xe::memory::Prefetch(src, length);
+  }
+  std::memcpy(dest, src, length);
+}
+
+}  // namespace vfs
+}  // namespace xe
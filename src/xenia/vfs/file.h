@@ -10,7 +10,9 @@
 #ifndef XENIA_VFS_FILE_H_
 #define XENIA_VFS_FILE_H_
 
+#include <cstddef>
 #include <cstdint>
+#include <mutex>
 
 #include "xenia/xbox.h"
 
@@ -19,6 +21,20 @@ namespace vfs {
 
 class Entry;
 
+// Read-ahead counters summed over all files, for tuning
+// --vfs_read_ahead_size against streaming-heavy titles.
+struct ReadAheadStats {
+  uint64_t reads;
+  // Reads starting where the previous read of the same file ended.
+  uint64_t sequential_reads;
+  // Sequential reads entirely inside a range prefetched ahead of them.
+  uint64_t hits;
+  // Sequential reads that were not (fully) prefetched.
+  uint64_t misses;
+  uint64_t prefetches;
+  uint64_t prefetched_bytes;
+};
+
 class File {
  public:
   File(uint32_t file_access, Entry* entry)
@@ -51,10 +67,35 @@ class File {
   const Entry* entry() const { return entry_; }
   Entry* entry() { return entry_; }
 
+  static ReadAheadStats read_ahead_stats();
+  static void ResetReadAheadStats();
+  static void LogReadAheadStats();
+
  protected:
+  // Called by ReadSync implementations with each request. Once a file is
+  // read sequentially, keeps the data past the reader being loaded through
+  // PrefetchRange.
+  void TrackRead(size_t byte_offset, size_t length);
+  // Starts loading part of the file into host memory without waiting for it.
+  virtual void PrefetchRange(size_t byte_offset, size_t length) {}
+
+  // Copies part of a memory-mapped image into a read buffer, prefetching the
+  // source first if it is large.
+  static void CopyFromMapping(void* dest, const uint8_t* src, size_t length);
+
   // xe::filesystem::FileAccess
   uint32_t file_access_ = 0;
   Entry* entry_ = nullptr;
+
+ private:
+  // Guards the read-ahead state below, as overlapped reads may run
+  // concurrently.
+  std::mutex read_ahead_mutex_;
+  size_t next_read_offset_ = 0;
+  uint32_t sequential_read_count_ = 0;
+  // Range prefetched so far for the current sequential stream.
+  size_t prefetch_start_ = 0;
+  size_t prefetch_end_ = 0;
 };
 
 }  // namespace vfs
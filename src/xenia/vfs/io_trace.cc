@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/io_trace.h"
+
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/string.h"
+#include "xenia/vfs/vfs_flags.h"
+
+namespace xe {
+namespace vfs {
+
+namespace {
+
+const char kHeader[] = "# xenia vfs io trace v1";
+// Records are flushed in batches, so a crash loses at most this many.
+const uint32_t kFlushInterval = 1024;
+
+const char* kOpNames[] = {"open", "read", "write", "querydir", "stat"};
+
+class IoTraceWriter {
+ public:
+  ~IoTraceWriter() {
+    if (file_) {
+      fclose(file_);
+    }
+  }
+
+  void Write(uint64_t start_us, uint64_t duration_us, IoTraceRecord::Op op,
+             const std::string& path, uint64_t offset, uint64_t length,
+             uint32_t status) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) {
+      if (failed_) {
+        return;
+      }
+      file_ = xe::filesystem::OpenFile(xe::to_wstring(FLAGS_vfs_io_trace),
+                                       "w");
+      if (!file_) {
+        XELOGE("Unable to open I/O trace %s", FLAGS_vfs_io_trace.c_str());
+        failed_ = true;
+        return;
+      }
+      fprintf(file_, "%s\n", kHeader);
+    }
+    fprintf(file_,
+            "%s %" PRIu64 " %" PRIu64 " 0x%.8X %" PRIu64 " %" PRIu64 " %s\n",
+            IoTrace::OpName(op), start_us, duration_us, status, offset,
+            length, path.c_str());
+    if (++record_count_ % kFlushInterval == 0) {
+      fflush(file_);
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  FILE* file_ = nullptr;
+  bool failed_ = false;
+  uint32_t record_count_ = 0;
+};
+
+IoTraceWriter writer_;
+// Host tick count of the first request, which record times are relative to.
+std::atomic<uint64_t> base_ticks_(0);
+
+uint64_t TicksToMicroseconds(uint64_t ticks) {
+  uint64_t frequency = Clock::host_tick_frequency();
+  return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+}  // namespace
+
+uint64_t IoTrace::Begin() {
+  if (FLAGS_vfs_io_trace.empty()) {
+    return 0;
+  }
+  uint64_t ticks = Clock::QueryHostTickCount();
+  uint64_t expected = 0;
+  base_ticks_.compare_exchange_strong(expected, ticks);
+  return ticks ? ticks : 1;
+}
+
+void IoTrace::Append(uint64_t begin_ticks, IoTraceRecord::Op op,
+                     const std::string& path, uint64_t offset, uint64_t length,
+                     uint32_t status) {
+  if (!begin_ticks) {
+    return;
+  }
+  uint64_t end_ticks = Clock::QueryHostTickCount();
+  uint64_t base_ticks = base_ticks_.load();
+  uint64_t start_us = begin_ticks > base_ticks
+                          ? TicksToMicroseconds(begin_ticks - base_ticks)
+                          : 0;
+  uint64_t duration_us = end_ticks > begin_ticks
+                             ? TicksToMicroseconds(end_ticks - begin_ticks)
+                             : 0;
+  writer_.Write(start_us, duration_us, op, path, offset, length, status);
+}
+
+bool IoTrace::Load(const std::wstring& path,
+                   std::vector<IoTraceRecord>* out_records) {
+  FILE* file = xe::filesystem::OpenFile(path, "r");
+  if (!file) {
+    XELOGE("Unable to open I/O trace %s", xe::to_string(path).c_str());
+    return false;
+  }
+  char line[4096];
+  if (!fgets(line, sizeof(line), file) ||
+      std::strncmp(line, kHeader, sizeof(kHeader) - 1) != 0) {
+    XELOGE("%s is not an I/O trace", xe::to_string(path).c_str());
+    fclose(file);
+    return false;
+  }
+  size_t line_number = 1;
+  while (fgets(line, sizeof(line), file)) {
+    ++line_number;
+    size_t line_length = std::strlen(line);
+    while (line_length && (line[line_length - 1] == '\n' ||
+                           line[line_length - 1] == '\r')) {
+      line[--line_length] = 0;
+    }
+    if (!line_length || line[0] == '#') {
+      continue;
+    }
+    char op_name[16];
+    IoTraceRecord record;
+    int path_start = 0;
+    if (sscanf(line,
+               "%15s %" SCNu64 " %" SCNu64 " %" SCNx32 " %" SCNu64
+               " %" SCNu64 " %n",
+               op_name, &record.start_us, &record.duration_us, &record.status,
+               &record.offset, &record.length, &path_start) != 6 ||
+        !path_start) {
+      XELOGW("I/O trace line %zu is malformed; skipped", line_number);
+      continue;
+    }
+    size_t op_index = 0;
+    while (op_index < xe::countof(kOpNames) &&
+           std::strcmp(op_name, kOpNames[op_index]) != 0) {
+      ++op_index;
+    }
+    if (op_index == xe::countof(kOpNames)) {
+      XELOGW("I/O trace line %zu has unknown operation %s; skipped",
+             line_number, op_name);
+      continue;
+    }
+    record.op = IoTraceRecord::Op(op_index);
+    record.path = line + path_start;
+    out_records->push_back(std::move(record));
+  }
+  fclose(file);
+  return true;
+}
+
+const char* IoTrace::OpName(IoTraceRecord::Op op) {
+  return kOpNames[size_t(op)];
+}
+
+}  // namespace vfs
+}  // namespace xe
@@ -0,0 +1,65 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_IO_TRACE_H_
+#define XENIA_VFS_IO_TRACE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace xe {
+namespace vfs {
+
+struct IoTraceRecord {
+  enum class Op : uint8_t {
+    kOpen,
+    kRead,
+    kWrite,
+    kQueryDirectory,
+    kQueryAttributes,
+  };
+
+  Op op;
+  // Microseconds since the first record, and spent completing the request.
+  uint64_t start_us;
+  uint64_t duration_us;
+  uint32_t status;
+  // Byte range of reads and writes. For directory queries offset is 1 when
+  // the scan restarts, and length is that of the name filter that ends the
+  // path, if any.
+  uint64_t offset;
+  uint64_t length;
+  // Absolute guest path, such as \Device\Cdrom0\default.xex.
+  std::string path;
+};
+
+// Text log of the file requests guests make, written when --vfs_io_trace is
+// set, so xenia-vfs-bench can replay them against a device outside of the
+// emulator. One record per line:
+//   <op> <start_us> <duration_us> <status> <offset> <length> <path>
+class IoTrace {
+ public:
+  // Returns the start time to pass to Append, or 0 if tracing is off.
+  static uint64_t Begin();
+  // Thread safe.
+  static void Append(uint64_t begin_ticks, IoTraceRecord::Op op,
+                     const std::string& path, uint64_t offset, uint64_t length,
+                     uint32_t status);
+
+  static bool Load(const std::wstring& path,
+                   std::vector<IoTraceRecord>* out_records);
+
+  static const char* OpName(IoTraceRecord::Op op);
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_IO_TRACE_H_
@@ -15,6 +15,7 @@ project("xenia-vfs")
     project_root.."/third_party/gflags/src",
   })
   recursive_platform_files()
+  removefiles({"vfs_bench.cc"})
   removefiles({"vfs_dump.cc"})
 
 project("xenia-vfs-dump")
@@ -42,3 +43,25 @@ project("xenia-vfs-dump")
     project_root,
   })
 
+
+project("xenia-vfs-bench")
+  uuid("4b0a8f3e-6c2d-4e71-9a5f-0d3c7e2b1a64")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "gflags",
+    "xenia-base",
+    "xenia-vfs",
+  })
+  defines({})
+  includedirs({
+    project_root.."/third_party/gflags/src",
+  })
+
+  files({
+    "vfs_bench.cc",
+    project_root.."/src/xenia/base/main_"..platform_suffix..".cc",
+  })
+  resincludedirs({
+    project_root,
+  })
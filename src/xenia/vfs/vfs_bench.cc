@@ -0,0 +1,650 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <gflags/gflags.h>
+
+#include <algorithm>
+#include <cctype>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/filesystem_wildcard.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/main.h"
+#include "xenia/base/math.h"
+#include "xenia/base/string.h"
+#include "xenia/vfs/device.h"
+#include "xenia/vfs/devices/disc_image_device.h"
+#include "xenia/vfs/devices/disc_image_entry.h"
+#include "xenia/vfs/devices/host_path_device.h"
+#include "xenia/vfs/devices/stfs_container_device.h"
+#include "xenia/vfs/entry.h"
+#include "xenia/vfs/file.h"
+#include "xenia/vfs/io_trace.h"
+#include "xenia/vfs/vfs_flags.h"
+#include "xenia/vfs/virtual_file_system.h"
+
+DEFINE_int32(vfs_bench_entries, 100000,
+             "Number of entries in each synthetic tree.");
+DEFINE_int32(vfs_bench_lookups, 100000, "Number of lookups per iteration.");
+DEFINE_int32(vfs_bench_iterations, 10,
+             "Number of times each benchmark is repeated.");
+DEFINE_string(vfs_bench_image, "",
+              "Disc image or STFS package to time mounting and whole-file "
+              "reads from. Compare runs with --vfs_read_prefetch and "
+              "--vfs_read_ahead on and off, starting from a cold host page "
+              "cache.");
+DEFINE_int32(vfs_bench_read_size, 1024 * 1024,
+             "Size in bytes of each read from --vfs_bench_image.");
+DEFINE_string(vfs_bench_trace, "",
+              "I/O trace recorded with --vfs_io_trace to replay against "
+              "--vfs_bench_image (which may also be a host folder), reporting "
+              "latency percentiles and read throughput per operation.");
+
+namespace xe {
+namespace vfs {
+
+// Entry that only exists in memory, for building large synthetic trees.
+class BenchEntry : public Entry {
+ public:
+  BenchEntry(Device* device, Entry* parent, const std::string& path,
+             uint32_t attributes)
+      : Entry(device, parent, path) {
+    attributes_ = attributes;
+  }
+
+  BenchEntry* AddBenchChild(const std::string& name, uint32_t attributes) {
+    return static_cast<BenchEntry*>(AddChild(std::make_unique<BenchEntry>(
+        device_, this, xe::join_paths(path_, name), attributes)));
+  }
+
+  X_STATUS Open(uint32_t desired_access, File** out_file) override {
+    return X_STATUS_ACCESS_DENIED;
+  }
+};
+
+class BenchDevice : public Device {
+ public:
+  explicit BenchDevice(const std::string& mount_path) : Device(mount_path) {
+    root_entry_ = std::make_unique<BenchEntry>(this, nullptr, "",
+                                               kFileAttributeDirectory);
+  }
+
+  bool Initialize() override { return true; }
+  void Dump(StringBuffer* string_buffer) override {
+    root_entry_->Dump(string_buffer, 0);
+  }
+  Entry* ResolvePath(std::string path) override {
+    Entry* entry = root_entry_.get();
+    for (auto& part : xe::split_path(path)) {
+      entry = entry->GetChild(part);
+      if (!entry) {
+        return nullptr;
+      }
+    }
+    return entry;
+  }
+
+  uint32_t total_allocation_units() const override { return 1; }
+  uint32_t available_allocation_units() const override { return 0; }
+  uint32_t sectors_per_allocation_unit() const override { return 1; }
+  uint32_t bytes_per_sector() const override { return 2 * 1024; }
+
+  BenchEntry* root_entry() const { return root_entry_.get(); }
+
+ private:
+  std::unique_ptr<BenchEntry> root_entry_;
+};
+
+// Mounts another device's tree, so fresh file systems can share one tree.
+class ForwardingDevice : public Device {
+ public:
+  ForwardingDevice(const std::string& mount_path, Device* target)
+      : Device(mount_path), target_(target) {}
+
+  bool Initialize() override { return true; }
+  void Dump(StringBuffer* string_buffer) override {
+    target_->Dump(string_buffer);
+  }
+  Entry* ResolvePath(std::string path) override {
+    return target_->ResolvePath(path);
+  }
+
+  uint32_t total_allocation_units() const override { return 1; }
+  uint32_t available_allocation_units() const override { return 0; }
+  uint32_t sectors_per_allocation_unit() const override { return 1; }
+  uint32_t bytes_per_sector() const override { return 2 * 1024; }
+
+ private:
+  Device* target_;
+};
+
+// Child lookup and path resolution over synthetic trees: one flat directory
+// holding every entry, and a nested tree of the same size as a game disc
+// would have.
+class VfsBench {
+ public:
+  void Run() {
+    entry_count_ = uint32_t(std::max(FLAGS_vfs_bench_entries, 1));
+    lookup_count_ = uint32_t(std::max(FLAGS_vfs_bench_lookups, 1));
+    XELOGI("VFS benchmark: %u entries, %u lookups, %d iterations",
+           entry_count_, lookup_count_, FLAGS_vfs_bench_iterations);
+
+    BenchChildLookup();
+    BenchResolvePath();
+    if (!FLAGS_vfs_bench_image.empty()) {
+      if (!FLAGS_vfs_bench_trace.empty()) {
+        BenchTraceReplay(FLAGS_vfs_bench_image, FLAGS_vfs_bench_trace);
+        return;
+      }
+      BenchImageMount(FLAGS_vfs_bench_image);
+      BenchImageReads(FLAGS_vfs_bench_image);
+    }
+  }
+
+ private:
+  // Runs fn, doing lookup_count lookups, iterations times and logs the time
+  // per lookup.
+  void Measure(const std::string& name, uint32_t lookup_count,
+               const std::function<void()>& fn) {
+    uint64_t start = Clock::QueryHostTickCount();
+    for (int i = 0; i < FLAGS_vfs_bench_iterations; ++i) {
+      fn();
+    }
+    uint64_t ticks = Clock::QueryHostTickCount() - start;
+    double seconds = double(ticks) / double(Clock::host_tick_frequency());
+    double lookups = double(lookup_count) * FLAGS_vfs_bench_iterations;
+    XELOGI("  %-40s %10.1f ns/lookup", name.c_str(),
+           seconds * 1.0e9 / lookups);
+  }
+
+  static std::string FileName(uint32_t i) {
+    return "File" + std::to_string(i) + ".bin";
+  }
+
+  // Flips the case of some letters, as titles rarely match the case on disc.
+  static std::string Recase(std::string name, uint32_t seed) {
+    for (size_t i = 0; i < name.size(); ++i) {
+      if ((seed >> (i & 31)) & 1) {
+        name[i] = char(std::toupper(uint8_t(name[i])));
+      }
+    }
+    return name;
+  }
+
+  // The lookup the index replaced: a scan comparing every name.
+  static Entry* LinearGetChild(Entry* parent, const std::string& name) {
+    for (auto& child : parent->children()) {
+      if (strcasecmp(child->name().c_str(), name.c_str()) == 0) {
+        return child.get();
+      }
+    }
+    return nullptr;
+  }
+
+  void BenchChildLookup() {
+    BenchDevice device("\\Device\\Flat");
+    auto root = device.root_entry();
+    for (uint32_t i = 0; i < entry_count_; ++i) {
+      root->AddBenchChild(FileName(i), kFileAttributeNormal);
+    }
+
+    std::mt19937 random(0x56465342);
+    std::vector<std::string> names(lookup_count_);
+    for (auto& name : names) {
+      name = Recase(FileName(random() % entry_count_), uint32_t(random()));
+    }
+
+    XELOGI("Child lookup in a directory of %u entries:", entry_count_);
+    // The linear scan is far slower, so only a slice of the names is used.
+    uint32_t linear_count = std::max(lookup_count_ / 100, 1u);
+    size_t found = 0;
+    Measure("Linear strcasecmp scan", linear_count, [&]() {
+      for (uint32_t i = 0; i < linear_count; ++i) {
+        found += LinearGetChild(root, names[i]) != nullptr;
+      }
+    });
+    Measure("Hashed GetChild", lookup_count_, [&]() {
+      for (auto& name : names) {
+        found += root->GetChild(name) != nullptr;
+      }
+    });
+    if (!found) {
+      XELOGE("No entries found");
+    }
+  }
+
+  void BenchResolvePath() {
+    // Square-ish tree: sqrt(n) directories of sqrt(n) files each.
+    uint32_t fanout = 1;
+    while (fanout * fanout < entry_count_) {
+      ++fanout;
+    }
+    BenchDevice device("\\Device\\Bench");
+    auto root = device.root_entry();
+    for (uint32_t i = 0; i < fanout; ++i) {
+      auto dir = root->AddBenchChild("Dir" + std::to_string(i),
+                                     kFileAttributeDirectory);
+      for (uint32_t j = 0; j < fanout; ++j) {
+        dir->AddBenchChild(FileName(j), kFileAttributeNormal);
+      }
+    }
+
+    // Distinct paths in random order, so no lookup of a pass hits the cache
+    // for an earlier one.
+    std::mt19937 random(0x52534C56);
+    uint32_t file_count = fanout * fanout;
+    std::vector<uint32_t> order(file_count);
+    for (uint32_t i = 0; i < file_count; ++i) {
+      order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), random);
+    std::vector<std::string> paths(lookup_count_);
+    for (uint32_t i = 0; i < lookup_count_; ++i) {
+      uint32_t file = order[i % file_count];
+      paths[i] = "game:\\Dir" + std::to_string(file / fanout) + "\\" +
+                 Recase(FileName(file % fanout), uint32_t(random()));
+    }
+
+    XELOGI("ResolvePath in a %ux%u tree:", fanout, fanout);
+    size_t found = 0;
+    // Every cold pass resolves through a new, empty file system.
+    Measure("Cold (uncached)", lookup_count_, [&]() {
+      VirtualFileSystem fs;
+      fs.RegisterDevice(
+          std::make_unique<ForwardingDevice>("\\Device\\Bench", &device));
+      fs.RegisterSymbolicLink("game:", "\\Device\\Bench");
+      for (auto& path : paths) {
+        found += fs.ResolvePath(path) != nullptr;
+      }
+    });
+    VirtualFileSystem fs;
+    fs.RegisterDevice(
+        std::make_unique<ForwardingDevice>("\\Device\\Bench", &device));
+    fs.RegisterSymbolicLink("game:", "\\Device\\Bench");
+    for (auto& path : paths) {
+      found += fs.ResolvePath(path) != nullptr;
+    }
+    Measure("Cached", lookup_count_, [&]() {
+      for (auto& path : paths) {
+        found += fs.ResolvePath(path) != nullptr;
+      }
+    });
+    if (!found) {
+      XELOGE("No paths resolved");
+    }
+  }
+
+  static double SecondsSince(uint64_t start_ticks) {
+    return double(Clock::QueryHostTickCount() - start_ticks) /
+           double(Clock::host_tick_frequency());
+  }
+
+  // Disc images only read directories when first accessed: compares the
+  // mount against materializing every entry, as mounting used to.
+  void BenchImageMount(const std::string& path) {
+    uint64_t start = Clock::QueryHostTickCount();
+    DiscImageDevice device("\\Device\\Image", xe::to_wstring(path));
+    if (!device.Initialize()) {
+      return;
+    }
+    double mount_seconds = SecondsSince(start);
+    size_t mount_entries = device.entry_count();
+
+    start = Clock::QueryHostTickCount();
+    std::vector<Entry*> pending = {device.ResolvePath("")};
+    while (!pending.empty()) {
+      Entry* entry = pending.back();
+      pending.pop_back();
+      for (auto& child : entry->children()) {
+        pending.push_back(child.get());
+      }
+    }
+    double walk_seconds = SecondsSince(start);
+    size_t all_entries = device.entry_count();
+
+    XELOGI("Mount of %s:", path.c_str());
+    XELOGI("  mount       %9.3f ms %8zu entries %8zu KiB", mount_seconds * 1e3,
+           mount_entries, mount_entries * sizeof(DiscImageEntry) / 1024);
+    XELOGI("  whole tree  %9.3f ms %8zu entries %8zu KiB",
+           (mount_seconds + walk_seconds) * 1e3, all_entries,
+           all_entries * sizeof(DiscImageEntry) / 1024);
+  }
+
+  // Mounts a disc image, STFS package or host folder.
+  static std::unique_ptr<Device> MountImage(const std::string& path) {
+    std::wstring local_path = xe::to_wstring(path);
+    xe::filesystem::FileInfo info;
+    std::unique_ptr<Device> device;
+    if (xe::filesystem::GetInfo(local_path, &info) &&
+        info.type == xe::filesystem::FileInfo::Type::kDirectory) {
+      device = std::make_unique<HostPathDevice>("\\Device\\Image",
+                                                local_path, true);
+      if (device->Initialize()) {
+        return device;
+      }
+    } else {
+      device = std::make_unique<DiscImageDevice>("\\Device\\Image",
+                                                 local_path);
+      if (device->Initialize()) {
+        return device;
+      }
+      device = std::make_unique<StfsContainerDevice>("\\Device\\Image",
+                                                     local_path);
+      if (device->Initialize()) {
+        return device;
+      }
+    }
+    XELOGE("Unable to mount %s", path.c_str());
+    return nullptr;
+  }
+
+  // Reads every file of the image once, front to back, as a title streaming
+  // its assets would.
+  void BenchImageReads(const std::string& path) {
+    auto device = MountImage(path);
+    if (!device) {
+      return;
+    }
+
+    File::ResetReadAheadStats();
+    size_t read_size = size_t(std::max(FLAGS_vfs_bench_read_size, 1));
+    std::vector<uint8_t> buffer(read_size);
+    size_t file_count = 0;
+    size_t bytes_total = 0;
+    uint64_t start = Clock::QueryHostTickCount();
+    std::vector<Entry*> pending = {device->ResolvePath("")};
+    while (!pending.empty()) {
+      Entry* entry = pending.back();
+      pending.pop_back();
+      for (auto& child : entry->children()) {
+        pending.push_back(child.get());
+      }
+      if (entry->attributes() & kFileAttributeDirectory) {
+        continue;
+      }
+      File* file = nullptr;
+      if (XFAILED(entry->Open(FileAccess::kFileReadData, &file))) {
+        continue;
+      }
+      ++file_count;
+      for (size_t offset = 0; offset < entry->size(); offset += read_size) {
+        size_t bytes_read = 0;
+        if (XFAILED(file->ReadSync(buffer.data(), read_size, offset,
+                                   &bytes_read)) ||
+            !bytes_read) {
+          break;
+        }
+        bytes_total += bytes_read;
+      }
+      file->Destroy();
+    }
+    uint64_t ticks = Clock::QueryHostTickCount() - start;
+    double seconds = double(ticks) / double(Clock::host_tick_frequency());
+
+    XELOGI("Reads from %s, %zu byte requests, prefetch %s, read-ahead %s:",
+           path.c_str(), read_size, FLAGS_vfs_read_prefetch ? "on" : "off",
+           FLAGS_vfs_read_ahead ? "on" : "off");
+    XELOGI("  %zu files, %.1f MiB in %.3f s, %.1f MiB/s", file_count,
+           bytes_total / (1024.0 * 1024.0), seconds,
+           bytes_total / (1024.0 * 1024.0) / seconds);
+    File::LogReadAheadStats();
+  }
+
+  // Splits \Device\Cdrom0\a\b.bin or game:\a\b.bin into the device, in
+  // lower case, and the path on it.
+  static bool SplitDevicePath(const std::string& path, std::string* device,
+                              std::string* relative_path) {
+    std::string normalized = xe::fix_path_separators(path, '\\');
+    const char kDevicePrefix[] = "\\Device\\";
+    size_t device_end;
+    if (xe::find_first_of_case(normalized, kDevicePrefix) == 0) {
+      device_end = std::min(
+          normalized.find('\\', sizeof(kDevicePrefix) - 1), normalized.size());
+    } else {
+      device_end = normalized.find(':');
+      if (device_end == std::string::npos) {
+        return false;
+      }
+      ++device_end;
+    }
+    *device = normalized.substr(0, device_end);
+    for (auto& c : *device) {
+      c = char(std::tolower(uint8_t(c)));
+    }
+    size_t path_start = normalized.find_first_not_of('\\', device_end);
+    *relative_path = path_start == std::string::npos
+                         ? std::string()
+                         : normalized.substr(path_start);
+    return true;
+  }
+
+  struct ReplayOp {
+    std::vector<double> latencies_us;
+    std::vector<double> traced_us;
+    size_t skipped = 0;
+    // Replayed requests that failed when the traced one succeeded, or the
+    // other way around.
+    size_t mismatched = 0;
+    size_t bytes = 0;
+  };
+
+  // Reissues the traced requests made to one device back to back, without
+  // the gaps between them, against the image. Requests to other devices are
+  // skipped, as are writes so the image is left as it was.
+  void BenchTraceReplay(const std::string& image_path,
+                        const std::string& trace_path) {
+    std::vector<IoTraceRecord> records;
+    if (!IoTrace::Load(xe::to_wstring(trace_path), &records)) {
+      return;
+    }
+
+    // Replay the device the title used most, which is usually the disc.
+    std::unordered_map<std::string, size_t> device_counts;
+    std::string device_name;
+    std::string relative_path;
+    for (auto& record : records) {
+      if (SplitDevicePath(record.path, &device_name, &relative_path)) {
+        ++device_counts[device_name];
+      }
+    }
+    std::string replay_device;
+    size_t replay_count = 0;
+    for (auto& it : device_counts) {
+      if (it.second > replay_count) {
+        replay_device = it.first;
+        replay_count = it.second;
+      }
+    }
+
+    auto device = MountImage(image_path);
+    if (!device) {
+      return;
+    }
+
+    struct DirectoryScan {
+      xe::filesystem::WildcardEngine engine;
+      size_t index = 0;
+    };
+    std::unordered_map<std::string, File*> files;
+    std::unordered_map<std::string, DirectoryScan> scans;
+    std::vector<uint8_t> buffer;
+    ReplayOp ops[5];
+    size_t other_device_count = 0;
+
+    // Files are kept open from their open to the end of the replay. Files
+    // read without a traced open, as they were opened before recording
+    // began, are opened outside of the timed region of the read.
+    auto open_file = [&](const std::string& path, Entry* entry) -> File* {
+      File* file = nullptr;
+      if (!entry ||
+          XFAILED(entry->Open(FileAccess::kFileReadData, &file))) {
+        file = nullptr;
+      }
+      // Reopening replaces the handle, as the title closed the old one.
+      File*& slot = files[path];
+      if (slot) {
+        slot->Destroy();
+      }
+      slot = file;
+      return file;
+    };
+
+    File::ResetReadAheadStats();
+    uint64_t replay_start = Clock::QueryHostTickCount();
+    for (auto& record : records) {
+      ReplayOp& op = ops[size_t(record.op)];
+      if (!SplitDevicePath(record.path, &device_name, &relative_path) ||
+          device_name != replay_device) {
+        ++other_device_count;
+        continue;
+      }
+      bool traced_success = XSUCCEEDED(record.status);
+      bool success = false;
+      uint64_t start = 0;
+      switch (record.op) {
+        case IoTraceRecord::Op::kOpen:
+        case IoTraceRecord::Op::kQueryAttributes: {
+          start = Clock::QueryHostTickCount();
+          Entry* entry = device->ResolvePath(relative_path);
+          if (entry && record.op == IoTraceRecord::Op::kOpen &&
+              !(entry->attributes() & kFileAttributeDirectory)) {
+            success = open_file(relative_path, entry) != nullptr;
+          } else {
+            success = entry != nullptr;
+          }
+          break;
+        }
+        case IoTraceRecord::Op::kRead: {
+          if (!traced_success) {
+            ++op.skipped;
+            continue;
+          }
+          auto it = files.find(relative_path);
+          File* file = it != files.end()
+                           ? it->second
+                           : open_file(relative_path,
+                                       device->ResolvePath(relative_path));
+          if (!file) {
+            ++op.mismatched;
+            continue;
+          }
+          buffer.resize(std::max(buffer.size(), size_t(record.length)));
+          size_t bytes_read = 0;
+          start = Clock::QueryHostTickCount();
+          success = XSUCCEEDED(file->ReadSync(buffer.data(), record.length,
+                                              record.offset, &bytes_read));
+          op.bytes += bytes_read;
+          break;
+        }
+        case IoTraceRecord::Op::kQueryDirectory: {
+          std::string directory = relative_path;
+          std::string pattern;
+          if (record.length && record.length <= directory.size()) {
+            pattern = directory.substr(directory.size() - record.length);
+            directory.resize(directory.size() - record.length);
+            while (!directory.empty() && directory.back() == '\\') {
+              directory.pop_back();
+            }
+          }
+          auto& scan = scans[directory];
+          if (record.offset) {
+            scan.index = 0;
+          }
+          if (!pattern.empty()) {
+            scan.engine.SetRule(pattern);
+          }
+          start = Clock::QueryHostTickCount();
+          Entry* entry = device->ResolvePath(directory);
+          success = entry && entry->IterateChildren(scan.engine, &scan.index);
+          break;
+        }
+        case IoTraceRecord::Op::kWrite:
+        default:
+          ++op.skipped;
+          continue;
+      }
+      op.latencies_us.push_back(SecondsSince(start) * 1e6);
+      op.traced_us.push_back(double(record.duration_us));
+      if (success != traced_success) {
+        ++op.mismatched;
+      }
+    }
+    double replay_seconds = SecondsSince(replay_start);
+    for (auto& it : files) {
+      if (it.second) {
+        it.second->Destroy();
+      }
+    }
+
+    XELOGI("Replay of %s (%zu records, device %s) against %s in %.3f s:",
+           trace_path.c_str(), records.size(), replay_device.c_str(),
+           image_path.c_str(), replay_seconds);
+    XELOGI("  %-8s %8s %9s %9s %9s %9s %10s %6s %5s", "op", "count",
+           "p50 us", "p90 us", "p99 us", "max us", "traced p50", "skip",
+           "diff");
+    for (size_t i = 0; i < xe::countof(ops); ++i) {
+      ReplayOp& op = ops[i];
+      if (op.latencies_us.empty() && !op.skipped && !op.mismatched) {
+        continue;
+      }
+      auto& latencies = op.latencies_us;
+      std::sort(latencies.begin(), latencies.end());
+      std::sort(op.traced_us.begin(), op.traced_us.end());
+      XELOGI("  %-8s %8zu %9.1f %9.1f %9.1f %9.1f %10.1f %6zu %5zu",
+             IoTrace::OpName(IoTraceRecord::Op(i)), latencies.size(),
+             Percentile(latencies, 0.5), Percentile(latencies, 0.9),
+             Percentile(latencies, 0.99), Percentile(latencies, 1.0),
+             Percentile(op.traced_us, 0.5), op.skipped, op.mismatched);
+    }
+    ReplayOp& reads = ops[size_t(IoTraceRecord::Op::kRead)];
+    double read_seconds = 0.0;
+    for (double latency : reads.latencies_us) {
+      read_seconds += latency / 1e6;
+    }
+    if (read_seconds > 0.0) {
+      XELOGI("  Reads: %.1f MiB at %.1f MiB/s", reads.bytes / 1048576.0,
+             reads.bytes / 1048576.0 / read_seconds);
+    }
+    if (other_device_count) {
+      XELOGI("  %zu records for other devices skipped", other_device_count);
+    }
+    File::LogReadAheadStats();
+  }
+
+  // Nearest-rank percentile of sorted values.
+  static double Percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+      return 0.0;
+    }
+    size_t rank = size_t(p * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+  }
+
+  uint32_t entry_count_ = 0;
+  uint32_t lookup_count_ = 0;
+};
+
+int vfs_bench_main(const std::vector<std::wstring>& args) {
+  VfsBench bench;
+  bench.Run();
+  return 0;
+}
+
+}  // namespace vfs
+}  // namespace xe
+
+DEFINE_ENTRY_POINT(L"xenia-vfs-bench", L"xenia-vfs-bench",
+                   xe::vfs::vfs_bench_main);
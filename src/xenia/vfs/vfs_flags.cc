@@ -0,0 +1,37 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/vfs_flags.h"
+
+DEFINE_bool(vfs_read_prefetch, true,
+            "Ask the host to page in the source range of large reads from "
+            "disc images and STFS packages before copying it.");
+DEFINE_int32(vfs_read_prefetch_min_size, 64 * 1024,
+             "Size in bytes of the smallest contiguous read that is "
+             "prefetched.");
+
+DEFINE_bool(vfs_read_ahead, true,
+            "Detect guest files being read sequentially and have the host "
+            "load the data past each read in the background.");
+DEFINE_int32(vfs_read_ahead_size, 2 * 1024 * 1024,
+             "Size in bytes of the range kept prefetched past sequential "
+             "reads.");
+
+DEFINE_bool(vfs_stfs_extent_cache, true,
+            "Cache the extents of the files in STFS and SVOD packages in a "
+            ".extents file beside the package, to speed up later mounts.");
+
+DEFINE_bool(vfs_host_path_watch, true,
+            "Watch host folders mounted as devices for changes made outside "
+            "of the emulator, so their cached listings stay current.");
+
+DEFINE_string(vfs_io_trace, "",
+              "Path of a file to record the guest's file opens, reads, writes "
+              "and queries to, with their timings, for replaying with "
+              "xenia-vfs-bench --vfs_bench_trace.");
@@ -0,0 +1,27 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2018 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_VFS_FLAGS_H_
+#define XENIA_VFS_VFS_FLAGS_H_
+
+#include <gflags/gflags.h>
+
+DECLARE_bool(vfs_read_prefetch);
+DECLARE_int32(vfs_read_prefetch_min_size);
+
+DECLARE_bool(vfs_read_ahead);
+DECLARE_int32(vfs_read_ahead_size);
+
+DECLARE_bool(vfs_stfs_extent_cache);
+
+DECLARE_bool(vfs_host_path_watch);
+
+DECLARE_string(vfs_io_trace);
+
+#endif  // XENIA_VFS_VFS_FLAGS_H_
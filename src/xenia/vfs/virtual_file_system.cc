@@ -13,13 +13,19 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
 #include "xenia/kernel/xfile.h"
+#include "xenia/vfs/file.h"
 
 namespace xe {
 namespace vfs {
 
+// Resolved paths kept before the cache is emptied.
+constexpr size_t kMaxResolveCacheSize = 64 * 1024;
+
 VirtualFileSystem::VirtualFileSystem() {}
 
 VirtualFileSystem::~VirtualFileSystem() {
+  File::LogReadAheadStats();
+
   // Delete all devices.
   // This will explode if anyone is still using data from them.
   devices_.clear();
@@ -27,17 +33,19 @@ VirtualFileSystem::~VirtualFileSystem() {
 }
 
 bool VirtualFileSystem::RegisterDevice(std::unique_ptr<Device> device) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
   devices_.emplace_back(std::move(device));
+  ClearResolveCache();
   return true;
 }
 
 bool VirtualFileSystem::UnregisterDevice(const std::string& path) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
   for (auto it = devices_.begin(); it != devices_.end(); ++it) {
     if ((*it)->mount_path() == path) {
       XELOGD("Unregistered device: %s", (*it)->mount_path().c_str());
       devices_.erase(it);
+      ClearResolveCache();
       return true;
     }
   }
@@ -46,15 +54,16 @@ bool VirtualFileSystem::UnregisterDevice(const std::string& path) {
 
 bool VirtualFileSystem::RegisterSymbolicLink(const std::string& path,
                                              const std::string& target) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
   symlinks_.insert({path, target});
+  ClearResolveCache();
   XELOGD("Registered symbolic link: %s => %s", path.c_str(), target.c_str());
 
   return true;
 }
 
 bool VirtualFileSystem::UnregisterSymbolicLink(const std::string& path) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
   auto it = symlinks_.find(path);
   if (it == symlinks_.end()) {
     return false;
@@ -63,11 +72,12 @@ bool VirtualFileSystem::UnregisterSymbolicLink(const std::string& path) {
          it->second.c_str());
 
   symlinks_.erase(it);
+  ClearResolveCache();
   return true;
 }
 
 bool VirtualFileSystem::IsSymbolicLink(const std::string& path) {
-  auto global_lock = global_critical_region_.Acquire();
+  std::shared_lock<std::shared_timed_mutex> lock(mutex_);
   auto it = symlinks_.find(path);
   if (it == symlinks_.end()) {
     return false;
@@ -76,8 +86,42 @@ bool VirtualFileSystem::IsSymbolicLink(const std::string& path) {
 }
 
 Entry* VirtualFileSystem::ResolvePath(const std::string& path) {
-  auto global_lock = global_critical_region_.Acquire();
+  uint64_t generation = Entry::tree_generation();
+  uint64_t epoch;
+  Entry* entry;
+  {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    if (resolve_cache_generation_ == generation) {
+      auto it = resolve_cache_.find(path);
+      if (it != resolve_cache_.end()) {
+        return it->second;
+      }
+    }
+    epoch = resolve_cache_epoch_;
+    entry = ResolvePathUncached(path);
+  }
+
+  // Only remember the result if no entry was created or deleted, and no
+  // device or symbolic link changed, meanwhile.
+  std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+  if (Entry::tree_generation() == generation &&
+      resolve_cache_epoch_ == epoch) {
+    if (resolve_cache_generation_ != generation ||
+        resolve_cache_.size() >= kMaxResolveCacheSize) {
+      resolve_cache_.clear();
+      resolve_cache_generation_ = generation;
+    }
+    resolve_cache_.emplace(path, entry);
+  }
+  return entry;
+}
+
+void VirtualFileSystem::ClearResolveCache() {
+  resolve_cache_.clear();
+  ++resolve_cache_epoch_;
+}
 
+Entry* VirtualFileSystem::ResolvePathUncached(const std::string& path) {
   // Resolve relative paths
   std::string normalized_path(xe::filesystem::CanonicalizePath(path));
 
@@ -100,7 +144,7 @@ Entry* VirtualFileSystem::ResolvePath(const std::string& path) {
     }
 
     // Break as soon as we've completely resolved the symlinks to a device.
-    if (!IsSymbolicLink(device_path)) {
+    if (!symlinks_.count(device_path)) {
       break;
     }
   }
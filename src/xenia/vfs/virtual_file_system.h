@@ -11,11 +11,11 @@
 #define XENIA_VFS_VIRTUAL_FILE_SYSTEM_H_
 
 #include <memory>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
-#include "xenia/base/mutex.h"
 #include "xenia/vfs/device.h"
 #include "xenia/vfs/entry.h"
 #include "xenia/vfs/file.h"
@@ -47,9 +47,24 @@ class VirtualFileSystem {
                     FileAction* out_action);
 
  private:
-  xe::global_critical_region global_critical_region_;
+  // Resolves the path without consulting the cache. mutex_ must be held.
+  Entry* ResolvePathUncached(const std::string& path);
+  void ClearResolveCache();
+
+  // Guards everything below. Path resolution only takes it shared.
+  std::shared_timed_mutex mutex_;
   std::vector<std::unique_ptr<Device>> devices_;
   std::unordered_map<std::string, std::string> symlinks_;
+
+  // Results of ResolvePath, including failed ones, by the path as passed in.
+  // Dropped whenever the entry tree generation moves, that is after any
+  // entry is created or deleted.
+  std::unordered_map<std::string, Entry*, EntryNameHash, EntryNameEqual>
+      resolve_cache_;
+  uint64_t resolve_cache_generation_ = 0;
+  // Incremented by ClearResolveCache, so lookups that raced a device or
+  // symbolic link change don't cache what they resolved.
+  uint64_t resolve_cache_epoch_ = 0;
 };
 
 }  // namespace vfs